@@ -1,15 +1,98 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<math.h>
+#include<string.h>
 #include<omp.h>
+#include "profile.h"
+#include "checkpoint.h"
+#include "dataset.h"
+#include "arena.h"
+#include "reduce.h"
+
+// Build with -DPCA_COMPONENTS=k to project the raw features onto their top
+// k principal components before they enter the GCN layers. The basis is
+// saved next to the dataset as pca.bin.
+#ifdef PCA_COMPONENTS
+#include "pca.h"
+#endif
+
+// Build with -DGCN_NUMA to pin the threads, split the node rows between the
+// NUMA domains and first-touch each domain's feature rows from its own
+// threads; add -DGCN_NUMA_REPLICATE to also give every domain its own copy of
+// the CSR and labels
+#ifdef GCN_NUMA
+#include "numa_place.h"
+NumaLayout numa;
+#endif
+
+// Build with -DGCN_OOC to keep the features and every layer's activations in
+// binary files under GCN_OOC_DIR instead of RAM. Each layer is computed one
+// block of GCN_OOC_BLOCK_ROWS nodes at a time from the halo rows it reads,
+// through a GCN_OOC_CACHE_MB block cache that prefetches the next block's
+// halo while the current one computes.
+#ifdef GCN_OOC
+#if defined(GCN_NUMA) || defined(PCA_COMPONENTS)
+#error "GCN_OOC cannot be combined with GCN_NUMA or PCA_COMPONENTS"
+#endif
+#include "ooc.h"
+#ifndef GCN_OOC_DIR
+#define GCN_OOC_DIR "."
+#endif
+#ifndef GCN_OOC_BLOCK_ROWS
+#define GCN_OOC_BLOCK_ROWS 4096
+#endif
+#ifndef GCN_OOC_CACHE_MB
+#define GCN_OOC_CACHE_MB 256
+#endif
+// ooc_h[ooc_cur] holds the current activations; the other file receives the
+// next layer
+OocMatrix ooc_h[2];
+int ooc_cur;
+OocCache ooc_cache;
+OocPlan ooc_plan[2];
+float *ooc_halo;
+float *ooc_out;
+// Epochs of the last two row snapshots saved with a checkpoint (-1: none)
+int ooc_saved[2] = {-1, -1};
+#endif
+
+// Build with -DGCN_NORM=GRAPH_NORM_SYM (or _ROW, _MEAN) to aggregate over the
+// normalized adjacency with self loops instead of the raw sum capped at 50
+// neighbors. The weighted CSR is built once and cached next to the dataset
+// as graph_<norm>.bin.
+#ifdef GCN_NORM
+#if defined(GCN_NUMA) || defined(GCN_OOC)
+#error "GCN_NORM cannot be combined with GCN_NUMA or GCN_OOC"
+#endif
+#include "graph_norm.h"
+// Edge values of the normalized CSR, parallel to dest
+float *edge_weight;
+// Saved as gcn.norm = [norm, self_loops] so inference aggregates the same
+// way; [0, 0] (GRAPH_NORM_NONE) is the capped raw sum
+long gcn_norm[2] = {GCN_NORM, 1};
+#else
+long gcn_norm[2] = {0, 0};
+#endif
 
 
 #define num_layers 5
-#define num_features 500
-#define num_nodes 19717
 #define learning_rate 0.001
-#define num_edges 88648
-#define num_edges 88648
+#define gcn_seed 1
+#define checkpoint_every 10
+#define checkpoint_path "gcn_ckpt.bin"
+
+// Sizes of the loaded dataset, set once in main. feature_dim is the width
+// the layers see (num_features, or the PCA width).
+int num_nodes;
+long num_edges;
+int num_features;
+int feature_dim;
+
+// run_arena -> parameters and features, for the whole run.
+// epoch_arena -> per-epoch activations, cleared at the end of every epoch.
+Arena run_arena;
+Arena epoch_arena;
+
 
 
 typedef struct Node{
@@ -36,149 +119,571 @@ float sigmoid(float x){
 void initialize(GNN *layer){
        for(int i = 0;i<num_layers;i++){
        	       layer[i].bias = ((float)rand() / RAND_MAX) - 2.3;
- 	       layer[i].weight = (float*)(malloc(num_features * sizeof(float)));
-               for(int j = 0 ; j<num_features ; ++j){
+ 	       layer[i].weight = (float*)arenaAlloc(&run_arena, feature_dim * sizeof(float), 0);
+               for(int j = 0 ; j<feature_dim ; ++j){
 			layer[i].weight[j] = ((float)rand() / RAND_MAX);			}
        }
 }
 
 
 
-void messagePassing(Node *node, GNN *layer, int *csr, int *dest, int *label){
-	int x = 0, prev = 0, cnt = 0;
+// Sum of the first 50 neighbor rows of node i that share its label (with
+// GCN_NORM: the edge-weighted sum over all of them). Inlined so that dim is
+// a constant when called through DATASET_DISPATCH_WIDTH.
+static inline __attribute__((always_inline))
+void aggregateNode(Node *node, float *out, long *offsets, int *dest, int *label, int i, int dim){
+	for(int j = 0; j<dim; ++j){
+		out[j] = 0.0f;
+	}
+#ifdef GCN_NORM
+	for(long k = offsets[i]; k<offsets[i + 1]; k++){
+		if(label[i] == label[dest[k]]){
+			float w = edge_weight[k];
+			float *h = node[dest[k]].feature;
+			#pragma omp simd
+			for(int j = 0; j<dim; ++j){
+				out[j] += w * h[j];
+			}
+		}
+	}
+#else
+	int cnt = 0;
+	for(long k = offsets[i]; k<offsets[i + 1] && cnt<50; k++){
+		if(label[i] == label[dest[k]]){
+			cnt++;
+			float *h = node[dest[k]].feature;
+			#pragma omp simd
+			for(int j = 0; j<dim; ++j){
+				out[j] += h[j];
+			}
+		}
+	}
+#endif
+}
+
+
+#if defined(GCN_OOC)
+// Same sum as aggregateNode, reading neighbor u from row halo_of[u] of the
+// gathered halo
+static inline __attribute__((always_inline))
+void aggregateHalo(const float *halo, const int *halo_of, float *out, long *offsets, int *dest, int *label, int i, int dim){
+	for(int j = 0; j<dim; ++j){
+		out[j] = 0.0f;
+	}
+	int cnt = 0;
+	for(long k = offsets[i]; k<offsets[i + 1] && cnt<50; k++){
+		if(label[i] == label[dest[k]]){
+			cnt++;
+			const float *h = halo + (size_t)halo_of[dest[k]] * dim;
+			#pragma omp simd
+			for(int j = 0; j<dim; ++j){
+				out[j] += h[j];
+			}
+		}
+	}
+}
+
+
+// Layer by layer from ooc_h[ooc_cur] into the other file, block by block:
+// gather block b's halo, queue block b+1's halo for the prefetcher, then
+// compute and write block b
+void messagePassing(Node *node, GNN *layer, long *offsets, int *dest, int *label){
+	(void)node;
+	CSRGraph g = {num_nodes, num_edges, offsets, dest, NULL};
+	float *agg = (float*)arenaAlloc(&epoch_arena, (size_t)GCN_OOC_BLOCK_ROWS * feature_dim * sizeof(float), 0);
 	for(int l = 0 ; l<num_layers ; ++l){
-	#pragma omp parallel for num_threads(omp_get_max_threads())
-		for(int i = 0; i< num_nodes; ++i){
-			for(int j = 0; j<num_features; ++j){
-				cnt = 0;
-				float new_feat;
-				for(int k = prev; k<=csr[i];k++){
-					if(label[i] == label[dest[k]] && cnt<50){
-						cnt++;
-						new_feat += node[dest[k]].feature[j];
-					}
+		PROF_SCOPE_LAYER("ooc_layer", l);
+		OocMatrix *in = &ooc_h[ooc_cur], *out = &ooc_h[1 - ooc_cur];
+		oocCacheAttach(&ooc_cache, in);
+		OocPlan *cur = &ooc_plan[0], *next = &ooc_plan[1];
+		oocPlanBlock(cur, in, &g, label, 50, 0);
+		oocPrefetch(&ooc_cache, cur->blocks, cur->n_blocks);
+		for(int b = 0; b < in->n_blocks; ++b){
+			oocGather(&ooc_cache, cur, ooc_halo);
+			if(b + 1 < in->n_blocks){
+				oocPlanBlock(next, in, &g, label, 50, b + 1);
+				oocPrefetch(&ooc_cache, next->blocks, next->n_blocks);
+			}
+			int begin = oocBlockBegin(in, b), count = oocBlockCount(in, b);
+			#pragma omp parallel for schedule(dynamic, 64)
+			for(int r = 0; r < count; ++r){
+				float *a = agg + (size_t)r * feature_dim;
+#define AGGREGATE_HALO(W) aggregateHalo(ooc_halo, cur->halo_of, a, offsets, dest, label, begin + r, W)
+				DATASET_DISPATCH_WIDTH(feature_dim, AGGREGATE_HALO);
+#undef AGGREGATE_HALO
+				for(int j = 0; j<feature_dim; ++j){
+					ooc_out[(size_t)r * feature_dim + j] = relu(a[j]*layer[l].weight[j] + layer[l].bias);
 				}
-				node[i].feature[j] = relu(new_feat*layer[l].weight[j] + layer[l].bias);
 			}
-			x++;
-			prev = csr[x];
+			if(oocWriteBlock(out, b, ooc_out) != 0){
+				fprintf(stderr, "Error writing block %d of %s\n", b, out->path);
+				exit(1);
+			}
+			OocPlan *t = cur;
+			cur = next;
+			next = t;
 		}
+		ooc_cur = 1 - ooc_cur;
 	}
 }
+#elif defined(GCN_NUMA)
+// Each thread only takes rows of its own domain and reads that domain's
+// (possibly replicated) adjacency; agg is placed like the features
+void messagePassing(Node *node, GNN *layer, long *offsets, int *dest, int *label){
+	(void)offsets; (void)dest; (void)label;
+	size_t bytes = (size_t)num_nodes * feature_dim * sizeof(float);
+	float *agg = numaPlaceRows(&numa, NULL, num_nodes, feature_dim);
+	for(int l = 0 ; l<num_layers ; ++l){
+		{
+		PROF_SCOPE_LAYER("aggregate", l);
+		numaResetChunks(&numa);
+		#pragma omp parallel num_threads(numa.n_threads)
+		{
+		PROF_THREAD_BEGIN();
+		int tid = omp_get_thread_num(), begin, end;
+		const CSRGraph *g = numa.graph[numa.thread_domain[tid]];
+		int *lab = (int*)numa.labels[numa.thread_domain[tid]];
+		while(numaNextChunk(&numa, tid, 64, &begin, &end)){
+			for(int i = begin; i < end; ++i){
+				float *out = agg + (size_t)i * feature_dim;
+#define AGGREGATE_NODE(W) aggregateNode(node, out, g->offsets, g->indices, lab, i, W)
+				DATASET_DISPATCH_WIDTH(feature_dim, AGGREGATE_NODE);
+#undef AGGREGATE_NODE
+			}
+		}
+		PROF_THREAD_END();
+		}
+		}
+
+		PROF_SCOPE_LAYER("activation", l);
+		numaResetChunks(&numa);
+		#pragma omp parallel num_threads(numa.n_threads)
+		{
+		PROF_THREAD_BEGIN();
+		int tid = omp_get_thread_num(), begin, end;
+		while(numaNextChunk(&numa, tid, 256, &begin, &end)){
+			for(int i = begin; i < end; ++i){
+				for(int j = 0; j<feature_dim; ++j){
+					node[i].feature[j] = relu(agg[(size_t)i * feature_dim + j]*layer[l].weight[j] + layer[l].bias);
+				}
+			}
+		}
+		PROF_THREAD_END();
+		}
+	}
+	numaRelease(agg, bytes);
+}
+#else
+// Edges of node i are dest[offsets[i] .. offsets[i+1])
+void messagePassing(Node *node, GNN *layer, long *offsets, int *dest, int *label){
+	float *agg = (float*)arenaAlloc(&epoch_arena, (size_t)num_nodes * feature_dim * sizeof(float), 0);
+	for(int l = 0 ; l<num_layers ; ++l){
+		{
+		PROF_SCOPE_LAYER("aggregate", l);
+		#pragma omp parallel num_threads(omp_get_max_threads())
+		{
+		PROF_THREAD_BEGIN();
+		#pragma omp for schedule(dynamic, 64) nowait
+		for(int i = 0; i< num_nodes; ++i){
+			float *out = agg + (size_t)i * feature_dim;
+#define AGGREGATE_NODE(W) aggregateNode(node, out, offsets, dest, label, i, W)
+			DATASET_DISPATCH_WIDTH(feature_dim, AGGREGATE_NODE);
+#undef AGGREGATE_NODE
+		}
+		PROF_THREAD_END();
+		}
+		}
 
+		PROF_SCOPE_LAYER("activation", l);
+		#pragma omp parallel num_threads(omp_get_max_threads())
+		{
+		PROF_THREAD_BEGIN();
+		#pragma omp for schedule(static) nowait
+		for(int i = 0; i< num_nodes; ++i){
+			for(int j = 0; j<feature_dim; ++j){
+				node[i].feature[j] = relu(agg[(size_t)i * feature_dim + j]*layer[l].weight[j] + layer[l].bias);
+			}
+		}
+		PROF_THREAD_END();
+		}
+	}
+}
+#endif
+
+#ifdef GCN_OOC
+// Streams the current activations block by block; the per-row errors are
+// reduced the same way as in memory, so the MSE matches bit for bit
 float computeError(Node *node, int *labels){
+    PROF_SCOPE("computeError");
+    (void)node;
+
+    OocMatrix *h = &ooc_h[ooc_cur];
+    oocCacheAttach(&ooc_cache, h);
+    double *row_error = (double*)arenaAlloc(&epoch_arena, num_nodes * sizeof(double), 0);
+    for (int b = 0; b < h->n_blocks; b++) {
+        int next = b + 1;
+        if (next < h->n_blocks) {
+            oocPrefetch(&ooc_cache, &next, 1);
+        }
+        const float *rows = oocPin(&ooc_cache, b);
+        int begin = oocBlockBegin(h, b), count = oocBlockCount(h, b);
+        #pragma omp parallel for schedule(static)
+        for (int r = 0; r < count; r++) {
+            row_error[begin + r] = reduceSquaredDiffFloat(rows + (size_t)r * feature_dim, labels[begin + r], feature_dim);
+        }
+        oocUnpin(&ooc_cache, b);
+    }
+    return reduceSum(row_error, num_nodes) / num_nodes;
+}
+
 
-    float mse = 0.0;
+// Convert features.txt to the first activation file and set up the cache;
+// the text is streamed, never held in memory
+int oocSetup(Dataset *data){
+    char text[4200], path[2][4200];
+    snprintf(text, sizeof(text), "%s/features.txt", data->dir);
+    for (int k = 0; k < 2; ++k) {
+        snprintf(path[k], sizeof(path[k]), "%s/gcn_ooc_h%d.bin", GCN_OOC_DIR, k);
+    }
+    int width = 0;
+    double start = omp_get_wtime();
+    if (oocConvertText(text, path[0], data->n_nodes, &width, GCN_OOC_BLOCK_ROWS) != 0 ||
+        oocOpen(&ooc_h[0], path[0], GCN_OOC_BLOCK_ROWS) != 0 ||
+        oocCreate(&ooc_h[1], path[1], data->n_nodes, width, GCN_OOC_BLOCK_ROWS) != 0) {
+        return 1;
+    }
+    data->n_features = width;
+    ooc_cur = 0;
+    size_t block_bytes = (size_t)GCN_OOC_BLOCK_ROWS * width * sizeof(float);
+    int capacity = (int)(((size_t)GCN_OOC_CACHE_MB << 20) / block_bytes);
+    if (oocCacheInit(&ooc_cache, &ooc_h[0], capacity) != 0) {
+        return 1;
+    }
+    oocPlanInit(&ooc_plan[0], data->n_nodes, ooc_h[0].n_blocks);
+    oocPlanInit(&ooc_plan[1], data->n_nodes, ooc_h[0].n_blocks);
+    // A block's halo has at most 50 rows per node
+    long halo_rows = (long)GCN_OOC_BLOCK_ROWS * 50 < data->n_nodes ? (long)GCN_OOC_BLOCK_ROWS * 50 : data->n_nodes;
+    ooc_halo = (float*)arenaAlloc(&run_arena, (size_t)halo_rows * width * sizeof(float), 0);
+    ooc_out = (float*)arenaAlloc(&run_arena, block_bytes, 0);
+    printf("ooc: %d x %d features in %d blocks of %d rows, cache %d blocks (%.0fMB), converted in %.2fs\n",
+           data->n_nodes, width, ooc_h[0].n_blocks, GCN_OOC_BLOCK_ROWS, ooc_cache.capacity,
+           (double)ooc_cache.capacity * block_bytes / (1 << 20), omp_get_wtime() - start);
+    return 0;
+}
+#else
+// Squared error of every row, summed with the fixed-shape reduction so the
+// MSE is the same for any thread count
+float computeError(Node *node, int *labels){
+    PROF_SCOPE("computeError");
+
+    double *row_error = (double*)arenaAlloc(&epoch_arena, num_nodes * sizeof(double), 0);
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < num_nodes; i++) {
-        for (int j = 0;j<num_features;j++){
-		float error = labels[i] - node[i].feature[j];
-		mse += (error*error);
-	    }
-	}
-	    mse /= num_nodes; 
-	    return mse;
+        row_error[i] = reduceSquaredDiffFloat(node[i].feature, labels[i], feature_dim);
+    }
+    return reduceSum(row_error, num_nodes) / num_nodes;
 }
+#endif
 
 
 void backwardPass(Node *nodes,GNN* layer,int *labels) {           
 
     float error = computeError(nodes, labels);
-    for (int i = 0; i < num_layers; i++) {
-        for (int j = 0; j < num_features; j++) {
-            layer[i].weight[j] -= learning_rate * error;
+    for (int j = 0; j < feature_dim; j++) {
+        layer->weight[j] -= learning_rate * error;
+    }
+    layer->bias -= learning_rate * error;
+}
+
+
+#ifdef GCN_OOC
+// Row snapshot saved with the checkpoint of the given epoch
+void oocSnapshotPath(char *out, size_t size, const char *ckpt_path, int epoch){
+    snprintf(out, size, "%s.h%d", ckpt_path, epoch);
+}
+#endif
+
+
+// Snapshot the layer parameters and the node features the next epoch starts
+// from (messagePassing rewrites them in place, so a resumed run needs them
+// to follow the same trajectory); the writer thread does the disk I/O.
+// With GCN_OOC the rows are copied to their own matrix file here, before
+// the checkpoint that refers to it is queued.
+void saveCheckpoint(CkptWriter *writer, GNN *layers, Node *node, int epoch){
+    Checkpoint ckpt;
+    char name[CKPT_NAME_LEN];
+#ifdef GCN_OOC
+    (void)node;
+    char rows_path[4200];
+    // Once the previous checkpoint is on disk, the snapshot before it is unused
+    ckptWriterFlush(writer);
+    if(writer->errors == 0 && ooc_saved[0] >= 0){
+        oocSnapshotPath(rows_path, sizeof(rows_path), checkpoint_path, ooc_saved[0]);
+        unlink(rows_path);
+    }
+    ooc_saved[0] = ooc_saved[1];
+    oocSnapshotPath(rows_path, sizeof(rows_path), checkpoint_path, epoch);
+    if(oocSaveCopy(&ooc_h[ooc_cur], rows_path, ooc_out) != 0){
+        fprintf(stderr, "Skipping the checkpoint of epoch %d\n", epoch);
+        return;
+    }
+    ooc_saved[1] = epoch;
+#endif
+    ckptInit(&ckpt, epoch, epoch);
+    ckpt.header.rng[0] = gcn_seed;
+    for(int l = 0; l < num_layers; ++l){
+        snprintf(name, sizeof(name), "layer%d.weight", l);
+        ckptAdd1(&ckpt, name, CKPT_F32, feature_dim, layers[l].weight);
+        snprintf(name, sizeof(name), "layer%d.bias", l);
+        ckptAdd1(&ckpt, name, CKPT_F32, 1, &layers[l].bias);
+    }
+    ckptAdd1(&ckpt, "gcn.norm", CKPT_I64, 2, gcn_norm);
+#ifndef GCN_OOC
+    // Every build keeps the rows in one num_nodes x feature_dim block
+    ckptAdd2(&ckpt, "features", CKPT_F32, num_nodes, feature_dim, node[0].feature);
+#endif
+    ckptWriterSubmit(writer, &ckpt, checkpoint_path);
+}
+
+
+// Restore the layers and the node features from a checkpoint; returns the
+// epoch to resume from or -1 when the file can't be used
+int loadCheckpoint(GNN *layers, Node *node, const char *path){
+    CkptMap map;
+    if(ckptOpen(&map, path) != 0){
+        return -1;
+    }
+    char name[CKPT_NAME_LEN];
+    for(int l = 0; l < num_layers; ++l){
+        snprintf(name, sizeof(name), "layer%d.weight", l);
+        const float *w = (const float*)ckptTensor(&map, name, CKPT_F32, feature_dim);
+        snprintf(name, sizeof(name), "layer%d.bias", l);
+        const float *b = (const float*)ckptTensor(&map, name, CKPT_F32, 1);
+        if(!w || !b){
+            ckptClose(&map);
+            return -1;
         }
-        layer[i].bias -= learning_rate * error;
+        memcpy(layers[l].weight, w, feature_dim * sizeof(float));
+        layers[l].bias = b[0];
     }
+    // Checkpoints without gcn.norm predate it and used the raw sum
+    const long *norm = ckptFind(&map, "gcn.norm") ? (const long*)ckptTensor(&map, "gcn.norm", CKPT_I64, 2) : NULL;
+    if(norm ? norm[0] != gcn_norm[0] || norm[1] != gcn_norm[1] : gcn_norm[0] != 0){
+        fprintf(stderr, "%s was trained with normalization %ld, this build uses %ld\n", path,
+                norm ? norm[0] : 0L, gcn_norm[0]);
+        ckptClose(&map);
+        return -1;
+    }
+    int saved = (int)map.header->epoch;
+#ifdef GCN_OOC
+    (void)node;
+    char rows_path[4200];
+    oocSnapshotPath(rows_path, sizeof(rows_path), path, saved);
+    OocMatrix rows;
+    if(oocOpen(&rows, rows_path, GCN_OOC_BLOCK_ROWS) != 0){
+        ckptClose(&map);
+        return -1;
+    }
+    int status = oocCopyRows(&ooc_h[ooc_cur], &rows, ooc_out);
+    oocClose(&rows);
+    if(status != 0){
+        ckptClose(&map);
+        return -1;
+    }
+    if(strcmp(path, checkpoint_path) == 0){
+        ooc_saved[1] = saved;
+    }
+#else
+    const float *rows = (const float*)ckptTensor(&map, "features", CKPT_F32, (long)num_nodes * feature_dim);
+    if(!rows){
+        ckptClose(&map);
+        return -1;
+    }
+    memcpy(node[0].feature, rows, (size_t)num_nodes * feature_dim * sizeof(float));
+#endif
+    ckptClose(&map);
+    return saved + 1;
 }
 
 
-void run(Node *nodes, GNN *layers,int labels[],int csr[], int dest[]){
+void run(Node *nodes, GNN *layers,int labels[],long offsets[], int dest[], int start_epoch){
 
-    for (int epoch = 0; epoch < 100; epoch++) {
-            messagePassing(nodes, layers,csr,dest,labels);
+    CkptWriter writer;
+    ckptWriterStart(&writer);
+    PROF_INIT();
+    for (int epoch = start_epoch; epoch < 100; epoch++) {
+        PROF_EPOCH_BEGIN(epoch);
+        {
+            PROF_SCOPE("messagePassing");
+            messagePassing(nodes, layers,offsets,dest,labels);
+        }
             printf("Hello\n");
         double current_mse = computeError(nodes, labels);
         printf("Epoch %d, MSE: %lf\n", epoch, current_mse);
         
-        for (int layer = num_layers - 1; layer >= 0; layer--) {
-            backwardPass(nodes, &layers[layer], labels);
+        {
+            PROF_SCOPE("backwardPass");
+            for (int layer = num_layers - 1; layer >= 0; layer--) {
+                backwardPass(nodes, &layers[layer], labels);
+            }
         }
+        if ((epoch + 1) % checkpoint_every == 0 || epoch == 99) {
+            PROF_SCOPE("checkpoint");
+            saveCheckpoint(&writer, layers, nodes, epoch);
+        }
+        arenaClear(&epoch_arena);
+        PROF_EPOCH_END();
       }
+    PROF_FINISH("gcn_trace.json");
+#ifdef GCN_OOC
+    oocCacheReport(&ooc_cache, stdout);
+#endif
+    arenaReport(&run_arena, stdout);
+    arenaReport(&epoch_arena, stdout);
+    if (ckptWriterStop(&writer) != 0) {
+        fprintf(stderr, "Some checkpoints could not be written\n");
+    }
+#ifdef GCN_OOC
+    else if (ooc_saved[0] >= 0) {
+        char rows_path[4200];
+        oocSnapshotPath(rows_path, sizeof(rows_path), checkpoint_path, ooc_saved[0]);
+        unlink(rows_path);
+    }
+#endif
  }
 
 
-int main(){
-    GNN layer[num_layers];
-    Node node[num_nodes];
-    int labels[num_nodes];
-    int desttt[num_edges];
-
-    FILE *src = fopen("/home/anubhav/GraphNN/GNN/pubmed/src.txt", "r");
-    FILE *dest = fopen("/home/anubhav/GraphNN/GNN/pubmed/destination.txt", "r");
-    FILE *feat = fopen("/home/anubhav/GraphNN/GNN/pubmed/features.txt", "r");
-    FILE *label = fopen("/home/anubhav/GraphNN/GNN/pubmed/labels.txt", "r");
-
-    
-
-    int csr[num_nodes];
-    int i = 0,x = -1;
-    int prev = -11111;
-    int destination;
-
-    while (fscanf(src, "%d", &destination) ==1) { 
-        if(prev != destination){
-            prev = destination;
-            node[i].node = destination;
-            csr[i] = x;
-            if(i==0){
-            csr[i] = 0;}
-            i++;
-        }
-        x++;
-    }
-    int j = 0;
-     i = -1;
-     float det;
-    while (fscanf(feat, "%f", &det) ==1 ) {
+#ifdef PCA_COMPONENTS
+// Point each node at its projection of the raw feature rows onto the top
+// PCA_COMPONENTS principal axes (all of them when the rows are narrower) and
+// return that width. The projection is fitted once and saved to path, so
+// later runs and inference reuse the same basis.
+int reduceFeatures(Node *node, const float *raw, int count, const char *path){
 
-        if(j%num_features==0){
-            i++;
-            j = 0;
-            node[i].feature = (float*)malloc(num_features * sizeof(float)); 
-        }
-            // printf("%d  %d\n",j,i);
-            node[i].feature[j] = det;
-            // printf("%lf\n",nodes[i].feature[j]);
-            j++;
+    int k = PCA_COMPONENTS < num_features ? PCA_COMPONENTS : num_features;
+    if(k < PCA_COMPONENTS){
+        printf("PCA: only %d features, keeping all %d components\n", num_features, k);
+    }
+    PCAModel model;
+    int loaded = pcaLoad(&model, path) == 0;
+    if(loaded && (model.in_dim != num_features || model.k != k)){
+        pcaFree(&model);
+        loaded = 0;
+    }
+    if(!loaded){
+        double kept = pcaFit(&model, raw, count, num_features, k, 4096);
+        printf("PCA: %d components keep %.1f%% of the variance\n", model.k, 100.0 * kept);
+        pcaSave(&model, path);
+    }
 
+    float *reduced = (float*)arenaAlloc(&run_arena, (size_t)count * model.k * sizeof(float), 0);
+    pcaProject(&model, raw, count, reduced);
+    for(int i = 0; i < count; ++i){
+        node[i].feature = reduced + (size_t)i * model.k;
     }
+    pcaFree(&model);
+    return k;
+}
+#endif
 
-    i = 0;
-    while (fscanf(label, "%d", &destination)==1 ) { 
-            labels[i] = destination;
-            i++;
 
+// GCN_t1 [checkpoint|-] [dataset_dir]
+int main(int argc, char **argv){
+    Dataset data;
+    arenaInit(&run_arena, "run", 0, ARENA_HUGE_THP);
+    arenaInit(&epoch_arena, "epoch", 0, ARENA_HUGE_THP);
+#ifdef GCN_OOC
+    if (datasetLoadGraph(&data, argc > 2 ? argv[2] : DATASET_DIR) != 0 || oocSetup(&data) != 0) {
+        return 1;
     }
+#else
+    if (datasetLoad(&data, argc > 2 ? argv[2] : DATASET_DIR, 0) != 0) {
+        return 1;
+    }
+#endif
+    num_nodes = data.n_nodes;
+    num_edges = data.n_edges;
+    num_features = data.n_features;
+    feature_dim = num_features;
+    printf("Loaded %d nodes, %ld edges in %.2fs\n", num_nodes, num_edges, data.load_time);
 
-
-    i = 0;
-    while (fscanf(dest, "%d", &destination) == 1 ) {
-        desttt[i] = destination;
-        i++;
+    GNN layer[num_layers];
+    Node *node = (Node*)arenaAlloc(&run_arena, num_nodes * sizeof(Node), 0);
+    for (int i = 0; i < num_nodes; ++i) {
+        node[i].node = i;
+        node[i].feature = data.features ? data.features + (size_t)i * num_features : NULL;
+    }
+#ifdef PCA_COMPONENTS
+    char pca_path[4200];
+    snprintf(pca_path, sizeof(pca_path), "%s/pca.bin", data.dir);
+    feature_dim = reduceFeatures(node, data.features, num_nodes, pca_path);
+#endif
+#if defined(GCN_OOC)
+    // The rows stay on disk
+#elif defined(GCN_NUMA)
+    numaInit(&numa, data.graph, omp_get_max_threads());
+#ifdef GCN_NUMA_REPLICATE
+    numaReplicate(&numa, data.graph, data.labels);
+#else
+    numaShareLabels(&numa, data.labels);
+#endif
+    // Move the rows the layers update in place onto their owning domain
+    float *placed = numaPlaceRows(&numa, node[0].feature, num_nodes, feature_dim);
+    for (int i = 0; i < num_nodes; ++i) {
+        node[i].feature = placed + (size_t)i * feature_dim;
     }
+    numaCountAccesses(&numa, data.graph, data.labels, 50);
+    numaReport(&numa, stdout);
+#else
+    // The layers gather rows at random; keep them on huge pages
+    float *rows = (float*)arenaAlloc(&run_arena, (size_t)num_nodes * feature_dim * sizeof(float), 0);
+    memcpy(rows, node[0].feature, (size_t)num_nodes * feature_dim * sizeof(float));
+    for (int i = 0; i < num_nodes; ++i) {
+        node[i].feature = rows + (size_t)i * feature_dim;
+    }
+#endif
+    srand(gcn_seed);
     initialize(layer);
     printf("%f",layer[0].weight[9]);
 
+    // Resume training from a saved checkpoint ("-" starts fresh)
+    int start_epoch = 0;
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {
+        start_epoch = loadCheckpoint(layer, node, argv[1]);
+        if (start_epoch < 0) {
+            fprintf(stderr, "Error restoring checkpoint %s\n", argv[1]);
+            return 1;
+        }
+        printf("Resuming from epoch %d\n", start_epoch);
+    }
 
-    run(node,layer,labels, csr, desttt);
-
+#ifdef GCN_NORM
+    char norm_path[4200];
+    snprintf(norm_path, sizeof(norm_path), "%s/graph_%s.bin", data.dir, graphNormName(GCN_NORM));
+    double norm_start = omp_get_wtime();
+    CSRGraph *normalized = graphNormalizedCached(data.graph, GCN_NORM, 1, norm_path);
+    printf("graph: %s normalization, %ld edges with self loops in %.3fs\n", graphNormName(GCN_NORM),
+           normalized->n_edges, omp_get_wtime() - norm_start);
+    edge_weight = normalized->values;
+    run(node, layer, data.labels, normalized->offsets, normalized->indices, start_epoch);
+    csrFree(normalized);
+#else
+    run(node, layer, data.labels, data.graph->offsets, data.graph->indices, start_epoch);
+#endif
+
+#ifdef GCN_OOC
+    oocCacheFree(&ooc_cache);
+    oocPlanFree(&ooc_plan[0]);
+    oocPlanFree(&ooc_plan[1]);
+    oocClose(&ooc_h[0]);
+    oocClose(&ooc_h[1]);
+#endif
+#ifdef GCN_NUMA
+    numaRelease(placed, (size_t)num_nodes * feature_dim * sizeof(float));
+    numaFree(&numa);
+#endif
+    datasetFree(&data);
+    arenaRelease(&run_arena);
+    arenaRelease(&epoch_arena);
     return 0;
 }
-
-
-
-
-
-
-
-		
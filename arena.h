@@ -0,0 +1,264 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+// Bump allocator for buffers that share a lifetime.
+// Memory comes from large blocks (ARENA_BLOCK by default) that are 2 MB
+// aligned and backed by huge pages when possible, so row-major feature and
+// activation matrices gathered at random cost far fewer TLB misses than
+// thousands of separate mallocs. Nothing is freed individually: a scope is
+// released at once with arenaReset (to a mark) or arenaClear, and the blocks
+// stay mapped for the next epoch or batch, so the footprint after the first
+// one is fixed and the counters below are exact.
+//
+// Typical lifetimes are one arena per scope:
+//   run   -> dataset, parameters; released at exit
+//   epoch -> activations, gradients; arenaClear at the end of every epoch
+//   batch -> per-batch scratch; arenaClear after every batch
+// An arena is not thread-safe; allocate before the parallel region.
+//
+// Huge pages: ARENA_HUGE_EXPLICIT asks for hugetlbfs pages (MAP_HUGETLB,
+// needs /proc/sys/vm/nr_hugepages) and falls back to transparent huge
+// pages; ARENA_HUGE_THP only uses madvise(MADV_HUGEPAGE).
+
+#define ARENA_HUGE_PAGE (2UL << 20)
+#define ARENA_BLOCK (64UL << 20)
+#define ARENA_ALIGN 64
+
+#define ARENA_SMALL_PAGES 0
+#define ARENA_HUGE_THP 1
+#define ARENA_HUGE_EXPLICIT 2
+
+
+typedef struct ArenaBlock {
+    struct ArenaBlock *next;
+    char *base;
+    size_t size;
+    size_t used;
+    int huge;
+} ArenaBlock;
+
+
+// requested -> bytes asked for by live allocations.
+// used -> the same plus alignment padding.
+// committed -> bytes mapped in blocks (constant once the scope is warm).
+// peak -> highest `used` seen.
+typedef struct Arena {
+    const char *name;
+    size_t block_size;
+    int huge;
+    ArenaBlock *first;
+    ArenaBlock *current;
+
+    size_t requested;
+    size_t used;
+    size_t committed;
+    size_t peak;
+    long allocs;
+    long blocks;
+    long huge_blocks;
+    long resets;
+} Arena;
+
+
+// Position to roll an arena back to
+typedef struct ArenaMark {
+    ArenaBlock *block;
+    size_t block_used;
+    size_t requested;
+    size_t used;
+} ArenaMark;
+
+
+// block_size 0 means ARENA_BLOCK; huge is one of ARENA_SMALL_PAGES,
+// ARENA_HUGE_THP, ARENA_HUGE_EXPLICIT
+void arenaInit(Arena *a, const char *name, size_t block_size, int huge) {
+    memset(a, 0, sizeof(*a));
+    a->name = name;
+    a->block_size = block_size ? block_size : ARENA_BLOCK;
+    a->huge = huge;
+}
+
+
+// Map `size` bytes (a multiple of ARENA_HUGE_PAGE) aligned to a huge page
+static char *arenaMapBlock(size_t size, int huge, int *got_huge) {
+    *got_huge = 0;
+#ifdef __linux__
+#ifdef MAP_HUGETLB
+    if (huge == ARENA_HUGE_EXPLICIT) {
+        void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            *got_huge = 1;
+            return (char *)p;
+        }
+    }
+#endif
+    // Over-map by one huge page and trim both ends to get the alignment
+    char *raw = (char *)mmap(NULL, size + ARENA_HUGE_PAGE, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == (char *)MAP_FAILED) {
+        return NULL;
+    }
+    char *p = (char *)(((uintptr_t)raw + ARENA_HUGE_PAGE - 1) & ~(uintptr_t)(ARENA_HUGE_PAGE - 1));
+    if (p > raw) {
+        munmap(raw, p - raw);
+    }
+    size_t tail = (raw + size + ARENA_HUGE_PAGE) - (p + size);
+    if (tail > 0) {
+        munmap(p + size, tail);
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge != ARENA_SMALL_PAGES && madvise(p, size, MADV_HUGEPAGE) == 0) {
+        *got_huge = 1;
+    }
+#endif
+    return p;
+#else
+    (void)huge;
+    return (char *)aligned_alloc(ARENA_HUGE_PAGE, size);
+#endif
+}
+
+
+static void arenaUnmapBlock(ArenaBlock *b) {
+#ifdef __linux__
+    munmap(b->base, b->size);
+#else
+    free(b->base);
+#endif
+}
+
+
+// Make the next block current, mapping a new one of at least `bytes`
+static ArenaBlock *arenaGrow(Arena *a, size_t bytes) {
+    ArenaBlock *b = a->current ? a->current->next : a->first;
+    // Blocks kept from before a reset are reused if they are big enough
+    while (b && b->size < bytes) {
+        b = b->next;
+    }
+    if (b) {
+        b->used = 0;
+        a->current = b;
+        return b;
+    }
+    size_t size = bytes > a->block_size ? bytes : a->block_size;
+    size = (size + ARENA_HUGE_PAGE - 1) & ~(ARENA_HUGE_PAGE - 1);
+    b = (ArenaBlock *)malloc(sizeof(ArenaBlock));
+    b->base = arenaMapBlock(size, a->huge, &b->huge);
+    if (!b->base) {
+        free(b);
+        return NULL;
+    }
+    b->size = size;
+    b->used = 0;
+    // Insert after current so the blocks stay in allocation order
+    if (a->current) {
+        b->next = a->current->next;
+        a->current->next = b;
+    } else {
+        b->next = a->first;
+        a->first = b;
+    }
+    a->current = b;
+    a->committed += size;
+    a->blocks++;
+    a->huge_blocks += b->huge;
+    return b;
+}
+
+
+// bytes aligned to `align` (a power of two; 0 means ARENA_ALIGN). Returns
+// NULL only if the system is out of memory.
+void *arenaAlloc(Arena *a, size_t bytes, size_t align) {
+    align = align ? align : ARENA_ALIGN;
+    ArenaBlock *b = a->current;
+    size_t start = 0;
+    if (b) {
+        start = (b->used + align - 1) & ~(align - 1);
+    }
+    if (!b || start + bytes > b->size) {
+        b = arenaGrow(a, bytes + align);
+        if (!b) {
+            fprintf(stderr, "arena %s: out of memory for %zu bytes\n", a->name, bytes);
+            return NULL;
+        }
+        start = 0;
+    }
+    a->used += (start - b->used) + bytes;
+    a->requested += bytes;
+    b->used = start + bytes;
+    a->allocs++;
+    if (a->used > a->peak) {
+        a->peak = a->used;
+    }
+    return b->base + start;
+}
+
+
+void *arenaCalloc(Arena *a, size_t count, size_t size) {
+    void *p = arenaAlloc(a, count * size, 0);
+    if (p) {
+        memset(p, 0, count * size);
+    }
+    return p;
+}
+
+
+ArenaMark arenaMark(const Arena *a) {
+    ArenaMark m;
+    m.block = a->current;
+    m.block_used = a->current ? a->current->used : 0;
+    m.requested = a->requested;
+    m.used = a->used;
+    return m;
+}
+
+
+// Free everything allocated since the mark; the blocks stay mapped
+void arenaReset(Arena *a, ArenaMark m) {
+    a->current = m.block;
+    if (m.block) {
+        m.block->used = m.block_used;
+    }
+    a->requested = m.requested;
+    a->used = m.used;
+    a->resets++;
+}
+
+
+// Free everything (the start of the next epoch or batch)
+void arenaClear(Arena *a) {
+    ArenaMark start = {NULL, 0, 0, 0};
+    arenaReset(a, start);
+}
+
+
+// Unmap every block
+void arenaRelease(Arena *a) {
+    ArenaBlock *b = a->first;
+    while (b) {
+        ArenaBlock *next = b->next;
+        arenaUnmapBlock(b);
+        free(b);
+        b = next;
+    }
+    a->first = a->current = NULL;
+    a->requested = a->used = a->committed = 0;
+}
+
+
+void arenaReport(const Arena *a, FILE *out) {
+    fprintf(out, "arena %-8s live=%.3fMB padded=%.3fMB peak=%.3fMB mapped=%.1fMB allocs=%ld blocks=%ld "
+            "huge=%ld resets=%ld\n", a->name, (double)a->requested / (1 << 20), (double)a->used / (1 << 20),
+            (double)a->peak / (1 << 20), (double)a->committed / (1 << 20), a->allocs, a->blocks,
+            a->huge_blocks, a->resets);
+}
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "dataset.h"
+#include "gcn.h"
+#include "dyngraph.h"
+#include "incremental.h"
+#include "rng.h"
+
+// Update-to-fresh-prediction latency of the incremental GCN engine.
+// Usage: bench_incremental [--data dir] [--features 0] [--ckpt gcn_ckpt.bin]
+//                          [--layers 5] [--reps 20] [--fallback 0.25] [--seed 1]
+// For change sets of 1 .. 1024 nodes, either perturbs their feature rows,
+// inserts one same-label edge out of each of them (streamed through a
+// DynGraph) or moves them to the next label, then brings all layers up to
+// date with incUpdate. Reports the
+// median/max latency of the graph refresh and of the layer update, the rows
+// recomputed per update, and checks the final embeddings against a full
+// forward pass. Without --ckpt the layers are initialized like GCN_t1 does.
+
+
+typedef struct IncConfig {
+    const char *data;
+    const char *ckpt;
+    int features;
+    int layers;
+    int reps;
+    double fallback;
+    unsigned long long seed;
+} IncConfig;
+
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+static int parseArgs(IncConfig *cfg, int argc, char **argv) {
+    cfg->data = DATASET_DIR;
+    cfg->ckpt = NULL;
+    cfg->features = 0;
+    cfg->layers = 5;
+    cfg->reps = 20;
+    cfg->fallback = 0.25;
+    cfg->seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *key = argv[i], *val = argv[i + 1];
+        if (strcmp(key, "--data") == 0) cfg->data = val;
+        else if (strcmp(key, "--ckpt") == 0) cfg->ckpt = val;
+        else if (strcmp(key, "--features") == 0) cfg->features = atoi(val);
+        else if (strcmp(key, "--layers") == 0) cfg->layers = atoi(val);
+        else if (strcmp(key, "--reps") == 0) cfg->reps = atoi(val);
+        else if (strcmp(key, "--fallback") == 0) cfg->fallback = atof(val);
+        else if (strcmp(key, "--seed") == 0) cfg->seed = strtoull(val, NULL, 10);
+        else {
+            fprintf(stderr, "Unknown option %s\n", key);
+            return 1;
+        }
+    }
+    if (cfg->reps < 1 || cfg->layers < 1 || cfg->layers > GCN_MAX_LAYERS) {
+        fprintf(stderr, "reps must be positive and layers in [1, %d]\n", GCN_MAX_LAYERS);
+        return 1;
+    }
+    return 0;
+}
+
+
+// Same distribution as GCN_t1's initialize()
+static void randomModel(GCNModel *model, int layers, int dim, unsigned long long seed) {
+    model->n_layers = layers;
+    model->dim = dim;
+    model->norm = GRAPH_NORM_NONE;
+    model->self_loops = 0;
+    uint64_t counter = 0;
+    for (int l = 0; l < layers; ++l) {
+        model->bias[l] = (float)rngUniform(seed, counter++) - 2.3f;
+        model->weight[l] = (float *)malloc(dim * sizeof(float));
+        for (int j = 0; j < dim; ++j) {
+            model->weight[l][j] = (float)rngUniform(seed, counter++);
+        }
+    }
+}
+
+
+int main(int argc, char **argv) {
+    IncConfig cfg;
+    if (parseArgs(&cfg, argc, argv) != 0) {
+        return 1;
+    }
+    Dataset data;
+    if (datasetLoad(&data, cfg.data, cfg.features) != 0) {
+        return 1;
+    }
+    int n = data.n_nodes;
+    int *labels = data.labels;
+    float *X = data.features;
+    cfg.features = data.n_features;
+
+    GCNModel model;
+    if (cfg.ckpt) {
+        if (gcnLoad(&model, cfg.ckpt) != 0) {
+            return 1;
+        }
+        // The edge changes below are made to the raw graph
+        if (model.norm != GRAPH_NORM_NONE) {
+            fprintf(stderr, "%s was trained on the %s-normalized graph, which this benchmark does not update\n",
+                    cfg.ckpt, graphNormName(model.norm));
+            return 1;
+        }
+    } else {
+        randomModel(&model, cfg.layers, cfg.features, cfg.seed);
+    }
+    if (model.dim != cfg.features) {
+        fprintf(stderr, "Model expects %d features, the data has %d\n", model.dim, cfg.features);
+        return 1;
+    }
+
+    DynGraph *dyn = (DynGraph *)malloc(sizeof(DynGraph));
+    dynInit(dyn, csrClone(data.graph), 0.05);
+    const DynView *view = dynReadBegin(dyn, 0);
+    CSRGraph *g = dynMaterialize(view);
+    dynReadEnd(dyn, 0);
+
+    double start = omp_get_wtime();
+    IncEngine engine;
+    incInit(&engine, &model, g, labels, X, cfg.fallback);
+    double fullTime = omp_get_wtime() - start;
+    float *check = (float *)malloc(2 * (size_t)n * model.dim * sizeof(float));
+
+    printf("nodes=%d edges=%ld layers=%d dim=%d threads=%d fallback=%.2f full_forward=%.2fms\n", n,
+           g->n_edges, model.n_layers, model.dim, omp_get_max_threads(), cfg.fallback, 1e3 * fullTime);
+    printf("%6s %9s %12s %12s %12s %12s %12s %9s %6s\n", "size", "change", "graph(ms)", "p50(ms)",
+           "max(ms)", "rows/update", "speedup", "fallback", "exact");
+
+    int *nodes = (int *)malloc(1024 * sizeof(int));
+    double *times = (double *)malloc(cfg.reps * sizeof(double));
+    uint64_t counter = 0;
+    for (int size = 1; size <= 1024; size *= 4) {
+        for (int kind = 0; kind < 3; ++kind) {
+            long rows = 0, fallbacks = engine.fallbacks;
+            double graphTime = 0.0;
+            for (int rep = 0; rep < cfg.reps; ++rep) {
+                for (int q = 0; q < size; ++q) {
+                    nodes[q] = (int)rngBounded(cfg.seed + 1, counter++, (uint64_t)n);
+                }
+                CSRGraph *next = NULL;
+                if (kind == 0) {
+                    for (int q = 0; q < size; ++q) {
+                        float *x = X + (size_t)nodes[q] * model.dim;
+                        for (int j = 0; j < model.dim; ++j) {
+                            x[j] += (float)(rngUniform(cfg.seed + 2, counter++) - 0.5);
+                        }
+                    }
+                } else if (kind == 2) {
+                    for (int q = 0; q < size; ++q) {
+                        labels[nodes[q]] = (labels[nodes[q]] + 1) % data.n_classes;
+                    }
+                } else {
+                    double t0 = omp_get_wtime();
+                    for (int q = 0; q < size; ++q) {
+                        int u = nodes[q], v = u;
+                        for (int tries = 0; tries < 64 && (v == u || labels[v] != labels[u]); ++tries) {
+                            v = (int)rngBounded(cfg.seed + 3, counter++, (uint64_t)n);
+                        }
+                        dynInsert(dyn, 0, u, v);
+                    }
+                    dynRefresh(dyn, 0);
+                    view = dynReadBegin(dyn, 0);
+                    next = dynMaterialize(view);
+                    dynReadEnd(dyn, 0);
+                    graphTime += omp_get_wtime() - t0;
+                }
+                rows += incUpdate(&engine, next, kind == 0 ? nodes : NULL, kind == 0 ? size : 0,
+                                  kind == 1 ? nodes : NULL, kind == 1 ? size : 0,
+                                  kind == 2 ? nodes : NULL, kind == 2 ? size : 0);
+                times[rep] = engine.last_time;
+                if (next) {
+                    csrFree(g);
+                    g = next;
+                }
+            }
+            qsort(times, cfg.reps, sizeof(double), compareDouble);
+            const float *full = gcnForward(&model, g, labels, X, check);
+            int exact = memcmp(full, engine.H[model.n_layers], (size_t)n * model.dim * sizeof(float)) == 0;
+            printf("%6d %9s %12.3f %12.3f %12.3f %12.0f %12.1f %9ld %6s\n", size,
+                   kind == 0 ? "features" : (kind == 1 ? "edges" : "labels"), 1e3 * graphTime / cfg.reps, 1e3 * times[cfg.reps / 2],
+                   1e3 * times[cfg.reps - 1], (double)rows / cfg.reps, fullTime / times[cfg.reps / 2],
+                   engine.fallbacks - fallbacks, exact ? "yes" : "NO");
+        }
+    }
+    incReport(&engine, stdout);
+
+    incFree(&engine);
+    gcnFree(&model);
+    csrFree(g);
+    dynFree(dyn);
+    free(dyn);
+    free(check);
+    free(nodes);
+    free(times);
+    datasetFree(&data);
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "csr_build.h"
+#include "kernels.h"
+#include "rmat.h"
+#include "dyngraph.h"
+#include "gat.h"
+#include "quant.h"
+
+// Kernel microbenchmarks on reproducible synthetic graphs.
+// Usage: bench_kernels [--graph rmat|uniform] [--nodes N] [--edges M]
+//                      [--skew a] [--features F] [--hidden H] [--classes C]
+//                      [--reps R] [--seed S] [--tag name] [--json out.json]
+//                      [--delta f] [--heads A] [--dedup 1]
+//                      [--no-self-loops 1] [--symmetrize 1]
+// Each kernel runs once to warm up and then R times; the median, min and max
+// wall times are reported with GFLOP/s and GB/s derived from the median.
+// GB/s counts the bytes each kernel must move at least once (gathered
+// neighbor rows are counted per edge), not what the caches actually saw.
+// With --delta f, f * edges random inserts and deletes (2:1) are streamed
+// into a DynGraph from all threads; aggregation is then timed over the
+// uncompacted view, and publishing and compacting are timed once each.
+// The GAT rows run one layer of A heads with hidden / A columns each
+// (concatenated), forward and backward. The int8 rows gather features
+// quantized per channel and multiply per-row int8 features by per-column
+// int8 weights (quant.h). The csr_build row times building the CSR from the
+// generated edge list with the --dedup, --no-self-loops and --symmetrize
+// flags of csrBuild (csr_build.h); the kernels then run on that graph.
+
+
+typedef struct BenchConfig {
+    const char *graph;
+    int nodes;
+    long edges;
+    double skew;
+    int features;
+    int hidden;
+    int classes;
+    int reps;
+    unsigned long long seed;
+    const char *tag;
+    const char *json;
+    double delta;
+    int heads;
+    int csr_flags;
+} BenchConfig;
+
+
+typedef struct KernelResult {
+    const char *name;
+    double median;
+    double min;
+    double max;
+    double flops;
+    double bytes;
+} KernelResult;
+
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+static void summarize(KernelResult *r, double *times, int reps) {
+    qsort(times, reps, sizeof(double), compareDouble);
+    r->min = times[0];
+    r->max = times[reps - 1];
+    r->median = (reps % 2) ? times[reps / 2] : 0.5 * (times[reps / 2 - 1] + times[reps / 2]);
+}
+
+
+// Run `call` once untimed and then reps times, recording each wall time
+#define TIME_KERNEL(result, reps, call)                         \
+    do {                                                        \
+        double times_[(reps)];                                  \
+        call;                                                   \
+        for (int r_ = 0; r_ < (reps); ++r_) {                   \
+            double t0_ = omp_get_wtime();                       \
+            call;                                               \
+            times_[r_] = omp_get_wtime() - t0_;                 \
+        }                                                       \
+        summarize(&(result), times_, (reps));                   \
+    } while (0)
+
+
+static void printResult(const KernelResult *r) {
+    printf("%-22s %10.3f %10.3f %10.3f %9.2f %9.2f\n", r->name, 1e3 * r->median, 1e3 * r->min,
+           1e3 * r->max, r->flops / r->median * 1e-9, r->bytes / r->median * 1e-9);
+}
+
+
+static void writeJson(const BenchConfig *cfg, const CSRGraph *g, long maxDegree, double genTime,
+                      const KernelResult *results, int count) {
+    FILE *file = fopen(cfg->json, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening %s for writing\n", cfg->json);
+        return;
+    }
+    fprintf(file, "{\n  \"tag\": \"%s\",\n  \"threads\": %d,\n", cfg->tag, omp_get_max_threads());
+    fprintf(file, "  \"config\": {\"graph\": \"%s\", \"nodes\": %d, \"edges\": %ld, \"skew\": %.4f, "
+                  "\"features\": %d, \"hidden\": %d, \"classes\": %d, \"reps\": %d, \"seed\": %llu, "
+                  "\"csr_flags\": %d},\n",
+            cfg->graph, g->n_nodes, g->n_edges, cfg->skew, cfg->features, cfg->hidden, cfg->classes,
+            cfg->reps, cfg->seed, cfg->csr_flags);
+    fprintf(file, "  \"graph\": {\"max_degree\": %ld, \"generate_s\": %.6f},\n", maxDegree, genTime);
+    fprintf(file, "  \"kernels\": [\n");
+    for (int i = 0; i < count; ++i) {
+        const KernelResult *r = &results[i];
+        fprintf(file, "    {\"name\": \"%s\", \"median_s\": %.9f, \"min_s\": %.9f, \"max_s\": %.9f, "
+                      "\"gflops\": %.4f, \"gbytes_per_s\": %.4f}%s\n",
+                r->name, r->median, r->min, r->max, r->flops / r->median * 1e-9,
+                r->bytes / r->median * 1e-9, (i + 1 < count) ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+
+static int parseArgs(BenchConfig *cfg, int argc, char **argv) {
+    cfg->graph = "rmat";
+    cfg->nodes = 1 << 18;
+    cfg->edges = 16L << 18;
+    cfg->skew = 0.57;
+    cfg->features = 128;
+    cfg->hidden = 64;
+    cfg->classes = 8;
+    cfg->reps = 9;
+    cfg->seed = 1;
+    cfg->tag = "dev";
+    cfg->json = NULL;
+    cfg->delta = 0.0;
+    cfg->heads = 4;
+    cfg->csr_flags = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *key = argv[i], *val = argv[i + 1];
+        if (strcmp(key, "--graph") == 0) cfg->graph = val;
+        else if (strcmp(key, "--nodes") == 0) cfg->nodes = atoi(val);
+        else if (strcmp(key, "--edges") == 0) cfg->edges = atol(val);
+        else if (strcmp(key, "--skew") == 0) cfg->skew = atof(val);
+        else if (strcmp(key, "--features") == 0) cfg->features = atoi(val);
+        else if (strcmp(key, "--hidden") == 0) cfg->hidden = atoi(val);
+        else if (strcmp(key, "--classes") == 0) cfg->classes = atoi(val);
+        else if (strcmp(key, "--reps") == 0) cfg->reps = atoi(val);
+        else if (strcmp(key, "--seed") == 0) cfg->seed = strtoull(val, NULL, 10);
+        else if (strcmp(key, "--tag") == 0) cfg->tag = val;
+        else if (strcmp(key, "--json") == 0) cfg->json = val;
+        else if (strcmp(key, "--delta") == 0) cfg->delta = atof(val);
+        else if (strcmp(key, "--heads") == 0) cfg->heads = atoi(val);
+        else if (strcmp(key, "--dedup") == 0) cfg->csr_flags |= atoi(val) ? CSR_DEDUP : 0;
+        else if (strcmp(key, "--no-self-loops") == 0) cfg->csr_flags |= atoi(val) ? CSR_NO_SELF_LOOPS : 0;
+        else if (strcmp(key, "--symmetrize") == 0) cfg->csr_flags |= atoi(val) ? CSR_SYMMETRIZE : 0;
+        else {
+            fprintf(stderr, "Unknown option %s\n", key);
+            return 1;
+        }
+    }
+    if (cfg->reps < 1 || cfg->nodes < 1 || cfg->edges < 1) {
+        fprintf(stderr, "nodes, edges and reps must be positive\n");
+        return 1;
+    }
+    if (cfg->heads < 1 || cfg->heads > GAT_MAX_HEADS || cfg->hidden % cfg->heads != 0) {
+        fprintf(stderr, "heads must be in [1, %d] and divide hidden\n", GAT_MAX_HEADS);
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    BenchConfig cfg;
+    if (parseArgs(&cfg, argc, argv) != 0) {
+        return 1;
+    }
+    int n = cfg.nodes, F = cfg.features, H = cfg.hidden, C = cfg.classes;
+    long m = cfg.edges;
+
+    double start = omp_get_wtime();
+    int *src = (int *)malloc(m * sizeof(int));
+    int *dst = (int *)malloc(m * sizeof(int));
+    if (strcmp(cfg.graph, "uniform") == 0) {
+        uniformEdges(n, m, cfg.seed, src, dst);
+    } else {
+        rmatEdges(n, m, rmatParams(cfg.skew), cfg.seed, src, dst);
+    }
+    CSRGraph *g = csrBuild(n, m, src, dst, cfg.csr_flags);
+    double genTime = omp_get_wtime() - start;
+
+    long maxDegree = 0;
+    for (int i = 0; i < n; ++i) {
+        long d = g->offsets[i + 1] - g->offsets[i];
+        maxDegree = d > maxDegree ? d : maxDegree;
+    }
+
+    float *X = (float *)malloc((size_t)n * F * sizeof(float));
+    float *Y = (float *)malloc((size_t)n * F * sizeof(float));
+    float *W = (float *)malloc((size_t)F * H * sizeof(float));
+    float *bias = (float *)calloc(H, sizeof(float));
+    float *Z = (float *)malloc((size_t)n * H * sizeof(float));
+    float *dW = (float *)malloc((size_t)F * H * sizeof(float));
+    float *W2 = (float *)malloc((size_t)H * C * sizeof(float));
+    float *logits = (float *)malloc((size_t)n * C * sizeof(float));
+    float *grad = (float *)malloc((size_t)n * C * sizeof(float));
+    int *labels = (int *)malloc(n * sizeof(int));
+    randomMatrix(X, (long)n * F, 1.0f, cfg.seed + 1);
+    randomMatrix(W, (long)F * H, 0.1f, cfg.seed + 2);
+    randomMatrix(Z, (long)n * H, 1.0f, cfg.seed + 3);
+    randomMatrix(W2, (long)H * C, 0.1f, cfg.seed + 4);
+    denseForward(Z, W2, NULL, logits, n, H, C);
+    for (int i = 0; i < n; ++i) {
+        labels[i] = (int)rngBounded(cfg.seed + 5, (uint64_t)i, (uint64_t)C);
+    }
+    Adam opt;
+    adamInit(&opt, (long)F * H, 1e-3f);
+
+    printf("graph=%s nodes=%d edges=%ld stored=%ld dedup=%d no_self_loops=%d symmetrize=%d max_degree=%ld skew=%.2f "
+           "features=%d hidden=%d classes=%d threads=%d reps=%d generate=%.3fs\n",
+           cfg.graph, n, m, g->n_edges, (cfg.csr_flags & CSR_DEDUP) != 0, (cfg.csr_flags & CSR_NO_SELF_LOOPS) != 0,
+           (cfg.csr_flags & CSR_SYMMETRIZE) != 0, maxDegree, cfg.skew, F, H, C, omp_get_max_threads(), cfg.reps,
+           genTime);
+    printf("%-22s %10s %10s %10s %9s %9s\n", "kernel", "median(ms)", "min(ms)", "max(ms)", "GFLOP/s", "GB/s");
+
+    KernelResult results[14];
+    int count = 0;
+    double rowBytes = (double)F * sizeof(float);
+
+    // Edge list -> CSR; keys are written, sorted and compacted once per pass
+    KernelResult *r = &results[count++];
+    r->name = "csr_build";
+    r->flops = 0;
+    r->bytes = 2.0 * m * sizeof(int) + g->n_edges * (16.0 * ((2 * csrIdBits(n) + CSR_RADIX_BITS - 1) / CSR_RADIX_BITS) +
+                                                  sizeof(int)) + (n + 1.0) * sizeof(long);
+    TIME_KERNEL(*r, cfg.reps, csrFree(csrBuild(n, m, src, dst, cfg.csr_flags)));
+    free(src);
+    free(dst);
+    m = g->n_edges;
+
+    r = &results[count++];
+    r->name = "aggregate_sum";
+    r->flops = 2.0 * m * F;
+    r->bytes = m * (rowBytes + sizeof(int)) + n * (rowBytes + sizeof(long));
+    TIME_KERNEL(*r, cfg.reps, aggregateSum(g, X, Y, F));
+
+    r = &results[count++];
+    r->name = "aggregate_mean";
+    r->flops = 2.0 * m * F + (double)n * F;
+    r->bytes = m * (rowBytes + sizeof(int)) + n * (3 * rowBytes + sizeof(long));
+    TIME_KERNEL(*r, cfg.reps, aggregateMean(g, X, Y, F));
+
+    r = &results[count++];
+    r->name = "dense_forward";
+    r->flops = 2.0 * n * F * H;
+    r->bytes = ((double)n * F + (double)F * H + (double)n * H) * sizeof(float);
+    TIME_KERNEL(*r, cfg.reps, denseForward(X, W, bias, Z, n, F, H));
+
+    QuantRows QX, QXr;
+    quantRowsInit(&QX, n, F, QUANT_PER_CHANNEL);
+    quantRowsInit(&QXr, n, F, QUANT_PER_ROW);
+    float *xscale = (float *)malloc(F * sizeof(float));
+    quantChannelScales(X, F, NULL, n, 100.0, xscale);
+    quantRowsSetScale(&QX, xscale);
+    quantizeRows(&QX, X);
+    quantizeRows(&QXr, X);
+    int8_t *Wq = (int8_t *)malloc((size_t)F * H);
+    float *wscale = (float *)malloc(H * sizeof(float));
+    quantizeWeightColumns(W, F, H, Wq, wscale);
+
+    r = &results[count++];
+    r->name = "aggregate_sum_int8";
+    r->flops = 2.0 * m * F;
+    r->bytes = m * ((double)F + sizeof(int)) + n * (rowBytes + sizeof(long));
+    TIME_KERNEL(*r, cfg.reps, aggregateSumInt8(g, &QX, Y));
+
+    r = &results[count++];
+    r->name = "dense_forward_int8";
+    r->flops = 2.0 * n * F * H;
+    r->bytes = (double)n * F + (double)F * H + (double)n * H * sizeof(float);
+    TIME_KERNEL(*r, cfg.reps, denseForwardInt8(&QXr, Wq, wscale, bias, Z, H));
+    quantRowsFree(&QX);
+    quantRowsFree(&QXr);
+    free(xscale);
+    free(Wq);
+    free(wscale);
+
+    r = &results[count++];
+    r->name = "dense_grad_weight";
+    r->flops = 2.0 * n * F * H;
+    r->bytes = ((double)n * F + (double)n * H + (double)F * H) * sizeof(float);
+    TIME_KERNEL(*r, cfg.reps, denseGradWeight(X, Z, dW, n, F, H));
+
+    r = &results[count++];
+    r->name = "softmax_cross_entropy";
+    r->flops = 6.0 * n * C;
+    r->bytes = 2.0 * n * C * sizeof(float) + (double)n * sizeof(int);
+    TIME_KERNEL(*r, cfg.reps, softmaxCrossEntropy(logits, labels, NULL, n, C, grad, NULL));
+
+    r = &results[count++];
+    r->name = "adam_step";
+    r->flops = 12.0 * F * H;
+    r->bytes = 7.0 * F * H * sizeof(float);
+    TIME_KERNEL(*r, cfg.reps, adamStep(&opt, W, dW));
+
+    GATLayer gat;
+    gatInit(&gat, F, H / cfg.heads, cfg.heads, 1, cfg.seed + 7);
+    CSRGraph *rev = csrTranspose(g);
+    double attend = (double)(m + n) * (4.0 * H + 6.0 * cfg.heads);
+    r = &results[count++];
+    r->name = "gat_forward";
+    r->flops = 2.0 * n * F * H + 4.0 * n * H + attend;
+    r->bytes = ((double)n * F + (double)F * H + 2.0 * n * H) * sizeof(float) +
+               m * ((double)H * sizeof(float) + sizeof(int)) + n * sizeof(long);
+    TIME_KERNEL(*r, cfg.reps, gatForward(&gat, g, X, Z));
+
+    r = &results[count++];
+    r->name = "gat_backward";
+    r->flops = 4.0 * n * F * H + 4.0 * n * H + 2.0 * attend;
+    r->bytes = 2.0 * ((double)n * F + (double)F * H + 2.0 * n * H) * sizeof(float) +
+               2.0 * m * (2.0 * H * sizeof(float) + sizeof(int)) + 2.0 * n * sizeof(long);
+    TIME_KERNEL(*r, cfg.reps, gatBackward(&gat, g, rev, X, Z, Y));
+    gatFree(&gat);
+    csrFree(rev);
+
+    long dynOps = 0, dynLive = 0;
+    if (cfg.delta > 0) {
+        DynGraph *dyn = (DynGraph *)malloc(sizeof(DynGraph));
+        dynInit(dyn, csrClone(g), 1e9);
+        long ops = (long)(cfg.delta * m);
+        #pragma omp parallel for schedule(static)
+        for (long k = 0; k < ops; ++k) {
+            int tid = omp_get_thread_num();
+            uint64_t bits = rngBits(cfg.seed + 6, (uint64_t)k);
+            int u = (int)((bits >> 2) % (uint64_t)n);
+            long degree = g->offsets[u + 1] - g->offsets[u];
+            if (bits % 3 == 0 && degree > 0) {
+                dynDelete(dyn, tid, u, g->indices[g->offsets[u] + (long)((bits >> 34) % (uint64_t)degree)]);
+            } else {
+                dynInsert(dyn, tid, u, (int)((bits >> 34) % (uint64_t)n));
+            }
+        }
+
+        r = &results[count++];
+        r->name = "dyn_publish";
+        r->flops = 0;
+        r->bytes = (double)ops * (sizeof(DynOp) + sizeof(long) + 2 * sizeof(int)) + (double)(m + ops) / DYN_PAGE_IDS * sizeof(void *);
+        r->median = r->min = r->max = omp_get_wtime();
+        dynRefresh(dyn, 0);
+        r->median = r->min = r->max = omp_get_wtime() - r->median;
+
+        const DynView *view = dynReadBegin(dyn, 0);
+        long live = view->n_edges;
+        r = &results[count++];
+        r->name = "aggregate_sum_dyn";
+        r->flops = 2.0 * live * F;
+        r->bytes = live * (rowBytes + sizeof(int)) + m / 8.0 + n * (rowBytes + 2 * sizeof(long));
+        TIME_KERNEL(*r, cfg.reps, dynAggregateSum(view, X, Y, F));
+        dynReadEnd(dyn, 0);
+
+        r = &results[count++];
+        r->name = "dyn_compact";
+        r->flops = 0;
+        r->bytes = 2.0 * live * sizeof(int) + 2.0 * n * sizeof(long);
+        r->median = r->min = r->max = omp_get_wtime();
+        dynRefresh(dyn, 1);
+        r->median = r->min = r->max = omp_get_wtime() - r->median;
+        dynOps = ops;
+        dynLive = dyn->view->n_edges;
+        dynFree(dyn);
+        free(dyn);
+    }
+    for (int i = 0; i < count; ++i) {
+        printResult(&results[i]);
+    }
+    if (dynOps) {
+        printf("delta: %ld ops, %ld live edges after compaction\n", dynOps, dynLive);
+    }
+    if (cfg.json) {
+        writeJson(&cfg, g, maxDegree, genTime, results, count);
+    }
+
+    adamFree(&opt);
+    csrFree(g);
+    free(X);
+    free(Y);
+    free(W);
+    free(bias);
+    free(Z);
+    free(dW);
+    free(W2);
+    free(logits);
+    free(grad);
+    free(labels);
+    return 0;
+}
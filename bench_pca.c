@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "csr_build.h"
+#include "dataset.h"
+#include "kernels.h"
+#include "pca.h"
+
+// Epoch time and accuracy of a 2-hop GCN classifier as the PCA width k varies.
+// Usage: bench_pca [dataset_dir] [num_features|0] [epochs]
+// Each configuration projects the features to k dims (k = num_features means
+// no PCA), then trains logits = A(A(X)) * W + b with softmax cross-entropy and
+// Adam. Every 5th node is held out for the reported test accuracy.
+
+#define BENCH_HOPS 2
+
+
+typedef struct BenchResult {
+    int k;
+    double variance;
+    double fit_time;
+    double project_time;
+    double epoch_time;
+    double aggregate_time;
+    double train_acc;
+    double test_acc;
+} BenchResult;
+
+
+BenchResult benchWidth(const CSRGraph *g, const float *X, int dim, int k, const int *labels,
+                       int classes, const unsigned char *train, const unsigned char *test, int epochs) {
+    BenchResult res;
+    memset(&res, 0, sizeof(res));
+    res.k = k;
+    long n = g->n_nodes;
+
+    float *feat = (float *)X;
+    if (k < dim) {
+        PCAModel model;
+        double start = omp_get_wtime();
+        res.variance = pcaFit(&model, X, n, dim, k, 4096);
+        res.fit_time = omp_get_wtime() - start;
+        feat = (float *)malloc((size_t)n * k * sizeof(float));
+        start = omp_get_wtime();
+        pcaProject(&model, X, n, feat);
+        res.project_time = omp_get_wtime() - start;
+        pcaFree(&model);
+    } else {
+        res.variance = 1.0;
+    }
+
+    float *H[2];
+    H[0] = (float *)malloc((size_t)n * k * sizeof(float));
+    H[1] = (float *)malloc((size_t)n * k * sizeof(float));
+    float *W = (float *)malloc((size_t)k * classes * sizeof(float));
+    float *b = (float *)calloc(classes, sizeof(float));
+    float *dW = (float *)malloc((size_t)k * classes * sizeof(float));
+    float *db = (float *)malloc(classes * sizeof(float));
+    float *logits = (float *)malloc((size_t)n * classes * sizeof(float));
+    float *grad = (float *)malloc((size_t)n * classes * sizeof(float));
+    srand(7);
+    for (long e = 0; e < (long)k * classes; ++e) {
+        W[e] = (((float)rand() / RAND_MAX) - 0.5f) / sqrtf((float)k);
+    }
+    Adam optW, optB;
+    adamInit(&optW, (long)k * classes, 0.05f);
+    adamInit(&optB, classes, 0.05f);
+
+    double total = 0.0, aggregate = 0.0;
+    for (int epoch = 0; epoch < epochs; ++epoch) {
+        double start = omp_get_wtime();
+        // Aggregation is recomputed every epoch, like messagePassing does
+        const float *in = feat;
+        for (int hop = 0; hop < BENCH_HOPS; ++hop) {
+            aggregateMean(g, in, H[hop & 1], k);
+            in = H[hop & 1];
+        }
+        double mid = omp_get_wtime();
+        denseForward(in, W, b, logits, n, k, classes);
+        softmaxCrossEntropy(logits, labels, train, n, classes, grad, NULL);
+        denseGradWeight(in, grad, dW, n, k, classes);
+        denseGradBias(grad, n, classes, db);
+        adamStep(&optW, W, dW);
+        adamStep(&optB, b, db);
+        double end = omp_get_wtime();
+        total += end - start;
+        aggregate += mid - start;
+    }
+    res.epoch_time = total / epochs;
+    res.aggregate_time = aggregate / epochs;
+
+    const float *in = feat;
+    for (int hop = 0; hop < BENCH_HOPS; ++hop) {
+        aggregateMean(g, in, H[hop & 1], k);
+        in = H[hop & 1];
+    }
+    denseForward(in, W, b, logits, n, k, classes);
+    long hits = 0, count = 0;
+    softmaxCrossEntropy(logits, labels, train, n, classes, NULL, &hits);
+    for (long i = 0; i < n; ++i) {
+        count += train[i];
+    }
+    res.train_acc = (double)hits / count;
+    softmaxCrossEntropy(logits, labels, test, n, classes, NULL, &hits);
+    res.test_acc = (double)hits / (n - count);
+
+    adamFree(&optW);
+    adamFree(&optB);
+    free(H[0]);
+    free(H[1]);
+    free(W);
+    free(b);
+    free(dW);
+    free(db);
+    free(logits);
+    free(grad);
+    if (feat != X) {
+        free(feat);
+    }
+    return res;
+}
+
+
+int main(int argc, char **argv) {
+    const char *dir = argc > 1 ? argv[1] : DATASET_DIR;
+    int epochs = argc > 3 ? atoi(argv[3]) : 50;
+    Dataset data;
+    if (datasetLoad(&data, dir, argc > 2 ? atoi(argv[2]) : 0) != 0) {
+        return 1;
+    }
+    int dim = data.n_features, classes = data.n_classes;
+    long n_labels = data.n_nodes;
+    const int *labels = data.labels;
+    const float *X = data.features;
+    // Mean aggregation doesn't depend on row order, so use sorted rows
+    CSRGraph *g = csrFromEdges(data.n_nodes, data.n_edges, data.src, data.dst);
+    unsigned char *train = (unsigned char *)malloc(n_labels);
+    unsigned char *test = (unsigned char *)malloc(n_labels);
+    for (long i = 0; i < n_labels; ++i) {
+        test[i] = (i % 5 == 0);
+        train[i] = !test[i];
+    }
+
+    printf("nodes=%d edges=%ld features=%d classes=%d threads=%d epochs=%d\n",
+           g->n_nodes, g->n_edges, dim, classes, omp_get_max_threads(), epochs);
+    printf("%6s %9s %9s %9s %12s %12s %9s %9s\n", "k", "variance", "fit(s)", "proj(s)",
+           "epoch(ms)", "aggr(ms)", "train", "test");
+
+    int widths[] = {8, 16, 32, 64, 128, 256};
+    int nwidths = sizeof(widths) / sizeof(widths[0]);
+    for (int w = 0; w <= nwidths; ++w) {
+        int k = (w < nwidths) ? widths[w] : dim;
+        if (k > dim || (w < nwidths && k == dim)) {
+            continue;
+        }
+        BenchResult r = benchWidth(g, X, dim, k, labels, classes, train, test, epochs);
+        printf("%6d %9.3f %9.3f %9.3f %12.3f %12.3f %9.4f %9.4f\n", r.k, r.variance, r.fit_time,
+               r.project_time, 1e3 * r.epoch_time, 1e3 * r.aggregate_time, r.train_acc, r.test_acc);
+    }
+
+    csrFree(g);
+    datasetFree(&data);
+    free(train);
+    free(test);
+    return 0;
+}
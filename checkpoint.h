@@ -0,0 +1,425 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Versioned binary checkpoints of model parameters and optimizer state.
+//
+// File layout (little endian, every tensor payload 64-byte aligned):
+//   CkptHeader                       magic, version, counters, RNG state
+//   CkptEntry[n_tensors]             name, dtype, shape, offset, size, crc
+//   payloads                         raw tensor data
+//
+// Saving goes through a CkptWriter: ckptWriterSubmit copies the tensors into
+// one buffer already laid out like the file (the only work on the training
+// thread) and a background thread checksums it, writes it to path.tmp,
+// fsyncs and renames it over path, so a crash never leaves a torn file.
+// Restoring maps the file with mmap and hands out pointers straight into the
+// mapping; nothing is parsed or copied.
+
+#define CKPT_MAGIC "GNNCKPT"
+#define CKPT_VERSION 1
+#define CKPT_MAX_TENSORS 256
+#define CKPT_MAX_DIMS 4
+#define CKPT_NAME_LEN 48
+#define CKPT_ALIGN 64
+
+enum CkptDtype { CKPT_F32 = 0, CKPT_F64 = 1, CKPT_I32 = 2, CKPT_I64 = 3, CKPT_I8 = 4 };
+
+
+typedef struct CkptHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_tensors;
+    uint64_t epoch;
+    uint64_t step;
+    uint64_t rng[4];
+    uint64_t file_size;
+    uint64_t reserved[3];
+} CkptHeader;
+
+
+typedef struct CkptEntry {
+    char name[CKPT_NAME_LEN];
+    uint32_t dtype;
+    uint32_t ndim;
+    uint64_t shape[CKPT_MAX_DIMS];
+    uint64_t offset;
+    uint64_t nbytes;
+    uint32_t crc;
+    uint32_t reserved;
+} CkptEntry;
+
+
+// Description of a checkpoint being assembled. Tensors are referenced, not
+// copied, until the checkpoint is submitted or written.
+typedef struct Checkpoint {
+    CkptHeader header;
+    CkptEntry entries[CKPT_MAX_TENSORS];
+    const void *data[CKPT_MAX_TENSORS];
+} Checkpoint;
+
+
+static size_t ckptDtypeSize(uint32_t dtype) {
+    if (dtype == CKPT_I8) {
+        return 1;
+    }
+    return (dtype == CKPT_F64 || dtype == CKPT_I64) ? 8 : 4;
+}
+
+
+static uint64_t ckptAlignUp(uint64_t x) {
+    return (x + CKPT_ALIGN - 1) & ~(uint64_t)(CKPT_ALIGN - 1);
+}
+
+
+uint32_t ckptCrc32(const void *data, size_t nbytes) {
+    uint32_t table[256];
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+            c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        }
+        table[i] = c;
+    }
+    const unsigned char *p = (const unsigned char *)data;
+    uint32_t crc = 0xffffffffu;
+    for (size_t i = 0; i < nbytes; ++i) {
+        crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+    }
+    return crc ^ 0xffffffffu;
+}
+
+
+void ckptInit(Checkpoint *ckpt, uint64_t epoch, uint64_t step) {
+    memset(ckpt, 0, sizeof(*ckpt));
+    memcpy(ckpt->header.magic, CKPT_MAGIC, sizeof(CKPT_MAGIC));
+    ckpt->header.version = CKPT_VERSION;
+    ckpt->header.epoch = epoch;
+    ckpt->header.step = step;
+}
+
+
+// Register a tensor. shape has ndim entries; returns 0 on success.
+int ckptAdd(Checkpoint *ckpt, const char *name, uint32_t dtype, int ndim, const long *shape, const void *data) {
+    if (ckpt->header.n_tensors == CKPT_MAX_TENSORS || ndim > CKPT_MAX_DIMS || strlen(name) >= CKPT_NAME_LEN) {
+        fprintf(stderr, "checkpoint: cannot add tensor %s\n", name);
+        return 1;
+    }
+    CkptEntry *e = &ckpt->entries[ckpt->header.n_tensors];
+    strcpy(e->name, name);
+    e->dtype = dtype;
+    e->ndim = ndim;
+    uint64_t count = 1;
+    for (int d = 0; d < ndim; ++d) {
+        e->shape[d] = shape[d];
+        count *= shape[d];
+    }
+    e->nbytes = count * ckptDtypeSize(dtype);
+    ckpt->data[ckpt->header.n_tensors] = data;
+    ckpt->header.n_tensors++;
+    return 0;
+}
+
+
+// Shorthand for 1-D and 2-D tensors
+int ckptAdd1(Checkpoint *ckpt, const char *name, uint32_t dtype, long n, const void *data) {
+    return ckptAdd(ckpt, name, dtype, 1, &n, data);
+}
+
+
+int ckptAdd2(Checkpoint *ckpt, const char *name, uint32_t dtype, long rows, long cols, const void *data) {
+    long shape[2] = {rows, cols};
+    return ckptAdd(ckpt, name, dtype, 2, shape, data);
+}
+
+
+// Assign payload offsets and copy everything into one file image
+static void *ckptPack(Checkpoint *ckpt, size_t *size) {
+    uint64_t offset = ckptAlignUp(sizeof(CkptHeader) + ckpt->header.n_tensors * sizeof(CkptEntry));
+    for (uint32_t t = 0; t < ckpt->header.n_tensors; ++t) {
+        ckpt->entries[t].offset = offset;
+        offset = ckptAlignUp(offset + ckpt->entries[t].nbytes);
+    }
+    ckpt->header.file_size = offset;
+
+    char *image = (char *)calloc(1, offset);
+    if (image == NULL) {
+        return NULL;
+    }
+    for (uint32_t t = 0; t < ckpt->header.n_tensors; ++t) {
+        memcpy(image + ckpt->entries[t].offset, ckpt->data[t], ckpt->entries[t].nbytes);
+    }
+    *size = offset;
+    return image;
+}
+
+
+// Fill in checksums and the header/table, then write the image atomically
+static int ckptWriteImage(char *image, size_t size, const Checkpoint *ckpt, const char *path) {
+    CkptHeader *header = (CkptHeader *)image;
+    CkptEntry *entries = (CkptEntry *)(image + sizeof(CkptHeader));
+    *header = ckpt->header;
+    for (uint32_t t = 0; t < ckpt->header.n_tensors; ++t) {
+        entries[t] = ckpt->entries[t];
+        entries[t].crc = ckptCrc32(image + entries[t].offset, entries[t].nbytes);
+    }
+
+    char tmp[4096];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "checkpoint: error opening %s\n", tmp);
+        return 1;
+    }
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(fd, image + done, size - done);
+        if (n <= 0) {
+            fprintf(stderr, "checkpoint: error writing %s\n", tmp);
+            close(fd);
+            unlink(tmp);
+            return 1;
+        }
+        done += (size_t)n;
+    }
+    if (fsync(fd) != 0 || close(fd) != 0 || rename(tmp, path) != 0) {
+        fprintf(stderr, "checkpoint: error committing %s\n", path);
+        unlink(tmp);
+        return 1;
+    }
+    return 0;
+}
+
+
+// Synchronous save, for the end of training or when no writer is running
+int ckptWrite(Checkpoint *ckpt, const char *path) {
+    size_t size;
+    char *image = (char *)ckptPack(ckpt, &size);
+    if (image == NULL) {
+        return 1;
+    }
+    int status = ckptWriteImage(image, size, ckpt, path);
+    free(image);
+    return status;
+}
+
+
+// Background checkpoint writer. At most one snapshot waits behind the one
+// being written; submitting again replaces the waiting one, so a slow disk
+// drops intermediate checkpoints instead of stalling training.
+typedef struct CkptWriter {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int stop;
+    int writing;
+    char *image;
+    size_t size;
+    Checkpoint ckpt;
+    char path[4096];
+    long written;
+    long dropped;
+    int errors;
+} CkptWriter;
+
+
+static void *ckptWriterMain(void *arg) {
+    CkptWriter *w = (CkptWriter *)arg;
+    Checkpoint *ckpt = (Checkpoint *)malloc(sizeof(Checkpoint));
+    char path[4096];
+    pthread_mutex_lock(&w->lock);
+    for (;;) {
+        while (w->image == NULL && !w->stop) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        if (w->image == NULL) {
+            break;
+        }
+        char *image = w->image;
+        size_t size = w->size;
+        *ckpt = w->ckpt;
+        strcpy(path, w->path);
+        w->image = NULL;
+        w->writing = 1;
+        pthread_mutex_unlock(&w->lock);
+
+        int status = ckptWriteImage(image, size, ckpt, path);
+        free(image);
+
+        pthread_mutex_lock(&w->lock);
+        w->writing = 0;
+        w->written += (status == 0);
+        w->errors += (status != 0);
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    free(ckpt);
+    return NULL;
+}
+
+
+int ckptWriterStart(CkptWriter *w) {
+    memset(w, 0, sizeof(*w));
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->cond, NULL);
+    if (pthread_create(&w->thread, NULL, ckptWriterMain, w) != 0) {
+        fprintf(stderr, "checkpoint: cannot start writer thread\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Snapshot the checkpoint's tensors and queue them for writing. The tensors
+// may be modified as soon as this returns.
+int ckptWriterSubmit(CkptWriter *w, Checkpoint *ckpt, const char *path) {
+    size_t size;
+    char *image = (char *)ckptPack(ckpt, &size);
+    if (image == NULL) {
+        return 1;
+    }
+    pthread_mutex_lock(&w->lock);
+    if (w->image != NULL) {
+        free(w->image);
+        w->dropped++;
+    }
+    w->image = image;
+    w->size = size;
+    w->ckpt = *ckpt;
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    return 0;
+}
+
+
+// Wait until everything submitted so far is on disk
+void ckptWriterFlush(CkptWriter *w) {
+    pthread_mutex_lock(&w->lock);
+    while (w->image != NULL || w->writing) {
+        pthread_cond_wait(&w->cond, &w->lock);
+    }
+    pthread_mutex_unlock(&w->lock);
+}
+
+
+// Flush and join the writer thread; returns the number of failed writes
+int ckptWriterStop(CkptWriter *w) {
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    return w->errors;
+}
+
+
+// A checkpoint file mapped read-only into memory
+typedef struct CkptMap {
+    void *base;
+    size_t size;
+    const CkptHeader *header;
+    const CkptEntry *entries;
+} CkptMap;
+
+
+int ckptOpen(CkptMap *map, const char *path) {
+    memset(map, 0, sizeof(*map));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return 1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CkptHeader)) {
+        fprintf(stderr, "checkpoint: %s is too small\n", path);
+        close(fd);
+        return 1;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "checkpoint: cannot map %s\n", path);
+        return 1;
+    }
+    const CkptHeader *header = (const CkptHeader *)base;
+    if (memcmp(header->magic, CKPT_MAGIC, sizeof(CKPT_MAGIC)) != 0 || header->version != CKPT_VERSION ||
+        header->file_size != (uint64_t)st.st_size ||
+        sizeof(CkptHeader) + header->n_tensors * sizeof(CkptEntry) > (size_t)st.st_size) {
+        fprintf(stderr, "checkpoint: %s is not a version %d checkpoint\n", path, CKPT_VERSION);
+        munmap(base, st.st_size);
+        return 1;
+    }
+    madvise(base, st.st_size, MADV_WILLNEED);
+    map->base = base;
+    map->size = st.st_size;
+    map->header = header;
+    map->entries = (const CkptEntry *)((const char *)base + sizeof(CkptHeader));
+    return 0;
+}
+
+
+void ckptClose(CkptMap *map) {
+    if (map->base) {
+        munmap(map->base, map->size);
+    }
+    memset(map, 0, sizeof(*map));
+}
+
+
+// Table entry of the named tensor, or NULL
+const CkptEntry *ckptFind(const CkptMap *map, const char *name) {
+    for (uint32_t t = 0; t < map->header->n_tensors; ++t) {
+        if (strncmp(map->entries[t].name, name, CKPT_NAME_LEN) == 0) {
+            return &map->entries[t];
+        }
+    }
+    return NULL;
+}
+
+
+// Pointer to a tensor inside the mapping, or NULL when the name is missing or
+// the dtype / element count disagree with what the caller expects (count < 0
+// accepts any size)
+const void *ckptTensor(const CkptMap *map, const char *name, uint32_t dtype, long count) {
+    const CkptEntry *e = ckptFind(map, name);
+    if (e == NULL) {
+        fprintf(stderr, "checkpoint: tensor %s not found\n", name);
+        return NULL;
+    }
+    uint64_t n = 1;
+    for (uint32_t d = 0; d < e->ndim; ++d) {
+        n *= e->shape[d];
+    }
+    if (e->dtype != dtype || (count >= 0 && n != (uint64_t)count) || e->offset + e->nbytes > map->size) {
+        fprintf(stderr, "checkpoint: tensor %s has an unexpected type or shape\n", name);
+        return NULL;
+    }
+    return (const char *)map->base + e->offset;
+}
+
+
+// Recompute every payload checksum (touches the whole file); 0 when intact
+int ckptVerify(const CkptMap *map) {
+    int bad = 0;
+    for (uint32_t t = 0; t < map->header->n_tensors; ++t) {
+        const CkptEntry *e = &map->entries[t];
+        if (ckptCrc32((const char *)map->base + e->offset, e->nbytes) != e->crc) {
+            fprintf(stderr, "checkpoint: tensor %s is corrupt\n", e->name);
+            bad++;
+        }
+    }
+    return bad;
+}
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef CSR_BUILD_H
+#define CSR_BUILD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <omp.h>
+#include "graph.h"
+
+// Parallel CSR construction from an arbitrary edge list.
+// Every edge becomes one 64-bit key (src << b) | dst, b being the bit width
+// of the largest id, and the keys are sorted with an LSD radix sort over
+// only the 2b bits in use, in ceil(2b / 11) passes of equal width. A pass is a
+// histogram of each thread's contiguous chunk, a prefix sum over (digit,
+// thread) and a stable scatter of the chunk, so the result is the same for
+// any number of threads. Repeated edges end up adjacent and are dropped in
+// a parallel compaction, which also writes the row offsets from the places
+// where the source changes: sources may come in any order and nodes without
+// edges get empty rows. Rows come out sorted by neighbor id.
+//
+// flags:
+//   CSR_DEDUP          keep one copy of each repeated edge
+//   CSR_NO_SELF_LOOPS  drop i -> i
+//   CSR_SYMMETRIZE     add v -> u for every u -> v (with CSR_DEDUP an edge
+//                      listed in both directions is still stored once each)
+//
+// The keys and their scatter buffer take 16 bytes per stored edge while the
+// graph is built.
+
+#define CSR_DEDUP 1
+#define CSR_NO_SELF_LOOPS 2
+#define CSR_SYMMETRIZE 4
+
+// Widest digit; 2^11 buckets per thread still fit in L1 next to the scatter
+#define CSR_RADIX_BITS 11
+#define CSR_RADIX (1 << CSR_RADIX_BITS)
+
+
+// Bits needed for ids in [0, n)
+static int csrIdBits(int n) {
+    int b = 0;
+    while (b < 31 && (1L << b) < n) {
+        b++;
+    }
+    return b;
+}
+
+
+// Stable LSD radix sort of keys[0..m) on their low `bits` bits, tmp being a
+// buffer of m keys. Returns whichever of the two holds the sorted keys.
+// Passes where every key has the same digit are skipped.
+uint64_t *csrRadixSort(uint64_t *keys, uint64_t *tmp, long m, int bits) {
+    int nthreads = omp_get_max_threads();
+    long *count = (long *)malloc((size_t)nthreads * CSR_RADIX * sizeof(long));
+    int passes = (bits + CSR_RADIX_BITS - 1) / CSR_RADIX_BITS;
+    int width = passes ? (bits + passes - 1) / passes : 0;
+    int radix = 1 << width;
+    uint64_t digit = (uint64_t)radix - 1;
+    for (int shift = 0; shift < bits; shift += width) {
+        int skip = 0;
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int t = omp_get_thread_num(), T = omp_get_num_threads();
+            long lo = m * t / T, hi = m * (t + 1) / T;
+            long *c = count + (size_t)t * radix;
+            memset(c, 0, radix * sizeof(long));
+            for (long k = lo; k < hi; ++k) {
+                c[(keys[k] >> shift) & digit]++;
+            }
+            #pragma omp barrier
+            #pragma omp single
+            {
+                long sum = 0;
+                for (int d = 0; d < radix; ++d) {
+                    long before = sum;
+                    for (int u = 0; u < T; ++u) {
+                        long x = count[(size_t)u * radix + d];
+                        count[(size_t)u * radix + d] = sum;
+                        sum += x;
+                    }
+                    skip |= sum - before == m;
+                }
+            }
+            if (!skip) {
+                for (long k = lo; k < hi; ++k) {
+                    tmp[c[(keys[k] >> shift) & digit]++] = keys[k];
+                }
+            }
+        }
+        if (!skip) {
+            uint64_t *swap = keys;
+            keys = tmp;
+            tmp = swap;
+        }
+    }
+    free(count);
+    return keys;
+}
+
+
+// Sorted CSR of the edges src[e] -> dst[e] (see flags above). NULL when an
+// id is outside [0, n_nodes).
+CSRGraph *csrBuild(int n_nodes, long n_edges, const int *src, const int *dst, int flags) {
+    long bad = n_edges;
+    #pragma omp parallel for reduction(min:bad) schedule(static)
+    for (long e = 0; e < n_edges; ++e) {
+        if (src[e] < 0 || src[e] >= n_nodes || dst[e] < 0 || dst[e] >= n_nodes) {
+            bad = e < bad ? e : bad;
+        }
+    }
+    if (bad < n_edges) {
+        fprintf(stderr, "edge %ld (%d -> %d) is outside the %d nodes\n", bad, src[bad], dst[bad], n_nodes);
+        return NULL;
+    }
+
+    int b = csrIdBits(n_nodes);
+    uint64_t mask = ((uint64_t)1 << b) - 1;
+    int sym = (flags & CSR_SYMMETRIZE) != 0, loops = (flags & CSR_NO_SELF_LOOPS) == 0;
+    int nthreads = omp_get_max_threads();
+    long *start = (long *)calloc(nthreads + 1, sizeof(long));
+    uint64_t *keys = NULL, *tmp = NULL;
+    long m = 0;
+
+    // Keys: count what each chunk emits, then write at its prefix
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int t = omp_get_thread_num(), T = omp_get_num_threads();
+        long lo = n_edges * t / T, hi = n_edges * (t + 1) / T, c = 0;
+        for (long e = lo; e < hi; ++e) {
+            c += src[e] == dst[e] ? loops : 1 + sym;
+        }
+        start[t + 1] = c;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            for (int u = 0; u < T; ++u) {
+                start[u + 1] += start[u];
+            }
+            m = start[T];
+            keys = (uint64_t *)malloc((m ? m : 1) * sizeof(uint64_t));
+            tmp = (uint64_t *)malloc((m ? m : 1) * sizeof(uint64_t));
+        }
+        long k = start[t];
+        for (long e = lo; e < hi; ++e) {
+            uint64_t u = (uint64_t)src[e], v = (uint64_t)dst[e];
+            if (u == v && !loops) {
+                continue;
+            }
+            keys[k++] = u << b | v;
+            if (sym && u != v) {
+                keys[k++] = v << b | u;
+            }
+        }
+    }
+    uint64_t *sorted = csrRadixSort(keys, tmp, m, 2 * b);
+
+    // Compaction: chunk t writes the keys it keeps from start[t] on.
+    // A key whose source differs from the key before it opens its row and
+    // every empty row between the two sources.
+    CSRGraph *g = (CSRGraph *)malloc(sizeof(CSRGraph));
+    g->n_nodes = n_nodes;
+    g->offsets = (long *)malloc((n_nodes + 1) * sizeof(long));
+    g->values = NULL;
+    int dedup = (flags & CSR_DEDUP) != 0;
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int t = omp_get_thread_num(), T = omp_get_num_threads();
+        long lo = m * t / T, hi = m * (t + 1) / T, c = 0;
+        for (long k = lo; k < hi; ++k) {
+            c += !(dedup && k > 0 && sorted[k] == sorted[k - 1]);
+        }
+        start[t + 1] = c;
+        #pragma omp barrier
+        #pragma omp single
+        {
+            start[0] = 0;
+            for (int u = 0; u < T; ++u) {
+                start[u + 1] += start[u];
+            }
+            g->n_edges = start[T];
+            g->indices = (int *)malloc((g->n_edges ? g->n_edges : 1) * sizeof(int));
+        }
+        long p = start[t];
+        for (long k = lo; k < hi; ++k) {
+            if (dedup && k > 0 && sorted[k] == sorted[k - 1]) {
+                continue;
+            }
+            long s = (long)(sorted[k] >> b), prev = k > 0 ? (long)(sorted[k - 1] >> b) : -1;
+            for (long r = prev + 1; r <= s; ++r) {
+                g->offsets[r] = p;
+            }
+            g->indices[p++] = (int)(sorted[k] & mask);
+        }
+    }
+    long last = m > 0 ? (long)(sorted[m - 1] >> b) : -1;
+    for (long r = last + 1; r <= n_nodes; ++r) {
+        g->offsets[r] = g->n_edges;
+    }
+    free(keys);
+    free(tmp);
+    free(start);
+    return g;
+}
+
+
+// Sorted rows with every input edge kept (duplicates and self loops too).
+// Neither array needs to be sorted.
+CSRGraph *csrFromEdges(int n_nodes, long n_edges, const int *src, const int *dst) {
+    return csrBuild(n_nodes, n_edges, src, dst, 0);
+}
+
+#endif
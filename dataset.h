@@ -0,0 +1,187 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graph.h"
+#include "loader.h"
+
+// A graph dataset in the pubmed layout, sized at load time:
+//   src.txt, destination.txt -> one edge per line pair
+//   labels.txt               -> one label per node
+//   features.txt             -> n_nodes rows of n_features floats
+// Node ids are 0 .. n_nodes-1 where n_nodes is the number of labels; the
+// edge files need not be sorted. Every buffer is on the heap. The files are
+// read and parsed concurrently, and the out-degrees are counted while
+// src.txt is still arriving.
+
+#define DATASET_DIR "/home/anubhav/GraphNN/GNN/pubmed"
+
+
+// n_nodes, n_edges, n_features, n_classes -> sizes found in the files.
+// src, dst -> edges in file order.
+// labels -> n_nodes labels in [0, n_classes).
+// features -> n_nodes x n_features, row-major.
+// graph -> CSR over src -> dst, each row in file order.
+// load_time -> seconds to read and parse the files (read concurrently).
+typedef struct Dataset {
+    char dir[4096];
+    int n_nodes;
+    long n_edges;
+    int n_features;
+    int n_classes;
+    int *src;
+    int *dst;
+    int *labels;
+    float *features;
+    CSRGraph *graph;
+    double load_time;
+} Dataset;
+
+
+void datasetFree(Dataset *d) {
+    free(d->src);
+    free(d->dst);
+    free(d->labels);
+    free(d->features);
+    csrFree(d->graph);
+    memset(d, 0, sizeof(*d));
+}
+
+
+// Out-degrees counted while src.txt is still arriving
+typedef struct DatasetDegrees {
+    long *count;
+    int cap;
+} DatasetDegrees;
+
+
+static void datasetCountDegrees(void *ctx, const void *values, long first, long count) {
+    DatasetDegrees *deg = (DatasetDegrees *)ctx;
+    const int *src = (const int *)values;
+    (void)first;
+    for (long e = 0; e < count; ++e) {
+        int u = src[e];
+        if (u < 0) {
+            continue;
+        }
+        if (u >= deg->cap) {
+            int cap = deg->cap ? deg->cap : 1024;
+            while (cap <= u) {
+                cap *= 2;
+            }
+            deg->count = (long *)realloc(deg->count, cap * sizeof(long));
+            memset(deg->count + deg->cap, 0, (cap - deg->cap) * sizeof(long));
+            deg->cap = cap;
+        }
+        deg->count[u]++;
+    }
+}
+
+
+// Read the files of dir concurrently (loader.h), validate them and build the
+// graph from the degrees counted on the fly
+static int datasetLoadFiles(Dataset *d, const char *dir, int with_features, int n_features) {
+    memset(d, 0, sizeof(*d));
+    snprintf(d->dir, sizeof(d->dir), "%s", dir ? dir : DATASET_DIR);
+    char path[4][4200];
+    const char *names[4] = {"src.txt", "destination.txt", "labels.txt", "features.txt"};
+    LoadFile files[4];
+    memset(files, 0, sizeof(files));
+    DatasetDegrees deg = {NULL, 0};
+    for (int k = 0; k < 4; ++k) {
+        snprintf(path[k], sizeof(path[k]), "%s/%s", d->dir, names[k]);
+        files[k].path = path[k];
+        files[k].type = k == 3 ? LOADER_FLOAT : LOADER_INT;
+    }
+    files[0].on_values = datasetCountDegrees;
+    files[0].ctx = &deg;
+    double start = omp_get_wtime();
+    int status = loaderRun(files, with_features ? 4 : 3, 0);
+    d->load_time = omp_get_wtime() - start;
+    d->src = (int *)files[0].values;
+    d->dst = (int *)files[1].values;
+    d->labels = (int *)files[2].values;
+    d->features = (float *)files[3].values;
+    long n_src = files[0].count, n_dst = files[1].count, n_labels = files[2].count, n_values = files[3].count;
+    if (status != 0) {
+        free(deg.count);
+        datasetFree(d);
+        return 1;
+    }
+    if (n_src != n_dst || n_labels == 0) {
+        fprintf(stderr, "%s: %ld sources, %ld destinations, %ld labels\n", d->dir, n_src, n_dst, n_labels);
+        free(deg.count);
+        datasetFree(d);
+        return 1;
+    }
+    d->n_nodes = (int)n_labels;
+    d->n_edges = n_src;
+    if (with_features) {
+        if (n_features <= 0) {
+            n_features = (int)(n_values / n_labels);
+        }
+        if (n_features <= 0 || n_values != (long)n_features * n_labels) {
+            fprintf(stderr, "%s: %ld feature values do not make %ld rows\n", d->dir, n_values, n_labels);
+            free(deg.count);
+            datasetFree(d);
+            return 1;
+        }
+        d->n_features = n_features;
+    }
+
+    for (long e = 0; e < d->n_edges; ++e) {
+        if (d->src[e] < 0 || d->src[e] >= d->n_nodes || d->dst[e] < 0 || d->dst[e] >= d->n_nodes) {
+            fprintf(stderr, "%s: edge %ld (%d -> %d) is outside the %d labelled nodes\n", d->dir, e,
+                    d->src[e], d->dst[e], d->n_nodes);
+            free(deg.count);
+            datasetFree(d);
+            return 1;
+        }
+    }
+    for (int i = 0; i < d->n_nodes; ++i) {
+        d->n_classes = d->labels[i] + 1 > d->n_classes ? d->labels[i] + 1 : d->n_classes;
+    }
+    if (deg.cap < d->n_nodes) {
+        // Nodes past the largest source have no out-edges
+        deg.count = (long *)realloc(deg.count, d->n_nodes * sizeof(long));
+        memset(deg.count + deg.cap, 0, (d->n_nodes - deg.cap) * sizeof(long));
+    }
+    d->graph = csrFromEdgesCounted(d->n_nodes, d->n_edges, d->src, d->dst, deg.count);
+    free(deg.count);
+    return 0;
+}
+
+
+// Read the edges and labels of dir and build the graph; the features are
+// left to the caller (features NULL, n_features 0). Returns 0 on success.
+int datasetLoadGraph(Dataset *d, const char *dir) {
+    return datasetLoadFiles(d, dir, 0, 0);
+}
+
+
+// Load dir (DATASET_DIR when NULL). n_features may be 0 to take the width
+// from the number of values per label. Returns 0 on success.
+int datasetLoad(Dataset *d, const char *dir, int n_features) {
+    return datasetLoadFiles(d, dir, 1, n_features);
+}
+
+
+// Expand `call(width)` with the width as a compile-time constant for the
+// common feature widths, so the inner loops of always-inline kernels are
+// specialized for them; other widths take the generic path.
+#define DATASET_DISPATCH_WIDTH(dim, call)         \
+    do {                                          \
+        switch (dim) {                            \
+        case 16: call(16); break;                 \
+        case 32: call(32); break;                 \
+        case 64: call(64); break;                 \
+        case 128: call(128); break;               \
+        case 256: call(256); break;               \
+        case 500: call(500); break;               \
+        default: call(dim); break;                \
+        }                                         \
+    } while (0)
+
+#endif
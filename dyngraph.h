@@ -0,0 +1,778 @@
+#ifndef DYNGRAPH_H
+#define DYNGRAPH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <omp.h>
+#include "graph.h"
+
+// Mutable adjacency for a graph that receives a stream of edge inserts and
+// deletes over a fixed set of nodes.
+//
+// Writers append operations to their own log (one per thread id, so writers
+// never contend). Readers never look at the logs: they work on an immutable
+// DynView, which is
+//   base  -> compacted CSR, rows in insertion order
+//   added -> segments of the edges inserted since base was built
+//   dead  -> tombstone pages over the base edges and the inserted ones
+// Row i of the graph is the live part of base row i followed by the live
+// inserts of i, oldest first.
+//
+// dynRefresh drains the logs and publishes a new view. While the delta is
+// small the view keeps the base and only what changed is new: the inserts
+// of the batch become one segment sorted by source (merged into the newest
+// segments while those are not more than twice its size, so there are
+// O(log inserts) of them and an insert is copied O(log) times), and the
+// tombstones are bitmap pages of DYN_PAGE_IDS edges shared between views,
+// where a delete copies only the page it lands on. A publish costs the
+// batch plus the page table, not the base. Once the delta exceeds
+// compact_ratio of the base edges, a merged base is built instead. The swap
+// is a single pointer store; old views, and the pages and segments only they
+// use, are freed once every reader that could have loaded them has left its
+// read section (epoch-based reclamation), so readers never block and never
+// see a half-built view. dynCompactorStart runs dynRefresh on a background
+// thread.
+//
+// Operations from one thread apply in order. Operations on the same edge
+// from different threads have no defined order. A delete removes one live
+// copy of the edge (base first, then the oldest insert).
+
+#define DYN_MAX_THREADS 256
+#define DYN_INSERT 1
+#define DYN_DELETE -1
+// Tombstone ids per bitmap page (base edge e -> id e, the k-th insert since
+// the base was built -> id base->n_edges + k)
+#define DYN_PAGE_SHIFT 12
+#define DYN_PAGE_IDS (1L << DYN_PAGE_SHIFT)
+#define DYN_PAGE_WORDS (DYN_PAGE_IDS / 64)
+// Each segment is more than twice the next one, so this is never reached
+// below 2^63 inserts
+#define DYN_MAX_SEGMENTS 64
+// Rows per chunk of the row loops; a chunk seeks into each segment once
+#define DYN_ROW_CHUNK 64
+
+
+typedef struct DynOp {
+    int src;
+    int dst;
+    int op;
+} DynOp;
+
+
+// One writer's log; padded so neighboring writers don't share a line
+typedef struct DynLog {
+    pthread_mutex_t lock;
+    DynOp *ops;
+    long count;
+    long cap;
+    char pad[64];
+} DynLog;
+
+
+// Inserts sorted by source, a row's edges in insertion order; id[k] -> the
+// tombstone id of edge k. One allocation, never written once published.
+typedef struct DynSegment {
+    long count;
+    long *id;
+    int *src;
+    int *dst;
+} DynSegment;
+
+
+// dead -> n_pages tombstone pages (a NULL page has no dead edge), NULL when
+// nothing is dead. added -> n_added segments, oldest first.
+typedef struct DynView {
+    CSRGraph *base;
+    uint64_t **dead;
+    long n_pages;
+    DynSegment **added;
+    int n_added;
+    long n_edges;
+    long version;
+} DynView;
+
+
+// Read-side epoch announcement; 0 while the thread is outside a read section
+typedef struct DynReader {
+    unsigned long epoch;
+    char pad[64 - sizeof(unsigned long)];
+} DynReader;
+
+
+// garbage -> pages and segments that a later view replaced; freed with view
+typedef struct DynRetired {
+    DynView *view;
+    int free_base;
+    void **garbage;
+    long n_garbage;
+    unsigned long epoch;
+    struct DynRetired *next;
+} DynRetired;
+
+
+typedef struct DynGraph {
+    int n_nodes;
+    double compact_ratio;
+    DynView *view;
+    unsigned long epoch;
+    DynReader readers[DYN_MAX_THREADS];
+    DynLog logs[DYN_MAX_THREADS];
+
+    // Owned by whoever holds refresh_lock. dead_pages is the current
+    // tombstone set; a page not marked in page_dirty is shared with the
+    // published view and is copied before it is written.
+    pthread_mutex_t refresh_lock;
+    uint64_t **dead_pages;
+    unsigned char *page_dirty;
+    long page_cap;
+    long *dirty;
+    long n_dirty;
+    long base_dead_count;
+    int *pend_src;
+    int *pend_dst;
+    int *pend_next;
+    int *pend_head;
+    long pend_count;
+    long pend_cap;
+    long pend_live;
+    long pend_folded;
+    DynSegment *segs[DYN_MAX_SEGMENTS];
+    int n_segs;
+    void **garbage;
+    long n_garbage;
+    long garbage_cap;
+    DynRetired *retired;
+
+    long applied;
+    long missed_deletes;
+    long publishes;
+    long compactions;
+    long reclaimed;
+    double compact_time;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int running;
+    int stop;
+    int period_ms;
+} DynGraph;
+
+
+// Grow the writer's page table to at least n pages
+static void dynReservePages(DynGraph *g, long n) {
+    if (n <= g->page_cap) {
+        return;
+    }
+    long cap = 2 * g->page_cap > n ? 2 * g->page_cap : n;
+    g->dead_pages = (uint64_t **)realloc(g->dead_pages, cap * sizeof(uint64_t *));
+    g->page_dirty = (unsigned char *)realloc(g->page_dirty, cap);
+    g->dirty = (long *)realloc(g->dirty, cap * sizeof(long));
+    memset(g->dead_pages + g->page_cap, 0, (cap - g->page_cap) * sizeof(uint64_t *));
+    memset(g->page_dirty + g->page_cap, 0, cap - g->page_cap);
+    g->page_cap = cap;
+}
+
+
+// Snapshot of the writer-side state (refresh_lock held)
+static DynView *dynViewNew(DynGraph *g, CSRGraph *base, long version) {
+    DynView *v = (DynView *)malloc(sizeof(DynView));
+    v->base = base;
+    v->dead = NULL;
+    v->n_pages = 0;
+    if (g->base_dead_count || g->pend_live < g->pend_count) {
+        v->n_pages = (base->n_edges + g->pend_count + DYN_PAGE_IDS - 1) >> DYN_PAGE_SHIFT;
+        v->dead = (uint64_t **)malloc(v->n_pages * sizeof(uint64_t *));
+        memcpy(v->dead, g->dead_pages, v->n_pages * sizeof(uint64_t *));
+    }
+    v->n_added = g->n_segs;
+    v->added = NULL;
+    if (g->n_segs) {
+        v->added = (DynSegment **)malloc(g->n_segs * sizeof(DynSegment *));
+        memcpy(v->added, g->segs, g->n_segs * sizeof(DynSegment *));
+    }
+    v->version = version;
+    v->n_edges = base->n_edges - g->base_dead_count + g->pend_live;
+    // From here on the view shares every page
+    for (long k = 0; k < g->n_dirty; ++k) {
+        g->page_dirty[g->dirty[k]] = 0;
+    }
+    g->n_dirty = 0;
+    return v;
+}
+
+
+static void dynViewFree(DynView *v) {
+    free(v->dead);
+    free(v->added);
+    free(v);
+}
+
+
+// Take ownership of base (rows are kept in their current order)
+void dynInit(DynGraph *g, CSRGraph *base, double compact_ratio) {
+    memset(g, 0, sizeof(*g));
+    g->n_nodes = base->n_nodes;
+    g->compact_ratio = compact_ratio;
+    g->epoch = 1;
+    for (int t = 0; t < DYN_MAX_THREADS; ++t) {
+        pthread_mutex_init(&g->logs[t].lock, NULL);
+    }
+    pthread_mutex_init(&g->refresh_lock, NULL);
+    pthread_mutex_init(&g->lock, NULL);
+    pthread_cond_init(&g->cond, NULL);
+    dynReservePages(g, (base->n_edges >> DYN_PAGE_SHIFT) + 1);
+    g->pend_head = (int *)malloc(g->n_nodes * sizeof(int));
+    memset(g->pend_head, 0xff, g->n_nodes * sizeof(int));
+    g->view = dynViewNew(g, base, 0);
+}
+
+
+// Append an operation to thread tid's log; returns 1 for an invalid edge
+int dynPush(DynGraph *g, int tid, int src, int dst, int op) {
+    if (src < 0 || src >= g->n_nodes || dst < 0 || dst >= g->n_nodes || tid < 0 || tid >= DYN_MAX_THREADS) {
+        return 1;
+    }
+    DynLog *log = &g->logs[tid];
+    pthread_mutex_lock(&log->lock);
+    if (log->count == log->cap) {
+        log->cap = log->cap ? 2 * log->cap : 1024;
+        log->ops = (DynOp *)realloc(log->ops, log->cap * sizeof(DynOp));
+    }
+    DynOp *o = &log->ops[log->count++];
+    o->src = src;
+    o->dst = dst;
+    o->op = op;
+    pthread_mutex_unlock(&log->lock);
+    return 0;
+}
+
+
+int dynInsert(DynGraph *g, int tid, int src, int dst) {
+    return dynPush(g, tid, src, dst, DYN_INSERT);
+}
+
+
+int dynDelete(DynGraph *g, int tid, int src, int dst) {
+    return dynPush(g, tid, src, dst, DYN_DELETE);
+}
+
+
+// Enter a read section on thread tid and get the current view. The view
+// stays valid (and unchanged) until dynReadEnd.
+const DynView *dynReadBegin(DynGraph *g, int tid) {
+    __atomic_store_n(&g->readers[tid].epoch, __atomic_load_n(&g->epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+    return __atomic_load_n(&g->view, __ATOMIC_SEQ_CST);
+}
+
+
+void dynReadEnd(DynGraph *g, int tid) {
+    __atomic_store_n(&g->readers[tid].epoch, 0, __ATOMIC_RELEASE);
+}
+
+
+static inline int dynPageTest(uint64_t *const *pages, long id) {
+    const uint64_t *p = pages[id >> DYN_PAGE_SHIFT];
+    return p && (p[(id & (DYN_PAGE_IDS - 1)) >> 6] >> (id & 63) & 1);
+}
+
+
+static inline int dynIsDead(const DynView *v, long id) {
+    return v->dead && dynPageTest(v->dead, id);
+}
+
+
+// First entry of row i in segment s
+static inline long dynSegmentRow(const DynSegment *s, int i) {
+    long lo = 0, hi = s->count;
+    while (lo < hi) {
+        long mid = lo + (hi - lo) / 2;
+        if (s->src[mid] < i) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+// at[s] -> first entry of row i in segment s. A row loop that moves at[s]
+// past the entries of each row it visits keeps it there for the next row.
+static inline void dynSeek(const DynView *v, int i, long *at) {
+    for (int s = 0; s < v->n_added; ++s) {
+        at[s] = dynSegmentRow(v->added[s], i);
+    }
+}
+
+
+// Number of live neighbors of i
+long dynDegree(const DynView *v, int i) {
+    long d = 0;
+    for (long e = v->base->offsets[i]; e < v->base->offsets[i + 1]; ++e) {
+        d += !dynIsDead(v, e);
+    }
+    for (int s = 0; s < v->n_added; ++s) {
+        const DynSegment *a = v->added[s];
+        for (long k = dynSegmentRow(a, i); k < a->count && a->src[k] == i; ++k) {
+            d += !dynIsDead(v, a->id[k]);
+        }
+    }
+    return d;
+}
+
+
+// Y = A X over the live edges of the view (same contract as aggregateSum)
+void dynAggregateSum(const DynView *v, const float *X, float *Y, int dim) {
+    const CSRGraph *b = v->base;
+    int n = b->n_nodes;
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n; c += DYN_ROW_CHUNK) {
+        long at[DYN_MAX_SEGMENTS];
+        dynSeek(v, c, at);
+        int end = c + DYN_ROW_CHUNK < n ? c + DYN_ROW_CHUNK : n;
+        for (int i = c; i < end; ++i) {
+            float *y = Y + (size_t)i * dim;
+            memset(y, 0, dim * sizeof(float));
+            for (long e = b->offsets[i]; e < b->offsets[i + 1]; ++e) {
+                if (dynIsDead(v, e)) {
+                    continue;
+                }
+                const float *x = X + (size_t)b->indices[e] * dim;
+                #pragma omp simd
+                for (int j = 0; j < dim; ++j) {
+                    y[j] += x[j];
+                }
+            }
+            for (int s = 0; s < v->n_added; ++s) {
+                const DynSegment *a = v->added[s];
+                for (; at[s] < a->count && a->src[at[s]] == i; ++at[s]) {
+                    if (dynIsDead(v, a->id[at[s]])) {
+                        continue;
+                    }
+                    const float *x = X + (size_t)a->dst[at[s]] * dim;
+                    #pragma omp simd
+                    for (int j = 0; j < dim; ++j) {
+                        y[j] += x[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// Plain CSR of the view's live edges, rows in the same order as a reader
+// walks them
+CSRGraph *dynMaterialize(const DynView *v) {
+    const CSRGraph *b = v->base;
+    int n = b->n_nodes;
+    CSRGraph *g = (CSRGraph *)malloc(sizeof(CSRGraph));
+    g->n_nodes = n;
+    g->values = NULL;
+    g->offsets = (long *)malloc((n + 1) * sizeof(long));
+    g->offsets[0] = 0;
+    // Degrees first, into offsets[i + 1]
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n; c += DYN_ROW_CHUNK) {
+        long at[DYN_MAX_SEGMENTS];
+        dynSeek(v, c, at);
+        int end = c + DYN_ROW_CHUNK < n ? c + DYN_ROW_CHUNK : n;
+        for (int i = c; i < end; ++i) {
+            long d = 0;
+            for (long e = b->offsets[i]; e < b->offsets[i + 1]; ++e) {
+                d += !dynIsDead(v, e);
+            }
+            for (int s = 0; s < v->n_added; ++s) {
+                const DynSegment *a = v->added[s];
+                for (; at[s] < a->count && a->src[at[s]] == i; ++at[s]) {
+                    d += !dynIsDead(v, a->id[at[s]]);
+                }
+            }
+            g->offsets[i + 1] = d;
+        }
+    }
+    for (int i = 0; i < n; ++i) {
+        g->offsets[i + 1] += g->offsets[i];
+    }
+    g->n_edges = g->offsets[n];
+    g->indices = (int *)malloc((g->n_edges ? g->n_edges : 1) * sizeof(int));
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int c = 0; c < n; c += DYN_ROW_CHUNK) {
+        long at[DYN_MAX_SEGMENTS];
+        dynSeek(v, c, at);
+        int end = c + DYN_ROW_CHUNK < n ? c + DYN_ROW_CHUNK : n;
+        for (int i = c; i < end; ++i) {
+            long k = g->offsets[i];
+            for (long e = b->offsets[i]; e < b->offsets[i + 1]; ++e) {
+                if (!dynIsDead(v, e)) {
+                    g->indices[k++] = b->indices[e];
+                }
+            }
+            for (int s = 0; s < v->n_added; ++s) {
+                const DynSegment *a = v->added[s];
+                for (; at[s] < a->count && a->src[at[s]] == i; ++at[s]) {
+                    if (!dynIsDead(v, a->id[at[s]])) {
+                        g->indices[k++] = a->dst[at[s]];
+                    }
+                }
+            }
+        }
+    }
+    return g;
+}
+
+
+// Free p with the view being replaced (refresh_lock held)
+static void dynDiscard(DynGraph *g, void *p) {
+    if (g->n_garbage == g->garbage_cap) {
+        g->garbage_cap = g->garbage_cap ? 2 * g->garbage_cap : 64;
+        g->garbage = (void **)realloc(g->garbage, g->garbage_cap * sizeof(void *));
+    }
+    g->garbage[g->n_garbage++] = p;
+}
+
+
+// Set tombstone id, copying its page first if the published view shares it
+static void dynMarkDead(DynGraph *g, long id) {
+    long p = id >> DYN_PAGE_SHIFT;
+    if (!g->page_dirty[p]) {
+        uint64_t *page = (uint64_t *)malloc(DYN_PAGE_WORDS * sizeof(uint64_t));
+        if (g->dead_pages[p]) {
+            memcpy(page, g->dead_pages[p], DYN_PAGE_WORDS * sizeof(uint64_t));
+            dynDiscard(g, g->dead_pages[p]);
+        } else {
+            memset(page, 0, DYN_PAGE_WORDS * sizeof(uint64_t));
+        }
+        g->dead_pages[p] = page;
+        g->page_dirty[p] = 1;
+        g->dirty[g->n_dirty++] = p;
+    }
+    g->dead_pages[p][(id & (DYN_PAGE_IDS - 1)) >> 6] |= (uint64_t)1 << (id & 63);
+}
+
+
+// Apply one drained operation to the writer-side state (refresh_lock held)
+static void dynApply(DynGraph *g, const CSRGraph *base, const DynOp *o) {
+    if (o->op == DYN_INSERT) {
+        if (g->pend_count == g->pend_cap) {
+            g->pend_cap = g->pend_cap ? 2 * g->pend_cap : 4096;
+            g->pend_src = (int *)realloc(g->pend_src, g->pend_cap * sizeof(int));
+            g->pend_dst = (int *)realloc(g->pend_dst, g->pend_cap * sizeof(int));
+            g->pend_next = (int *)realloc(g->pend_next, g->pend_cap * sizeof(int));
+        }
+        long k = g->pend_count++;
+        g->pend_src[k] = o->src;
+        g->pend_dst[k] = o->dst;
+        g->pend_next[k] = g->pend_head[o->src];
+        g->pend_head[o->src] = (int)k;
+        g->pend_live++;
+        dynReservePages(g, ((base->n_edges + k) >> DYN_PAGE_SHIFT) + 1);
+        return;
+    }
+    for (long e = base->offsets[o->src]; e < base->offsets[o->src + 1]; ++e) {
+        if (base->indices[e] == o->dst && !dynPageTest(g->dead_pages, e)) {
+            dynMarkDead(g, e);
+            g->base_dead_count++;
+            return;
+        }
+    }
+    // The chain runs newest first; remove the oldest live copy
+    long hit = -1;
+    for (long k = g->pend_head[o->src]; k >= 0; k = g->pend_next[k]) {
+        if (g->pend_dst[k] == o->dst && !dynPageTest(g->dead_pages, base->n_edges + k)) {
+            hit = k;
+        }
+    }
+    if (hit >= 0) {
+        dynMarkDead(g, base->n_edges + hit);
+        g->pend_live--;
+    } else {
+        g->missed_deletes++;
+    }
+}
+
+
+static DynSegment *dynSegmentAlloc(long count) {
+    DynSegment *s = (DynSegment *)malloc(sizeof(DynSegment) + count * (sizeof(long) + 2 * sizeof(int)));
+    s->count = count;
+    s->id = (long *)(s + 1);
+    s->src = (int *)(s->id + count);
+    s->dst = s->src + count;
+    return s;
+}
+
+
+static int dynCompareKey(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+
+// Live edges of a and b as one segment; on equal sources a (the older) goes
+// first
+static DynSegment *dynSegmentMerge(const DynGraph *g, const DynSegment *a, const DynSegment *b) {
+    DynSegment *s = dynSegmentAlloc(a->count + b->count);
+    long i = 0, j = 0, k = 0;
+    while (i < a->count || j < b->count) {
+        const DynSegment *from = b;
+        long e;
+        if (j == b->count || (i < a->count && a->src[i] <= b->src[j])) {
+            from = a;
+            e = i++;
+        } else {
+            e = j++;
+        }
+        if (dynPageTest(g->dead_pages, from->id[e])) {
+            continue;
+        }
+        s->id[k] = from->id[e];
+        s->src[k] = from->src[e];
+        s->dst[k++] = from->dst[e];
+    }
+    s->count = k;
+    return s;
+}
+
+
+// Turn the inserts applied since the last publish into a segment and merge
+// it into the newest segments while they are not more than twice its size
+// (refresh_lock held)
+static void dynFold(DynGraph *g, long base_edges) {
+    long m = 0;
+    uint64_t *keys = (uint64_t *)malloc((g->pend_count - g->pend_folded + 1) * sizeof(uint64_t));
+    for (long k = g->pend_folded; k < g->pend_count; ++k) {
+        if (!dynPageTest(g->dead_pages, base_edges + k)) {
+            keys[m++] = (uint64_t)g->pend_src[k] << 32 | (uint64_t)k;
+        }
+    }
+    g->pend_folded = g->pend_count;
+    if (m == 0) {
+        free(keys);
+        return;
+    }
+    // Pending ids grow with insertion order, so (src, id) keeps rows in it
+    qsort(keys, m, sizeof(uint64_t), dynCompareKey);
+    DynSegment *s = dynSegmentAlloc(m);
+    for (long r = 0; r < m; ++r) {
+        long k = (long)(keys[r] & 0xffffffffu);
+        s->id[r] = base_edges + k;
+        s->src[r] = g->pend_src[k];
+        s->dst[r] = g->pend_dst[k];
+    }
+    free(keys);
+    while (g->n_segs > 0 && (g->segs[g->n_segs - 1]->count <= 2 * s->count || g->n_segs == DYN_MAX_SEGMENTS)) {
+        DynSegment *older = g->segs[--g->n_segs];
+        DynSegment *merged = dynSegmentMerge(g, older, s);
+        dynDiscard(g, older);
+        free(s);
+        s = merged;
+    }
+    if (s->count == 0) {
+        free(s);
+        return;
+    }
+    g->segs[g->n_segs++] = s;
+}
+
+
+// Free retired views that no reader can still hold (refresh_lock held)
+static void dynReclaim(DynGraph *g) {
+    unsigned long oldest = (unsigned long)-1;
+    for (int t = 0; t < DYN_MAX_THREADS; ++t) {
+        unsigned long e = __atomic_load_n(&g->readers[t].epoch, __ATOMIC_SEQ_CST);
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+    DynRetired **link = &g->retired;
+    while (*link) {
+        DynRetired *r = *link;
+        if (r->epoch <= oldest) {
+            if (r->free_base) {
+                csrFree(r->view->base);
+            }
+            dynViewFree(r->view);
+            for (long k = 0; k < r->n_garbage; ++k) {
+                free(r->garbage[k]);
+            }
+            free(r->garbage);
+            *link = r->next;
+            free(r);
+            g->reclaimed++;
+        } else {
+            link = &r->next;
+        }
+    }
+}
+
+
+// Drain every log and publish a view with the result. compact forces the
+// deltas to be merged into a new base. Returns the number of operations
+// applied.
+long dynRefresh(DynGraph *g, int compact) {
+    pthread_mutex_lock(&g->refresh_lock);
+    DynView *old = g->view;
+    const CSRGraph *base = old->base;
+    long applied = 0;
+    for (int t = 0; t < DYN_MAX_THREADS; ++t) {
+        DynLog *log = &g->logs[t];
+        if (__atomic_load_n(&log->count, __ATOMIC_RELAXED) == 0) {
+            continue;
+        }
+        pthread_mutex_lock(&log->lock);
+        DynOp *ops = log->ops;
+        long count = log->count;
+        log->ops = NULL;
+        log->count = log->cap = 0;
+        pthread_mutex_unlock(&log->lock);
+        for (long k = 0; k < count; ++k) {
+            dynApply(g, base, &ops[k]);
+        }
+        free(ops);
+        applied += count;
+    }
+    g->applied += applied;
+    if (applied == 0 && !compact) {
+        dynReclaim(g);
+        pthread_mutex_unlock(&g->refresh_lock);
+        return 0;
+    }
+    dynFold(g, base->n_edges);
+
+    long delta = g->pend_live + g->base_dead_count;
+    DynView *next;
+    int free_base = 0;
+    if (compact || delta > g->compact_ratio * (base->n_edges + 1)) {
+        double start = omp_get_wtime();
+        DynView tmp = {(CSRGraph *)base, g->dead_pages, g->page_cap, g->segs, g->n_segs, 0, 0};
+        CSRGraph *merged = dynMaterialize(&tmp);
+        free_base = 1;
+
+        for (long p = 0; p < g->page_cap; ++p) {
+            if (g->dead_pages[p]) {
+                dynDiscard(g, g->dead_pages[p]);
+            }
+        }
+        memset(g->dead_pages, 0, g->page_cap * sizeof(uint64_t *));
+        memset(g->page_dirty, 0, g->page_cap);
+        g->n_dirty = 0;
+        for (int s = 0; s < g->n_segs; ++s) {
+            dynDiscard(g, g->segs[s]);
+        }
+        g->n_segs = 0;
+        g->base_dead_count = 0;
+        memset(g->pend_head, 0xff, g->n_nodes * sizeof(int));
+        g->pend_count = g->pend_live = g->pend_folded = 0;
+        dynReservePages(g, (merged->n_edges >> DYN_PAGE_SHIFT) + 1);
+        next = dynViewNew(g, merged, old->version + 1);
+        g->compactions++;
+        g->compact_time += omp_get_wtime() - start;
+    } else {
+        next = dynViewNew(g, (CSRGraph *)base, old->version + 1);
+    }
+
+    __atomic_store_n(&g->view, next, __ATOMIC_SEQ_CST);
+    DynRetired *r = (DynRetired *)malloc(sizeof(DynRetired));
+    r->view = old;
+    r->free_base = free_base;
+    r->garbage = g->garbage;
+    r->n_garbage = g->n_garbage;
+    g->garbage = NULL;
+    g->n_garbage = g->garbage_cap = 0;
+    r->epoch = __atomic_add_fetch(&g->epoch, 1, __ATOMIC_SEQ_CST);
+    r->next = g->retired;
+    g->retired = r;
+    g->publishes++;
+    dynReclaim(g);
+    pthread_mutex_unlock(&g->refresh_lock);
+    return applied;
+}
+
+
+static void *dynCompactorMain(void *arg) {
+    DynGraph *g = (DynGraph *)arg;
+    pthread_mutex_lock(&g->lock);
+    while (!g->stop) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        long ns = ts.tv_nsec + g->period_ms * 1000000L;
+        ts.tv_sec += ns / 1000000000L;
+        ts.tv_nsec = ns % 1000000000L;
+        pthread_cond_timedwait(&g->cond, &g->lock, &ts);
+        pthread_mutex_unlock(&g->lock);
+        dynRefresh(g, 0);
+        pthread_mutex_lock(&g->lock);
+    }
+    pthread_mutex_unlock(&g->lock);
+    return NULL;
+}
+
+
+// Refresh every period_ms on a background thread
+int dynCompactorStart(DynGraph *g, int period_ms) {
+    g->period_ms = period_ms;
+    g->stop = 0;
+    if (pthread_create(&g->thread, NULL, dynCompactorMain, g) != 0) {
+        fprintf(stderr, "dyngraph: cannot start compaction thread\n");
+        return 1;
+    }
+    g->running = 1;
+    return 0;
+}
+
+
+// Stop the background thread and publish whatever is still in the logs
+void dynCompactorStop(DynGraph *g) {
+    if (g->running) {
+        pthread_mutex_lock(&g->lock);
+        g->stop = 1;
+        pthread_cond_broadcast(&g->cond);
+        pthread_mutex_unlock(&g->lock);
+        pthread_join(g->thread, NULL);
+        g->running = 0;
+    }
+    dynRefresh(g, 0);
+}
+
+
+// No reader may be inside a read section
+void dynFree(DynGraph *g) {
+    dynCompactorStop(g);
+    pthread_mutex_lock(&g->refresh_lock);
+    dynReclaim(g);
+    pthread_mutex_unlock(&g->refresh_lock);
+    csrFree(g->view->base);
+    dynViewFree(g->view);
+    for (int t = 0; t < DYN_MAX_THREADS; ++t) {
+        free(g->logs[t].ops);
+        pthread_mutex_destroy(&g->logs[t].lock);
+    }
+    // The current view's pages and segments are the writer's
+    for (long p = 0; p < g->page_cap; ++p) {
+        free(g->dead_pages[p]);
+    }
+    for (int s = 0; s < g->n_segs; ++s) {
+        free(g->segs[s]);
+    }
+    for (long k = 0; k < g->n_garbage; ++k) {
+        free(g->garbage[k]);
+    }
+    free(g->dead_pages);
+    free(g->page_dirty);
+    free(g->dirty);
+    free(g->garbage);
+    free(g->pend_src);
+    free(g->pend_dst);
+    free(g->pend_next);
+    free(g->pend_head);
+    pthread_mutex_destroy(&g->refresh_lock);
+    pthread_mutex_destroy(&g->lock);
+    pthread_cond_destroy(&g->cond);
+}
+
+#endif
@@ -0,0 +1,299 @@
+#ifndef EMBED_CACHE_H
+#define EMBED_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "graph.h"
+#include "gcn.h"
+
+// Per-layer cache of GCN node embeddings for inference.
+// Layer l (1..n_layers) keeps the rows computed so far in a dense pool;
+// slot[l][i] is node i's row in that pool or -1. A query only computes the
+// rows it misses, reusing cached rows of lower layers as inputs, so hot nodes
+// and their neighborhoods are evaluated once.
+//
+// Invariant: a cached row was computed from cached (or input) rows of the
+// layer below, and dropping a row drops everything computed from it. When a
+// node's features or edges change, only its k-hop out-neighborhood (the
+// nodes that aggregate it, found on the reverse adjacency) is dropped.
+
+
+typedef struct EmbedCache {
+    const GCNModel *model;
+    const CSRGraph *g;
+    CSRGraph *rev;
+    const int *labels;
+    const float *X;
+    int n_nodes;
+    int n_layers;
+    int dim;
+
+    int *slot[GCN_MAX_LAYERS + 1];
+    float *pool[GCN_MAX_LAYERS + 1];
+    int used[GCN_MAX_LAYERS + 1];
+    int cap[GCN_MAX_LAYERS + 1];
+    int *free_rows[GCN_MAX_LAYERS + 1];
+    int n_free[GCN_MAX_LAYERS + 1];
+    GCNFrontier frontier;
+
+    long hits[GCN_MAX_LAYERS + 1];
+    long misses[GCN_MAX_LAYERS + 1];
+    long dropped[GCN_MAX_LAYERS + 1];
+} EmbedCache;
+
+
+// Totals over all layers
+typedef struct EmbedCacheStats {
+    long hits;
+    long misses;
+    long dropped;
+    long rows;
+    size_t bytes;
+} EmbedCacheStats;
+
+
+// The cache keeps pointers to the model, graph, labels and features; they
+// must outlive it. labels may be NULL (no label gate).
+void embedCacheInit(EmbedCache *c, const GCNModel *model, const CSRGraph *g, const int *labels,
+                    const float *X) {
+    memset(c, 0, sizeof(*c));
+    c->model = model;
+    c->g = g;
+    c->rev = csrTranspose(g);
+    c->labels = labels;
+    c->X = X;
+    c->n_nodes = g->n_nodes;
+    c->n_layers = model->n_layers;
+    c->dim = model->dim;
+    for (int l = 1; l <= c->n_layers; ++l) {
+        c->slot[l] = (int *)malloc(c->n_nodes * sizeof(int));
+        memset(c->slot[l], 0xff, c->n_nodes * sizeof(int));
+        c->free_rows[l] = (int *)malloc(c->n_nodes * sizeof(int));
+    }
+    gcnFrontierInit(&c->frontier, c->n_nodes, c->n_layers, gcnNeighborCap(model->norm));
+}
+
+
+void embedCacheFree(EmbedCache *c) {
+    for (int l = 1; l <= c->n_layers; ++l) {
+        free(c->slot[l]);
+        free(c->pool[l]);
+        free(c->free_rows[l]);
+    }
+    csrFree(c->rev);
+    gcnFrontierFree(&c->frontier);
+}
+
+
+// Give node i a row in layer l's pool, reusing dropped rows first
+static void embedCacheTake(EmbedCache *c, int l, int i) {
+    int row;
+    if (c->n_free[l] > 0) {
+        row = c->free_rows[l][--c->n_free[l]];
+    } else {
+        if (c->used[l] == c->cap[l]) {
+            int cap = c->cap[l] ? 2 * c->cap[l] : 1024;
+            c->cap[l] = cap < c->n_nodes ? cap : c->n_nodes;
+            c->pool[l] = (float *)realloc(c->pool[l], (size_t)c->cap[l] * c->dim * sizeof(float));
+        }
+        row = c->used[l]++;
+    }
+    c->slot[l][i] = row;
+}
+
+
+// Embeddings of the given nodes after the last layer; out[q] points into the
+// cache (NULL for an id outside the graph) and stays valid until the next
+// query, invalidation or compaction.
+void embedCacheQuery(EmbedCache *c, const int *nodes, int count, const float **out) {
+    GCNFrontier *f = &c->frontier;
+    int L = c->n_layers;
+
+    // Top-down: keep only the rows that are missing, and for those only the
+    // inputs that are missing too
+    unsigned s = gcnNextStamp(f);
+    f->count[L] = 0;
+    for (int q = 0; q < count; ++q) {
+        int i = nodes[q];
+        if (i < 0 || i >= c->n_nodes || f->stamp[i] == s) {
+            continue;
+        }
+        f->stamp[i] = s;
+        if (c->slot[L][i] >= 0) {
+            c->hits[L]++;
+        } else {
+            c->misses[L]++;
+            f->rows[L][f->count[L]++] = i;
+        }
+    }
+    for (int l = L - 1; l >= 1; --l) {
+        s = gcnNextStamp(f);
+        f->count[l] = 0;
+        for (int r = 0; r < f->count[l + 1]; ++r) {
+            int i = f->rows[l + 1][r];
+            int cnt = 0;
+            for (long e = c->g->offsets[i]; e < c->g->offsets[i + 1] && cnt < f->cap; ++e) {
+                int u = c->g->indices[e];
+                if (c->labels && c->labels[u] != c->labels[i]) {
+                    continue;
+                }
+                cnt++;
+                if (f->stamp[u] == s) {
+                    continue;
+                }
+                f->stamp[u] = s;
+                if (c->slot[l][u] >= 0) {
+                    c->hits[l]++;
+                } else {
+                    c->misses[l]++;
+                    f->rows[l][f->count[l]++] = u;
+                }
+            }
+        }
+    }
+
+    // Bottom-up: place and compute the missing rows
+    for (int l = 1; l <= L; ++l) {
+        for (int r = 0; r < f->count[l]; ++r) {
+            embedCacheTake(c, l, f->rows[l][r]);
+        }
+        const float *in = (l == 1) ? c->X : c->pool[l - 1];
+        const int *in_slot = (l == 1) ? NULL : c->slot[l - 1];
+        gcnLayerRowsMapped(c->model, l - 1, c->g, c->labels, in, in_slot, c->pool[l], c->slot[l],
+                           f->rows[l], f->count[l]);
+    }
+
+    for (int q = 0; q < count; ++q) {
+        int i = nodes[q];
+        out[q] = (i >= 0 && i < c->n_nodes) ? c->pool[L] + (size_t)c->slot[L][i] * c->dim : NULL;
+    }
+}
+
+
+// Drop what depends on the layer-`layer` values of the given nodes (layer 0
+// is the input features): their own rows at that layer and, for every layer
+// above, the rows of the nodes that aggregate a dropped row. Uncached rows
+// stop the walk, since nothing cached can have been computed from them.
+void embedCacheInvalidate(EmbedCache *c, const int *nodes, int count, int layer) {
+    GCNFrontier *f = &c->frontier;
+    int *cur = f->rows[0], *next = f->rows[1];
+    int n_cur = 0;
+    unsigned s = gcnNextStamp(f);
+    for (int q = 0; q < count; ++q) {
+        int i = nodes[q];
+        if (i < 0 || i >= c->n_nodes || f->stamp[i] == s) {
+            continue;
+        }
+        f->stamp[i] = s;
+        if (layer == 0 || c->slot[layer][i] >= 0) {
+            cur[n_cur++] = i;
+        }
+    }
+
+    for (int l = layer; l <= c->n_layers && n_cur > 0; ++l) {
+        if (l > layer) {
+            // Next level: cached readers of the current level
+            s = gcnNextStamp(f);
+            int n_next = 0;
+            for (int r = 0; r < n_cur; ++r) {
+                int u = cur[r];
+                for (long e = c->rev->offsets[u]; e < c->rev->offsets[u + 1]; ++e) {
+                    int i = c->rev->indices[e];
+                    if (f->stamp[i] != s && c->slot[l][i] >= 0) {
+                        f->stamp[i] = s;
+                        next[n_next++] = i;
+                    }
+                }
+            }
+            int *t = cur;
+            cur = next;
+            next = t;
+            n_cur = n_next;
+        }
+        if (l == 0) {
+            continue;
+        }
+        for (int r = 0; r < n_cur; ++r) {
+            int i = cur[r];
+            c->free_rows[l][c->n_free[l]++] = c->slot[l][i];
+            c->slot[l][i] = -1;
+        }
+        c->dropped[l] += n_cur;
+    }
+}
+
+
+// The caller changed the feature rows of the given nodes in place
+void embedCacheFeaturesChanged(EmbedCache *c, const int *nodes, int count) {
+    embedCacheInvalidate(c, nodes, count, 0);
+}
+
+
+// The caller changed the out-edges (or labels) of the given nodes; g is the
+// updated graph and replaces the one the cache was built on. For a
+// normalized model g is renormalized and nodes lists every row whose edge
+// values changed.
+void embedCacheEdgesChanged(EmbedCache *c, const CSRGraph *g, const int *nodes, int count) {
+    c->g = g;
+    csrFree(c->rev);
+    c->rev = csrTranspose(g);
+    // Their own adjacency is read again at every layer
+    for (int l = 1; l <= c->n_layers; ++l) {
+        embedCacheInvalidate(c, nodes, count, l);
+    }
+    if (c->labels) {
+        // A label change also flips the gate of everyone reading these nodes
+        embedCacheInvalidate(c, nodes, count, 0);
+    }
+}
+
+
+// Repack every layer's pool so the cached rows are contiguous and the pool
+// holds no dead rows; invalidates pointers returned by embedCacheQuery
+void embedCacheCompact(EmbedCache *c) {
+    for (int l = 1; l <= c->n_layers; ++l) {
+        int rows = c->used[l] - c->n_free[l];
+        float *pool = (float *)malloc((size_t)(rows ? rows : 1) * c->dim * sizeof(float));
+        int next = 0;
+        for (int i = 0; i < c->n_nodes; ++i) {
+            if (c->slot[l][i] >= 0) {
+                memcpy(pool + (size_t)next * c->dim, c->pool[l] + (size_t)c->slot[l][i] * c->dim,
+                       c->dim * sizeof(float));
+                c->slot[l][i] = next++;
+            }
+        }
+        free(c->pool[l]);
+        c->pool[l] = pool;
+        c->used[l] = c->cap[l] = rows;
+        c->n_free[l] = 0;
+    }
+}
+
+
+void embedCacheStats(const EmbedCache *c, EmbedCacheStats *st) {
+    memset(st, 0, sizeof(*st));
+    st->bytes = (size_t)(c->n_nodes + 1) * sizeof(long) + (size_t)c->rev->n_edges * sizeof(int);
+    for (int l = 1; l <= c->n_layers; ++l) {
+        st->hits += c->hits[l];
+        st->misses += c->misses[l];
+        st->dropped += c->dropped[l];
+        st->rows += c->used[l] - c->n_free[l];
+        st->bytes += (size_t)c->cap[l] * c->dim * sizeof(float) + 2 * (size_t)c->n_nodes * sizeof(int);
+    }
+}
+
+
+// Per-layer table of hit rates and resident rows
+void embedCacheReport(const EmbedCache *c, FILE *out) {
+    fprintf(out, "%6s %12s %12s %9s %10s %10s %10s\n", "layer", "hits", "misses", "hit_rate",
+            "rows", "dropped", "pool(MB)");
+    for (int l = 1; l <= c->n_layers; ++l) {
+        long total = c->hits[l] + c->misses[l];
+        fprintf(out, "%6d %12ld %12ld %9.3f %10d %10ld %10.2f\n", l, c->hits[l], c->misses[l],
+                total ? (double)c->hits[l] / total : 0.0, c->used[l] - c->n_free[l], c->dropped[l],
+                (double)c->cap[l] * c->dim * sizeof(float) / (1 << 20));
+    }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <omp.h>
+#include "reduce.h"
+
+// Inference-only evaluation of a trained model over a labeled set.
+// evalRun cuts the samples into batches and threads take whole batches. The
+// batch function reads the model (shared, never written) and keeps the
+// batch's activations in the calling thread's own scratch block, allocated
+// and first touched by that thread. It writes the predicted class and the
+// loss of every sample in the batch. The correct and per-class counts are
+// integer reductions and the mean loss is a fixed-shape sum (reduce.h), so
+// the report is the same for any number of threads or batch size.
+
+// pred[r], loss[r] -> class and loss of sample begin + r
+typedef void (*EvalBatch)(const void *ctx, void *scratch, long begin, long end, int *pred, double *loss);
+
+
+// class_samples[c] -> samples labeled c; class_correct[c] -> those predicted c.
+// Labels outside [0, n_classes) count as wrong and in no class.
+typedef struct EvalReport {
+    long n_samples;
+    long correct;
+    double loss;
+    double accuracy;
+    int n_classes;
+    long *class_samples;
+    long *class_correct;
+    int n_threads;
+    double seconds;
+} EvalReport;
+
+
+void evalFree(EvalReport *r) {
+    free(r->class_samples);
+    free(r->class_correct);
+    r->class_samples = NULL;
+    r->class_correct = NULL;
+}
+
+
+// Evaluate samples [0, n) in batches of batch_size; scratch_bytes per thread
+// (0 for none). Returns 0 on success.
+int evalRun(EvalReport *r, EvalBatch batch, const void *ctx, long n, long batch_size, size_t scratch_bytes,
+            const int *labels, int n_classes) {
+    double start = omp_get_wtime();
+    int *pred = (int *)malloc((n ? n : 1) * sizeof(int));
+    double *loss = (double *)malloc((n ? n : 1) * sizeof(double));
+    r->n_samples = n;
+    r->n_classes = n_classes;
+    r->class_samples = (long *)calloc(n_classes ? n_classes : 1, sizeof(long));
+    r->class_correct = (long *)calloc(n_classes ? n_classes : 1, sizeof(long));
+    if (!pred || !loss || !r->class_samples || !r->class_correct) {
+        fprintf(stderr, "Could not allocate the evaluation of %ld samples\n", n);
+        free(pred);
+        free(loss);
+        evalFree(r);
+        return 1;
+    }
+    batch_size = batch_size > 0 ? batch_size : 1;
+    long batches = (n + batch_size - 1) / batch_size;
+    int threads = 1;
+    #pragma omp parallel
+    {
+        #pragma omp single
+        threads = omp_get_num_threads();
+        void *scratch = scratch_bytes ? malloc(scratch_bytes) : NULL;
+        #pragma omp for schedule(dynamic, 1)
+        for (long b = 0; b < batches; ++b) {
+            long begin = b * batch_size, end = begin + batch_size < n ? begin + batch_size : n;
+            batch(ctx, scratch, begin, end, pred + begin, loss + begin);
+        }
+        free(scratch);
+    }
+
+    long correct = 0;
+    long *samples = r->class_samples, *hits = r->class_correct;
+    #pragma omp parallel for reduction(+:correct, samples[:n_classes], hits[:n_classes]) schedule(static)
+    for (long i = 0; i < n; ++i) {
+        int c = labels[i];
+        if (c >= 0 && c < n_classes) {
+            samples[c]++;
+            hits[c] += pred[i] == c;
+            correct += pred[i] == c;
+        }
+    }
+    r->correct = correct;
+    r->loss = n ? reduceSum(loss, n) / n : 0.0;
+    r->accuracy = n ? (double)correct / n : 0.0;
+    r->n_threads = threads;
+    r->seconds = omp_get_wtime() - start;
+    free(pred);
+    free(loss);
+    return 0;
+}
+
+
+void evalPrint(const EvalReport *r, const char *name, FILE *out) {
+    fprintf(out, "%s: %ld samples, loss %.6f, accuracy %.4f (%ld correct), %.3fs on %d threads\n", name,
+            r->n_samples, r->loss, r->accuracy, r->correct, r->seconds, r->n_threads);
+    for (int c = 0; c < r->n_classes; ++c) {
+        long s = r->class_samples[c];
+        fprintf(out, "  class %d: %ld/%ld = %.4f\n", c, r->class_correct[c], s,
+                s ? (double)r->class_correct[c] / s : 0.0);
+    }
+}
+
+#endif
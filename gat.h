@@ -0,0 +1,383 @@
+#ifndef GAT_H
+#define GAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "kernels.h"
+#include "rng.h"
+
+// Graph attention layer on the CSR arrays.
+// Per head h, with z = X W_h projected rows,
+//     e_ij  = leakyrelu(a_dst_h . z_i + a_src_h . z_j)
+//     alpha = softmax of e_ij over the neighbors j of i (and i itself when
+//             self_loop is set)
+//     y_i   = sum_j alpha_ij z_j
+// and the heads are concatenated (heads * out_dim columns) or averaged.
+//
+// The logits, the softmax and the weighted sum run in one pass over each
+// row: the softmax is computed online, rescaling the partial sum whenever
+// a larger logit shows up, so only the row maximum and normalizer are kept
+// (per node and head). Nothing is stored per edge; the backward pass
+// recomputes alpha from those two numbers and the projected scores. It walks
+// the rows once for the destination side and the transposed graph once for
+// the source side, so every row is written by one thread and the gradients
+// do not depend on scheduling. Edge values are ignored.
+
+#define GAT_MAX_HEADS 16
+#define GAT_SLOPE 0.2f
+
+
+// W -> in_dim x (heads * out_dim), head h owns columns h*out_dim ...
+// a_src, a_dst -> heads * out_dim attention vectors.
+// dW, da_src, da_dst -> gradients from the last gatBackward.
+// Z, s_src, s_dst, row_max, row_sum, Yh -> state of the last gatForward
+// (n_rows rows), kept for the backward pass.
+typedef struct GATLayer {
+    int in_dim;
+    int out_dim;
+    int heads;
+    int concat;
+    int self_loop;
+    float slope;
+    float *W;
+    float *a_src;
+    float *a_dst;
+    float *dW;
+    float *da_src;
+    float *da_dst;
+
+    int n_rows;
+    float *Z;
+    float *s_src;
+    float *s_dst;
+    float *row_max;
+    float *row_sum;
+    float *Yh;
+    float *dZ;
+    float *ds_src;
+    float *ds_dst;
+    float *row_dot;
+} GATLayer;
+
+
+// Glorot-uniform weights from the counter-based stream `seed`
+int gatInit(GATLayer *layer, int in_dim, int out_dim, int heads, int concat, unsigned long long seed) {
+    if (heads < 1 || heads > GAT_MAX_HEADS) {
+        fprintf(stderr, "GAT heads must be in [1, %d]\n", GAT_MAX_HEADS);
+        return 1;
+    }
+    memset(layer, 0, sizeof(*layer));
+    layer->in_dim = in_dim;
+    layer->out_dim = out_dim;
+    layer->heads = heads;
+    layer->concat = concat;
+    layer->self_loop = 1;
+    layer->slope = GAT_SLOPE;
+    int width = heads * out_dim;
+    layer->W = (float *)malloc((size_t)in_dim * width * sizeof(float));
+    layer->a_src = (float *)malloc(width * sizeof(float));
+    layer->a_dst = (float *)malloc(width * sizeof(float));
+    layer->dW = (float *)calloc((size_t)in_dim * width, sizeof(float));
+    layer->da_src = (float *)calloc(width, sizeof(float));
+    layer->da_dst = (float *)calloc(width, sizeof(float));
+    double scale = sqrt(6.0 / (in_dim + out_dim)), ascale = sqrt(6.0 / (out_dim + 1));
+    for (long k = 0; k < (long)in_dim * width; ++k) {
+        layer->W[k] = (float)((2.0 * rngUniform(seed, k) - 1.0) * scale);
+    }
+    for (int k = 0; k < width; ++k) {
+        layer->a_src[k] = (float)((2.0 * rngUniform(seed + 1, k) - 1.0) * ascale);
+        layer->a_dst[k] = (float)((2.0 * rngUniform(seed + 2, k) - 1.0) * ascale);
+    }
+    return 0;
+}
+
+
+int gatOutputDim(const GATLayer *layer) {
+    return layer->concat ? layer->heads * layer->out_dim : layer->out_dim;
+}
+
+
+void gatFree(GATLayer *layer) {
+    free(layer->W);
+    free(layer->a_src);
+    free(layer->a_dst);
+    free(layer->dW);
+    free(layer->da_src);
+    free(layer->da_dst);
+    free(layer->Z);
+    free(layer->s_src);
+    free(layer->s_dst);
+    free(layer->row_max);
+    free(layer->row_sum);
+    free(layer->Yh);
+    free(layer->dZ);
+    free(layer->ds_src);
+    free(layer->ds_dst);
+    free(layer->row_dot);
+}
+
+
+// (Re)size the per-node state for n rows
+static void gatReserve(GATLayer *layer, int n) {
+    if (layer->n_rows == n) {
+        return;
+    }
+    size_t width = (size_t)layer->heads * layer->out_dim, heads = layer->heads;
+    layer->n_rows = n;
+    layer->Z = (float *)realloc(layer->Z, n * width * sizeof(float));
+    layer->Yh = (float *)realloc(layer->Yh, n * width * sizeof(float));
+    layer->s_src = (float *)realloc(layer->s_src, n * heads * sizeof(float));
+    layer->s_dst = (float *)realloc(layer->s_dst, n * heads * sizeof(float));
+    layer->row_max = (float *)realloc(layer->row_max, n * heads * sizeof(float));
+    layer->row_sum = (float *)realloc(layer->row_sum, n * heads * sizeof(float));
+    free(layer->dZ);
+    free(layer->ds_src);
+    free(layer->ds_dst);
+    free(layer->row_dot);
+    layer->dZ = layer->ds_src = layer->ds_dst = layer->row_dot = NULL;
+}
+
+
+static inline float gatLeaky(float x, float slope) {
+    return x > 0.0f ? x : slope * x;
+}
+
+
+// Neighbor k of row i, where k == degree is the self loop
+static inline int gatNeighbor(const CSRGraph *g, int i, long k) {
+    long e = g->offsets[i] + k;
+    return e < g->offsets[i + 1] ? g->indices[e] : i;
+}
+
+
+// Y (n x gatOutputDim) = the layer applied to X (n x in_dim) over g
+void gatForward(GATLayer *layer, const CSRGraph *g, const float *X, float *Y) {
+    int n = g->n_nodes, H = layer->heads, F = layer->out_dim, HF = H * F;
+    float slope = layer->slope;
+    gatReserve(layer, n);
+    float *Z = layer->Z, *Yh = layer->Yh, *s_src = layer->s_src, *s_dst = layer->s_dst;
+    denseForward(X, layer->W, NULL, Z, n, layer->in_dim, HF);
+
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < n; ++i) {
+        const float *zi = Z + (size_t)i * HF;
+        for (int h = 0; h < H; ++h) {
+            float src = 0.0f, dst = 0.0f;
+            for (int f = 0; f < F; ++f) {
+                src += layer->a_src[h * F + f] * zi[h * F + f];
+                dst += layer->a_dst[h * F + f] * zi[h * F + f];
+            }
+            s_src[(size_t)i * H + h] = src;
+            s_dst[(size_t)i * H + h] = dst;
+        }
+    }
+
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < n; ++i) {
+        float mx[GAT_MAX_HEADS], sum[GAT_MAX_HEADS];
+        float *yi = Yh + (size_t)i * HF;
+        memset(yi, 0, HF * sizeof(float));
+        for (int h = 0; h < H; ++h) {
+            mx[h] = -INFINITY;
+            sum[h] = 0.0f;
+        }
+        long degree = g->offsets[i + 1] - g->offsets[i] + layer->self_loop;
+        for (long k = 0; k < degree; ++k) {
+            int j = gatNeighbor(g, i, k);
+            const float *zj = Z + (size_t)j * HF;
+            for (int h = 0; h < H; ++h) {
+                float e = gatLeaky(s_dst[(size_t)i * H + h] + s_src[(size_t)j * H + h], slope);
+                float *yh = yi + h * F;
+                if (e > mx[h]) {
+                    // New running maximum: rescale what was summed so far
+                    float scale = expf(mx[h] - e);
+                    sum[h] *= scale;
+                    #pragma omp simd
+                    for (int f = 0; f < F; ++f) {
+                        yh[f] *= scale;
+                    }
+                    mx[h] = e;
+                }
+                float p = expf(e - mx[h]);
+                sum[h] += p;
+                const float *zh = zj + h * F;
+                #pragma omp simd
+                for (int f = 0; f < F; ++f) {
+                    yh[f] += p * zh[f];
+                }
+            }
+        }
+        for (int h = 0; h < H; ++h) {
+            float inv = sum[h] > 0.0f ? 1.0f / sum[h] : 0.0f;
+            float *yh = yi + h * F;
+            #pragma omp simd
+            for (int f = 0; f < F; ++f) {
+                yh[f] *= inv;
+            }
+            layer->row_max[(size_t)i * H + h] = mx[h];
+            layer->row_sum[(size_t)i * H + h] = sum[h];
+        }
+
+        if (layer->concat) {
+            memcpy(Y + (size_t)i * HF, yi, HF * sizeof(float));
+        } else {
+            float *out = Y + (size_t)i * F;
+            for (int f = 0; f < F; ++f) {
+                float acc = 0.0f;
+                for (int h = 0; h < H; ++h) {
+                    acc += yi[h * F + f];
+                }
+                out[f] = acc / H;
+            }
+        }
+    }
+}
+
+
+// Upstream gradient of head h at row i: a pointer into dY and its weight
+static inline const float *gatHeadGrad(const GATLayer *layer, const float *dY, int i, int h, float *scale) {
+    int F = layer->out_dim;
+    if (layer->concat) {
+        *scale = 1.0f;
+        return dY + (size_t)i * layer->heads * F + h * F;
+    }
+    *scale = 1.0f / layer->heads;
+    return dY + (size_t)i * F;
+}
+
+
+// Given dY = d(loss)/d(Y) for the last gatForward over g, fill dW, da_src,
+// da_dst and (when dX != NULL) dX = d(loss)/d(X). rev is csrTranspose(g)
+// and X the same input the forward pass saw.
+void gatBackward(GATLayer *layer, const CSRGraph *g, const CSRGraph *rev, const float *X, const float *dY,
+                 float *dX) {
+    int n = g->n_nodes, H = layer->heads, F = layer->out_dim, HF = H * F;
+    float slope = layer->slope;
+    const float *Z = layer->Z, *s_src = layer->s_src, *s_dst = layer->s_dst;
+    const float *row_max = layer->row_max, *row_sum = layer->row_sum;
+    if (!layer->dZ) {
+        layer->dZ = (float *)malloc((size_t)n * HF * sizeof(float));
+        layer->ds_src = (float *)malloc((size_t)n * H * sizeof(float));
+        layer->ds_dst = (float *)malloc((size_t)n * H * sizeof(float));
+        layer->row_dot = (float *)malloc((size_t)n * H * sizeof(float));
+    }
+    float *dZ = layer->dZ, *ds_src = layer->ds_src, *ds_dst = layer->ds_dst, *row_dot = layer->row_dot;
+
+    // Destination side: d(loss)/d(e_ij) = alpha_ij (dy_i . z_j - dy_i . y_i),
+    // summed over the row into the gradient of s_dst[i]
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < n; ++i) {
+        long degree = g->offsets[i + 1] - g->offsets[i] + layer->self_loop;
+        for (int h = 0; h < H; ++h) {
+            float w;
+            const float *dy = gatHeadGrad(layer, dY, i, h, &w);
+            const float *yh = layer->Yh + (size_t)i * HF + h * F;
+            float c = 0.0f;
+            for (int f = 0; f < F; ++f) {
+                c += dy[f] * yh[f];
+            }
+            c *= w;
+            row_dot[(size_t)i * H + h] = c;
+            float mx = row_max[(size_t)i * H + h], sum = row_sum[(size_t)i * H + h], acc = 0.0f;
+            for (long k = 0; k < degree && sum > 0.0f; ++k) {
+                int j = gatNeighbor(g, i, k);
+                const float *zh = Z + (size_t)j * HF + h * F;
+                float raw = s_dst[(size_t)i * H + h] + s_src[(size_t)j * H + h];
+                float alpha = expf(gatLeaky(raw, slope) - mx) / sum;
+                float dot = 0.0f;
+                #pragma omp simd reduction(+:dot)
+                for (int f = 0; f < F; ++f) {
+                    dot += dy[f] * zh[f];
+                }
+                acc += alpha * (w * dot - c) * (raw > 0.0f ? 1.0f : slope);
+            }
+            ds_dst[(size_t)i * H + h] = acc;
+        }
+    }
+
+    // Source side over the transposed graph: z_j collects alpha_ij dy_i from
+    // every row i that attends to it, and the gradient of s_src[j]
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int j = 0; j < n; ++j) {
+        float *dz = dZ + (size_t)j * HF;
+        const float *zj = Z + (size_t)j * HF;
+        memset(dz, 0, HF * sizeof(float));
+        float acc[GAT_MAX_HEADS];
+        for (int h = 0; h < H; ++h) {
+            acc[h] = 0.0f;
+        }
+        long degree = rev->offsets[j + 1] - rev->offsets[j] + layer->self_loop;
+        for (long k = 0; k < degree; ++k) {
+            int i = gatNeighbor(rev, j, k);
+            for (int h = 0; h < H; ++h) {
+                float mx = row_max[(size_t)i * H + h], sum = row_sum[(size_t)i * H + h];
+                if (sum <= 0.0f) {
+                    continue;
+                }
+                float w;
+                const float *dy = gatHeadGrad(layer, dY, i, h, &w);
+                const float *zh = zj + h * F;
+                float *dzh = dz + h * F;
+                float raw = s_dst[(size_t)i * H + h] + s_src[(size_t)j * H + h];
+                float alpha = expf(gatLeaky(raw, slope) - mx) / sum;
+                float dot = 0.0f, aw = alpha * w;
+                #pragma omp simd reduction(+:dot)
+                for (int f = 0; f < F; ++f) {
+                    dot += dy[f] * zh[f];
+                    dzh[f] += aw * dy[f];
+                }
+                acc[h] += alpha * (w * dot - row_dot[(size_t)i * H + h]) * (raw > 0.0f ? 1.0f : slope);
+            }
+        }
+        for (int h = 0; h < H; ++h) {
+            ds_src[(size_t)j * H + h] = acc[h];
+            float a = acc[h], b = ds_dst[(size_t)j * H + h];
+            float *dzh = dz + h * F;
+            #pragma omp simd
+            for (int f = 0; f < F; ++f) {
+                dzh[f] += a * layer->a_src[h * F + f] + b * layer->a_dst[h * F + f];
+            }
+        }
+    }
+
+    // Attention vectors: per-thread partials summed in thread order
+    int nthreads = omp_get_max_threads();
+    float *partial = (float *)calloc((size_t)nthreads * 2 * HF, sizeof(float));
+    #pragma omp parallel num_threads(nthreads)
+    {
+        float *P = partial + (size_t)omp_get_thread_num() * 2 * HF;
+        #pragma omp for schedule(static)
+        for (int j = 0; j < n; ++j) {
+            const float *zj = Z + (size_t)j * HF;
+            for (int h = 0; h < H; ++h) {
+                float a = ds_src[(size_t)j * H + h], b = ds_dst[(size_t)j * H + h];
+                for (int f = 0; f < F; ++f) {
+                    P[h * F + f] += a * zj[h * F + f];
+                    P[HF + h * F + f] += b * zj[h * F + f];
+                }
+            }
+        }
+        #pragma omp for schedule(static)
+        for (int k = 0; k < HF; ++k) {
+            float src = 0.0f, dst = 0.0f;
+            for (int t = 0; t < nthreads; ++t) {
+                src += partial[(size_t)t * 2 * HF + k];
+                dst += partial[(size_t)t * 2 * HF + HF + k];
+            }
+            layer->da_src[k] = src;
+            layer->da_dst[k] = dst;
+        }
+    }
+    free(partial);
+
+    denseGradWeight(X, dZ, layer->dW, n, layer->in_dim, HF);
+    if (dX) {
+        denseGradInput(dZ, layer->W, dX, n, layer->in_dim, HF);
+    }
+}
+
+#endif
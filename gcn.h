@@ -0,0 +1,301 @@
+#ifndef GCN_H
+#define GCN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <limits.h>
+#include <omp.h>
+#include "graph.h"
+#include "checkpoint.h"
+#include "graph_norm.h"
+
+// Inference-side copy of the GCN_t1 model, loaded from its checkpoints.
+// Layer l maps the node embeddings h to
+//     h'[i] = relu(w_l .* sum_{u in N(i)} a_iu h[u] + b_l)
+// where N(i) is the first GCN_NEIGHBOR_CAP neighbors of i, in edge order, that
+// share i's label (no gate when labels is NULL) and a_iu = 1. A model trained
+// with -DGCN_NORM runs on the normalized graph instead (gcnModelGraph): N(i)
+// is every gated neighbor and a_iu the edge value. Training pulls every
+// feature of node i towards labels[i], so the class is the rounded mean of
+// the final embedding.
+
+#define GCN_MAX_LAYERS 16
+#define GCN_NEIGHBOR_CAP 50
+
+
+// n_layers -> number of message-passing layers.
+// dim -> embedding width (num_features, or the PCA width).
+// weight -> per-layer weight vectors of dim entries.
+// bias -> per-layer scalar bias.
+// norm, self_loops -> GRAPH_NORM_* and self loops of the graph it was
+//                     trained on (GRAPH_NORM_NONE: the capped raw sum).
+typedef struct GCNModel {
+    int n_layers;
+    int dim;
+    int norm;
+    int self_loops;
+    float *weight[GCN_MAX_LAYERS];
+    float bias[GCN_MAX_LAYERS];
+} GCNModel;
+
+
+void gcnFree(GCNModel *model) {
+    for (int l = 0; l < model->n_layers; ++l) {
+        free(model->weight[l]);
+    }
+    model->n_layers = 0;
+}
+
+
+// Neighbors aggregated per row: all of them on a normalized graph
+int gcnNeighborCap(int norm) {
+    return norm == GRAPH_NORM_NONE ? GCN_NEIGHBOR_CAP : INT_MAX;
+}
+
+
+// Read the "layer%d.weight" / "layer%d.bias" and "gcn.norm" tensors written
+// by GCN_t1 (no gcn.norm: the raw sum). Returns 0 on success.
+int gcnLoad(GCNModel *model, const char *path) {
+    CkptMap map;
+    if (ckptOpen(&map, path) != 0) {
+        return 1;
+    }
+    char name[CKPT_NAME_LEN];
+    model->n_layers = 0;
+    model->dim = 0;
+    model->norm = GRAPH_NORM_NONE;
+    model->self_loops = 0;
+    if (ckptFind(&map, "gcn.norm")) {
+        const long *norm = (const long *)ckptTensor(&map, "gcn.norm", CKPT_I64, 2);
+        if (!norm || norm[0] < GRAPH_NORM_NONE || norm[0] > GRAPH_NORM_MEAN) {
+            fprintf(stderr, "%s: unknown normalization\n", path);
+            ckptClose(&map);
+            return 1;
+        }
+        model->norm = (int)norm[0];
+        model->self_loops = (int)norm[1];
+    }
+    for (int l = 0; l < GCN_MAX_LAYERS; ++l) {
+        snprintf(name, sizeof(name), "layer%d.weight", l);
+        const CkptEntry *e = ckptFind(&map, name);
+        if (e == NULL) {
+            break;
+        }
+        int dim = (int)e->shape[0];
+        const float *w = (const float *)ckptTensor(&map, name, CKPT_F32, dim);
+        snprintf(name, sizeof(name), "layer%d.bias", l);
+        const float *b = (const float *)ckptTensor(&map, name, CKPT_F32, 1);
+        if (!w || !b || (model->dim && dim != model->dim)) {
+            fprintf(stderr, "%s: layer %d is malformed\n", path, l);
+            gcnFree(model);
+            ckptClose(&map);
+            return 1;
+        }
+        model->dim = dim;
+        model->weight[l] = (float *)malloc(dim * sizeof(float));
+        memcpy(model->weight[l], w, dim * sizeof(float));
+        model->bias[l] = b[0];
+        model->n_layers++;
+    }
+    ckptClose(&map);
+    if (model->n_layers == 0) {
+        fprintf(stderr, "%s: no GCN layers found\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+
+// The graph the model was trained on: g itself, or its normalized copy from
+// the dataset's graph_<norm>.bin cache (the one GCN_t1 writes). Free the
+// result with csrFree when it is not g.
+CSRGraph *gcnModelGraph(const GCNModel *model, CSRGraph *g, const char *dir) {
+    if (model->norm == GRAPH_NORM_NONE) {
+        return g;
+    }
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/graph_%s.bin", dir, graphNormName(model->norm));
+    return graphNormalizedCached(g, model->norm, model->self_loops, path);
+}
+
+
+// Apply layer l to the listed rows only (all rows when rows is NULL). Row i
+// of in lives at in_slot[i] and row i of out at out_slot[i]; a NULL slot map
+// means rows are indexed by node id. Only the listed rows of out are
+// written, and only the neighbors of those rows are read from in.
+void gcnLayerRowsMapped(const GCNModel *model, int l, const CSRGraph *g, const int *labels,
+                        const float *in, const int *in_slot, float *out, const int *out_slot,
+                        const int *rows, int count) {
+    int dim = model->dim;
+    const float *w = model->weight[l];
+    float b = model->bias[l];
+    int cap = gcnNeighborCap(model->norm);
+    const float *a = model->norm == GRAPH_NORM_NONE ? NULL : g->values;
+
+    #pragma omp parallel for schedule(dynamic, 16) if (count > 64)
+    for (int r = 0; r < count; ++r) {
+        int i = rows ? rows[r] : r;
+        float *o = out + (size_t)(out_slot ? out_slot[i] : i) * dim;
+        memset(o, 0, dim * sizeof(float));
+        int cnt = 0;
+        for (long e = g->offsets[i]; e < g->offsets[i + 1] && cnt < cap; ++e) {
+            int u = g->indices[e];
+            if (labels && labels[u] != labels[i]) {
+                continue;
+            }
+            cnt++;
+            const float *h = in + (size_t)(in_slot ? in_slot[u] : u) * dim;
+            if (a) {
+                float s = a[e];
+                #pragma omp simd
+                for (int j = 0; j < dim; ++j) {
+                    o[j] += s * h[j];
+                }
+            } else {
+                #pragma omp simd
+                for (int j = 0; j < dim; ++j) {
+                    o[j] += h[j];
+                }
+            }
+        }
+        #pragma omp simd
+        for (int j = 0; j < dim; ++j) {
+            float v = o[j] * w[j] + b;
+            o[j] = v > 0 ? v : 0;
+        }
+    }
+}
+
+
+void gcnLayerRows(const GCNModel *model, int l, const CSRGraph *g, const int *labels,
+                  const float *in, float *out, const int *rows, int count) {
+    gcnLayerRowsMapped(model, l, g, labels, in, NULL, out, NULL, rows, count);
+}
+
+
+// Full forward pass over every node; buf must hold 2 * n_nodes * dim floats.
+// Returns the final embeddings (one of the two halves of buf).
+float *gcnForward(const GCNModel *model, const CSRGraph *g, const int *labels, const float *X,
+                  float *buf) {
+    float *half[2] = {buf, buf + (size_t)g->n_nodes * model->dim};
+    const float *in = X;
+    for (int l = 0; l < model->n_layers; ++l) {
+        gcnLayerRows(model, l, g, labels, in, half[l & 1], NULL, g->n_nodes);
+        in = half[l & 1];
+    }
+    return half[(model->n_layers - 1) & 1];
+}
+
+
+// Receptive field of a batch of query nodes.
+// rows[l], count[l] -> distinct nodes whose layer-l output (l = 1..n_layers)
+//                      has to be computed; rows[n_layers] is the batch itself.
+// cap -> neighbors read per row (gcnNeighborCap of the model).
+// stamp, current -> visit marks, so building a level costs O(touched edges)
+//                   instead of O(n_nodes).
+typedef struct GCNFrontier {
+    int n_nodes;
+    int n_layers;
+    int cap;
+    int *rows[GCN_MAX_LAYERS + 1];
+    int count[GCN_MAX_LAYERS + 1];
+    unsigned *stamp;
+    unsigned current;
+} GCNFrontier;
+
+
+void gcnFrontierInit(GCNFrontier *f, int n_nodes, int n_layers, int cap) {
+    f->n_nodes = n_nodes;
+    f->n_layers = n_layers;
+    f->cap = cap;
+    for (int l = 0; l <= n_layers; ++l) {
+        f->rows[l] = (int *)malloc(n_nodes * sizeof(int));
+        f->count[l] = 0;
+    }
+    f->stamp = (unsigned *)calloc(n_nodes, sizeof(unsigned));
+    f->current = 0;
+}
+
+
+void gcnFrontierFree(GCNFrontier *f) {
+    for (int l = 0; l <= f->n_layers; ++l) {
+        free(f->rows[l]);
+    }
+    free(f->stamp);
+}
+
+
+static unsigned gcnNextStamp(GCNFrontier *f) {
+    if (++f->current == 0) {
+        memset(f->stamp, 0, f->n_nodes * sizeof(unsigned));
+        f->current = 1;
+    }
+    return f->current;
+}
+
+
+// Collect the receptive field of the given nodes, level by level from the
+// top. A level only holds the gated, capped neighbors that the layer above
+// actually reads, so a batch touches at most cap^k rows per query.
+// Ids outside [0, n_nodes) are skipped.
+void gcnFrontierBuild(GCNFrontier *f, const CSRGraph *g, const int *labels, const int *nodes,
+                      int count) {
+    int L = f->n_layers;
+    unsigned s = gcnNextStamp(f);
+    f->count[L] = 0;
+    for (int q = 0; q < count; ++q) {
+        int i = nodes[q];
+        if (i >= 0 && i < f->n_nodes && f->stamp[i] != s) {
+            f->stamp[i] = s;
+            f->rows[L][f->count[L]++] = i;
+        }
+    }
+    for (int l = L - 1; l >= 1; --l) {
+        s = gcnNextStamp(f);
+        f->count[l] = 0;
+        for (int r = 0; r < f->count[l + 1]; ++r) {
+            int i = f->rows[l + 1][r];
+            int cnt = 0;
+            for (long e = g->offsets[i]; e < g->offsets[i + 1] && cnt < f->cap; ++e) {
+                int u = g->indices[e];
+                if (labels && labels[u] != labels[i]) {
+                    continue;
+                }
+                cnt++;
+                if (f->stamp[u] != s) {
+                    f->stamp[u] = s;
+                    f->rows[l][f->count[l]++] = u;
+                }
+            }
+        }
+    }
+}
+
+
+// Evaluate the layers over a built frontier; buf is laid out like in
+// gcnForward. Rows of the result outside rows[n_layers] are stale.
+float *gcnForwardFrontier(const GCNModel *model, const GCNFrontier *f, const CSRGraph *g,
+                          const int *labels, const float *X, float *buf) {
+    float *half[2] = {buf, buf + (size_t)g->n_nodes * model->dim};
+    const float *in = X;
+    for (int l = 1; l <= model->n_layers; ++l) {
+        gcnLayerRows(model, l - 1, g, labels, in, half[l & 1], f->rows[l], f->count[l]);
+        in = half[l & 1];
+    }
+    return half[model->n_layers & 1];
+}
+
+
+// Class of one final embedding: its mean rounded into [0, classes)
+int gcnPredict(const float *h, int dim, int classes) {
+    double sum = 0.0;
+    for (int j = 0; j < dim; ++j) {
+        sum += h[j];
+    }
+    long c = lrint(sum / dim);
+    return (int)(c < 0 ? 0 : (c >= classes ? classes - 1 : c));
+}
+
+#endif
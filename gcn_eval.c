@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "graph.h"
+#include "dataset.h"
+#include "gcn.h"
+#include "reduce.h"
+#include "eval.h"
+
+// Accuracy of a GCN_t1 checkpoint on the node labels (labels.txt), overall
+// and per class.
+// Usage: gcn_eval [--data dir] [--ckpt gcn_ckpt.bin] [--features 0]
+//                 [--no-gate 1] [--batch 1024]
+// A layer reads the neighbor rows of the layer below, so the embeddings of
+// the whole graph come from one gcnForward; evalRun then scores them in
+// batches of nodes. A node is predicted as gcnPredict does and its loss is
+// the mean squared distance of its embedding to its label, the error
+// GCN_t1 trains on.
+
+
+typedef struct EvalConfig {
+    const char *data;
+    const char *ckpt;
+    int features;
+    int gate;
+    long batch;
+} EvalConfig;
+
+
+static int parseArgs(EvalConfig *cfg, int argc, char **argv) {
+    cfg->data = DATASET_DIR;
+    cfg->ckpt = "gcn_ckpt.bin";
+    cfg->features = 0;
+    cfg->gate = 1;
+    cfg->batch = 1024;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *key = argv[i], *val = argv[i + 1];
+        if (strcmp(key, "--data") == 0) cfg->data = val;
+        else if (strcmp(key, "--ckpt") == 0) cfg->ckpt = val;
+        else if (strcmp(key, "--features") == 0) cfg->features = atoi(val);
+        else if (strcmp(key, "--no-gate") == 0) cfg->gate = !atoi(val);
+        else if (strcmp(key, "--batch") == 0) cfg->batch = atol(val);
+        else {
+            fprintf(stderr, "Unknown option %s\n", key);
+            return 1;
+        }
+    }
+    if (cfg->batch < 1 || cfg->features < 0) {
+        fprintf(stderr, "batch must be positive\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Final embeddings and labels, read by every batch
+typedef struct NodeSet {
+    const float *H;
+    const int *labels;
+    int dim;
+    int n_classes;
+} NodeSet;
+
+
+static void nodeBatch(const void *ctx, void *scratch, long begin, long end, int *pred, double *loss) {
+    const NodeSet *set = (const NodeSet *)ctx;
+    (void)scratch;
+    for (long i = begin; i < end; ++i) {
+        const float *h = set->H + (size_t)i * set->dim;
+        pred[i - begin] = gcnPredict(h, set->dim, set->n_classes);
+        loss[i - begin] = reduceSquaredDiffFloat(h, set->labels[i], set->dim) / set->dim;
+    }
+}
+
+
+int main(int argc, char **argv) {
+    EvalConfig cfg;
+    if (parseArgs(&cfg, argc, argv) != 0) {
+        return 1;
+    }
+    GCNModel model;
+    if (gcnLoad(&model, cfg.ckpt) != 0) {
+        fprintf(stderr, "Could not load %s\n", cfg.ckpt);
+        return 1;
+    }
+    static Dataset data;
+    if (datasetLoad(&data, cfg.data, cfg.features) != 0) {
+        return 1;
+    }
+    if (data.n_features != model.dim) {
+        fprintf(stderr, "Checkpoint expects %d features, the data has %d\n", model.dim, data.n_features);
+        return 1;
+    }
+    CSRGraph *g = gcnModelGraph(&model, data.graph, data.dir);
+    int n = data.n_nodes, dim = model.dim;
+    float *buf = (float *)malloc(2 * (size_t)n * dim * sizeof(float));
+    double start = omp_get_wtime();
+    const float *H = gcnForward(&model, g, cfg.gate ? data.labels : NULL, data.features, buf);
+    double forwardTime = omp_get_wtime() - start;
+
+    NodeSet set = {H, data.labels, dim, data.n_classes};
+    EvalReport report;
+    if (evalRun(&report, nodeBatch, &set, n, cfg.batch, 0, data.labels, data.n_classes) != 0) {
+        return 1;
+    }
+    printf("nodes=%d layers=%d dim=%d classes=%d gate=%d forward=%.3fs\n", n, model.n_layers, dim, data.n_classes,
+           cfg.gate, forwardTime);
+    evalPrint(&report, "nodes", stdout);
+
+    evalFree(&report);
+    if (g != data.graph) {
+        csrFree(g);
+    }
+    gcnFree(&model);
+    free(buf);
+    datasetFree(&data);
+    return 0;
+}
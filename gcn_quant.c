@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "dataset.h"
+#include "gcn.h"
+#include "quant.h"
+#include "rng.h"
+
+// Post-training int8 quantization of a GCN_t1 checkpoint.
+// Usage: gcn_quant [--data dir] [--ckpt gcn_ckpt.bin] [--out gcn_quant.bin]
+//                  [--features 0] [--mode channel|row] [--calib 2048]
+//                  [--percentile 100] [--no-gate 1] [--seed 1]
+// Calibration runs the float model over the graph and records, for each
+// layer input, the per-channel range over --calib randomly drawn nodes
+// (clipped at --percentile). The int8 model (weights, bias and scales) is
+// written to --out for gcn_serve --quant. Both models then classify every
+// node and the report compares them: accuracy, the predictions that changed,
+// the error of the final embeddings, feature memory and forward time.
+
+
+typedef struct QuantConfig {
+    const char *data;
+    const char *ckpt;
+    const char *out;
+    int features;
+    int mode;
+    long calib;
+    double percentile;
+    int gate;
+    unsigned long long seed;
+} QuantConfig;
+
+
+static int parseArgs(QuantConfig *cfg, int argc, char **argv) {
+    cfg->data = DATASET_DIR;
+    cfg->ckpt = "gcn_ckpt.bin";
+    cfg->out = "gcn_quant.bin";
+    cfg->features = 0;
+    cfg->mode = QUANT_PER_CHANNEL;
+    cfg->calib = 2048;
+    cfg->percentile = 100.0;
+    cfg->gate = 1;
+    cfg->seed = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *key = argv[i], *val = argv[i + 1];
+        if (strcmp(key, "--data") == 0) cfg->data = val;
+        else if (strcmp(key, "--ckpt") == 0) cfg->ckpt = val;
+        else if (strcmp(key, "--out") == 0) cfg->out = val;
+        else if (strcmp(key, "--features") == 0) cfg->features = atoi(val);
+        else if (strcmp(key, "--mode") == 0) cfg->mode = strcmp(val, "row") == 0 ? QUANT_PER_ROW : QUANT_PER_CHANNEL;
+        else if (strcmp(key, "--calib") == 0) cfg->calib = atol(val);
+        else if (strcmp(key, "--percentile") == 0) cfg->percentile = atof(val);
+        else if (strcmp(key, "--no-gate") == 0) cfg->gate = !atoi(val);
+        else if (strcmp(key, "--seed") == 0) cfg->seed = strtoull(val, NULL, 10);
+        else {
+            fprintf(stderr, "Unknown option %s\n", key);
+            return 1;
+        }
+    }
+    if (cfg->calib < 1 || cfg->percentile <= 0.0 || cfg->percentile > 100.0 || cfg->features < 0) {
+        fprintf(stderr, "calib must be positive and percentile in (0, 100]\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// count distinct nodes drawn without replacement (partial Fisher-Yates)
+static int *calibrationNodes(int n, long count, unsigned long long seed) {
+    int *perm = (int *)malloc(n * sizeof(int));
+    for (int i = 0; i < n; ++i) {
+        perm[i] = i;
+    }
+    for (long k = 0; k < count; ++k) {
+        long j = k + (long)rngBounded(seed, (uint64_t)k, (uint64_t)(n - k));
+        int t = perm[k];
+        perm[k] = perm[j];
+        perm[j] = t;
+    }
+    return perm;
+}
+
+
+int main(int argc, char **argv) {
+    QuantConfig cfg;
+    if (parseArgs(&cfg, argc, argv) != 0) {
+        return 1;
+    }
+    GCNModel model;
+    if (gcnLoad(&model, cfg.ckpt) != 0) {
+        fprintf(stderr, "Could not load %s\n", cfg.ckpt);
+        return 1;
+    }
+    static Dataset data;
+    if (datasetLoad(&data, cfg.data, cfg.features) != 0) {
+        return 1;
+    }
+    if (data.n_features != model.dim) {
+        fprintf(stderr, "Checkpoint expects %d features, the data has %d\n", model.dim, data.n_features);
+        return 1;
+    }
+    CSRGraph *g = gcnModelGraph(&model, data.graph, data.dir);
+    const int *labels = cfg.gate ? data.labels : NULL;
+    int n = data.n_nodes, dim = model.dim;
+    long calib = cfg.calib < n ? cfg.calib : n;
+
+    double start = omp_get_wtime();
+    float *scale[GCN_MAX_LAYERS];
+    for (int l = 0; l < model.n_layers; ++l) {
+        scale[l] = (float *)malloc(dim * sizeof(float));
+    }
+    int *nodes = calibrationNodes(n, calib, cfg.seed);
+    if (cfg.mode == QUANT_PER_CHANNEL) {
+        gcnCalibrate(&model, g, labels, data.features, nodes, calib, cfg.percentile, scale);
+    }
+    GCNQuant qm;
+    gcnQuantize(&qm, &model, cfg.mode, scale);
+    double calibTime = omp_get_wtime() - start;
+    if (gcnQuantSave(&qm, cfg.out) != 0) {
+        return 1;
+    }
+    printf("nodes=%d layers=%d dim=%d threads=%d mode=%s calib=%ld percentile=%.3f calibrate=%.3fs -> %s\n", n,
+           model.n_layers, dim, omp_get_max_threads(), quantModeName(cfg.mode), calib, cfg.percentile, calibTime,
+           cfg.out);
+
+    // Float reference
+    float *buf = (float *)malloc(2 * (size_t)n * dim * sizeof(float));
+    start = omp_get_wtime();
+    const float *H = gcnForward(&model, g, labels, data.features, buf);
+    double floatTime = omp_get_wtime() - start;
+
+    // Int8: features quantized once, as a server would keep them
+    QuantRows QX, act[2];
+    gcnQuantInput(&qm, 0, &QX, n);
+    gcnQuantInput(&qm, 0, &act[0], n);
+    gcnQuantInput(&qm, 0, &act[1], n);
+    start = omp_get_wtime();
+    quantizeRows(&QX, data.features);
+    double quantizeTime = omp_get_wtime() - start;
+    float *Hq = (float *)malloc((size_t)n * dim * sizeof(float));
+    start = omp_get_wtime();
+    gcnQuantForward(&qm, g, labels, &QX, act, Hq);
+    double int8Time = omp_get_wtime() - start;
+
+    long hits = 0, hitsq = 0, changed = 0;
+    double sumErr = 0.0, maxErr = 0.0, sumRef = 0.0;
+    #pragma omp parallel for reduction(+:hits, hitsq, changed, sumErr, sumRef) reduction(max:maxErr) schedule(static)
+    for (int i = 0; i < n; ++i) {
+        const float *h = H + (size_t)i * dim, *hq = Hq + (size_t)i * dim;
+        int c = gcnPredict(h, dim, data.n_classes), cq = gcnPredict(hq, dim, data.n_classes);
+        hits += (c == data.labels[i]);
+        hitsq += (cq == data.labels[i]);
+        changed += (c != cq);
+        for (int j = 0; j < dim; ++j) {
+            double e = fabs((double)hq[j] - h[j]);
+            sumErr += e;
+            sumRef += fabs((double)h[j]);
+            maxErr = e > maxErr ? e : maxErr;
+        }
+    }
+    double featBytes = (double)n * dim * sizeof(float);
+    printf("features: float32 %.1fMB, int8 %.1fMB (%.2fx smaller), quantized in %.3fs\n", featBytes / 1048576.0,
+           quantRowsBytes(&QX) / 1048576.0, featBytes / quantRowsBytes(&QX), quantizeTime);
+    printf("forward: float32 %.3fs, int8 %.3fs (%.2fx)\n", floatTime, int8Time, floatTime / int8Time);
+    printf("accuracy: float32 %.4f, int8 %.4f, delta %+.4f; %ld of %d predictions changed\n", (double)hits / n,
+           (double)hitsq / n, (double)(hitsq - hits) / n, changed, n);
+    printf("embedding error: mean abs %.3g (%.3g relative), max abs %.3g\n", sumErr / ((double)n * dim),
+           sumRef > 0 ? sumErr / sumRef : 0.0, maxErr);
+
+    quantRowsFree(&QX);
+    quantRowsFree(&act[0]);
+    quantRowsFree(&act[1]);
+    for (int l = 0; l < model.n_layers; ++l) {
+        free(scale[l]);
+    }
+    gcnQuantFree(&qm);
+    gcnFree(&model);
+    if (g != data.graph) {
+        csrFree(g);
+    }
+    free(nodes);
+    free(buf);
+    free(Hq);
+    datasetFree(&data);
+    return 0;
+}
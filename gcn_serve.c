@@ -0,0 +1,561 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <omp.h>
+#include "graph.h"
+#include "dataset.h"
+#include "gcn.h"
+#include "embed_cache.h"
+#include "pca.h"
+#include "quant.h"
+
+// Long-running node-classification server for a trained GCN_t1 model.
+// Usage: gcn_serve [--data dir] [--ckpt gcn_ckpt.bin] [--features 0]
+//                  [--pca pca.bin] [--socket path] [--batch 64]
+//                  [--wait-us 200] [--no-gate 1] [--cache 1]
+//                  [--quant gcn_quant.bin]
+// The graph, features and weights are loaded once. Clients send lines of
+// whitespace-separated node ids and get one "<id> <class>" line back per id,
+// in order ("<id> -1" for an unknown id). The line "stats" answers with the
+// latency summary right away. Without --socket the protocol runs over
+// stdin/stdout and the server exits at end of input.
+//
+// Queries from all clients go through one queue. The batcher takes up to
+// --batch of them, or fewer once the oldest has waited --wait-us, and only
+// evaluates the k-hop receptive field of that batch. Latency is measured from
+// the moment a query is parsed to the moment its answer is written. With
+// --cache every layer's embeddings are kept between batches (embed_cache.h),
+// so only rows no earlier batch has computed are evaluated; the stats then
+// include the hit rate and the cache size.
+//
+// --quant serves the int8 model written by gcn_quant instead of --ckpt: the
+// features are quantized once at startup (a quarter of the float memory) and
+// the layers gather int8 rows. It does not combine with --cache.
+
+#define SERVE_QUEUE_CAP 65536
+
+
+typedef struct ServeConfig {
+    const char *data;
+    const char *ckpt;
+    const char *pca;
+    const char *socket;
+    int features;
+    int batch;
+    int wait_us;
+    const char *quant;
+    int gate;
+    int cache;
+} ServeConfig;
+
+
+// One client. The reader thread owns the input side; the batcher writes the
+// answers, so the connection is closed by whichever finishes last.
+typedef struct Conn {
+    FILE *in;
+    int out;
+    int owned;
+    int pending;
+    int closed;
+} Conn;
+
+
+// node is -1 when id is not a node of the graph
+typedef struct Request {
+    Conn *conn;
+    long id;
+    int node;
+    double arrival;
+} Request;
+
+
+typedef struct Server {
+    const CSRGraph *g;
+    const int *labels;
+    const float *X;
+    int classes;
+    GCNModel model;
+    GCNQuant *quant;
+    QuantRows QX;
+    QuantRows act[2];
+    GCNFrontier frontier;
+    float *buf;
+    EmbedCache *cache;
+    const float **rows;
+    int batch;
+    double wait;
+
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t space;
+    pthread_mutex_t out_lock;
+    Request queue[SERVE_QUEUE_CAP];
+    long head;
+    long tail;
+    int readers;
+    int stop;
+
+    double *latency;
+    long served;
+    long latency_cap;
+    long batches;
+    double first_arrival;
+    double last_done;
+    EmbedCacheStats cache_stats;
+} Server;
+
+
+static volatile sig_atomic_t interrupted = 0;
+
+
+static void onSignal(int sig) {
+    (void)sig;
+    interrupted = 1;
+}
+
+
+static int writeAll(int fd, const char *buf, size_t len) {
+    while (len > 0) {
+        ssize_t w = write(fd, buf, len);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 1;
+        }
+        buf += w;
+        len -= w;
+    }
+    return 0;
+}
+
+
+// Caller holds s->lock
+static void releaseConn(Conn *c) {
+    if (c->closed && c->pending == 0) {
+        if (c->owned) {
+            fclose(c->in);
+        }
+        free(c);
+    }
+}
+
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+
+// Latency summary of everything answered so far
+static void formatStats(Server *s, char *line, size_t size) {
+    pthread_mutex_lock(&s->lock);
+    long n = s->served;
+    double *sorted = (double *)malloc((n ? n : 1) * sizeof(double));
+    memcpy(sorted, s->latency, n * sizeof(double));
+    long batches = s->batches;
+    double span = s->last_done - s->first_arrival;
+    EmbedCacheStats cs = s->cache_stats;
+    pthread_mutex_unlock(&s->lock);
+
+    qsort(sorted, n, sizeof(double), compareDouble);
+    double p50 = n ? sorted[(n - 1) / 2] : 0.0;
+    double p99 = n ? sorted[(long)((n - 1) * 0.99)] : 0.0;
+    int len = snprintf(line, size, "served=%ld batches=%ld mean_batch=%.1f p50_us=%.1f p99_us=%.1f qps=%.1f",
+                       n, batches, batches ? (double)n / batches : 0.0, 1e6 * p50, 1e6 * p99,
+                       span > 0 ? n / span : 0.0);
+    if (s->cache) {
+        long lookups = cs.hits + cs.misses;
+        len += snprintf(line + len, size - len, " hit_rate=%.3f cached_rows=%ld cache_mb=%.1f",
+                        lookups ? (double)cs.hits / lookups : 0.0, cs.rows, cs.bytes / 1048576.0);
+    }
+    snprintf(line + len, size - len, "\n");
+    free(sorted);
+}
+
+
+static void enqueue(Server *s, Conn *c, long id) {
+    pthread_mutex_lock(&s->lock);
+    while (s->tail - s->head == SERVE_QUEUE_CAP && !s->stop) {
+        pthread_cond_wait(&s->space, &s->lock);
+    }
+    Request *r = &s->queue[s->tail % SERVE_QUEUE_CAP];
+    r->conn = c;
+    r->id = id;
+    r->node = (id >= 0 && id < s->g->n_nodes) ? (int)id : -1;
+    r->arrival = omp_get_wtime();
+    if (s->first_arrival == 0.0) {
+        s->first_arrival = r->arrival;
+    }
+    s->tail++;
+    c->pending++;
+    pthread_cond_signal(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+}
+
+
+typedef struct ReaderArgs {
+    Server *server;
+    Conn *conn;
+} ReaderArgs;
+
+
+// Parse one client's lines into queued requests
+static void *readerMain(void *arg) {
+    ReaderArgs *a = (ReaderArgs *)arg;
+    Server *s = a->server;
+    Conn *c = a->conn;
+    free(a);
+
+    char *line = NULL;
+    size_t cap = 0;
+    while (getline(&line, &cap, c->in) > 0) {
+        if (strncmp(line, "stats", 5) == 0) {
+            char stats[256];
+            formatStats(s, stats, sizeof(stats));
+            pthread_mutex_lock(&s->out_lock);
+            writeAll(c->out, stats, strlen(stats));
+            pthread_mutex_unlock(&s->out_lock);
+            continue;
+        }
+        char *p = line, *end;
+        for (;;) {
+            long id = strtol(p, &end, 10);
+            if (end == p) {
+                break;
+            }
+            enqueue(s, c, id);
+            p = end;
+        }
+    }
+    free(line);
+
+    pthread_mutex_lock(&s->lock);
+    c->closed = 1;
+    s->readers--;
+    releaseConn(c);
+    pthread_cond_signal(&s->ready);
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+
+// Answer one batch: build the receptive field, run the layers over it and
+// write the replies, coalescing consecutive ones for the same client
+static void serveBatch(Server *s, Request *reqs, int count) {
+    int *nodes = (int *)malloc(count * sizeof(int));
+    for (int r = 0; r < count; ++r) {
+        nodes[r] = reqs[r].node;
+    }
+    const float *H = NULL;
+    if (s->cache) {
+        embedCacheQuery(s->cache, nodes, count, s->rows);
+    } else if (s->quant) {
+        gcnFrontierBuild(&s->frontier, s->g, s->labels, nodes, count);
+        gcnQuantForwardFrontier(s->quant, &s->frontier, s->g, s->labels, &s->QX, s->act, s->buf);
+        H = s->buf;
+    } else {
+        gcnFrontierBuild(&s->frontier, s->g, s->labels, nodes, count);
+        H = gcnForwardFrontier(&s->model, &s->frontier, s->g, s->labels, s->X, s->buf);
+    }
+
+    char *out = (char *)malloc((size_t)count * 40);
+    size_t len = 0;
+    double *done = (double *)malloc(count * sizeof(double));
+    int first = 0;
+    pthread_mutex_lock(&s->out_lock);
+    for (int r = 0; r < count; ++r) {
+        int i = nodes[r];
+        const float *h = s->cache ? s->rows[r] : H + (size_t)i * s->model.dim;
+        int c = (i >= 0) ? gcnPredict(h, s->model.dim, s->classes) : -1;
+        len += sprintf(out + len, "%ld %d\n", reqs[r].id, c);
+        if (r + 1 == count || reqs[r + 1].conn != reqs[r].conn) {
+            writeAll(reqs[r].conn->out, out, len);
+            double now = omp_get_wtime();
+            for (int q = first; q <= r; ++q) {
+                done[q] = now;
+            }
+            len = 0;
+            first = r + 1;
+        }
+    }
+    pthread_mutex_unlock(&s->out_lock);
+
+    pthread_mutex_lock(&s->lock);
+    if (s->served + count > s->latency_cap) {
+        s->latency_cap = 2 * (s->served + count);
+        s->latency = (double *)realloc(s->latency, s->latency_cap * sizeof(double));
+    }
+    for (int r = 0; r < count; ++r) {
+        s->latency[s->served++] = done[r] - reqs[r].arrival;
+        reqs[r].conn->pending--;
+        releaseConn(reqs[r].conn);
+    }
+    s->batches++;
+    s->last_done = done[count - 1];
+    if (s->cache) {
+        embedCacheStats(s->cache, &s->cache_stats);
+    }
+    pthread_mutex_unlock(&s->lock);
+    free(nodes);
+    free(out);
+    free(done);
+}
+
+
+// Batcher loop; returns once there are no readers left (stdin mode) or on stop
+static void *batcherMain(void *arg) {
+    Server *s = (Server *)arg;
+    Request *reqs = (Request *)malloc(s->batch * sizeof(Request));
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        while (s->head == s->tail && !s->stop && s->readers > 0) {
+            pthread_cond_wait(&s->ready, &s->lock);
+        }
+        if (s->head == s->tail) {
+            break;
+        }
+        // Give a partial batch until the oldest query's deadline to fill up
+        double deadline = s->queue[s->head % SERVE_QUEUE_CAP].arrival + s->wait;
+        while (s->tail - s->head < s->batch && !s->stop && s->readers > 0) {
+            double left = deadline - omp_get_wtime();
+            if (left <= 0) {
+                break;
+            }
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            long ns = ts.tv_nsec + (long)(left * 1e9);
+            ts.tv_sec += ns / 1000000000L;
+            ts.tv_nsec = ns % 1000000000L;
+            pthread_cond_timedwait(&s->ready, &s->lock, &ts);
+        }
+        int count = 0;
+        while (count < s->batch && s->head < s->tail) {
+            reqs[count++] = s->queue[s->head++ % SERVE_QUEUE_CAP];
+        }
+        pthread_cond_broadcast(&s->space);
+        pthread_mutex_unlock(&s->lock);
+        serveBatch(s, reqs, count);
+        pthread_mutex_lock(&s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    free(reqs);
+    return NULL;
+}
+
+
+static void startReader(Server *s, FILE *in, int out, int owned) {
+    Conn *c = (Conn *)calloc(1, sizeof(Conn));
+    c->in = in;
+    c->out = out;
+    c->owned = owned;
+    ReaderArgs *a = (ReaderArgs *)malloc(sizeof(ReaderArgs));
+    a->server = s;
+    a->conn = c;
+    pthread_mutex_lock(&s->lock);
+    s->readers++;
+    pthread_mutex_unlock(&s->lock);
+    pthread_t tid;
+    pthread_create(&tid, NULL, readerMain, a);
+    pthread_detach(tid);
+}
+
+
+static int listenUnix(const char *path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        perror(path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+static int parseArgs(ServeConfig *cfg, int argc, char **argv) {
+    cfg->data = DATASET_DIR;
+    cfg->ckpt = "gcn_ckpt.bin";
+    cfg->pca = NULL;
+    cfg->socket = NULL;
+    cfg->quant = NULL;
+    cfg->features = 0;
+    cfg->batch = 64;
+    cfg->wait_us = 200;
+    cfg->gate = 1;
+    cfg->cache = 0;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const char *key = argv[i], *val = argv[i + 1];
+        if (strcmp(key, "--data") == 0) cfg->data = val;
+        else if (strcmp(key, "--ckpt") == 0) cfg->ckpt = val;
+        else if (strcmp(key, "--pca") == 0) cfg->pca = val;
+        else if (strcmp(key, "--socket") == 0) cfg->socket = val;
+        else if (strcmp(key, "--features") == 0) cfg->features = atoi(val);
+        else if (strcmp(key, "--batch") == 0) cfg->batch = atoi(val);
+        else if (strcmp(key, "--wait-us") == 0) cfg->wait_us = atoi(val);
+        else if (strcmp(key, "--no-gate") == 0) cfg->gate = !atoi(val);
+        else if (strcmp(key, "--cache") == 0) cfg->cache = atoi(val);
+        else if (strcmp(key, "--quant") == 0) cfg->quant = val;
+        else {
+            fprintf(stderr, "Unknown option %s\n", key);
+            return 1;
+        }
+    }
+    if (cfg->batch < 1 || cfg->wait_us < 0 || cfg->features < 0) {
+        fprintf(stderr, "batch must be positive\n");
+        return 1;
+    }
+    if (cfg->quant && cfg->cache) {
+        fprintf(stderr, "--quant does not combine with --cache\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+int main(int argc, char **argv) {
+    ServeConfig cfg;
+    if (parseArgs(&cfg, argc, argv) != 0) {
+        return 1;
+    }
+    static Server s;
+    if (cfg.quant) {
+        // Only the shape of the float model is used from here on
+        static GCNQuant quant;
+        if (gcnQuantLoad(&quant, cfg.quant) != 0) {
+            fprintf(stderr, "Could not load %s\n", cfg.quant);
+            return 1;
+        }
+        s.quant = &quant;
+        s.model.n_layers = quant.n_layers;
+        s.model.dim = quant.dim;
+        s.model.norm = quant.norm;
+        s.model.self_loops = quant.self_loops;
+    } else if (gcnLoad(&s.model, cfg.ckpt) != 0) {
+        fprintf(stderr, "Could not load %s\n", cfg.ckpt);
+        return 1;
+    }
+
+    double start = omp_get_wtime();
+    static Dataset data;
+    if (datasetLoad(&data, cfg.data, cfg.features) != 0) {
+        return 1;
+    }
+    float *X = data.features;
+    int width = data.n_features;
+    if (cfg.pca) {
+        PCAModel pca;
+        if (pcaLoad(&pca, cfg.pca) != 0 || pca.in_dim != width) {
+            fprintf(stderr, "Error loading the projection %s\n", cfg.pca);
+            return 1;
+        }
+        X = (float *)malloc((size_t)data.n_nodes * pca.k * sizeof(float));
+        pcaProject(&pca, data.features, data.n_nodes, X);
+        width = pca.k;
+        pcaFree(&pca);
+    }
+    if (width != s.model.dim) {
+        fprintf(stderr, "Checkpoint expects %d features, the data has %d\n", s.model.dim, width);
+        return 1;
+    }
+
+    // The dataset's adjacency keeps src.txt order, like GCN_t1's
+    const CSRGraph *g = gcnModelGraph(&s.model, data.graph, data.dir);
+    s.g = g;
+    s.labels = cfg.gate ? data.labels : NULL;
+    s.X = X;
+    if (s.quant) {
+        gcnQuantInput(s.quant, 0, &s.QX, g->n_nodes);
+        quantizeRows(&s.QX, X);
+        gcnQuantInput(s.quant, 0, &s.act[0], g->n_nodes);
+        gcnQuantInput(s.quant, 0, &s.act[1], g->n_nodes);
+        fprintf(stderr, "int8 %s model, features %.1fMB instead of %.1fMB\n", quantModeName(s.quant->mode),
+                quantRowsBytes(&s.QX) / 1048576.0, (double)g->n_nodes * width * sizeof(float) / 1048576.0);
+        if (X == data.features) {
+            data.features = NULL;
+        }
+        free(X);
+        s.X = NULL;
+    }
+    s.classes = data.n_classes;
+    s.batch = cfg.batch;
+    s.wait = cfg.wait_us * 1e-6;
+    if (cfg.cache) {
+        s.cache = (EmbedCache *)malloc(sizeof(EmbedCache));
+        embedCacheInit(s.cache, &s.model, g, s.labels, X);
+        s.rows = (const float **)malloc(s.batch * sizeof(float *));
+    } else {
+        s.buf = (float *)malloc((s.quant ? 1 : 2) * (size_t)g->n_nodes * s.model.dim * sizeof(float));
+        gcnFrontierInit(&s.frontier, g->n_nodes, s.model.n_layers, gcnNeighborCap(s.model.norm));
+    }
+    pthread_mutex_init(&s.lock, NULL);
+    pthread_mutex_init(&s.out_lock, NULL);
+    pthread_cond_init(&s.ready, NULL);
+    pthread_cond_init(&s.space, NULL);
+    fprintf(stderr, "nodes=%d edges=%ld layers=%d dim=%d classes=%d threads=%d load=%.2fs\n",
+            g->n_nodes, g->n_edges, s.model.n_layers, s.model.dim, s.classes,
+            omp_get_max_threads(), omp_get_wtime() - start);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    if (cfg.socket == NULL) {
+        startReader(&s, stdin, STDOUT_FILENO, 0);
+        batcherMain(&s);
+    } else {
+        int fd = listenUnix(cfg.socket);
+        if (fd < 0) {
+            return 1;
+        }
+        fprintf(stderr, "listening on %s\n", cfg.socket);
+        pthread_t batcher;
+        // Keep the batcher alive while no client is connected
+        s.readers = 1;
+        pthread_create(&batcher, NULL, batcherMain, &s);
+        while (!interrupted) {
+            int client = accept(fd, NULL, NULL);
+            if (client < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("accept");
+                break;
+            }
+            startReader(&s, fdopen(client, "r"), client, 1);
+        }
+        pthread_mutex_lock(&s.lock);
+        s.stop = 1;
+        pthread_cond_broadcast(&s.ready);
+        pthread_cond_broadcast(&s.space);
+        pthread_mutex_unlock(&s.lock);
+        pthread_join(batcher, NULL);
+        close(fd);
+        unlink(cfg.socket);
+    }
+
+    char stats[256];
+    formatStats(&s, stats, sizeof(stats));
+    fputs(stats, stderr);
+    if (s.cache) {
+        embedCacheReport(s.cache, stderr);
+    }
+    return 0;
+}
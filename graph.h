@@ -0,0 +1,214 @@
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Compressed sparse row adjacency.
+// n_nodes -> number of rows.
+// n_edges -> number of stored (directed) edges.
+// offsets -> n_nodes+1 entries, neighbors of i are indices[offsets[i] .. offsets[i+1]).
+// indices -> neighbor ids, sorted within each row unless built in input order.
+// values -> optional per-edge weights (NULL means every edge weighs 1).
+typedef struct CSRGraph {
+    int n_nodes;
+    long n_edges;
+    long *offsets;
+    int *indices;
+    float *values;
+} CSRGraph;
+
+
+void csrFree(CSRGraph *g) {
+    if (!g) {
+        return;
+    }
+    free(g->offsets);
+    free(g->indices);
+    free(g->values);
+    free(g);
+}
+
+
+// Build a CSR from an edge list with a counting sort on the source id. The
+// sort is stable, so each row keeps its edges in input order (GCN_t1's
+// 50-neighbor cap depends on that order). Ids must lie in [0, n_nodes).
+// degree[i] is the number of edges with source i.
+CSRGraph *csrFromEdgesCounted(int n_nodes, long n_edges, const int *src, const int *dst, const long *degree) {
+    CSRGraph *g = (CSRGraph *)malloc(sizeof(CSRGraph));
+    g->n_nodes = n_nodes;
+    g->n_edges = n_edges;
+    g->offsets = (long *)malloc((n_nodes + 1) * sizeof(long));
+    g->indices = (int *)malloc((n_edges ? n_edges : 1) * sizeof(int));
+    g->values = NULL;
+    g->offsets[0] = 0;
+    for (int i = 0; i < n_nodes; ++i) {
+        g->offsets[i + 1] = g->offsets[i] + degree[i];
+    }
+    long *fill = (long *)malloc((n_nodes ? n_nodes : 1) * sizeof(long));
+    memcpy(fill, g->offsets, n_nodes * sizeof(long));
+    for (long e = 0; e < n_edges; ++e) {
+        g->indices[fill[src[e]]++] = dst[e];
+    }
+    free(fill);
+    return g;
+}
+
+
+// csrFromEdgesCounted that counts the degrees itself
+CSRGraph *csrFromEdgesInOrder(int n_nodes, long n_edges, const int *src, const int *dst) {
+    long *degree = (long *)calloc(n_nodes ? n_nodes : 1, sizeof(long));
+    for (long e = 0; e < n_edges; ++e) {
+        degree[src[e]]++;
+    }
+    CSRGraph *g = csrFromEdgesCounted(n_nodes, n_edges, src, dst, degree);
+    free(degree);
+    return g;
+}
+
+
+CSRGraph *csrClone(const CSRGraph *g) {
+    CSRGraph *c = (CSRGraph *)malloc(sizeof(CSRGraph));
+    *c = *g;
+    c->offsets = (long *)malloc((g->n_nodes + 1) * sizeof(long));
+    memcpy(c->offsets, g->offsets, (g->n_nodes + 1) * sizeof(long));
+    c->indices = (int *)malloc((g->n_edges ? g->n_edges : 1) * sizeof(int));
+    memcpy(c->indices, g->indices, g->n_edges * sizeof(int));
+    if (g->values) {
+        c->values = (float *)malloc(g->n_edges * sizeof(float));
+        memcpy(c->values, g->values, g->n_edges * sizeof(float));
+    }
+    return c;
+}
+
+
+// Reverse adjacency: row u of the result lists every i with an edge i -> u,
+// in increasing i. Edge values are carried over.
+CSRGraph *csrTranspose(const CSRGraph *g) {
+    int n = g->n_nodes;
+    CSRGraph *t = (CSRGraph *)malloc(sizeof(CSRGraph));
+    t->n_nodes = n;
+    t->n_edges = g->n_edges;
+    t->offsets = (long *)calloc(n + 1, sizeof(long));
+    t->indices = (int *)malloc(g->n_edges * sizeof(int));
+    t->values = g->values ? (float *)malloc(g->n_edges * sizeof(float)) : NULL;
+
+    for (long e = 0; e < g->n_edges; ++e) {
+        t->offsets[g->indices[e] + 1]++;
+    }
+    for (int i = 0; i < n; ++i) {
+        t->offsets[i + 1] += t->offsets[i];
+    }
+    long *fill = (long *)malloc(n * sizeof(long));
+    memcpy(fill, t->offsets, n * sizeof(long));
+    for (int i = 0; i < n; ++i) {
+        for (long e = g->offsets[i]; e < g->offsets[i + 1]; ++e) {
+            long k = fill[g->indices[e]]++;
+            t->indices[k] = i;
+            if (t->values) {
+                t->values[k] = g->values[e];
+            }
+        }
+    }
+    free(fill);
+    return t;
+}
+
+
+// Whole file as one NUL-terminated buffer; NULL on error
+char *readTextFile(const char *path, size_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening %s\n", path);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = (char *)malloc(len + 1);
+    if (text == NULL || fread(text, 1, len, file) != (size_t)len) {
+        fprintf(stderr, "Error reading %s\n", path);
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+    fclose(file);
+    text[len] = '\0';
+    if (size) {
+        *size = len;
+    }
+    return text;
+}
+
+
+// Read whitespace-separated integers (one per edge/node, like src.txt or
+// labels.txt). The count is discovered while reading. Returns NULL on error.
+int *readIntFile(const char *path, long *count) {
+    size_t size;
+    char *text = readTextFile(path, &size);
+    if (text == NULL) {
+        return NULL;
+    }
+    // Every value takes at least two bytes with its separator
+    long cap = size / 2 + 1, n = 0;
+    int *data = (int *)malloc(cap * sizeof(int));
+    char *p = text, *end;
+    for (;;) {
+        long value = strtol(p, &end, 10);
+        if (end == p) {
+            break;
+        }
+        data[n++] = (int)value;
+        p = end;
+    }
+    free(text);
+    *count = n;
+    return (int *)realloc(data, (n ? n : 1) * sizeof(int));
+}
+
+
+// Read whitespace-separated floats in file order; the count is discovered
+// while reading. Returns NULL on error.
+float *readFloatFile(const char *path, long *count) {
+    size_t size;
+    char *text = readTextFile(path, &size);
+    if (text == NULL) {
+        return NULL;
+    }
+    long cap = size / 2 + 1, n = 0;
+    float *data = (float *)malloc(cap * sizeof(float));
+    char *p = text, *end;
+    for (;;) {
+        float value = strtof(p, &end);
+        if (end == p) {
+            break;
+        }
+        data[n++] = value;
+        p = end;
+    }
+    free(text);
+    *count = n;
+    return (float *)realloc(data, (n ? n : 1) * sizeof(float));
+}
+
+
+// Read a whitespace-separated float matrix with a known row width into one
+// contiguous row-major buffer (features.txt). The number of rows is
+// discovered while reading. Returns NULL on error.
+float *readFloatMatrix(const char *path, int cols, long *rows) {
+    long n;
+    float *data = readFloatFile(path, &n);
+    if (data == NULL) {
+        return NULL;
+    }
+    if (n % cols != 0) {
+        fprintf(stderr, "%s: %ld values is not a multiple of %d columns\n", path, n, cols);
+        free(data);
+        return NULL;
+    }
+    *rows = n / cols;
+    return data;
+}
+
+#endif
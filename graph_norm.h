@@ -0,0 +1,220 @@
+#ifndef GRAPH_NORM_H
+#define GRAPH_NORM_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "checkpoint.h"
+
+// Normalized adjacency as CSR edge values.
+// csrNormalize optionally adds a self loop to every row that lacks one
+// (A + I) and stores one of these weightings in g->values:
+//   GRAPH_NORM_SYM  -> w_ij / sqrt(d_i d_j)   D^-1/2 A D^-1/2 (GCN)
+//   GRAPH_NORM_ROW  -> w_ij / d_i             D^-1 A, weighted degrees
+//   GRAPH_NORM_MEAN -> 1 / |N(i)|             plain mean, input weights ignored
+// where d_i is the weighted out-degree of i after the self loops (equal to
+// the in-degree for the symmetric graphs GCN normalization assumes).
+// aggregateSum then computes A_hat X directly. Rows keep their neighbors in
+// input order and the self loop goes last.
+//
+// The result is saved in the checkpoint container (graphSave / graphLoad),
+// so it is computed once per dataset and mapped back on later runs:
+//   graph.meta    I64 [n_nodes, n_edges, norm, self_loops, source edges,
+//                      source checksum (graphChecksum)]
+//   graph.offsets I64 [n_nodes + 1]
+//   graph.indices I32 [n_edges]
+//   graph.values  F32 [n_edges] (absent for GRAPH_NORM_NONE without weights)
+
+#define GRAPH_NORM_NONE 0
+#define GRAPH_NORM_SYM 1
+#define GRAPH_NORM_ROW 2
+#define GRAPH_NORM_MEAN 3
+#define GRAPH_META_LEN 6
+
+
+const char *graphNormName(int norm) {
+    switch (norm) {
+    case GRAPH_NORM_SYM: return "sym";
+    case GRAPH_NORM_ROW: return "row";
+    case GRAPH_NORM_MEAN: return "mean";
+    default: return "none";
+    }
+}
+
+
+// New CSR with self loops (when self_loops is set) and normalized values.
+// Rows are filled and weighted in parallel.
+CSRGraph *csrNormalize(const CSRGraph *g, int norm, int self_loops) {
+    int n = g->n_nodes;
+    CSRGraph *out = (CSRGraph *)malloc(sizeof(CSRGraph));
+    out->n_nodes = n;
+    out->offsets = (long *)malloc((n + 1) * sizeof(long));
+    unsigned char *add = (unsigned char *)calloc(n ? n : 1, 1);
+    if (self_loops) {
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int i = 0; i < n; ++i) {
+            add[i] = 1;
+            for (long e = g->offsets[i]; e < g->offsets[i + 1]; ++e) {
+                if (g->indices[e] == i) {
+                    add[i] = 0;
+                    break;
+                }
+            }
+        }
+    }
+    out->offsets[0] = 0;
+    for (int i = 0; i < n; ++i) {
+        out->offsets[i + 1] = out->offsets[i] + (g->offsets[i + 1] - g->offsets[i]) + add[i];
+    }
+    out->n_edges = out->offsets[n];
+    long m = out->n_edges;
+    out->indices = (int *)malloc((m ? m : 1) * sizeof(int));
+    int weighted = g->values != NULL || norm != GRAPH_NORM_NONE;
+    out->values = weighted ? (float *)malloc((m ? m : 1) * sizeof(float)) : NULL;
+    float *degree = (float *)malloc((n ? n : 1) * sizeof(float));
+
+    #pragma omp parallel for schedule(dynamic, 256)
+    for (int i = 0; i < n; ++i) {
+        long from = g->offsets[i], count = g->offsets[i + 1] - from, to = out->offsets[i];
+        memcpy(out->indices + to, g->indices + from, count * sizeof(int));
+        double d = 0.0;
+        for (long k = 0; k < count; ++k) {
+            float w = g->values ? g->values[from + k] : 1.0f;
+            if (weighted) {
+                out->values[to + k] = w;
+            }
+            d += w;
+        }
+        if (add[i]) {
+            out->indices[to + count] = i;
+            if (weighted) {
+                out->values[to + count] = 1.0f;
+            }
+            d += 1.0;
+        }
+        degree[i] = (float)d;
+    }
+
+    if (norm != GRAPH_NORM_NONE) {
+        #pragma omp parallel for schedule(dynamic, 256)
+        for (int i = 0; i < n; ++i) {
+            long begin = out->offsets[i], end = out->offsets[i + 1];
+            float inv_i = degree[i] > 0.0f ? 1.0f / degree[i] : 0.0f;
+            float mean = end > begin ? 1.0f / (float)(end - begin) : 0.0f;
+            for (long e = begin; e < end; ++e) {
+                int j = out->indices[e];
+                if (norm == GRAPH_NORM_SYM) {
+                    float dd = degree[i] * degree[j];
+                    out->values[e] = dd > 0.0f ? out->values[e] / sqrtf(dd) : 0.0f;
+                } else if (norm == GRAPH_NORM_ROW) {
+                    out->values[e] *= inv_i;
+                } else {
+                    out->values[e] = mean;
+                }
+            }
+        }
+    }
+    free(degree);
+    free(add);
+    return out;
+}
+
+
+// CRC-32 of the offsets in the high half and of the indices (xor the
+// values, when there are any) in the low half
+long graphChecksum(const CSRGraph *g) {
+    uint64_t offsets = ckptCrc32(g->offsets, (g->n_nodes + 1) * sizeof(long));
+    uint64_t edges = ckptCrc32(g->indices, g->n_edges * sizeof(int));
+    if (g->values) {
+        edges ^= ckptCrc32(g->values, g->n_edges * sizeof(float));
+    }
+    return (long)(offsets << 32 | edges);
+}
+
+
+// source -> the graph g was derived from, recorded to detect a stale cache
+int graphSave(const CSRGraph *g, int norm, int self_loops, const CSRGraph *source, const char *path) {
+    long meta[GRAPH_META_LEN] = {g->n_nodes, g->n_edges, norm, self_loops, source->n_edges, graphChecksum(source)};
+    Checkpoint ckpt;
+    ckptInit(&ckpt, 0, 0);
+    ckptAdd1(&ckpt, "graph.meta", CKPT_I64, GRAPH_META_LEN, meta);
+    ckptAdd1(&ckpt, "graph.offsets", CKPT_I64, g->n_nodes + 1, g->offsets);
+    ckptAdd1(&ckpt, "graph.indices", CKPT_I32, g->n_edges, g->indices);
+    if (g->values) {
+        ckptAdd1(&ckpt, "graph.values", CKPT_F32, g->n_edges, g->values);
+    }
+    return ckptWrite(&ckpt, path);
+}
+
+
+// Graph saved by graphSave, copied out of the mapping; NULL if the file is
+// missing, damaged or from an older layout. meta (optional, GRAPH_META_LEN
+// entries) receives the graph.meta row.
+CSRGraph *graphLoad(const char *path, long *meta_out) {
+    CkptMap map;
+    if (ckptOpen(&map, path) != 0) {
+        return NULL;
+    }
+    const CkptEntry *entry = ckptFind(&map, "graph.meta");
+    if (!entry || entry->ndim != 1 || entry->shape[0] != GRAPH_META_LEN) {
+        ckptClose(&map);
+        return NULL;
+    }
+    const long *meta = (const long *)ckptTensor(&map, "graph.meta", CKPT_I64, GRAPH_META_LEN);
+    if (!meta || ckptVerify(&map) != 0) {
+        ckptClose(&map);
+        return NULL;
+    }
+    int n = (int)meta[0];
+    long m = meta[1];
+    const long *offsets = (const long *)ckptTensor(&map, "graph.offsets", CKPT_I64, n + 1);
+    const int *indices = (const int *)ckptTensor(&map, "graph.indices", CKPT_I32, m);
+    int weighted = ckptFind(&map, "graph.values") != NULL;
+    const float *values = weighted ? (const float *)ckptTensor(&map, "graph.values", CKPT_F32, m) : NULL;
+    if (!offsets || !indices || offsets[n] != m || (weighted && !values)) {
+        ckptClose(&map);
+        return NULL;
+    }
+    CSRGraph *g = (CSRGraph *)malloc(sizeof(CSRGraph));
+    g->n_nodes = n;
+    g->n_edges = m;
+    g->offsets = (long *)malloc((n + 1) * sizeof(long));
+    g->indices = (int *)malloc((m ? m : 1) * sizeof(int));
+    g->values = values ? (float *)malloc((m ? m : 1) * sizeof(float)) : NULL;
+    memcpy(g->offsets, offsets, (n + 1) * sizeof(long));
+    memcpy(g->indices, indices, m * sizeof(int));
+    if (values) {
+        memcpy(g->values, values, m * sizeof(float));
+    }
+    if (meta_out) {
+        memcpy(meta_out, meta, GRAPH_META_LEN * sizeof(long));
+    }
+    ckptClose(&map);
+    return g;
+}
+
+
+// The normalized graph cached at path: loaded when it was built the same way
+// from a graph with the same edges (size and checksum), otherwise computed
+// from g and saved there
+CSRGraph *graphNormalizedCached(const CSRGraph *g, int norm, int self_loops, const char *path) {
+    long meta[GRAPH_META_LEN];
+    CSRGraph *cached = graphLoad(path, meta);
+    if (cached && meta[0] == g->n_nodes && meta[2] == norm && meta[3] == self_loops && meta[4] == g->n_edges) {
+        if (meta[5] == graphChecksum(g)) {
+            return cached;
+        }
+        fprintf(stderr, "%s was built from different edges, rebuilding it\n", path);
+    }
+    csrFree(cached);
+    CSRGraph *out = csrNormalize(g, norm, self_loops);
+    if (graphSave(out, norm, self_loops, g, path) != 0) {
+        fprintf(stderr, "Could not save the normalized graph to %s\n", path);
+    }
+    return out;
+}
+
+#endif
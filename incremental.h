@@ -0,0 +1,223 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "graph.h"
+#include "gcn.h"
+
+// Incremental GCN inference. Every layer's output is kept for every node;
+// after a batch of feature or edge changes only the rows that can differ are
+// recomputed, layer by layer:
+//   layer 1 -> nodes that aggregate a changed feature row (through the
+//              label gate), plus nodes whose own edges changed
+//   layer l -> nodes that aggregate a row that changed at layer l-1, plus
+//              nodes whose own edges changed
+// and, at every layer, each relabeled node and all of its readers. A label
+// change moves the gate, so readers that matched the old label stop
+// aggregating the node and ones matching the new label start; both are
+// recomputed without looking at the gate.
+// "Changed" means the recomputed row differs from the stored one, so the
+// frontier stops growing where a change is absorbed (e.g. by the relu).
+// Once a layer's frontier passes fallback * n_nodes rows, that layer and
+// the ones above are recomputed in full, which is cheaper at that point.
+// The results are bitwise identical to a full forward pass.
+
+
+typedef struct IncEngine {
+    const GCNModel *model;
+    const CSRGraph *g;
+    CSRGraph *rev;
+    const int *labels;
+    const float *X;
+    int n_nodes;
+    int n_layers;
+    int dim;
+    double fallback;
+
+    float *H[GCN_MAX_LAYERS + 1];
+    float *scratch;
+    int *scratch_slot;
+    int scratch_rows;
+    GCNFrontier frontier;
+
+    long updates;
+    long recomputed[GCN_MAX_LAYERS + 1];
+    long changed[GCN_MAX_LAYERS + 1];
+    long fallbacks;
+    int last_full_from;
+    double last_time;
+} IncEngine;
+
+
+// Run the full forward pass once. X is read in place (the caller updates
+// its rows and reports them through incUpdate); labels may be NULL.
+void incInit(IncEngine *e, const GCNModel *model, const CSRGraph *g, const int *labels,
+             const float *X, double fallback) {
+    memset(e, 0, sizeof(*e));
+    e->model = model;
+    e->g = g;
+    e->rev = csrTranspose(g);
+    e->labels = labels;
+    e->X = X;
+    e->n_nodes = g->n_nodes;
+    e->n_layers = model->n_layers;
+    e->dim = model->dim;
+    e->fallback = fallback;
+    e->H[0] = (float *)X;
+    for (int l = 1; l <= e->n_layers; ++l) {
+        e->H[l] = (float *)malloc((size_t)e->n_nodes * e->dim * sizeof(float));
+        gcnLayerRows(model, l - 1, g, labels, e->H[l - 1], e->H[l], NULL, e->n_nodes);
+    }
+    e->scratch_rows = (int)(fallback * e->n_nodes) + 1;
+    e->scratch = (float *)malloc((size_t)e->scratch_rows * e->dim * sizeof(float));
+    e->scratch_slot = (int *)malloc(e->n_nodes * sizeof(int));
+    gcnFrontierInit(&e->frontier, e->n_nodes, 1, gcnNeighborCap(model->norm));
+    e->last_full_from = 0;
+}
+
+
+void incFree(IncEngine *e) {
+    for (int l = 1; l <= e->n_layers; ++l) {
+        free(e->H[l]);
+    }
+    free(e->scratch);
+    free(e->scratch_slot);
+    csrFree(e->rev);
+    gcnFrontierFree(&e->frontier);
+}
+
+
+const float *incEmbedding(const IncEngine *e, int i) {
+    return e->H[e->n_layers] + (size_t)i * e->dim;
+}
+
+
+// Bring every layer up to date after a change set.
+// g -> the graph after the change (NULL when no edge changed); it replaces
+//      the engine's graph and must stay alive. For a normalized model it is
+//      renormalized, and every row whose edge values changed is listed in
+//      edge_nodes.
+// feat_nodes -> nodes whose rows of X the caller has rewritten.
+// edge_nodes -> nodes whose out-edges changed.
+// relabeled -> nodes whose entry in the labels array the caller has
+//              rewritten (the engine reads labels in place).
+// Returns the number of rows recomputed.
+long incUpdate(IncEngine *e, const CSRGraph *g, const int *feat_nodes, int n_feat,
+               const int *edge_nodes, int n_edge, const int *relabeled, int n_relabel) {
+    double start = omp_get_wtime();
+    if (g != NULL) {
+        e->g = g;
+        csrFree(e->rev);
+        e->rev = csrTranspose(g);
+    }
+    GCNFrontier *f = &e->frontier;
+    int dim = e->dim;
+    int *changed = f->rows[0], *rows = f->rows[1];
+    int n_changed = 0;
+    long total = 0;
+
+    // Layer-0 rows that changed; the stamp also dedups the caller's list
+    unsigned s = gcnNextStamp(f);
+    for (int q = 0; q < n_feat; ++q) {
+        int i = feat_nodes[q];
+        if (i >= 0 && i < e->n_nodes && f->stamp[i] != s) {
+            f->stamp[i] = s;
+            changed[n_changed++] = i;
+        }
+    }
+
+    e->last_full_from = 0;
+    for (int l = 1; l <= e->n_layers; ++l) {
+        if (e->last_full_from) {
+            gcnLayerRows(e->model, l - 1, e->g, e->labels, e->H[l - 1], e->H[l], NULL, e->n_nodes);
+            e->recomputed[l] += e->n_nodes;
+            total += e->n_nodes;
+            continue;
+        }
+
+        // Frontier: readers of the rows that changed below, nodes with new
+        // edges, and relabeled nodes with all their readers
+        s = gcnNextStamp(f);
+        int n_rows = 0;
+        for (int q = 0; q < n_edge; ++q) {
+            int i = edge_nodes[q];
+            if (i >= 0 && i < e->n_nodes && f->stamp[i] != s) {
+                f->stamp[i] = s;
+                rows[n_rows++] = i;
+            }
+        }
+        for (int q = 0; q < n_relabel && n_rows < e->scratch_rows; ++q) {
+            int u = relabeled[q];
+            if (u < 0 || u >= e->n_nodes) {
+                continue;
+            }
+            if (f->stamp[u] != s) {
+                f->stamp[u] = s;
+                rows[n_rows++] = u;
+            }
+            for (long k = e->rev->offsets[u]; k < e->rev->offsets[u + 1] && n_rows < e->scratch_rows; ++k) {
+                int i = e->rev->indices[k];
+                if (f->stamp[i] != s) {
+                    f->stamp[i] = s;
+                    rows[n_rows++] = i;
+                }
+            }
+        }
+        for (int r = 0; r < n_changed && n_rows < e->scratch_rows; ++r) {
+            int u = changed[r];
+            for (long k = e->rev->offsets[u]; k < e->rev->offsets[u + 1] && n_rows < e->scratch_rows; ++k) {
+                int i = e->rev->indices[k];
+                // i only reads u through the label gate
+                if (f->stamp[i] != s && !(e->labels && e->labels[i] != e->labels[u])) {
+                    f->stamp[i] = s;
+                    rows[n_rows++] = i;
+                }
+            }
+        }
+        if (n_rows >= e->scratch_rows) {
+            e->last_full_from = l;
+            e->fallbacks++;
+            gcnLayerRows(e->model, l - 1, e->g, e->labels, e->H[l - 1], e->H[l], NULL, e->n_nodes);
+            e->recomputed[l] += e->n_nodes;
+            total += e->n_nodes;
+            continue;
+        }
+
+        // Recompute the frontier into scratch, then keep the rows that moved
+        for (int r = 0; r < n_rows; ++r) {
+            e->scratch_slot[rows[r]] = r;
+        }
+        gcnLayerRowsMapped(e->model, l - 1, e->g, e->labels, e->H[l - 1], NULL, e->scratch,
+                           e->scratch_slot, rows, n_rows);
+        n_changed = 0;
+        for (int r = 0; r < n_rows; ++r) {
+            int i = rows[r];
+            float *old = e->H[l] + (size_t)i * dim;
+            const float *fresh = e->scratch + (size_t)r * dim;
+            if (memcmp(old, fresh, dim * sizeof(float)) != 0) {
+                memcpy(old, fresh, dim * sizeof(float));
+                changed[n_changed++] = i;
+            }
+        }
+        e->recomputed[l] += n_rows;
+        e->changed[l] += n_changed;
+        total += n_rows;
+    }
+    e->updates++;
+    e->last_time = omp_get_wtime() - start;
+    return total;
+}
+
+
+void incReport(const IncEngine *e, FILE *out) {
+    fprintf(out, "updates=%ld fallbacks=%ld\n", e->updates, e->fallbacks);
+    fprintf(out, "%6s %14s %14s\n", "layer", "recomputed", "changed");
+    for (int l = 1; l <= e->n_layers; ++l) {
+        fprintf(out, "%6d %14ld %14ld\n", l, e->recomputed[l], e->changed[l]);
+    }
+}
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "reduce.h"
+
+// Dense and sparse compute kernels shared by the GNN programs.
+// All matrices are contiguous row-major float arrays.
+
+#define GEMM_BLOCK_ROWS 32
+#define GEMM_BLOCK_K 128
+
+
+// C = A * B (+ bias per column when bias != NULL)
+// A is M x K, B is K x N, C is M x N. Row blocks are split across threads
+// and K is walked in panels so a slab of B stays in cache for the whole
+// row block; the inner loop is a SIMD axpy along contiguous N.
+void denseForward(const float *A, const float *B, const float *bias, float *C, long M, int K, int N) {
+    #pragma omp parallel for schedule(static)
+    for (long i0 = 0; i0 < M; i0 += GEMM_BLOCK_ROWS) {
+        long i1 = (i0 + GEMM_BLOCK_ROWS < M) ? i0 + GEMM_BLOCK_ROWS : M;
+        for (long i = i0; i < i1; ++i) {
+            float *ci = C + (size_t)i * N;
+            if (bias) {
+                memcpy(ci, bias, N * sizeof(float));
+            } else {
+                memset(ci, 0, N * sizeof(float));
+            }
+        }
+        for (int k0 = 0; k0 < K; k0 += GEMM_BLOCK_K) {
+            int k1 = (k0 + GEMM_BLOCK_K < K) ? k0 + GEMM_BLOCK_K : K;
+            for (long i = i0; i < i1; ++i) {
+                const float *ai = A + (size_t)i * K;
+                float *ci = C + (size_t)i * N;
+                for (int k = k0; k < k1; ++k) {
+                    float a = ai[k];
+                    const float *bk = B + (size_t)k * N;
+                    #pragma omp simd
+                    for (int j = 0; j < N; ++j) {
+                        ci[j] += a * bk[j];
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+// C = A^T * B, A is M x K, B is M x N, C is K x N (weight gradients).
+// Each thread accumulates a private K x N partial over its rows of A/B and
+// the partials are summed in thread order, so the result does not depend
+// on scheduling.
+void denseGradWeight(const float *A, const float *B, float *C, long M, int K, int N) {
+    int nthreads = omp_get_max_threads();
+    float *partial = (float *)calloc((size_t)nthreads * K * N, sizeof(float));
+
+    #pragma omp parallel num_threads(nthreads)
+    {
+        int tid = omp_get_thread_num();
+        float *P = partial + (size_t)tid * K * N;
+        #pragma omp for schedule(static)
+        for (long i = 0; i < M; ++i) {
+            const float *ai = A + (size_t)i * K;
+            const float *bi = B + (size_t)i * N;
+            for (int k = 0; k < K; ++k) {
+                float a = ai[k];
+                if (a == 0.0f) {
+                    continue;
+                }
+                float *pk = P + (size_t)k * N;
+                #pragma omp simd
+                for (int j = 0; j < N; ++j) {
+                    pk[j] += a * bi[j];
+                }
+            }
+        }
+        #pragma omp for schedule(static)
+        for (long e = 0; e < (long)K * N; ++e) {
+            float sum = 0.0f;
+            for (int t = 0; t < nthreads; ++t) {
+                sum += partial[(size_t)t * K * N + e];
+            }
+            C[e] = sum;
+        }
+    }
+    free(partial);
+}
+
+
+// C = G * B^T, G is M x N, B is K x N, C is M x K (input gradients).
+// Each output entry is a dot product of two contiguous rows.
+void denseGradInput(const float *G, const float *B, float *C, long M, int K, int N) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < M; ++i) {
+        const float *gi = G + (size_t)i * N;
+        float *ci = C + (size_t)i * K;
+        for (int k = 0; k < K; ++k) {
+            const float *bk = B + (size_t)k * N;
+            float sum = 0.0f;
+            #pragma omp simd reduction(+:sum)
+            for (int j = 0; j < N; ++j) {
+                sum += gi[j] * bk[j];
+            }
+            ci[k] = sum;
+        }
+    }
+}
+
+
+// out[j] = sum over rows of G[i][j] (bias gradients)
+void denseGradBias(const float *G, long M, int N, float *out) {
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < N; ++j) {
+        double sum = 0.0;
+        for (long i = 0; i < M; ++i) {
+            sum += G[(size_t)i * N + j];
+        }
+        out[j] = (float)sum;
+    }
+}
+
+
+// Y[i] = sum over neighbors j of X[j] (times the edge value when the graph
+// carries one). Rows are independent, so they are split across threads with
+// dynamic scheduling to absorb degree skew.
+void aggregateSum(const CSRGraph *g, const float *X, float *Y, int dim) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < g->n_nodes; ++i) {
+        float *yi = Y + (size_t)i * dim;
+        memset(yi, 0, dim * sizeof(float));
+        for (long e = g->offsets[i]; e < g->offsets[i + 1]; ++e) {
+            const float *xj = X + (size_t)g->indices[e] * dim;
+            float w = g->values ? g->values[e] : 1.0f;
+            #pragma omp simd
+            for (int f = 0; f < dim; ++f) {
+                yi[f] += w * xj[f];
+            }
+        }
+    }
+}
+
+
+// Mean of the neighbor rows (isolated nodes get zeros)
+void aggregateMean(const CSRGraph *g, const float *X, float *Y, int dim) {
+    aggregateSum(g, X, Y, dim);
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < g->n_nodes; ++i) {
+        long deg = g->offsets[i + 1] - g->offsets[i];
+        if (deg > 1) {
+            float inv = 1.0f / (float)deg;
+            float *yi = Y + (size_t)i * dim;
+            #pragma omp simd
+            for (int f = 0; f < dim; ++f) {
+                yi[f] *= inv;
+            }
+        }
+    }
+}
+
+
+void reluInPlace(float *X, long count) {
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < count; ++i) {
+        X[i] = X[i] > 0.0f ? X[i] : 0.0f;
+    }
+}
+
+
+// Mean softmax cross-entropy over the rows with mask[i] != 0 (all rows when
+// mask is NULL). When grad != NULL it receives d(loss)/d(logits), zero for
+// masked-out rows. correct (optional) receives the number of argmax hits.
+// The per-row losses are summed with reduceSum, so the loss does not depend
+// on the thread count.
+double softmaxCrossEntropy(const float *logits, const int *labels, const unsigned char *mask,
+                           long n, int classes, float *grad, long *correct) {
+    double *rowLoss = (double *)malloc((n ? n : 1) * sizeof(double));
+    long hits = 0, used = 0;
+
+    #pragma omp parallel for reduction(+:hits, used) schedule(static)
+    for (long i = 0; i < n; ++i) {
+        const float *zi = logits + (size_t)i * classes;
+        rowLoss[i] = 0.0;
+        if (mask && !mask[i]) {
+            if (grad) {
+                memset(grad + (size_t)i * classes, 0, classes * sizeof(float));
+            }
+            continue;
+        }
+        float zmax = zi[0];
+        int arg = 0;
+        for (int c = 1; c < classes; ++c) {
+            if (zi[c] > zmax) {
+                zmax = zi[c];
+                arg = c;
+            }
+        }
+        double deno = 0.0;
+        for (int c = 0; c < classes; ++c) {
+            deno += exp((double)(zi[c] - zmax));
+        }
+        rowLoss[i] = log(deno) - (double)(zi[labels[i]] - zmax);
+        hits += (arg == labels[i]);
+        used++;
+        if (grad) {
+            float *gi = grad + (size_t)i * classes;
+            for (int c = 0; c < classes; ++c) {
+                gi[c] = (float)(exp((double)(zi[c] - zmax)) / deno);
+            }
+            gi[labels[i]] -= 1.0f;
+        }
+    }
+
+    if (grad && used > 0) {
+        float inv = 1.0f / (float)used;
+        #pragma omp parallel for simd schedule(static)
+        for (long e = 0; e < n * classes; ++e) {
+            grad[e] *= inv;
+        }
+    }
+    if (correct) {
+        *correct = hits;
+    }
+    double loss = reduceSum(rowLoss, n);
+    free(rowLoss);
+    return used > 0 ? loss / (double)used : 0.0;
+}
+
+
+// Adam optimizer state for one parameter tensor
+// m, v -> first and second moment estimates.
+// t -> number of steps taken (for bias correction).
+typedef struct Adam {
+    long size;
+    float *m;
+    float *v;
+    long t;
+    float lr;
+    float beta1;
+    float beta2;
+    float eps;
+} Adam;
+
+
+void adamInit(Adam *opt, long size, float lr) {
+    opt->size = size;
+    opt->m = (float *)calloc(size, sizeof(float));
+    opt->v = (float *)calloc(size, sizeof(float));
+    opt->t = 0;
+    opt->lr = lr;
+    opt->beta1 = 0.9f;
+    opt->beta2 = 0.999f;
+    opt->eps = 1e-8f;
+}
+
+
+void adamFree(Adam *opt) {
+    free(opt->m);
+    free(opt->v);
+}
+
+
+void adamStep(Adam *opt, float *param, const float *grad) {
+    opt->t++;
+    float c1 = 1.0f - powf(opt->beta1, (float)opt->t);
+    float c2 = 1.0f - powf(opt->beta2, (float)opt->t);
+    float lr = opt->lr * sqrtf(c2) / c1;
+    float b1 = opt->beta1, b2 = opt->beta2, eps = opt->eps;
+    float *m = opt->m, *v = opt->v;
+
+    #pragma omp parallel for simd schedule(static)
+    for (long i = 0; i < opt->size; ++i) {
+        m[i] = b1 * m[i] + (1.0f - b1) * grad[i];
+        v[i] = b2 * v[i] + (1.0f - b2) * grad[i] * grad[i];
+        param[i] -= lr * m[i] / (sqrtf(v[i]) + eps);
+    }
+}
+
+#endif
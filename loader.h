@@ -0,0 +1,292 @@
+#ifndef LOADER_H
+#define LOADER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+
+// Concurrent loader for whitespace-separated number files.
+// All files are cut into LOADER_CHUNK byte chunks and a pool of threads
+// reads (pread) and parses the chunks of every file at once, so the load
+// takes about as long as the largest file rather than the sum of all of
+// them. A chunk owns the tokens that start inside it; it is read with one
+// byte before and LOADER_OVERLAP bytes after so it can be parsed on its own.
+//
+// Parsed chunks are committed to the file's output array in file order.
+// Each commit calls the file's on_values hook with the values' positions,
+// so a consumer (degree counting, statistics) works on the prefix that has
+// arrived while the rest is still being read. At most LOADER_IN_FLIGHT
+// chunks per thread are parsed but not committed, which bounds the memory
+// held by chunks that finished ahead of their turn.
+
+#ifndef LOADER_CHUNK
+#define LOADER_CHUNK (4L << 20)
+#endif
+#define LOADER_OVERLAP 256
+#define LOADER_IN_FLIGHT 4
+
+#define LOADER_INT 0
+#define LOADER_FLOAT 1
+
+
+// path, type, on_values, ctx -> filled in by the caller.
+// values, count -> the parsed file (int or float array, malloc'd).
+// read_time, parse_time -> seconds summed over the file's chunks.
+typedef struct LoadFile {
+    const char *path;
+    int type;
+    void (*on_values)(void *ctx, const void *values, long first, long count);
+    void *ctx;
+
+    void *values;
+    long count;
+    size_t bytes;
+    double read_time;
+    double parse_time;
+    double done_at;
+
+    int fd;
+    long n_chunks;
+    long claimed;
+    long committed;
+    void **chunk_values;
+    long *chunk_count;
+    int *chunk_state;
+    int failed;
+} LoadFile;
+
+
+// start -> wall clock when loaderRun began.
+typedef struct Loader {
+    LoadFile *files;
+    int n_files;
+    int threads;
+    long next_task;
+    long n_tasks;
+    int next_file;
+    long in_flight;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    double start;
+} Loader;
+
+
+static int loaderIsSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == ',';
+}
+
+
+// Parse the tokens of chunk k that start in [lo, hi) of the file
+static long loaderParseChunk(LoadFile *f, long k, void **out, double *read, double *parse) {
+    off_t lo = (off_t)k * LOADER_CHUNK, hi = lo + LOADER_CHUNK;
+    hi = hi < (off_t)f->bytes ? hi : (off_t)f->bytes;
+    off_t from = lo > 0 ? lo - 1 : 0;
+    off_t to = hi + LOADER_OVERLAP < (off_t)f->bytes ? hi + LOADER_OVERLAP : (off_t)f->bytes;
+    size_t len = to - from;
+    char *text = (char *)malloc(len + 1);
+    double start = omp_get_wtime();
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = pread(f->fd, text + got, len - got, from + got);
+        if (n <= 0) {
+            break;
+        }
+        got += n;
+    }
+    text[got] = '\0';
+    *read = omp_get_wtime() - start;
+
+    // Every value takes at least two bytes with its separator
+    long cap = (hi - lo) / 2 + 1, n = 0;
+    void *values = malloc(cap * (f->type == LOADER_INT ? sizeof(int) : sizeof(float)));
+    char *p = text + (lo - from), *stop = text + (hi - from);
+    if (lo > 0 && !loaderIsSpace(p[-1])) {
+        // The token at lo started in the previous chunk
+        while (p < stop && !loaderIsSpace(*p)) {
+            p++;
+        }
+    }
+    for (;;) {
+        while (p < stop && loaderIsSpace(*p)) {
+            p++;
+        }
+        if (p >= stop || n >= cap) {
+            break;
+        }
+        char *end;
+        if (f->type == LOADER_INT) {
+            ((int *)values)[n] = (int)strtol(p, &end, 10);
+        } else {
+            ((float *)values)[n] = strtof(p, &end);
+        }
+        if (end == p) {
+            fprintf(stderr, "%s: unexpected text at byte %ld\n", f->path, (long)(from + (p - text)));
+            f->failed = 1;
+            break;
+        }
+        n++;
+        p = end;
+    }
+    free(text);
+    *out = values;
+    *parse = omp_get_wtime() - start - *read;
+    return n;
+}
+
+
+// Append the finished chunks at the head of f's queue to f->values, in
+// order. Called with the loader lock held.
+static void loaderCommit(Loader *L, LoadFile *f) {
+    size_t size = f->type == LOADER_INT ? sizeof(int) : sizeof(float);
+    while (f->committed < f->n_chunks && f->chunk_state[f->committed] == 2) {
+        long k = f->committed;
+        memcpy((char *)f->values + f->count * size, f->chunk_values[k], f->chunk_count[k] * size);
+        free(f->chunk_values[k]);
+        f->chunk_values[k] = NULL;
+        if (f->on_values) {
+            f->on_values(f->ctx, (char *)f->values + f->count * size, f->count, f->chunk_count[k]);
+        }
+        f->count += f->chunk_count[k];
+        f->committed++;
+        L->in_flight--;
+    }
+    if (f->committed == f->n_chunks && f->done_at == 0.0) {
+        f->done_at = omp_get_wtime() - L->start;
+    }
+}
+
+
+static void *loaderWorker(void *arg) {
+    Loader *L = (Loader *)arg;
+    pthread_mutex_lock(&L->lock);
+    for (;;) {
+        while (L->next_task < L->n_tasks && L->in_flight >= (long)LOADER_IN_FLIGHT * L->threads) {
+            pthread_cond_wait(&L->cond, &L->lock);
+        }
+        if (L->next_task >= L->n_tasks) {
+            break;
+        }
+        // Chunks go round-robin over the files, so all of them progress
+        L->next_task++;
+        LoadFile *f = NULL;
+        for (int tries = 0; !f; ++tries) {
+            LoadFile *g = &L->files[(L->next_file + tries) % L->n_files];
+            if (g->claimed < g->n_chunks) {
+                f = g;
+                L->next_file = (L->next_file + tries + 1) % L->n_files;
+            }
+        }
+        long k = f->claimed++;
+        L->in_flight++;
+        f->chunk_state[k] = 1;
+        pthread_mutex_unlock(&L->lock);
+
+        void *values;
+        double read, parse;
+        long n = loaderParseChunk(f, k, &values, &read, &parse);
+
+        pthread_mutex_lock(&L->lock);
+        f->read_time += read;
+        f->parse_time += parse;
+        f->chunk_values[k] = values;
+        f->chunk_count[k] = n;
+        f->chunk_state[k] = 2;
+        loaderCommit(L, f);
+        pthread_cond_broadcast(&L->cond);
+    }
+    pthread_mutex_unlock(&L->lock);
+    return NULL;
+}
+
+
+// Load every file with `threads` threads (0: one per processor, at least
+// 4, since most of the wait is I/O). Hooks run on the loading threads, one
+// at a time. Returns 0 when every file was read.
+int loaderRun(LoadFile *files, int n_files, int threads) {
+    Loader L;
+    memset(&L, 0, sizeof(L));
+    L.files = files;
+    L.n_files = n_files;
+    L.threads = threads > 0 ? threads : (omp_get_num_procs() > 4 ? omp_get_num_procs() : 4);
+    L.start = omp_get_wtime();
+    int status = 0;
+    for (int i = 0; i < n_files; ++i) {
+        LoadFile *f = &files[i];
+        struct stat st;
+        f->values = NULL;
+        f->count = 0;
+        f->bytes = 0;
+        f->read_time = f->parse_time = f->done_at = 0.0;
+        f->failed = 0;
+        f->n_chunks = 0;
+        f->claimed = 0;
+        f->chunk_values = NULL;
+        f->chunk_count = NULL;
+        f->chunk_state = NULL;
+        f->fd = open(f->path, O_RDONLY);
+        if (f->fd < 0 || fstat(f->fd, &st) != 0) {
+            fprintf(stderr, "Error opening %s\n", f->path);
+            status = 1;
+            f->n_chunks = 0;
+            continue;
+        }
+        f->bytes = st.st_size;
+        f->n_chunks = (f->bytes + LOADER_CHUNK - 1) / LOADER_CHUNK;
+        f->values = malloc((f->bytes / 2 + 1) * (f->type == LOADER_INT ? sizeof(int) : sizeof(float)));
+        f->claimed = 0;
+        f->committed = 0;
+        f->chunk_values = (void **)calloc(f->n_chunks + 1, sizeof(void *));
+        f->chunk_count = (long *)calloc(f->n_chunks + 1, sizeof(long));
+        f->chunk_state = (int *)calloc(f->n_chunks + 1, sizeof(int));
+        L.n_tasks += f->n_chunks;
+    }
+
+    pthread_mutex_init(&L.lock, NULL);
+    pthread_cond_init(&L.cond, NULL);
+    pthread_t *pool = (pthread_t *)malloc(L.threads * sizeof(pthread_t));
+    for (int t = 0; t < L.threads; ++t) {
+        pthread_create(&pool[t], NULL, loaderWorker, &L);
+    }
+    for (int t = 0; t < L.threads; ++t) {
+        pthread_join(pool[t], NULL);
+    }
+    free(pool);
+    pthread_mutex_destroy(&L.lock);
+    pthread_cond_destroy(&L.cond);
+
+    for (int i = 0; i < n_files; ++i) {
+        LoadFile *f = &files[i];
+        if (f->fd >= 0) {
+            close(f->fd);
+        }
+        free(f->chunk_values);
+        free(f->chunk_count);
+        free(f->chunk_state);
+        if (f->fd < 0) {
+            continue;
+        }
+        if (f->failed) {
+            status = 1;
+        }
+        size_t size = f->type == LOADER_INT ? sizeof(int) : sizeof(float);
+        f->values = realloc(f->values, (f->count ? f->count : 1) * size);
+    }
+    return status;
+}
+
+
+// Per-file bytes, summed read/parse time and when the file was complete
+void loaderReport(const LoadFile *files, int n_files, FILE *out) {
+    for (int i = 0; i < n_files; ++i) {
+        const LoadFile *f = &files[i];
+        fprintf(out, "load %-40s %9.1fMB %10ld values read=%.3fs parse=%.3fs ready_at=%.3fs\n", f->path,
+                (double)f->bytes / (1 << 20), f->count, f->read_time, f->parse_time, f->done_at);
+    }
+}
+
+#endif
@@ -0,0 +1,488 @@
+#ifndef NUMA_PLACE_H
+#define NUMA_PLACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#include "graph.h"
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// NUMA placement for row-parallel graph kernels, without libnuma.
+// The node rows are split into one contiguous range per NUMA domain (sized
+// by the number of threads in that domain, balanced on rows + edges). Each
+// thread is pinned to a CPU of its domain, works only on rows of its domain,
+// and the row-major buffers are first-touched by the owning threads so their
+// pages land on the right socket. Optionally the CSR and labels are copied
+// once per domain so adjacency reads are local too.
+//
+//   numaInit(L, g, threads)   detect domains, pin threads, partition rows
+//   numaPlaceRows(L, src, n, width)   first-touched copy of a row-major matrix
+//   numaReplicate(L, g, labels)       per-domain CSR/labels (numaGraph/numaLabels)
+//   numaResetChunks(L), numaNextChunk(L, tid, chunk, &b, &e)
+//                             inside a parallel region of L->n_threads threads:
+//                             claim the next rows of the thread's own domain
+//   numaCountAccesses(...), numaReport(L, out)   local vs remote reads
+//
+// Domains come from /sys/devices/system/node. Build with -DGCN_NUMA_DOMAINS=k
+// to split the CPUs into k emulated domains on a single-socket machine. When
+// OMP_PLACES/OMP_PROC_BIND already bind the threads, their places are used
+// and no affinity mask is set.
+
+#define NUMA_MAX_DOMAINS 64
+#define NUMA_MAX_CPUS 1024
+#define NUMA_MAX_THREADS 256
+
+
+typedef struct NumaChunk {
+    int next;
+    char pad[60];
+} NumaChunk;
+
+
+// n_domains -> domains that own rows (those with at least one thread).
+// cpus[d] -> CPU ids of domain d.
+// thread_domain/thread_cpu -> placement of each OpenMP thread.
+// row_begin -> rows of domain d are [row_begin[d], row_begin[d+1]).
+// graph/labels -> what threads of domain d read (replicas or the originals).
+// local/remote -> neighbor-row and adjacency reads per layer, by domain.
+typedef struct NumaLayout {
+    int n_domains;
+    int n_cpus[NUMA_MAX_DOMAINS];
+    int *cpus[NUMA_MAX_DOMAINS];
+    int os_node[NUMA_MAX_DOMAINS];
+    int n_threads;
+    int pinned_by_places;
+    int thread_domain[NUMA_MAX_THREADS];
+    int thread_cpu[NUMA_MAX_THREADS];
+    int domain_threads[NUMA_MAX_DOMAINS];
+    int row_begin[NUMA_MAX_DOMAINS + 1];
+    NumaChunk chunk[NUMA_MAX_DOMAINS];
+
+    const CSRGraph *graph[NUMA_MAX_DOMAINS];
+    const int *labels[NUMA_MAX_DOMAINS];
+    CSRGraph *replica[NUMA_MAX_DOMAINS];
+    int *replica_labels[NUMA_MAX_DOMAINS];
+    int replicated;
+
+    long row_local[NUMA_MAX_DOMAINS];
+    long row_remote[NUMA_MAX_DOMAINS];
+    long adj_local[NUMA_MAX_DOMAINS];
+    long adj_remote[NUMA_MAX_DOMAINS];
+} NumaLayout;
+
+
+// Parse a sysfs cpulist such as "0-3,8-11" into cpus; returns the count
+static int numaParseCpuList(const char *s, int *cpus, int max) {
+    int count = 0;
+    while (*s && *s != '\n') {
+        char *end;
+        long a = strtol(s, &end, 10), b = a;
+        if (end == s) {
+            break;
+        }
+        if (*end == '-') {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+        }
+        for (long c = a; c <= b && count < max; ++c) {
+            cpus[count++] = (int)c;
+        }
+        s = (*end == ',') ? end + 1 : end;
+    }
+    return count;
+}
+
+
+// CPUs this process may run on (all of 0 .. NUMA_MAX_CPUS-1 if unknown)
+static int numaAllowedCpus(unsigned char *allowed) {
+    memset(allowed, 0, NUMA_MAX_CPUS);
+#ifdef __linux__
+    unsigned long mask[NUMA_MAX_CPUS / (8 * sizeof(unsigned long))];
+    long bytes = syscall(SYS_sched_getaffinity, 0, sizeof(mask), mask);
+    if (bytes > 0) {
+        int any = 0;
+        for (int c = 0; c < NUMA_MAX_CPUS && c < 8 * bytes; ++c) {
+            allowed[c] = (mask[c / (8 * sizeof(unsigned long))] >> (c % (8 * sizeof(unsigned long)))) & 1;
+            any |= allowed[c];
+        }
+        if (any) {
+            return 0;
+        }
+    }
+#endif
+    memset(allowed, 1, NUMA_MAX_CPUS);
+    return 1;
+}
+
+
+// Fill the domain table from sysfs, keeping only CPUs we may run on
+static void numaDetect(NumaLayout *L) {
+    unsigned char allowed[NUMA_MAX_CPUS];
+    int unknown = numaAllowedCpus(allowed);
+    int *buf = (int *)malloc(NUMA_MAX_CPUS * sizeof(int));
+    L->n_domains = 0;
+    for (int node = 0; node < NUMA_MAX_DOMAINS && !unknown; ++node) {
+        char path[128], line[4096];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+        FILE *fp = fopen(path, "r");
+        if (!fp) {
+            continue;
+        }
+        int n = fgets(line, sizeof(line), fp) ? numaParseCpuList(line, buf, NUMA_MAX_CPUS) : 0;
+        fclose(fp);
+        int kept = 0;
+        for (int k = 0; k < n; ++k) {
+            if (buf[k] < NUMA_MAX_CPUS && allowed[buf[k]]) {
+                buf[kept++] = buf[k];
+            }
+        }
+        // Memory-only nodes have no threads to own rows
+        if (kept == 0) {
+            continue;
+        }
+        int d = L->n_domains++;
+        L->os_node[d] = node;
+        L->n_cpus[d] = kept;
+        L->cpus[d] = (int *)malloc(kept * sizeof(int));
+        memcpy(L->cpus[d], buf, kept * sizeof(int));
+    }
+    if (L->n_domains == 0) {
+        int n = 0;
+        for (int c = 0; c < NUMA_MAX_CPUS && n < omp_get_num_procs(); ++c) {
+            if (allowed[c]) {
+                buf[n++] = c;
+            }
+        }
+        L->n_domains = 1;
+        L->os_node[0] = 0;
+        L->n_cpus[0] = n;
+        L->cpus[0] = (int *)malloc((n ? n : 1) * sizeof(int));
+        memcpy(L->cpus[0], buf, n * sizeof(int));
+    }
+#ifdef GCN_NUMA_DOMAINS
+    // Emulate GCN_NUMA_DOMAINS domains by dealing out the CPUs of domain 0
+    if (L->n_domains == 1 && GCN_NUMA_DOMAINS > 1) {
+        int n = L->n_cpus[0], *all = L->cpus[0];
+        L->n_domains = GCN_NUMA_DOMAINS < NUMA_MAX_DOMAINS ? GCN_NUMA_DOMAINS : NUMA_MAX_DOMAINS;
+        for (int d = 0; d < L->n_domains; ++d) {
+            int lo = (int)((long)n * d / L->n_domains), hi = (int)((long)n * (d + 1) / L->n_domains);
+            if (hi == lo) {
+                hi = lo + 1 < n ? lo + 1 : n;
+                lo = hi - 1;
+            }
+            L->os_node[d] = d;
+            L->n_cpus[d] = hi - lo;
+            L->cpus[d] = (int *)malloc((hi - lo) * sizeof(int));
+            memcpy(L->cpus[d], all + lo, (hi - lo) * sizeof(int));
+        }
+        free(all);
+    }
+#endif
+    free(buf);
+}
+
+
+static int numaDomainOfCpu(const NumaLayout *L, int cpu) {
+    for (int d = 0; d < L->n_domains; ++d) {
+        for (int k = 0; k < L->n_cpus[d]; ++k) {
+            if (L->cpus[d][k] == cpu) {
+                return d;
+            }
+        }
+    }
+    return 0;
+}
+
+
+// Pin the calling thread to one CPU
+static void numaPinSelf(int cpu) {
+#ifdef __linux__
+    unsigned long mask[NUMA_MAX_CPUS / (8 * sizeof(unsigned long))];
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / (8 * sizeof(unsigned long))] |= 1UL << (cpu % (8 * sizeof(unsigned long)));
+    syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+#else
+    (void)cpu;
+#endif
+}
+
+
+// Detect the domains, place and pin `threads` OpenMP threads (consecutive
+// thread ids share a domain) and split g's rows between the domains. The
+// threads stay pinned for later parallel regions of the same size.
+void numaInit(NumaLayout *L, const CSRGraph *g, int threads) {
+    memset(L, 0, sizeof(*L));
+    numaDetect(L);
+    L->n_threads = threads < NUMA_MAX_THREADS ? threads : NUMA_MAX_THREADS;
+
+    L->pinned_by_places = omp_get_proc_bind() != omp_proc_bind_false && omp_get_num_places() > 0;
+    if (L->pinned_by_places) {
+        // The runtime already binds threads to places; find each one's domain
+        #pragma omp parallel num_threads(L->n_threads)
+        {
+            int t = omp_get_thread_num(), place = omp_get_place_num();
+            int procs = place >= 0 ? omp_get_place_num_procs(place) : 0;
+            int ids[NUMA_MAX_CPUS];
+            if (procs > 0 && procs <= NUMA_MAX_CPUS) {
+                omp_get_place_proc_ids(place, ids);
+                L->thread_cpu[t] = ids[0];
+            } else {
+                L->thread_cpu[t] = -1;
+            }
+        }
+        for (int t = 0; t < L->n_threads; ++t) {
+            L->thread_domain[t] = L->thread_cpu[t] >= 0 ? numaDomainOfCpu(L, L->thread_cpu[t]) : 0;
+        }
+    } else {
+        int domains = L->n_domains < L->n_threads ? L->n_domains : L->n_threads;
+        int used[NUMA_MAX_DOMAINS] = {0};
+        for (int t = 0; t < L->n_threads; ++t) {
+            int d = (int)((long)t * domains / L->n_threads);
+            L->thread_domain[t] = d;
+            L->thread_cpu[t] = L->cpus[d][used[d]++ % L->n_cpus[d]];
+        }
+        #pragma omp parallel num_threads(L->n_threads)
+        numaPinSelf(L->thread_cpu[omp_get_thread_num()]);
+    }
+
+    // Drop domains without threads, keeping the domain ids dense
+    int remap[NUMA_MAX_DOMAINS], kept = 0;
+    for (int d = 0; d < L->n_domains; ++d) {
+        L->domain_threads[d] = 0;
+    }
+    for (int t = 0; t < L->n_threads; ++t) {
+        L->domain_threads[L->thread_domain[t]]++;
+    }
+    for (int d = 0; d < L->n_domains; ++d) {
+        remap[d] = kept;
+        if (L->domain_threads[d] > 0) {
+            L->n_cpus[kept] = L->n_cpus[d];
+            L->cpus[kept] = L->cpus[d];
+            L->os_node[kept] = L->os_node[d];
+            L->domain_threads[kept] = L->domain_threads[d];
+            kept++;
+        } else {
+            free(L->cpus[d]);
+        }
+    }
+    for (int t = 0; t < L->n_threads; ++t) {
+        L->thread_domain[t] = remap[L->thread_domain[t]];
+    }
+    L->n_domains = kept;
+
+    // Row ranges with a share of rows + edges proportional to the threads
+    int n = g->n_nodes;
+    double total = (double)n + g->n_edges;
+    int threadsSoFar = 0, row = 0;
+    L->row_begin[0] = 0;
+    for (int d = 0; d < L->n_domains; ++d) {
+        threadsSoFar += L->domain_threads[d];
+        double target = total * threadsSoFar / L->n_threads;
+        int lo = row, hi = n;
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if ((double)mid + g->offsets[mid] < target) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        row = (d == L->n_domains - 1) ? n : lo;
+        L->row_begin[d + 1] = row;
+        L->graph[d] = g;
+    }
+}
+
+
+// Release the replicas and the domain tables (not the placed matrices)
+void numaFree(NumaLayout *L) {
+    for (int d = 0; d < L->n_domains; ++d) {
+        csrFree(L->replica[d]);
+        free(L->replica_labels[d]);
+        free(L->cpus[d]);
+    }
+}
+
+
+// Rows [*begin, *end) handed to thread tid out of its share of its domain's
+// range; used for static first-touch loops
+static void numaThreadRows(const NumaLayout *L, int tid, int *begin, int *end) {
+    int d = L->thread_domain[tid], rank = 0;
+    for (int t = 0; t < tid; ++t) {
+        rank += L->thread_domain[t] == d;
+    }
+    long lo = L->row_begin[d], len = L->row_begin[d + 1] - lo;
+    *begin = (int)(lo + len * rank / L->domain_threads[d]);
+    *end = (int)(lo + len * (rank + 1) / L->domain_threads[d]);
+}
+
+
+// Page-aligned, untouched memory: the first thread to write a page places it
+void *numaAlloc(size_t bytes) {
+#ifdef __linux__
+    void *p = mmap(NULL, bytes ? bytes : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+#else
+    return malloc(bytes);
+#endif
+}
+
+
+void numaRelease(void *p, size_t bytes) {
+#ifdef __linux__
+    if (p) {
+        munmap(p, bytes ? bytes : 1);
+    }
+#else
+    (void)bytes;
+    free(p);
+#endif
+}
+
+
+// Copy of an n_rows x width row-major matrix (zeros when src is NULL) whose
+// rows are first-touched by the threads of their owning domain. Release it
+// with numaRelease(p, n_rows * width * sizeof(float)).
+float *numaPlaceRows(const NumaLayout *L, const float *src, int n_rows, int width) {
+    float *dst = (float *)numaAlloc((size_t)n_rows * width * sizeof(float));
+    if (!dst) {
+        return NULL;
+    }
+    #pragma omp parallel num_threads(L->n_threads)
+    {
+        int begin, end;
+        numaThreadRows(L, omp_get_thread_num(), &begin, &end);
+        size_t bytes = (size_t)(end - begin) * width * sizeof(float);
+        if (src) {
+            memcpy(dst + (size_t)begin * width, src + (size_t)begin * width, bytes);
+        } else {
+            memset(dst + (size_t)begin * width, 0, bytes);
+        }
+    }
+    return dst;
+}
+
+
+// Give every domain its own copy of g (and labels, if not NULL), made by
+// one of its threads so the pages are local to it
+void numaReplicate(NumaLayout *L, const CSRGraph *g, const int *labels) {
+    #pragma omp parallel num_threads(L->n_threads)
+    {
+        int t = omp_get_thread_num(), d = L->thread_domain[t];
+        int first = 1;
+        for (int u = 0; u < t; ++u) {
+            first &= L->thread_domain[u] != d;
+        }
+        if (first) {
+            L->replica[d] = csrClone(g);
+            if (labels) {
+                L->replica_labels[d] = (int *)malloc(g->n_nodes * sizeof(int));
+                memcpy(L->replica_labels[d], labels, g->n_nodes * sizeof(int));
+            }
+        }
+    }
+    for (int d = 0; d < L->n_domains; ++d) {
+        L->graph[d] = L->replica[d];
+        L->labels[d] = labels ? L->replica_labels[d] : NULL;
+    }
+    L->replicated = 1;
+}
+
+
+// Point every domain at the shared labels (after numaInit, without replicas)
+void numaShareLabels(NumaLayout *L, const int *labels) {
+    for (int d = 0; d < L->n_domains; ++d) {
+        L->labels[d] = labels;
+    }
+}
+
+
+// Call once (outside the parallel region) before each row loop
+void numaResetChunks(NumaLayout *L) {
+    for (int d = 0; d < L->n_domains; ++d) {
+        L->chunk[d].next = L->row_begin[d];
+    }
+}
+
+
+// Claim up to `chunk` rows of the calling thread's domain; 0 when it is done
+int numaNextChunk(NumaLayout *L, int tid, int chunk, int *begin, int *end) {
+    int d = L->thread_domain[tid];
+    int b = __atomic_fetch_add(&L->chunk[d].next, chunk, __ATOMIC_RELAXED);
+    if (b >= L->row_begin[d + 1]) {
+        return 0;
+    }
+    *begin = b;
+    *end = b + chunk < L->row_begin[d + 1] ? b + chunk : L->row_begin[d + 1];
+    return 1;
+}
+
+
+int numaDomainOfRow(const NumaLayout *L, int i) {
+    int d = 0;
+    while (d + 1 < L->n_domains && i >= L->row_begin[d + 1]) {
+        d++;
+    }
+    return d;
+}
+
+
+// Count, per domain, the neighbor rows one layer reads locally and remotely
+// when node i sums its first `cap` neighbors that share its label (labels
+// NULL: no gate). Adjacency reads are local with replicas, otherwise only
+// in the domain of the thread that built the graph (domain 0).
+void numaCountAccesses(NumaLayout *L, const CSRGraph *g, const int *labels, int cap) {
+    for (int d = 0; d < L->n_domains; ++d) {
+        long local = 0, remote = 0, adj = 0;
+        #pragma omp parallel for schedule(dynamic, 256) reduction(+ : local, remote, adj)
+        for (int i = L->row_begin[d]; i < L->row_begin[d + 1]; ++i) {
+            int cnt = 0;
+            long k = g->offsets[i];
+            for (; k < g->offsets[i + 1] && cnt < cap; ++k) {
+                int u = g->indices[k];
+                if (labels && labels[u] != labels[i]) {
+                    continue;
+                }
+                cnt++;
+                if (numaDomainOfRow(L, u) == d) {
+                    local++;
+                } else {
+                    remote++;
+                }
+            }
+            adj += 2 + (k - g->offsets[i]);
+        }
+        L->row_local[d] = local;
+        L->row_remote[d] = remote;
+        L->adj_local[d] = (L->replicated || d == 0) ? adj : 0;
+        L->adj_remote[d] = (L->replicated || d == 0) ? 0 : adj;
+    }
+}
+
+
+void numaReport(const NumaLayout *L, FILE *out) {
+    fprintf(out, "NUMA: %d domains, %d threads pinned by %s, adjacency %s\n", L->n_domains,
+            L->n_threads, L->pinned_by_places ? "OMP_PLACES" : "affinity mask",
+            L->replicated ? "replicated" : "shared");
+    fprintf(out, "%6s %5s %5s %8s %10s %14s %14s %8s %14s %14s\n", "domain", "node", "cpus", "threads",
+            "rows", "rows_local", "rows_remote", "remote%", "adj_local", "adj_remote");
+    long local = 0, remote = 0;
+    for (int d = 0; d < L->n_domains; ++d) {
+        long reads = L->row_local[d] + L->row_remote[d];
+        fprintf(out, "%6d %5d %5d %8d %10d %14ld %14ld %8.1f %14ld %14ld\n", d, L->os_node[d], L->n_cpus[d],
+                L->domain_threads[d], L->row_begin[d + 1] - L->row_begin[d], L->row_local[d],
+                L->row_remote[d], reads ? 100.0 * L->row_remote[d] / reads : 0.0, L->adj_local[d],
+                L->adj_remote[d]);
+        local += L->row_local[d];
+        remote += L->row_remote[d];
+    }
+    fprintf(out, "neighbor rows per layer: %ld local, %ld remote (%.1f%% remote)\n", local, remote,
+            local + remote ? 100.0 * remote / (local + remote) : 0.0);
+}
+
+#endif
@@ -0,0 +1,670 @@
+#ifndef OOC_H
+#define OOC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <omp.h>
+#include "graph.h"
+
+// Out-of-core row-major matrices for graphs whose features do not fit in RAM.
+// A matrix lives in a binary file (OocMatrix) and is read in blocks of
+// block_rows consecutive rows. An OocCache keeps up to capacity blocks in
+// memory with LRU replacement; a background prefetcher loads the blocks that
+// the next step will need while the current one computes.
+//
+// A layer that aggregates neighbor rows is run one output block at a time
+// (oocPlan / oocGather): the block's halo - the distinct rows its nodes read -
+// is gathered from the input blocks in ascending order, so every input block
+// is read whole and in file order, and the output block is written
+// sequentially. Only the cache, one halo and one output block are in memory.
+//
+// File layout: OocHeader (64 bytes), then n_rows x width float32 rows.
+
+#define OOC_MAGIC 0x46524e47u
+#define OOC_VERSION 1
+#define OOC_QUEUE 1024
+
+
+typedef struct OocHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t n_rows;
+    uint64_t width;
+    uint8_t reserved[40];
+} OocHeader;
+
+
+typedef struct OocMatrix {
+    char path[4096];
+    int fd;
+    int n_rows;
+    int width;
+    int block_rows;
+    int n_blocks;
+    size_t row_bytes;
+} OocMatrix;
+
+
+static int oocPreadAll(int fd, void *buf, size_t bytes, off_t offset) {
+    char *p = (char *)buf;
+    while (bytes > 0) {
+        ssize_t n = pread(fd, p, bytes, offset);
+        if (n <= 0) {
+            return 1;
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+
+static int oocPwriteAll(int fd, const void *buf, size_t bytes, off_t offset) {
+    const char *p = (const char *)buf;
+    while (bytes > 0) {
+        ssize_t n = pwrite(fd, p, bytes, offset);
+        if (n <= 0) {
+            return 1;
+        }
+        p += n;
+        bytes -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+
+static void oocSetBlocks(OocMatrix *m, int block_rows) {
+    m->block_rows = block_rows;
+    m->n_blocks = (m->n_rows + block_rows - 1) / block_rows;
+    m->row_bytes = (size_t)m->width * sizeof(float);
+}
+
+
+// Create (or truncate) a zero-filled n_rows x width matrix file
+int oocCreate(OocMatrix *m, const char *path, int n_rows, int width, int block_rows) {
+    memset(m, 0, sizeof(*m));
+    snprintf(m->path, sizeof(m->path), "%s", path);
+    m->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (m->fd < 0) {
+        fprintf(stderr, "Error creating %s\n", path);
+        return 1;
+    }
+    m->n_rows = n_rows;
+    m->width = width;
+    oocSetBlocks(m, block_rows);
+    OocHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = OOC_MAGIC;
+    h.version = OOC_VERSION;
+    h.n_rows = n_rows;
+    h.width = width;
+    if (oocPwriteAll(m->fd, &h, sizeof(h), 0) != 0 ||
+        ftruncate(m->fd, sizeof(h) + (off_t)n_rows * m->row_bytes) != 0) {
+        fprintf(stderr, "Error sizing %s\n", path);
+        close(m->fd);
+        return 1;
+    }
+    return 0;
+}
+
+
+int oocOpen(OocMatrix *m, const char *path, int block_rows) {
+    memset(m, 0, sizeof(*m));
+    snprintf(m->path, sizeof(m->path), "%s", path);
+    m->fd = open(path, O_RDWR);
+    OocHeader h;
+    if (m->fd < 0 || oocPreadAll(m->fd, &h, sizeof(h), 0) != 0 || h.magic != OOC_MAGIC ||
+        h.version != OOC_VERSION) {
+        fprintf(stderr, "%s is not an out-of-core matrix\n", path);
+        if (m->fd >= 0) {
+            close(m->fd);
+        }
+        return 1;
+    }
+    m->n_rows = (int)h.n_rows;
+    m->width = (int)h.width;
+    oocSetBlocks(m, block_rows);
+    return 0;
+}
+
+
+void oocClose(OocMatrix *m) {
+    if (m->fd >= 0) {
+        close(m->fd);
+    }
+    m->fd = -1;
+}
+
+
+int oocBlockBegin(const OocMatrix *m, int b) {
+    return b * m->block_rows;
+}
+
+
+int oocBlockCount(const OocMatrix *m, int b) {
+    int begin = b * m->block_rows;
+    return begin + m->block_rows < m->n_rows ? m->block_rows : m->n_rows - begin;
+}
+
+
+int oocReadBlock(const OocMatrix *m, int b, float *dst) {
+    off_t offset = sizeof(OocHeader) + (off_t)oocBlockBegin(m, b) * m->row_bytes;
+    return oocPreadAll(m->fd, dst, (size_t)oocBlockCount(m, b) * m->row_bytes, offset);
+}
+
+
+int oocWriteBlock(const OocMatrix *m, int b, const float *src) {
+    off_t offset = sizeof(OocHeader) + (off_t)oocBlockBegin(m, b) * m->row_bytes;
+    return oocPwriteAll(m->fd, src, (size_t)oocBlockCount(m, b) * m->row_bytes, offset);
+}
+
+
+// Copy every row of src into dst (same shape and block rows) through buf,
+// one block of src
+int oocCopyRows(const OocMatrix *dst, const OocMatrix *src, float *buf) {
+    if (dst->n_rows != src->n_rows || dst->width != src->width || dst->block_rows != src->block_rows) {
+        fprintf(stderr, "%s does not have the shape of %s\n", dst->path, src->path);
+        return 1;
+    }
+    for (int b = 0; b < src->n_blocks; ++b) {
+        if (oocReadBlock(src, b, buf) != 0 || oocWriteBlock(dst, b, buf) != 0) {
+            fprintf(stderr, "Error copying block %d of %s to %s\n", b, src->path, dst->path);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+// Save a copy of m at path. The copy is written to path.tmp, synced and
+// renamed over path, so path is never half written. buf holds one block.
+int oocSaveCopy(const OocMatrix *m, const char *path, float *buf) {
+    char tmp[4200];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    OocMatrix copy;
+    if (oocCreate(&copy, tmp, m->n_rows, m->width, m->block_rows) != 0) {
+        return 1;
+    }
+    int status = oocCopyRows(&copy, m, buf);
+    if (status == 0 && fsync(copy.fd) != 0) {
+        status = 1;
+    }
+    oocClose(&copy);
+    if (status == 0 && rename(tmp, path) != 0) {
+        fprintf(stderr, "Error renaming %s to %s\n", tmp, path);
+        status = 1;
+    }
+    if (status != 0) {
+        unlink(tmp);
+    }
+    return status;
+}
+
+
+// Stream a whitespace-separated text matrix (features.txt) into a matrix
+// file without holding it in memory. width 0 takes the number of values on
+// the first line. Returns 0 when exactly n_rows rows were written.
+int oocConvertText(const char *text, const char *path, int n_rows, int *width, int block_rows) {
+    FILE *in = fopen(text, "r");
+    if (!in) {
+        fprintf(stderr, "Error opening %s\n", text);
+        return 1;
+    }
+    if (*width <= 0) {
+        int w = 0, c, in_token = 0;
+        while ((c = fgetc(in)) != EOF && c != '\n') {
+            int space = (c == ' ' || c == '\t' || c == '\r' || c == ',');
+            w += !space && !in_token;
+            in_token = !space;
+        }
+        *width = w;
+        rewind(in);
+    }
+    OocMatrix m;
+    if (*width <= 0 || oocCreate(&m, path, n_rows, *width, block_rows) != 0) {
+        fclose(in);
+        return 1;
+    }
+
+    // Parse fixed-size chunks; a number cut at the end of a chunk is carried
+    // over to the next one
+    size_t chunk = 8 << 20, carry = 0;
+    char *buf = (char *)malloc(chunk + 1);
+    float *block = (float *)malloc((size_t)block_rows * m.row_bytes);
+    long values = 0, total = (long)n_rows * *width;
+    int b = 0, status = 0;
+    for (;;) {
+        size_t got = fread(buf + carry, 1, chunk - carry, in);
+        size_t len = carry + got;
+        int last = got == 0 || feof(in);
+        buf[len] = '\0';
+        size_t stop = len;
+        if (!last) {
+            while (stop > 0 && buf[stop - 1] != ' ' && buf[stop - 1] != '\n' && buf[stop - 1] != '\t') {
+                stop--;
+            }
+        }
+        char saved = buf[stop];
+        buf[stop] = '\0';
+        char *p = buf, *end;
+        for (;;) {
+            float v = strtof(p, &end);
+            if (end == p) {
+                break;
+            }
+            p = end;
+            if (values >= total) {
+                status = 1;
+                break;
+            }
+            long within = values - (long)b * block_rows * *width;
+            block[within] = v;
+            values++;
+            if (within + 1 == (long)oocBlockCount(&m, b) * *width) {
+                status |= oocWriteBlock(&m, b++, block);
+            }
+        }
+        buf[stop] = saved;
+        carry = len - stop;
+        memmove(buf, buf + stop, carry);
+        if (last || status) {
+            break;
+        }
+    }
+    if (values != total) {
+        fprintf(stderr, "%s: %ld values, expected %d rows of %d\n", text, values, n_rows, *width);
+        status = 1;
+    }
+    free(buf);
+    free(block);
+    fclose(in);
+    oocClose(&m);
+    return status;
+}
+
+
+// Slot states
+#define OOC_EMPTY 0
+#define OOC_LOADING 1
+#define OOC_READY 2
+
+
+// slot_of[b] -> cache slot holding block b or -1.
+// hits -> pins served from memory; prefetch_hits -> of those, blocks the
+// prefetcher loaded; misses -> pins that had to read the block themselves.
+// stall -> seconds spent waiting for a block in oocPin.
+typedef struct OocCache {
+    const OocMatrix *m;
+    int capacity;
+    float **data;
+    int *block;
+    int *state;
+    int *pins;
+    int *prefetched;
+    unsigned long *last_use;
+    int *slot_of;
+    int n_blocks;
+    unsigned long clock;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int queue[OOC_QUEUE];
+    int head;
+    int tail;
+    int stop;
+
+    long hits;
+    long prefetch_hits;
+    long misses;
+    long evictions;
+    long dropped;
+    long bytes_read;
+    double read_time;
+    double stall;
+} OocCache;
+
+
+// Least recently used unpinned slot (an empty one first); -1 if all pinned.
+// Called with the lock held.
+static int oocVictim(OocCache *c) {
+    int best = -1;
+    for (int s = 0; s < c->capacity; ++s) {
+        if (c->state[s] == OOC_EMPTY) {
+            return s;
+        }
+        if (c->state[s] == OOC_READY && c->pins[s] == 0 && (best < 0 || c->last_use[s] < c->last_use[best])) {
+            best = s;
+        }
+    }
+    return best;
+}
+
+
+// Claim a slot for block b and read it, releasing the lock during the read
+static int oocLoad(OocCache *c, int b, int slot, int prefetch) {
+    if (c->state[slot] == OOC_READY) {
+        c->slot_of[c->block[slot]] = -1;
+        c->evictions++;
+    }
+    c->block[slot] = b;
+    c->state[slot] = OOC_LOADING;
+    c->prefetched[slot] = prefetch;
+    c->slot_of[b] = slot;
+    const OocMatrix *m = c->m;
+    pthread_mutex_unlock(&c->lock);
+    double start = omp_get_wtime();
+    int status = oocReadBlock(m, b, c->data[slot]);
+    double elapsed = omp_get_wtime() - start;
+    pthread_mutex_lock(&c->lock);
+    c->read_time += elapsed;
+    c->bytes_read += (long)oocBlockCount(m, b) * m->row_bytes;
+    c->state[slot] = OOC_READY;
+    c->last_use[slot] = ++c->clock;
+    pthread_cond_broadcast(&c->cond);
+    return status;
+}
+
+
+static void *oocPrefetchMain(void *arg) {
+    OocCache *c = (OocCache *)arg;
+    pthread_mutex_lock(&c->lock);
+    for (;;) {
+        while (!c->stop && c->head == c->tail) {
+            pthread_cond_wait(&c->cond, &c->lock);
+        }
+        if (c->stop) {
+            break;
+        }
+        int b = c->queue[c->head];
+        c->head = (c->head + 1) % OOC_QUEUE;
+        if (b >= c->n_blocks || c->slot_of[b] >= 0) {
+            continue;
+        }
+        int slot = oocVictim(c);
+        if (slot < 0) {
+            // Everything is pinned; the consumer will read it itself
+            c->dropped++;
+            continue;
+        }
+        if (oocLoad(c, b, slot, 1) != 0) {
+            fprintf(stderr, "Error reading block %d of %s\n", b, c->m->path);
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+
+// A cache of `capacity` blocks of up to block_rows x width floats, reading
+// from m (see oocCacheAttach). Starts the prefetch thread.
+int oocCacheInit(OocCache *c, const OocMatrix *m, int capacity) {
+    memset(c, 0, sizeof(*c));
+    capacity = capacity < m->n_blocks ? capacity : m->n_blocks;
+    c->capacity = capacity < 2 ? 2 : capacity;
+    c->data = (float **)malloc(c->capacity * sizeof(float *));
+    c->block = (int *)malloc(c->capacity * sizeof(int));
+    c->state = (int *)calloc(c->capacity, sizeof(int));
+    c->pins = (int *)calloc(c->capacity, sizeof(int));
+    c->prefetched = (int *)calloc(c->capacity, sizeof(int));
+    c->last_use = (unsigned long *)calloc(c->capacity, sizeof(unsigned long));
+    for (int s = 0; s < c->capacity; ++s) {
+        c->data[s] = (float *)malloc((size_t)m->block_rows * m->row_bytes);
+    }
+    c->m = m;
+    c->n_blocks = m->n_blocks;
+    c->slot_of = (int *)malloc(c->n_blocks * sizeof(int));
+    memset(c->slot_of, 0xff, c->n_blocks * sizeof(int));
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    if (pthread_create(&c->thread, NULL, oocPrefetchMain, c) != 0) {
+        fprintf(stderr, "Error starting the prefetch thread\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Switch the cache to another matrix with the same shape and blocking
+// (e.g. the next layer's input); drops every cached block
+void oocCacheAttach(OocCache *c, const OocMatrix *m) {
+    pthread_mutex_lock(&c->lock);
+    c->head = c->tail;
+    while (1) {
+        int busy = 0;
+        for (int s = 0; s < c->capacity; ++s) {
+            busy |= c->state[s] == OOC_LOADING || c->pins[s] > 0;
+        }
+        if (!busy) {
+            break;
+        }
+        pthread_cond_wait(&c->cond, &c->lock);
+    }
+    for (int s = 0; s < c->capacity; ++s) {
+        c->state[s] = OOC_EMPTY;
+    }
+    memset(c->slot_of, 0xff, c->n_blocks * sizeof(int));
+    c->m = m;
+    pthread_mutex_unlock(&c->lock);
+}
+
+
+void oocCacheFree(OocCache *c) {
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->cond);
+    for (int s = 0; s < c->capacity; ++s) {
+        free(c->data[s]);
+    }
+    free(c->data);
+    free(c->block);
+    free(c->state);
+    free(c->pins);
+    free(c->prefetched);
+    free(c->last_use);
+    free(c->slot_of);
+}
+
+
+// Queue blocks for the prefetcher, in order. Only the first capacity-1 are
+// taken, so a prefetch never evicts the blocks it brought in itself.
+void oocPrefetch(OocCache *c, const int *blocks, int count) {
+    pthread_mutex_lock(&c->lock);
+    count = count < c->capacity - 1 ? count : c->capacity - 1;
+    for (int q = 0; q < count; ++q) {
+        int next = (c->tail + 1) % OOC_QUEUE;
+        if (next == c->head) {
+            c->dropped += count - q;
+            break;
+        }
+        c->queue[c->tail] = blocks[q];
+        c->tail = next;
+    }
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->lock);
+}
+
+
+// Rows of block b, kept in memory until oocUnpin. Waits for a block the
+// prefetcher is reading and reads missing blocks itself.
+const float *oocPin(OocCache *c, int b) {
+    pthread_mutex_lock(&c->lock);
+    double start = omp_get_wtime();
+    const float *rows = NULL;
+    for (;;) {
+        int slot = c->slot_of[b];
+        if (slot >= 0 && c->state[slot] == OOC_READY) {
+            c->hits++;
+            c->prefetch_hits += c->prefetched[slot];
+            c->prefetched[slot] = 0;
+            c->pins[slot]++;
+            c->last_use[slot] = ++c->clock;
+            rows = c->data[slot];
+            break;
+        }
+        if (slot < 0) {
+            slot = oocVictim(c);
+            if (slot >= 0) {
+                c->misses++;
+                if (oocLoad(c, b, slot, 0) != 0) {
+                    fprintf(stderr, "Error reading block %d of %s\n", b, c->m->path);
+                }
+                c->pins[slot]++;
+                rows = c->data[slot];
+                break;
+            }
+        }
+        // Loading elsewhere, or every slot pinned
+        pthread_cond_wait(&c->cond, &c->lock);
+    }
+    c->stall += omp_get_wtime() - start;
+    pthread_mutex_unlock(&c->lock);
+    return rows;
+}
+
+
+void oocUnpin(OocCache *c, int b) {
+    pthread_mutex_lock(&c->lock);
+    int slot = c->slot_of[b];
+    if (slot >= 0 && c->pins[slot] > 0 && --c->pins[slot] == 0) {
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->lock);
+}
+
+
+void oocCacheReport(const OocCache *c, FILE *out) {
+    long pins = c->hits + c->misses;
+    fprintf(out, "ooc cache: %d blocks, hits=%ld (prefetched %ld) misses=%ld hit_rate=%.3f evictions=%ld "
+            "dropped=%ld read=%.1fMB at %.1fMB/s stall=%.3fs\n", c->capacity, c->hits, c->prefetch_hits,
+            c->misses, pins ? (double)c->hits / pins : 0.0, c->evictions, c->dropped,
+            (double)c->bytes_read / (1 << 20),
+            c->read_time > 0 ? (double)c->bytes_read / (1 << 20) / c->read_time : 0.0, c->stall);
+}
+
+
+// What one output block needs from the layer below.
+// halo -> distinct input rows read by the block, ascending; halo_of[u] is
+// u's row in the halo buffer (valid for the rows in halo).
+// blocks -> the distinct input blocks holding them, in the order to read
+// them: ascending for even output blocks and descending for odd ones, so
+// the blocks the LRU cache kept from one block are the first the next needs.
+typedef struct OocPlan {
+    int *halo;
+    int n_halo;
+    int *blocks;
+    int n_blocks;
+    int *halo_of;
+    unsigned *stamp;
+    unsigned current;
+} OocPlan;
+
+
+void oocPlanInit(OocPlan *p, int n_nodes, int n_blocks) {
+    memset(p, 0, sizeof(*p));
+    p->halo = (int *)malloc(n_nodes * sizeof(int));
+    p->blocks = (int *)malloc(n_blocks * sizeof(int));
+    p->halo_of = (int *)malloc(n_nodes * sizeof(int));
+    p->stamp = (unsigned *)calloc(n_nodes, sizeof(unsigned));
+}
+
+
+void oocPlanFree(OocPlan *p) {
+    free(p->halo);
+    free(p->blocks);
+    free(p->halo_of);
+    free(p->stamp);
+}
+
+
+static int oocCompareInt(const void *a, const void *b) {
+    int x = *(const int *)a, y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+
+// Plan output block b: node i reads its first `cap` neighbors that share its
+// label (labels NULL: no gate), as the GCN layers do
+void oocPlanBlock(OocPlan *p, const OocMatrix *m, const CSRGraph *g, const int *labels, int cap, int b) {
+    if (++p->current == 0) {
+        memset(p->stamp, 0, g->n_nodes * sizeof(unsigned));
+        p->current = 1;
+    }
+    p->n_halo = 0;
+    int begin = oocBlockBegin(m, b), end = begin + oocBlockCount(m, b);
+    for (int i = begin; i < end; ++i) {
+        int cnt = 0;
+        for (long k = g->offsets[i]; k < g->offsets[i + 1] && cnt < cap; ++k) {
+            int u = g->indices[k];
+            if (labels && labels[u] != labels[i]) {
+                continue;
+            }
+            cnt++;
+            if (p->stamp[u] != p->current) {
+                p->stamp[u] = p->current;
+                p->halo[p->n_halo++] = u;
+            }
+        }
+    }
+    qsort(p->halo, p->n_halo, sizeof(int), oocCompareInt);
+    p->n_blocks = 0;
+    for (int r = 0; r < p->n_halo; ++r) {
+        p->halo_of[p->halo[r]] = r;
+        int blk = p->halo[r] / m->block_rows;
+        if (p->n_blocks == 0 || p->blocks[p->n_blocks - 1] != blk) {
+            p->blocks[p->n_blocks++] = blk;
+        }
+    }
+    for (int q = 0; b % 2 == 1 && q < p->n_blocks / 2; ++q) {
+        int t = p->blocks[q];
+        p->blocks[q] = p->blocks[p->n_blocks - 1 - q];
+        p->blocks[p->n_blocks - 1 - q] = t;
+    }
+}
+
+
+// First halo entry at or after row
+static int oocHaloLowerBound(const OocPlan *p, int row) {
+    int lo = 0, hi = p->n_halo;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (p->halo[mid] < row) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+// Copy the plan's halo rows into buf (n_halo x width), one input block at a
+// time in the plan's order
+void oocGather(OocCache *c, const OocPlan *p, float *buf) {
+    const OocMatrix *m = c->m;
+    for (int q = 0; q < p->n_blocks; ++q) {
+        int blk = p->blocks[q];
+        const float *rows = oocPin(c, blk);
+        int begin = oocBlockBegin(m, blk), end = begin + oocBlockCount(m, blk);
+        int first = oocHaloLowerBound(p, begin), r = oocHaloLowerBound(p, end);
+        #pragma omp parallel for schedule(static)
+        for (int k = first; k < r; ++k) {
+            memcpy(buf + (size_t)k * m->width, rows + (size_t)(p->halo[k] - begin) * m->width, m->row_bytes);
+        }
+        oocUnpin(c, blk);
+    }
+}
+
+#endif
@@ -1,118 +1,91 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
-
-#define EPSILON 1e-10 
-
-
-double calculateMean(double *data, int n) {
-    double sum = 0.0;
+#include <string.h>
+#include <omp.h>
+#include "pca.h"
+
+
+// Times the cyclic solver on a random dense symmetric n x n matrix and
+// reports the residual ||A v - lambda v|| of the leading eigenpair.
+int benchEigen(int n) {
+    double *A = malloc((size_t)n * n * sizeof(double));
+    double *A0 = malloc((size_t)n * n * sizeof(double));
+    double *V = malloc((size_t)n * n * sizeof(double));
+    double *eigenvalues = malloc(n * sizeof(double));
+    srand(42);
     for (int i = 0; i < n; ++i) {
-        sum += data[i];
-    }
-    return sum / n;
-}
-
-
-void computeCovarianceMatrix(double **data, int numRows, int numCols, double **covMatrix) {
-
-    double means[numCols];
-    for (int j = 0; j < numCols; ++j) {
-        means[j] = calculateMean(data[j], numRows);
-    }
-
-
-    for (int i = 0; i < numCols; ++i) {
-        for (int j = i; j < numCols; ++j) { 
-            double cov = 0.0;
-            for (int k = 0; k < numRows; ++k) {
-                cov += (data[i][k] - means[i]) * (data[j][k] - means[j]);
-            }
-            cov /= numRows;
-            covMatrix[i][j] = cov;
-            covMatrix[j][i] = cov;
+        for (int j = i; j < n; ++j) {
+            double x = (double)rand() / RAND_MAX - 0.5;
+            A[(size_t)i * n + j] = A[(size_t)j * n + i] = x;
         }
     }
-}
-
-void jacobiRotation(double **A, double **V, int p, int q, int n) {
-    double tau = (A[q][q] - A[p][p]) / (2.0 * A[p][q]);
-    double t = (tau >= 0) ? 1.0 / (tau + sqrt(1.0 + tau * tau)) : -1.0 / (-tau + sqrt(1.0 + tau * tau));
-    double c = 1.0 / sqrt(1.0 + t * t);
-    double s = c * t;
+    memcpy(A0, A, (size_t)n * n * sizeof(double));
 
+    double start = omp_get_wtime();
+    int sweeps = eigenDecompositionCyclic(A, n, eigenvalues, V, 1e-12, 50);
+    double end = omp_get_wtime();
+    sortEigenPairs(eigenvalues, V, n);
 
-    double Apq = A[p][q];
-    A[p][p] -= t * Apq;
-    A[q][q] += t * Apq;
-    A[p][q] = A[q][p] = 0.0;
+    double residual = 0.0;
     for (int i = 0; i < n; ++i) {
-        if (i != p && i != q) {
-            double Aip = A[i][p];
-            double Aiq = A[i][q];
-            A[i][p] = A[p][i] = c * Aip - s * Aiq;
-            A[i][q] = A[q][i] = s * Aip + c * Aiq;
+        double av = 0.0;
+        for (int j = 0; j < n; ++j) {
+            av += A0[(size_t)i * n + j] * V[(size_t)j * n];
         }
+        double r = av - eigenvalues[0] * V[(size_t)i * n];
+        residual += r * r;
     }
+    printf("n=%d threads=%d sweeps=%d time=%.3fs lambda_max=%lf residual=%.3e\n",
+           n, omp_get_max_threads(), sweeps, end - start, eigenvalues[0], sqrt(residual));
 
+    free(A);
+    free(A0);
+    free(V);
+    free(eigenvalues);
+    return 0;
+}
 
-    for (int i = 0; i < n; ++i) {
-        double Vip = V[i][p];
-        double Viq = V[i][q];
-        V[i][p] = c * Vip - s * Viq;
-        V[i][q] = s * Vip + c * Viq;
+// Fit a k-component projection on a whitespace-separated feature file and
+// save it for the GNN programs (GCN_t1.c built with -DPCA_COMPONENTS=k).
+int fitFeatures(const char *featurePath, int dim, int k, const char *outPath) {
+    long rows;
+    float *X = readFloatMatrix(featurePath, dim, &rows);
+    if (X == NULL) {
+        return 1;
     }
+    PCAModel model;
+    double start = omp_get_wtime();
+    double kept = pcaFit(&model, X, rows, dim, k, 4096);
+    double end = omp_get_wtime();
+    printf("rows=%ld dim=%d k=%d variance kept=%.4f time=%.3fs\n", rows, dim, model.k, kept, end - start);
+    int status = pcaSave(&model, outPath);
+    pcaFree(&model);
+    free(X);
+    return status;
 }
 
 
-void eigenDecomposition(double **A, int n, double *eigenvalues, double **eigenvectors) {
+int main(int argc, char **argv) {
 
-    for (int i = 0; i < n; ++i) {
-        for (int j = 0; j < n; ++j) {
-            eigenvectors[i][j] = (i == j) ? 1.0 : 0.0;
-        }
+    if (argc > 2 && strcmp(argv[1], "--bench") == 0) {
+        return benchEigen(atoi(argv[2]));
     }
-
-    int iter = 0;
-    int maxIter = n * n * n; 
-    int p, q;
-    double offDiagMax;
-    do {
-
-        offDiagMax = 0.0;
-        for (int i = 0; i < n; ++i) {
-            for (int j = i + 1; j < n; ++j) {
-                if (fabs(A[i][j]) > offDiagMax) {
-                    offDiagMax = fabs(A[i][j]);
-                    p = i;
-                    q = j;
-                }
-            }
-        }
-
-
-        if (offDiagMax > EPSILON) {
-            jacobiRotation(A, eigenvectors, p, q, n);
-        }
-
-        iter++;
-    } while (offDiagMax > EPSILON && iter < maxIter);
-
-
-    for (int i = 0; i < n; ++i) {
-        eigenvalues[i] = A[i][i];
+    if (argc > 5 && strcmp(argv[1], "--fit") == 0) {
+        return fitFeatures(argv[2], atoi(argv[3]), atoi(argv[4]), argv[5]);
     }
-}
-
-int main() {
-
-    double data[3][5] = {
-        {1.0, 2.0, 3.0, 4.0, 5.0},
-        {2.0, 3.0, 4.0, 5.0, 6.0},
-        {3.0, 4.0, 5.0, 6.0, 7.0}
+    int serial = (argc > 1 && strcmp(argv[1], "--serial") == 0);
+
+    // Rows are samples, columns are features (row-major)
+    double data[5][3] = {
+        {1.0, 2.0, 3.0},
+        {2.0, 3.0, 4.0},
+        {3.0, 4.0, 5.0},
+        {4.0, 5.0, 6.0},
+        {5.0, 6.0, 7.0}
     };
-    int numRows = sizeof(data[0]) / sizeof(double);
-    int numCols = sizeof(data) / sizeof(data[0]);
+    int numRows = sizeof(data) / sizeof(data[0]);
+    int numCols = sizeof(data[0]) / sizeof(double);
 
 
     double **covarianceMatrix = malloc(numCols * sizeof(double *));
@@ -121,7 +94,28 @@ int main() {
     }
 
 
-    computeCovarianceMatrix(data, numRows, numCols, covarianceMatrix);
+    if (serial) {
+        // computeCovarianceMatrix expects one array per feature
+        double **columns = malloc(numCols * sizeof(double *));
+        for (int j = 0; j < numCols; ++j) {
+            columns[j] = malloc(numRows * sizeof(double));
+            for (int i = 0; i < numRows; ++i) {
+                columns[j][i] = data[i][j];
+            }
+        }
+        computeCovarianceMatrix(columns, numRows, numCols, covarianceMatrix);
+        for (int j = 0; j < numCols; ++j) {
+            free(columns[j]);
+        }
+        free(columns);
+    } else {
+        double *cov = malloc(numCols * numCols * sizeof(double));
+        computeCovarianceBlocked(&data[0][0], numRows, numCols, cov);
+        for (int i = 0; i < numCols; ++i) {
+            memcpy(covarianceMatrix[i], cov + i * numCols, numCols * sizeof(double));
+        }
+        free(cov);
+    }
 
 
     double *eigenvalues = malloc(numCols * sizeof(double));
@@ -131,7 +125,22 @@ int main() {
     }
 
 
-    eigenDecomposition(covarianceMatrix, numCols, eigenvalues, eigenvectors);
+    if (serial) {
+        eigenDecomposition(covarianceMatrix, numCols, eigenvalues, eigenvectors);
+    } else {
+        double *A = malloc(numCols * numCols * sizeof(double));
+        double *V = malloc(numCols * numCols * sizeof(double));
+        for (int i = 0; i < numCols; ++i) {
+            memcpy(A + i * numCols, covarianceMatrix[i], numCols * sizeof(double));
+        }
+        eigenDecompositionCyclic(A, numCols, eigenvalues, V, 1e-12, 50);
+        sortEigenPairs(eigenvalues, V, numCols);
+        for (int i = 0; i < numCols; ++i) {
+            memcpy(eigenvectors[i], V + i * numCols, numCols * sizeof(double));
+        }
+        free(A);
+        free(V);
+    }
 
 
     printf("Eigenvalues:\n");
@@ -0,0 +1,723 @@
+#ifndef PCA_H
+#define PCA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <omp.h>
+#include "kernels.h"
+
+#define EPSILON 1e-10 
+
+
+double calculateMean(double *data, int n) {
+    double sum = 0.0;
+    for (int i = 0; i < n; ++i) {
+        sum += data[i];
+    }
+    return sum / n;
+}
+
+
+void computeCovarianceMatrix(double **data, int numRows, int numCols, double **covMatrix) {
+
+    double means[numCols];
+    for (int j = 0; j < numCols; ++j) {
+        means[j] = calculateMean(data[j], numRows);
+    }
+
+
+    for (int i = 0; i < numCols; ++i) {
+        for (int j = i; j < numCols; ++j) { 
+            double cov = 0.0;
+            for (int k = 0; k < numRows; ++k) {
+                cov += (data[i][k] - means[i]) * (data[j][k] - means[j]);
+            }
+            cov /= numRows;
+            covMatrix[i][j] = cov;
+            covMatrix[j][i] = cov;
+        }
+    }
+}
+
+#define COV_BLOCK_COLS 64
+#define COV_BLOCK_ROWS 256
+
+
+// Streaming covariance state. Chunks of rows are centered on their own mean
+// and merged with Chan's pairwise update, so datasets that don't fit in RAM
+// can be accumulated chunk by chunk without losing the one-pass centering.
+// cols -> number of features (columns of each row-major chunk).
+// count -> number of rows accumulated so far.
+// mean -> running column means.
+// M -> cols x cols row-major sum of centered outer products (upper triangle).
+// chunk/chunkMean -> scratch for the centered copy of the current chunk.
+typedef struct CovAccumulator {
+    int cols;
+    long count;
+    double *mean;
+    double *M;
+    double *chunk;
+    long chunkCap;
+    double *chunkMean;
+} CovAccumulator;
+
+
+void covInit(CovAccumulator *acc, int cols) {
+    acc->cols = cols;
+    acc->count = 0;
+    acc->mean = calloc(cols, sizeof(double));
+    acc->M = calloc((size_t)cols * cols, sizeof(double));
+    acc->chunk = NULL;
+    acc->chunkCap = 0;
+    acc->chunkMean = malloc(cols * sizeof(double));
+}
+
+
+void covFree(CovAccumulator *acc) {
+    free(acc->mean);
+    free(acc->M);
+    free(acc->chunk);
+    free(acc->chunkMean);
+}
+
+
+// M += Xc^T * Xc on the upper triangle, Xc row-major rows x cols.
+// Output is tiled COV_BLOCK_COLS x COV_BLOCK_COLS and each upper tile is
+// owned by one thread, so no atomics are needed; rows are consumed in
+// COV_BLOCK_ROWS slabs so both panels of a tile stay in cache, and the
+// innermost loop is a rank-1 update along contiguous j.
+void syrkUpperBlocked(const double *Xc, long rows, int cols, double *M) {
+    int nb = (cols + COV_BLOCK_COLS - 1) / COV_BLOCK_COLS;
+    int tiles = nb * (nb + 1) / 2;
+
+    #pragma omp parallel
+    {
+        double tile[COV_BLOCK_COLS * COV_BLOCK_COLS];
+
+        #pragma omp for schedule(dynamic, 1)
+        for (int t = 0; t < tiles; ++t) {
+            // Map linear index t to the upper-triangular tile (ib, jb)
+            int ib = 0, rem = t;
+            while (rem >= nb - ib) {
+                rem -= nb - ib;
+                ib++;
+            }
+            int jb = ib + rem;
+            int i0 = ib * COV_BLOCK_COLS, j0 = jb * COV_BLOCK_COLS;
+            int ni = (cols - i0 < COV_BLOCK_COLS) ? cols - i0 : COV_BLOCK_COLS;
+            int nj = (cols - j0 < COV_BLOCK_COLS) ? cols - j0 : COV_BLOCK_COLS;
+
+            memset(tile, 0, sizeof(tile));
+            for (long r0 = 0; r0 < rows; r0 += COV_BLOCK_ROWS) {
+                long r1 = (r0 + COV_BLOCK_ROWS < rows) ? r0 + COV_BLOCK_ROWS : rows;
+                for (long r = r0; r < r1; ++r) {
+                    const double *xr = Xc + (size_t)r * cols;
+                    for (int i = 0; i < ni; ++i) {
+                        double a = xr[i0 + i];
+                        double *ti = tile + i * COV_BLOCK_COLS;
+                        const double *xj = xr + j0;
+                        #pragma omp simd
+                        for (int j = 0; j < nj; ++j) {
+                            ti[j] += a * xj[j];
+                        }
+                    }
+                }
+            }
+            for (int i = 0; i < ni; ++i) {
+                double *mi = M + (size_t)(i0 + i) * cols + j0;
+                for (int j = 0; j < nj; ++j) {
+                    mi[j] += tile[i * COV_BLOCK_COLS + j];
+                }
+            }
+        }
+    }
+}
+
+
+// Merge the centered chunk sitting in acc->chunk (mean acc->chunkMean) into acc
+static void covMergeChunk(CovAccumulator *acc, long rows) {
+    int cols = acc->cols;
+    long na = acc->count;
+    long n = na + rows;
+    double w = (double)na * (double)rows / (double)n;
+
+    syrkUpperBlocked(acc->chunk, rows, cols, acc->M);
+
+    if (na > 0) {
+        double *delta = malloc(cols * sizeof(double));
+        for (int j = 0; j < cols; ++j) {
+            delta[j] = acc->chunkMean[j] - acc->mean[j];
+        }
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int i = 0; i < cols; ++i) {
+            double di = w * delta[i];
+            double *mi = acc->M + (size_t)i * cols;
+            #pragma omp simd
+            for (int j = i; j < cols; ++j) {
+                mi[j] += di * delta[j];
+            }
+        }
+        for (int j = 0; j < cols; ++j) {
+            acc->mean[j] += delta[j] * (double)rows / (double)n;
+        }
+        free(delta);
+    } else {
+        memcpy(acc->mean, acc->chunkMean, cols * sizeof(double));
+    }
+    acc->count = n;
+}
+
+
+static void covReserve(CovAccumulator *acc, long rows) {
+    if (rows > acc->chunkCap) {
+        free(acc->chunk);
+        acc->chunk = malloc((size_t)rows * acc->cols * sizeof(double));
+        acc->chunkCap = rows;
+    }
+}
+
+
+// Column means of a row-major chunk, then its centered copy into acc->chunk
+void covCenterChunk(CovAccumulator *acc, const double *X, long rows) {
+    int cols = acc->cols;
+    memset(acc->chunkMean, 0, cols * sizeof(double));
+    for (long r = 0; r < rows; ++r) {
+        for (int j = 0; j < cols; ++j) {
+            acc->chunkMean[j] += X[(size_t)r * cols + j];
+        }
+    }
+    for (int j = 0; j < cols; ++j) {
+        acc->chunkMean[j] /= (double)rows;
+    }
+    #pragma omp parallel for
+    for (long r = 0; r < rows; ++r) {
+        double *dst = acc->chunk + (size_t)r * cols;
+        for (int j = 0; j < cols; ++j) {
+            dst[j] = X[(size_t)r * cols + j] - acc->chunkMean[j];
+        }
+    }
+}
+
+
+void covCenterChunkf(CovAccumulator *acc, const float *X, long rows) {
+    int cols = acc->cols;
+    memset(acc->chunkMean, 0, cols * sizeof(double));
+    for (long r = 0; r < rows; ++r) {
+        for (int j = 0; j < cols; ++j) {
+            acc->chunkMean[j] += X[(size_t)r * cols + j];
+        }
+    }
+    for (int j = 0; j < cols; ++j) {
+        acc->chunkMean[j] /= (double)rows;
+    }
+    #pragma omp parallel for
+    for (long r = 0; r < rows; ++r) {
+        double *dst = acc->chunk + (size_t)r * cols;
+        for (int j = 0; j < cols; ++j) {
+            dst[j] = X[(size_t)r * cols + j] - acc->chunkMean[j];
+        }
+    }
+}
+
+
+// Add a chunk of rows (row-major, acc->cols wide) to the running covariance
+void covAccumulate(CovAccumulator *acc, const double *X, long rows) {
+    if (rows <= 0) {
+        return;
+    }
+    covReserve(acc, rows);
+    covCenterChunk(acc, X, rows);
+    covMergeChunk(acc, rows);
+}
+
+
+void covAccumulatef(CovAccumulator *acc, const float *X, long rows) {
+    if (rows <= 0) {
+        return;
+    }
+    covReserve(acc, rows);
+    covCenterChunkf(acc, X, rows);
+    covMergeChunk(acc, rows);
+}
+
+
+// Write the population covariance (divided by count, like
+// computeCovarianceMatrix) as a full symmetric row-major matrix
+void covFinalize(const CovAccumulator *acc, double *cov) {
+    int cols = acc->cols;
+    double inv = acc->count > 0 ? 1.0 / (double)acc->count : 0.0;
+    #pragma omp parallel for
+    for (int i = 0; i < cols; ++i) {
+        for (int j = i; j < cols; ++j) {
+            double c = acc->M[(size_t)i * cols + j] * inv;
+            cov[(size_t)i * cols + j] = c;
+            cov[(size_t)j * cols + i] = c;
+        }
+    }
+}
+
+
+// One-shot covariance of a row-major rows x cols matrix (rows are samples)
+void computeCovarianceBlocked(const double *X, long rows, int cols, double *cov) {
+    CovAccumulator acc;
+    covInit(&acc, cols);
+    covAccumulate(&acc, X, rows);
+    covFinalize(&acc, cov);
+    covFree(&acc);
+}
+
+
+void jacobiRotation(double **A, double **V, int p, int q, int n) {
+    double tau = (A[q][q] - A[p][p]) / (2.0 * A[p][q]);
+    double t = (tau >= 0) ? 1.0 / (tau + sqrt(1.0 + tau * tau)) : -1.0 / (-tau + sqrt(1.0 + tau * tau));
+    double c = 1.0 / sqrt(1.0 + t * t);
+    double s = c * t;
+
+
+    double Apq = A[p][q];
+    A[p][p] -= t * Apq;
+    A[q][q] += t * Apq;
+    A[p][q] = A[q][p] = 0.0;
+    for (int i = 0; i < n; ++i) {
+        if (i != p && i != q) {
+            double Aip = A[i][p];
+            double Aiq = A[i][q];
+            A[i][p] = A[p][i] = c * Aip - s * Aiq;
+            A[i][q] = A[q][i] = s * Aip + c * Aiq;
+        }
+    }
+
+
+    for (int i = 0; i < n; ++i) {
+        double Vip = V[i][p];
+        double Viq = V[i][q];
+        V[i][p] = c * Vip - s * Viq;
+        V[i][q] = s * Vip + c * Viq;
+    }
+}
+
+
+void eigenDecomposition(double **A, int n, double *eigenvalues, double **eigenvectors) {
+
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            eigenvectors[i][j] = (i == j) ? 1.0 : 0.0;
+        }
+    }
+
+    int iter = 0;
+    int maxIter = n * n * n; 
+    int p, q;
+    double offDiagMax;
+    do {
+
+        offDiagMax = 0.0;
+        for (int i = 0; i < n; ++i) {
+            for (int j = i + 1; j < n; ++j) {
+                if (fabs(A[i][j]) > offDiagMax) {
+                    offDiagMax = fabs(A[i][j]);
+                    p = i;
+                    q = j;
+                }
+            }
+        }
+
+
+        if (offDiagMax > EPSILON) {
+            jacobiRotation(A, eigenvectors, p, q, n);
+        }
+
+        iter++;
+    } while (offDiagMax > EPSILON && iter < maxIter);
+
+
+    for (int i = 0; i < n; ++i) {
+        eigenvalues[i] = A[i][i];
+    }
+}
+
+
+#define JACOBI_V_BATCH 16
+
+
+// Exact symmetric eigensolver using parallel cyclic Jacobi sweeps.
+// A is a contiguous row-major n x n matrix and is overwritten (its diagonal
+// holds the eigenvalues on return). V receives the eigenvectors as columns,
+// row-major, so V[i*n + k] is component i of eigenvector k.
+// Each round applies the n/2 disjoint rotations of one round-robin step at
+// once. Every row belongs to exactly one pair, so a thread owning pair (p,q)
+// rotates rows p and q and then applies all of the round's column rotations
+// to those two rows: one pass over A per round. V only ever sees column
+// rotations, so they are replayed JACOBI_V_BATCH rounds at a time while a
+// row of V sits in cache. Convergence is checked once per sweep on the
+// relative off-diagonal norm instead of searching for the max pivot.
+// Returns the number of sweeps performed.
+int eigenDecompositionCyclic(double *A, int n, double *eigenvalues, double *V, double tol, int maxSweeps) {
+    int m = n + (n & 1);
+    int half = m / 2;
+    int *P = malloc(JACOBI_V_BATCH * half * sizeof(int));
+    int *Q = malloc(JACOBI_V_BATCH * half * sizeof(int));
+    double *C = malloc(JACOBI_V_BATCH * half * sizeof(double));
+    double *S = malloc(JACOBI_V_BATCH * half * sizeof(double));
+    int active[JACOBI_V_BATCH];
+    int *rowP = malloc(half * sizeof(int));
+    int *rowQ = malloc(half * sizeof(int));
+    double *rowC = malloc(half * sizeof(double));
+    double *rowS = malloc(half * sizeof(double));
+    int rowPairs = 0;
+    int sweeps = 0;
+    int done = 0;
+    double offNorm = 0.0, fullNorm = 0.0;
+
+    #pragma omp parallel
+    {
+        #pragma omp for
+        for (int i = 0; i < n; ++i) {
+            for (int j = 0; j < n; ++j) {
+                V[(size_t)i * n + j] = (i == j) ? 1.0 : 0.0;
+            }
+        }
+
+        while (!done) {
+            for (int round = 0; round < m - 1; ++round) {
+                int slot = round % JACOBI_V_BATCH;
+                int *p_ = P + slot * half;
+                int *q_ = Q + slot * half;
+                double *c_ = C + slot * half;
+                double *s_ = S + slot * half;
+
+                #pragma omp single
+                {
+                    // Round-robin (Brent-Luk) ordering: slot 0 stays fixed and
+                    // 1..m-1 rotate, so every (p,q) meets once per sweep and a
+                    // round's pairs are disjoint. rowP/rowQ cover every row
+                    // (q < 0 for the odd one out when n is odd); p_/q_ keep
+                    // only the rotations that actually do something.
+                    rowPairs = 0;
+                    active[slot] = 0;
+                    for (int k = 0; k < half; ++k) {
+                        int a = (k == 0) ? 0 : 1 + (round + k - 1) % (m - 1);
+                        int b = 1 + (round + m - 2 - k) % (m - 1);
+                        int p = a < b ? a : b;
+                        int q = a < b ? b : a;
+                        if (q >= n) {
+                            rowP[rowPairs] = p;
+                            rowQ[rowPairs] = -1;
+                            rowC[rowPairs] = 1.0;
+                            rowS[rowPairs] = 0.0;
+                            rowPairs++;
+                            continue;
+                        }
+                        double app = A[(size_t)p * n + p];
+                        double aqq = A[(size_t)q * n + q];
+                        double apq = A[(size_t)p * n + q];
+                        double c = 1.0, sn = 0.0;
+                        // Skip rotations that would not change the matrix in working precision
+                        if (apq != 0.0 && fabs(apq) > DBL_EPSILON * sqrt(fabs(app) * fabs(aqq))) {
+                            double tau = (aqq - app) / (2.0 * apq);
+                            double t = (tau >= 0) ? 1.0 / (tau + sqrt(1.0 + tau * tau)) : -1.0 / (-tau + sqrt(1.0 + tau * tau));
+                            c = 1.0 / sqrt(1.0 + t * t);
+                            sn = c * t;
+                            int k2 = active[slot]++;
+                            p_[k2] = p;
+                            q_[k2] = q;
+                            c_[k2] = c;
+                            s_[k2] = sn;
+                        }
+                        rowP[rowPairs] = p;
+                        rowQ[rowPairs] = q;
+                        rowC[rowPairs] = c;
+                        rowS[rowPairs] = sn;
+                        rowPairs++;
+                    }
+                }
+
+                int nact = active[slot];
+                #pragma omp for schedule(static)
+                for (int k = 0; k < rowPairs; ++k) {
+                    double *rp = A + (size_t)rowP[k] * n;
+                    double *rq = rowQ[k] >= 0 ? A + (size_t)rowQ[k] * n : NULL;
+                    double c = rowC[k], sn = rowS[k];
+                    if (sn != 0.0) {
+                        #pragma omp simd
+                        for (int j = 0; j < n; ++j) {
+                            double x = rp[j], y = rq[j];
+                            rp[j] = c * x - sn * y;
+                            rq[j] = sn * x + c * y;
+                        }
+                    }
+                    for (int a = 0; a < nact; ++a) {
+                        int p = p_[a], q = q_[a];
+                        double ca = c_[a], sa = s_[a];
+                        double x = rp[p], y = rp[q];
+                        rp[p] = ca * x - sa * y;
+                        rp[q] = sa * x + ca * y;
+                        if (rq) {
+                            x = rq[p];
+                            y = rq[q];
+                            rq[p] = ca * x - sa * y;
+                            rq[q] = sa * x + ca * y;
+                        }
+                    }
+                    // The annihilated entry is zero up to rounding; make it exact
+                    if (sn != 0.0) {
+                        rp[rowQ[k]] = 0.0;
+                        rq[rowP[k]] = 0.0;
+                    }
+                }
+
+                if (slot == JACOBI_V_BATCH - 1 || round == m - 2) {
+                    int batch = slot + 1;
+                    #pragma omp for schedule(static)
+                    for (int i = 0; i < n; ++i) {
+                        double *rv = V + (size_t)i * n;
+                        for (int r = 0; r < batch; ++r) {
+                            for (int a = 0; a < active[r]; ++a) {
+                                int p = P[r * half + a], q = Q[r * half + a];
+                                double ca = C[r * half + a], sa = S[r * half + a];
+                                double x = rv[p], y = rv[q];
+                                rv[p] = ca * x - sa * y;
+                                rv[q] = sa * x + ca * y;
+                            }
+                        }
+                    }
+                }
+            }
+
+            #pragma omp single
+            {
+                offNorm = 0.0;
+                fullNorm = 0.0;
+            }
+            #pragma omp for reduction(+:offNorm, fullNorm)
+            for (int i = 0; i < n; ++i) {
+                for (int j = 0; j < n; ++j) {
+                    double a = A[(size_t)i * n + j];
+                    fullNorm += a * a;
+                    if (i != j) {
+                        offNorm += a * a;
+                    }
+                }
+            }
+            #pragma omp single
+            {
+                sweeps++;
+                if (offNorm <= tol * tol * fullNorm || offNorm < EPSILON * EPSILON || sweeps >= maxSweeps) {
+                    done = 1;
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        eigenvalues[i] = A[(size_t)i * n + i];
+    }
+    free(P);
+    free(Q);
+    free(C);
+    free(S);
+    free(rowP);
+    free(rowQ);
+    free(rowC);
+    free(rowS);
+    return sweeps;
+}
+
+
+// Sort eigenpairs by decreasing eigenvalue (columns of row-major V move along)
+void sortEigenPairs(double *eigenvalues, double *V, int n) {
+    int *order = malloc(n * sizeof(int));
+    for (int i = 0; i < n; ++i) {
+        order[i] = i;
+    }
+    for (int i = 1; i < n; ++i) {
+        int key = order[i];
+        int j = i - 1;
+        while (j >= 0 && eigenvalues[order[j]] < eigenvalues[key]) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = key;
+    }
+    double *vals = malloc(n * sizeof(double));
+    for (int k = 0; k < n; ++k) {
+        vals[k] = eigenvalues[order[k]];
+    }
+    for (int k = 0; k < n; ++k) {
+        eigenvalues[k] = vals[k];
+    }
+    #pragma omp parallel for
+    for (int i = 0; i < n; ++i) {
+        double *r = V + (size_t)i * n;
+        double tmp[n];
+        for (int k = 0; k < n; ++k) {
+            tmp[k] = r[order[k]];
+        }
+        for (int k = 0; k < n; ++k) {
+            r[k] = tmp[k];
+        }
+    }
+    free(vals);
+    free(order);
+}
+
+
+// Fitted PCA projection, the dimensionality-reduction stage in front of
+// the GNN layers.
+// in_dim -> width of the raw feature rows.
+// k -> number of retained components (width of the projected rows).
+// mean -> in_dim column means subtracted before projecting.
+// components -> in_dim x k row-major, column c is the c-th principal axis.
+// bias -> k entries, -mean * components, folded into the projection GEMM.
+// explained -> k eigenvalues (variance along each component).
+typedef struct PCAModel {
+    int in_dim;
+    int k;
+    float *mean;
+    float *components;
+    float *bias;
+    double *explained;
+} PCAModel;
+
+
+#define PCA_MAGIC 0x31414350  // "PCA1"
+
+
+void pcaFree(PCAModel *model) {
+    free(model->mean);
+    free(model->components);
+    free(model->bias);
+    free(model->explained);
+}
+
+
+static void pcaComputeBias(PCAModel *model) {
+    for (int c = 0; c < model->k; ++c) {
+        double sum = 0.0;
+        for (int f = 0; f < model->in_dim; ++f) {
+            sum += (double)model->mean[f] * model->components[(size_t)f * model->k + c];
+        }
+        model->bias[c] = (float)-sum;
+    }
+}
+
+
+// Fit a k-component projection on a rows x dim feature matrix. The
+// covariance is streamed over chunkRows-row slices (0 means all at once),
+// then the cyclic Jacobi solver gives the full spectrum and the top k axes
+// are kept. Returns the fraction of total variance retained.
+double pcaFit(PCAModel *model, const float *X, long rows, int dim, int k, long chunkRows) {
+    if (k > dim) {
+        k = dim;
+    }
+    if (chunkRows <= 0) {
+        chunkRows = rows;
+    }
+    CovAccumulator acc;
+    covInit(&acc, dim);
+    for (long r = 0; r < rows; r += chunkRows) {
+        long n = (rows - r < chunkRows) ? rows - r : chunkRows;
+        covAccumulatef(&acc, X + (size_t)r * dim, n);
+    }
+
+    double *cov = malloc((size_t)dim * dim * sizeof(double));
+    double *V = malloc((size_t)dim * dim * sizeof(double));
+    double *eigenvalues = malloc(dim * sizeof(double));
+    covFinalize(&acc, cov);
+    eigenDecompositionCyclic(cov, dim, eigenvalues, V, 1e-10, 30);
+    sortEigenPairs(eigenvalues, V, dim);
+
+    model->in_dim = dim;
+    model->k = k;
+    model->mean = malloc(dim * sizeof(float));
+    model->components = malloc((size_t)dim * k * sizeof(float));
+    model->bias = malloc(k * sizeof(float));
+    model->explained = malloc(k * sizeof(double));
+    for (int f = 0; f < dim; ++f) {
+        model->mean[f] = (float)acc.mean[f];
+        for (int c = 0; c < k; ++c) {
+            model->components[(size_t)f * k + c] = (float)V[(size_t)f * dim + c];
+        }
+    }
+    double total = 0.0, kept = 0.0;
+    for (int c = 0; c < dim; ++c) {
+        double ev = eigenvalues[c] > 0.0 ? eigenvalues[c] : 0.0;
+        total += ev;
+        if (c < k) {
+            kept += ev;
+            model->explained[c] = eigenvalues[c];
+        }
+    }
+    pcaComputeBias(model);
+
+    covFree(&acc);
+    free(cov);
+    free(V);
+    free(eigenvalues);
+    return total > 0.0 ? kept / total : 0.0;
+}
+
+
+// out (rows x k) = (X - mean) * components, as one parallel GEMM
+void pcaProject(const PCAModel *model, const float *X, long rows, float *out) {
+    denseForward(X, model->components, model->bias, out, rows, model->in_dim, model->k);
+}
+
+
+// Binary layout: magic, in_dim, k, mean[in_dim], components[in_dim*k],
+// explained[k]. Returns 0 on success.
+int pcaSave(const PCAModel *model, const char *path) {
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "Error opening %s for writing\n", path);
+        return 1;
+    }
+    int header[3] = {PCA_MAGIC, model->in_dim, model->k};
+    size_t ok = fwrite(header, sizeof(int), 3, file) == 3;
+    ok = ok && fwrite(model->mean, sizeof(float), model->in_dim, file) == (size_t)model->in_dim;
+    ok = ok && fwrite(model->components, sizeof(float), (size_t)model->in_dim * model->k, file) == (size_t)model->in_dim * model->k;
+    ok = ok && fwrite(model->explained, sizeof(double), model->k, file) == (size_t)model->k;
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "Error writing %s\n", path);
+        return 1;
+    }
+    return 0;
+}
+
+
+int pcaLoad(PCAModel *model, const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return 1;
+    }
+    int header[3];
+    if (fread(header, sizeof(int), 3, file) != 3 || header[0] != PCA_MAGIC) {
+        fprintf(stderr, "%s is not a PCA projection file\n", path);
+        fclose(file);
+        return 1;
+    }
+    model->in_dim = header[1];
+    model->k = header[2];
+    model->mean = malloc(model->in_dim * sizeof(float));
+    model->components = malloc((size_t)model->in_dim * model->k * sizeof(float));
+    model->bias = malloc(model->k * sizeof(float));
+    model->explained = malloc(model->k * sizeof(double));
+    size_t ok = fread(model->mean, sizeof(float), model->in_dim, file) == (size_t)model->in_dim;
+    ok = ok && fread(model->components, sizeof(float), (size_t)model->in_dim * model->k, file) == (size_t)model->in_dim * model->k;
+    ok = ok && fread(model->explained, sizeof(double), model->k, file) == (size_t)model->k;
+    fclose(file);
+    if (!ok) {
+        fprintf(stderr, "%s is truncated\n", path);
+        pcaFree(model);
+        return 1;
+    }
+    pcaComputeBias(model);
+    return 0;
+}
+
+
+#endif
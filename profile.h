@@ -0,0 +1,417 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+// Hot-path instrumentation for the training loops.
+// Build with -DGNN_PROFILE to enable it; without that flag every macro below
+// expands to nothing and the instrumented code compiles exactly as before.
+// Add -DGNN_PROFILE_PERF (Linux) to also read cycles, instructions and LLC
+// misses through perf_event_open for every phase.
+//
+//   PROF_INIT()                      once, before the first parallel region
+//   PROF_EPOCH_BEGIN(e) / PROF_EPOCH_END()   prints a per-epoch summary table
+//   PROF_SCOPE(name)                 times the rest of the enclosing block
+//   PROF_SCOPE_LAYER(name, layer)    same, keyed per layer
+//   PROF_THREAD_BEGIN() / PROF_THREAD_END()  inside a parallel region, around
+//                                    a worksharing loop with nowait: records
+//                                    each thread's busy time for the phase
+//   PROF_FINISH(path)                prints totals and writes a Chrome trace
+//                                    (chrome://tracing or ui.perfetto.dev)
+//
+// Scopes are only recorded on the thread that runs the serial code; thread
+// busy time is charged to the innermost open scope, and idle time is that
+// scope's wall time minus the thread's busy time.
+
+#ifdef GNN_PROFILE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#ifdef GNN_PROFILE_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define PROF_MAX_PHASES 64
+#define PROF_MAX_THREADS 256
+#define PROF_MAX_DEPTH 16
+#define PROF_COUNTERS 3
+
+
+// Accumulated statistics of one (name, layer) phase.
+// epoch_* fields are reset at every PROF_EPOCH_END, total_* never.
+typedef struct ProfPhase {
+    const char *name;
+    int layer;
+    long epoch_calls;
+    double epoch_time;
+    double epoch_busy[PROF_MAX_THREADS];
+    unsigned long long epoch_counters[PROF_COUNTERS];
+    long total_calls;
+    double total_time;
+    double total_busy;
+    double total_max_busy;
+    unsigned long long total_counters[PROF_COUNTERS];
+} ProfPhase;
+
+
+// One complete ("ph":"X") event of the Chrome trace
+typedef struct ProfEvent {
+    const char *name;
+    int layer;
+    int tid;
+    double start;
+    double duration;
+} ProfEvent;
+
+
+typedef struct ProfEventBuffer {
+    ProfEvent *events;
+    long count;
+    long cap;
+} ProfEventBuffer;
+
+
+typedef struct ProfScope {
+    int phase;
+    double start;
+    unsigned long long counters[PROF_COUNTERS];
+} ProfScope;
+
+
+typedef struct ProfState {
+    int initialized;
+    int threads;
+    double origin;
+    int epoch;
+    double epoch_start;
+    int n_phases;
+    ProfPhase phases[PROF_MAX_PHASES];
+    int depth;
+    int stack[PROF_MAX_DEPTH];
+    ProfEventBuffer buffers[PROF_MAX_THREADS];
+    int perf_enabled;
+    int perf_fd[PROF_MAX_THREADS][PROF_COUNTERS];
+} ProfState;
+
+ProfState prof_state;
+
+static const char *prof_counter_names[PROF_COUNTERS] = {"cycles", "instr", "llc_miss"};
+
+
+static inline double profNow(void) {
+    return omp_get_wtime() - prof_state.origin;
+}
+
+
+void profRecord(int tid, const char *name, int layer, double start, double duration) {
+    ProfEventBuffer *buf = &prof_state.buffers[tid];
+    if (buf->count == buf->cap) {
+        buf->cap = buf->cap ? 2 * buf->cap : 4096;
+        buf->events = (ProfEvent *)realloc(buf->events, buf->cap * sizeof(ProfEvent));
+    }
+    ProfEvent *ev = &buf->events[buf->count++];
+    ev->name = name;
+    ev->layer = layer;
+    ev->tid = tid;
+    ev->start = start;
+    ev->duration = duration;
+}
+
+
+#ifdef GNN_PROFILE_PERF
+// Each OpenMP thread opens counters on itself; the serial thread later reads
+// all of them, so a phase sees the work of the whole team.
+static void profOpenCounters(void) {
+    static const unsigned long long configs[PROF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES};
+    int failed = 0;
+    #pragma omp parallel num_threads(prof_state.threads) reduction(+:failed)
+    {
+        int tid = omp_get_thread_num();
+        for (int c = 0; c < PROF_COUNTERS; ++c) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = configs[c];
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            int fd = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+            prof_state.perf_fd[tid][c] = fd;
+            failed += (fd < 0);
+        }
+    }
+    prof_state.perf_enabled = (failed == 0);
+    if (!prof_state.perf_enabled) {
+        fprintf(stderr, "profile: perf_event_open unavailable (check perf_event_paranoid), counters disabled\n");
+    }
+}
+#endif
+
+
+static void profReadCounters(unsigned long long *out) {
+    memset(out, 0, PROF_COUNTERS * sizeof(unsigned long long));
+#ifdef GNN_PROFILE_PERF
+    if (!prof_state.perf_enabled) {
+        return;
+    }
+    for (int t = 0; t < prof_state.threads; ++t) {
+        for (int c = 0; c < PROF_COUNTERS; ++c) {
+            unsigned long long value = 0;
+            if (read(prof_state.perf_fd[t][c], &value, sizeof(value)) == (ssize_t)sizeof(value)) {
+                out[c] += value;
+            }
+        }
+    }
+#endif
+}
+
+
+void profInit(void) {
+    memset(&prof_state, 0, sizeof(prof_state));
+    prof_state.initialized = 1;
+    prof_state.threads = omp_get_max_threads();
+    if (prof_state.threads > PROF_MAX_THREADS) {
+        prof_state.threads = PROF_MAX_THREADS;
+    }
+    prof_state.origin = omp_get_wtime();
+#ifdef GNN_PROFILE_PERF
+    profOpenCounters();
+#endif
+}
+
+
+static int profPhase(const char *name, int layer) {
+    for (int p = 0; p < prof_state.n_phases; ++p) {
+        if (prof_state.phases[p].layer == layer && strcmp(prof_state.phases[p].name, name) == 0) {
+            return p;
+        }
+    }
+    if (prof_state.n_phases == PROF_MAX_PHASES) {
+        return -1;
+    }
+    ProfPhase *ph = &prof_state.phases[prof_state.n_phases];
+    memset(ph, 0, sizeof(*ph));
+    ph->name = name;
+    ph->layer = layer;
+    return prof_state.n_phases++;
+}
+
+
+ProfScope profScopeBegin(const char *name, int layer) {
+    ProfScope scope;
+    scope.phase = -1;
+    if (!prof_state.initialized || omp_in_parallel() || prof_state.depth == PROF_MAX_DEPTH) {
+        return scope;
+    }
+    scope.phase = profPhase(name, layer);
+    if (scope.phase < 0) {
+        return scope;
+    }
+    prof_state.stack[prof_state.depth++] = scope.phase;
+    profReadCounters(scope.counters);
+    scope.start = profNow();
+    return scope;
+}
+
+
+void profScopeEnd(ProfScope *scope) {
+    if (scope->phase < 0) {
+        return;
+    }
+    double end = profNow();
+    unsigned long long counters[PROF_COUNTERS];
+    profReadCounters(counters);
+    ProfPhase *ph = &prof_state.phases[scope->phase];
+    ph->epoch_calls++;
+    ph->epoch_time += end - scope->start;
+    for (int c = 0; c < PROF_COUNTERS; ++c) {
+        ph->epoch_counters[c] += counters[c] - scope->counters[c];
+    }
+    prof_state.depth--;
+    profRecord(0, ph->name, ph->layer, scope->start, end - scope->start);
+}
+
+
+// Busy time of the calling thread inside the innermost open scope
+void profThreadBusy(double start) {
+    if (!prof_state.initialized || prof_state.depth == 0) {
+        return;
+    }
+    int tid = omp_get_thread_num();
+    if (tid >= prof_state.threads) {
+        return;
+    }
+    double end = profNow();
+    ProfPhase *ph = &prof_state.phases[prof_state.stack[prof_state.depth - 1]];
+    ph->epoch_busy[tid] += end - start;
+    if (tid != 0) {
+        profRecord(tid, ph->name, ph->layer, start, end - start);
+    }
+}
+
+
+static const char *profLayerName(int layer) {
+    static char buf[16];
+    if (layer < 0) {
+        return "-";
+    }
+    snprintf(buf, sizeof(buf), "%d", layer);
+    return buf;
+}
+
+
+void profEpochBegin(int epoch) {
+    prof_state.epoch = epoch;
+    prof_state.epoch_start = profNow();
+}
+
+
+// Print this epoch's table and fold it into the totals
+void profEpochEnd(void) {
+    double epoch_time = profNow() - prof_state.epoch_start;
+    int threads = prof_state.threads;
+    printf("profile epoch %d: %.3f ms\n", prof_state.epoch, 1e3 * epoch_time);
+    printf("  %-20s %5s %6s %10s %7s %7s %7s", "phase", "layer", "calls", "time(ms)", "%epoch", "busy%", "imbal");
+    if (prof_state.perf_enabled) {
+        printf(" %12s %6s %12s", "cycles", "IPC", "llc_miss");
+    }
+    printf("\n");
+
+    for (int p = 0; p < prof_state.n_phases; ++p) {
+        ProfPhase *ph = &prof_state.phases[p];
+        if (ph->epoch_calls == 0) {
+            continue;
+        }
+        double busy = 0.0, max_busy = 0.0;
+        for (int t = 0; t < threads; ++t) {
+            busy += ph->epoch_busy[t];
+            max_busy = ph->epoch_busy[t] > max_busy ? ph->epoch_busy[t] : max_busy;
+        }
+        printf("  %-20s %5s %6ld %10.3f %6.1f%%", ph->name, profLayerName(ph->layer), ph->epoch_calls, 1e3 * ph->epoch_time,
+               epoch_time > 0.0 ? 100.0 * ph->epoch_time / epoch_time : 0.0);
+        if (busy > 0.0) {
+            // busy% is the share of the team's wall time spent working;
+            // imbal is the slowest thread over the average thread
+            printf(" %6.1f%% %7.2f", 100.0 * busy / (threads * ph->epoch_time), max_busy / (busy / threads));
+        } else {
+            printf(" %7s %7s", "-", "-");
+        }
+        if (prof_state.perf_enabled) {
+            unsigned long long *cnt = ph->epoch_counters;
+            printf(" %12llu %6.2f %12llu", cnt[0], cnt[0] ? (double)cnt[1] / cnt[0] : 0.0, cnt[2]);
+        }
+        printf("\n");
+
+        ph->total_calls += ph->epoch_calls;
+        ph->total_time += ph->epoch_time;
+        ph->total_busy += busy;
+        ph->total_max_busy += max_busy;
+        for (int c = 0; c < PROF_COUNTERS; ++c) {
+            ph->total_counters[c] += ph->epoch_counters[c];
+        }
+        ph->epoch_calls = 0;
+        ph->epoch_time = 0.0;
+        memset(ph->epoch_busy, 0, sizeof(ph->epoch_busy));
+        memset(ph->epoch_counters, 0, sizeof(ph->epoch_counters));
+    }
+    profRecord(0, "epoch", prof_state.epoch, prof_state.epoch_start, epoch_time);
+}
+
+
+static void profWriteTrace(const char *path) {
+    FILE *file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "profile: error opening %s for writing\n", path);
+        return;
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    int first = 1;
+    for (int t = 0; t < prof_state.threads; ++t) {
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"omp %d\"}}",
+                first ? "" : ",\n", t, t);
+        first = 0;
+        ProfEventBuffer *buf = &prof_state.buffers[t];
+        for (long e = 0; e < buf->count; ++e) {
+            ProfEvent *ev = &buf->events[e];
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                          "\"args\": {\"layer\": %d}}",
+                    ev->name, ev->tid, 1e6 * ev->start, 1e6 * ev->duration, ev->layer);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+
+void profFinish(const char *trace_path) {
+    printf("profile totals:\n");
+    printf("  %-20s %5s %6s %10s %7s %7s", "phase", "layer", "calls", "time(ms)", "busy%", "imbal");
+    for (int c = 0; c < PROF_COUNTERS && prof_state.perf_enabled; ++c) {
+        printf(" %12s", prof_counter_names[c]);
+    }
+    printf("\n");
+    for (int p = 0; p < prof_state.n_phases; ++p) {
+        ProfPhase *ph = &prof_state.phases[p];
+        if (ph->total_calls == 0) {
+            continue;
+        }
+        printf("  %-20s %5s %6ld %10.3f", ph->name, profLayerName(ph->layer), ph->total_calls, 1e3 * ph->total_time);
+        if (ph->total_busy > 0.0) {
+            printf(" %6.1f%% %7.2f", 100.0 * ph->total_busy / (prof_state.threads * ph->total_time),
+                   ph->total_max_busy / (ph->total_busy / prof_state.threads));
+        } else {
+            printf(" %7s %7s", "-", "-");
+        }
+        for (int c = 0; c < PROF_COUNTERS && prof_state.perf_enabled; ++c) {
+            printf(" %12llu", ph->total_counters[c]);
+        }
+        printf("\n");
+    }
+    if (trace_path) {
+        profWriteTrace(trace_path);
+    }
+    for (int t = 0; t < PROF_MAX_THREADS; ++t) {
+        free(prof_state.buffers[t].events);
+    }
+#ifdef GNN_PROFILE_PERF
+    for (int t = 0; t < prof_state.threads && prof_state.perf_enabled; ++t) {
+        for (int c = 0; c < PROF_COUNTERS; ++c) {
+            close(prof_state.perf_fd[t][c]);
+        }
+    }
+#endif
+    prof_state.initialized = 0;
+}
+
+
+#define PROF_CONCAT_(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT_(a, b)
+
+#define PROF_INIT() profInit()
+#define PROF_SCOPE_LAYER(name, layer) \
+    ProfScope PROF_CONCAT(prof_scope_, __LINE__) __attribute__((cleanup(profScopeEnd))) = profScopeBegin(name, layer)
+#define PROF_SCOPE(name) PROF_SCOPE_LAYER(name, -1)
+#define PROF_THREAD_BEGIN() double prof_thread_start_ = profNow()
+#define PROF_THREAD_END() profThreadBusy(prof_thread_start_)
+#define PROF_EPOCH_BEGIN(epoch) profEpochBegin(epoch)
+#define PROF_EPOCH_END() profEpochEnd()
+#define PROF_FINISH(path) profFinish(path)
+
+#else
+
+#define PROF_INIT() ((void)0)
+#define PROF_SCOPE_LAYER(name, layer) ((void)0)
+#define PROF_SCOPE(name) ((void)0)
+#define PROF_THREAD_BEGIN() ((void)0)
+#define PROF_THREAD_END() ((void)0)
+#define PROF_EPOCH_BEGIN(epoch) ((void)0)
+#define PROF_EPOCH_END() ((void)0)
+#define PROF_FINISH(path) ((void)0)
+
+#endif
+
+#endif
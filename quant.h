@@ -0,0 +1,594 @@
+#ifndef QUANT_H
+#define QUANT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <omp.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+#include "graph.h"
+#include "gcn.h"
+#include "checkpoint.h"
+
+// Post-training int8 quantization for inference.
+// Values are stored as q = round(x / scale) clamped to [-127, 127], with the
+// scale either per row (absmax of the row, computed when the row is stored)
+// or per channel (fixed ahead of time by calibration). -128 is never used,
+// so the AVX2 sign trick below cannot overflow.
+//
+// With per-channel scales every row of a channel shares its scale, so
+// neighbor rows are summed exactly in int32 and scaled once per output row.
+// With per-row scales each gathered row is scaled as it is added. Either
+// way a gathered PubMed row is 500 bytes instead of 2000.
+//
+// quantDot is the int8 dot product (int32 result) behind denseForwardInt8:
+// AVX-VNNI / AVX512-VNNI vpdpbusd, AVX2 vpmaddubsw + vpmaddwd, or a plain
+// loop, picked at compile time by the -m flags.
+
+#define QUANT_PER_ROW 0
+#define QUANT_PER_CHANNEL 1
+#define QUANT_MAX 127
+
+
+// n_rows x dim int8 values.
+// scale, inv -> n_rows scales (per row; inv unused) or dim scales and their
+//               reciprocals (per channel).
+typedef struct QuantRows {
+    long n_rows;
+    int dim;
+    int mode;
+    int8_t *q;
+    float *scale;
+    float *inv;
+} QuantRows;
+
+
+const char *quantModeName(int mode) {
+    return mode == QUANT_PER_CHANNEL ? "channel" : "row";
+}
+
+
+void quantRowsInit(QuantRows *qr, long n_rows, int dim, int mode) {
+    qr->n_rows = n_rows;
+    qr->dim = dim;
+    qr->mode = mode;
+    qr->q = (int8_t *)malloc((n_rows ? n_rows : 1) * (size_t)dim);
+    long scales = mode == QUANT_PER_CHANNEL ? dim : n_rows;
+    qr->scale = (float *)malloc((scales ? scales : 1) * sizeof(float));
+    qr->inv = mode == QUANT_PER_CHANNEL ? (float *)malloc(dim * sizeof(float)) : NULL;
+}
+
+
+void quantRowsFree(QuantRows *qr) {
+    free(qr->q);
+    free(qr->scale);
+    free(qr->inv);
+}
+
+
+size_t quantRowsBytes(const QuantRows *qr) {
+    long scales = qr->mode == QUANT_PER_CHANNEL ? qr->dim : qr->n_rows;
+    return (size_t)qr->n_rows * qr->dim + scales * sizeof(float);
+}
+
+
+// Per-channel mode: use these dim scales for every row stored from now on
+void quantRowsSetScale(QuantRows *qr, const float *scale) {
+    for (int j = 0; j < qr->dim; ++j) {
+        qr->scale[j] = scale[j];
+        qr->inv[j] = 1.0f / scale[j];
+    }
+}
+
+
+// Round half away from zero after clamping; plain arithmetic so the row
+// loops vectorize
+static inline int8_t quantClamp(float v) {
+    v = v > QUANT_MAX ? QUANT_MAX : (v < -QUANT_MAX ? -QUANT_MAX : v);
+    return (int8_t)(int)(v + (v >= 0.0f ? 0.5f : -0.5f));
+}
+
+
+// Scale that maps absmax to QUANT_MAX (1 for an all-zero range)
+static inline float quantScale(float absmax) {
+    return absmax > 0.0f ? absmax / QUANT_MAX : 1.0f;
+}
+
+
+// Store row i of qr from dim floats
+void quantizeRow(QuantRows *qr, long i, const float *x) {
+    int dim = qr->dim;
+    int8_t *q = qr->q + (size_t)i * dim;
+    if (qr->mode == QUANT_PER_CHANNEL) {
+        const float *inv = qr->inv;
+        #pragma omp simd
+        for (int j = 0; j < dim; ++j) {
+            q[j] = quantClamp(x[j] * inv[j]);
+        }
+        return;
+    }
+    float m = 0.0f;
+    for (int j = 0; j < dim; ++j) {
+        float a = fabsf(x[j]);
+        m = a > m ? a : m;
+    }
+    float s = quantScale(m);
+    float inv = 1.0f / s;
+    qr->scale[i] = s;
+    #pragma omp simd
+    for (int j = 0; j < dim; ++j) {
+        q[j] = quantClamp(x[j] * inv);
+    }
+}
+
+
+// Store all n_rows rows of X (n_rows x dim)
+void quantizeRows(QuantRows *qr, const float *X) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < qr->n_rows; ++i) {
+        quantizeRow(qr, i, X + (size_t)i * qr->dim);
+    }
+}
+
+
+void dequantizeRow(const QuantRows *qr, long i, float *x) {
+    const int8_t *q = qr->q + (size_t)i * qr->dim;
+    for (int j = 0; j < qr->dim; ++j) {
+        x[j] = (float)q[j] * (qr->mode == QUANT_PER_CHANNEL ? qr->scale[j] : qr->scale[i]);
+    }
+}
+
+
+static int quantCompareFloat(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+
+// Per-channel scales of X (n x dim) over the listed rows (all rows when rows
+// is NULL). percentile < 100 clips each channel at that percentile of |x|
+// instead of its maximum, trading a few saturated outliers for resolution.
+void quantChannelScales(const float *X, int dim, const int *rows, long count, double percentile, float *scale) {
+    #pragma omp parallel
+    {
+        float *column = percentile < 100.0 ? (float *)malloc((count ? count : 1) * sizeof(float)) : NULL;
+        #pragma omp for schedule(static)
+        for (int j = 0; j < dim; ++j) {
+            float m = 0.0f;
+            for (long r = 0; r < count; ++r) {
+                float a = fabsf(X[(size_t)(rows ? rows[r] : r) * dim + j]);
+                m = a > m ? a : m;
+                if (column) {
+                    column[r] = a;
+                }
+            }
+            if (column && count > 0) {
+                qsort(column, count, sizeof(float), quantCompareFloat);
+                long k = (long)ceil(percentile / 100.0 * count) - 1;
+                m = column[k < 0 ? 0 : k];
+            }
+            scale[j] = quantScale(m);
+        }
+        free(column);
+    }
+}
+
+
+// sum a[k] * b[k] over n int8 entries in [-127, 127]
+int32_t quantDot(const int8_t *a, const int8_t *b, int n) {
+    int k = 0;
+    int32_t sum = 0;
+#if defined(__AVX2__)
+    // The byte multiplies take an unsigned operand: use |a| and b * sign(a)
+    __m256i acc = _mm256_setzero_si256();
+#if !defined(__AVXVNNI__) && !(defined(__AVX512VNNI__) && defined(__AVX512VL__))
+    const __m256i ones = _mm256_set1_epi16(1);
+#endif
+    for (; k + 32 <= n; k += 32) {
+        __m256i va = _mm256_loadu_si256((const __m256i *)(a + k));
+        __m256i vb = _mm256_loadu_si256((const __m256i *)(b + k));
+        __m256i ua = _mm256_sign_epi8(va, va);
+        __m256i sb = _mm256_sign_epi8(vb, va);
+#if defined(__AVX512VNNI__) && defined(__AVX512VL__)
+        acc = _mm256_dpbusd_epi32(acc, ua, sb);
+#elif defined(__AVXVNNI__)
+        acc = _mm256_dpbusd_avx_epi32(acc, ua, sb);
+#else
+        // Pairs of products fit in int16: 2 * 127 * 127 < 32767
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(ua, sb), ones));
+#endif
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    sum = _mm_cvtsi128_si32(half);
+#endif
+    for (; k < n; ++k) {
+        sum += (int32_t)a[k] * b[k];
+    }
+    return sum;
+}
+
+
+// Weights of a dense layer (B is K x N, row-major) quantized per output
+// column and stored transposed, so each output is a quantDot of two rows.
+// Bt is N x K, scale has N entries.
+void quantizeWeightColumns(const float *B, int K, int N, int8_t *Bt, float *scale) {
+    #pragma omp parallel for schedule(static)
+    for (int j = 0; j < N; ++j) {
+        float m = 0.0f;
+        for (int k = 0; k < K; ++k) {
+            float a = fabsf(B[(size_t)k * N + j]);
+            m = a > m ? a : m;
+        }
+        scale[j] = quantScale(m);
+        float inv = 1.0f / scale[j];
+        for (int k = 0; k < K; ++k) {
+            Bt[(size_t)j * K + k] = quantClamp(B[(size_t)k * N + j] * inv);
+        }
+    }
+}
+
+
+// C = A * B (+ bias) with A quantized per row (M x K) and B given by
+// quantizeWeightColumns; int32 dot products, one float scale per output.
+void denseForwardInt8(const QuantRows *A, const int8_t *Bt, const float *b_scale, const float *bias, float *C,
+                      int N) {
+    int K = A->dim;
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < A->n_rows; ++i) {
+        const int8_t *ai = A->q + (size_t)i * K;
+        float *ci = C + (size_t)i * N;
+        float s = A->scale[i];
+        for (int j = 0; j < N; ++j) {
+            ci[j] = (float)quantDot(ai, Bt + (size_t)j * K, K) * (s * b_scale[j]) + (bias ? bias[j] : 0.0f);
+        }
+    }
+}
+
+
+// aggregateSum over int8 rows. Per-channel rows of an unweighted graph are
+// summed in int32 and scaled once; otherwise every row is scaled as it is
+// gathered.
+void aggregateSumInt8(const CSRGraph *g, const QuantRows *X, float *Y) {
+    int dim = X->dim;
+    int exact = X->mode == QUANT_PER_CHANNEL && g->values == NULL;
+    #pragma omp parallel
+    {
+        int32_t *acc = (int32_t *)malloc(dim * sizeof(int32_t));
+        #pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < g->n_nodes; ++i) {
+            float *yi = Y + (size_t)i * dim;
+            if (exact) {
+                memset(acc, 0, dim * sizeof(int32_t));
+            } else {
+                memset(yi, 0, dim * sizeof(float));
+            }
+            for (long e = g->offsets[i]; e < g->offsets[i + 1]; ++e) {
+                int u = g->indices[e];
+                const int8_t *xu = X->q + (size_t)u * dim;
+                if (exact) {
+                    #pragma omp simd
+                    for (int f = 0; f < dim; ++f) {
+                        acc[f] += xu[f];
+                    }
+                    continue;
+                }
+                float w = g->values ? g->values[e] : 1.0f;
+                if (X->mode == QUANT_PER_CHANNEL) {
+                    #pragma omp simd
+                    for (int f = 0; f < dim; ++f) {
+                        yi[f] += w * X->scale[f] * (float)xu[f];
+                    }
+                } else {
+                    float s = w * X->scale[u];
+                    #pragma omp simd
+                    for (int f = 0; f < dim; ++f) {
+                        yi[f] += s * (float)xu[f];
+                    }
+                }
+            }
+            if (exact) {
+                #pragma omp simd
+                for (int f = 0; f < dim; ++f) {
+                    yi[f] = (float)acc[f] * X->scale[f];
+                }
+            }
+        }
+        free(acc);
+    }
+}
+
+
+// Int8 copy of a GCNModel.
+// weight, wscale -> layer weights quantized with one scale per layer.
+// act_scale -> per-channel scales of each layer's input (per-channel mode
+//              only; act_scale[0] is for the node features).
+// mul -> act_scale[l][j] * wscale[l] (just wscale[l] per row), so an output
+//        is acc[j] * weight[j] * mul[j] + bias.
+// norm, self_loops -> as in GCNModel.
+typedef struct GCNQuant {
+    int n_layers;
+    int dim;
+    int mode;
+    int norm;
+    int self_loops;
+    int8_t *weight[GCN_MAX_LAYERS];
+    float wscale[GCN_MAX_LAYERS];
+    float bias[GCN_MAX_LAYERS];
+    float *act_scale[GCN_MAX_LAYERS];
+    float *mul[GCN_MAX_LAYERS];
+} GCNQuant;
+
+
+void gcnQuantFree(GCNQuant *qm) {
+    for (int l = 0; l < qm->n_layers; ++l) {
+        free(qm->weight[l]);
+        free(qm->act_scale[l]);
+        free(qm->mul[l]);
+    }
+    qm->n_layers = 0;
+}
+
+
+static void gcnQuantFinish(GCNQuant *qm) {
+    for (int l = 0; l < qm->n_layers; ++l) {
+        qm->mul[l] = (float *)malloc(qm->dim * sizeof(float));
+        for (int j = 0; j < qm->dim; ++j) {
+            qm->mul[l][j] = qm->wscale[l] * (qm->act_scale[l] ? qm->act_scale[l][j] : 1.0f);
+        }
+    }
+}
+
+
+// act_scale (per-channel mode) -> n_layers arrays of dim scales from
+// gcnCalibrate; ignored per row
+void gcnQuantize(GCNQuant *qm, const GCNModel *model, int mode, float *const *act_scale) {
+    memset(qm, 0, sizeof(*qm));
+    qm->n_layers = model->n_layers;
+    qm->dim = model->dim;
+    qm->mode = mode;
+    qm->norm = model->norm;
+    qm->self_loops = model->self_loops;
+    int dim = model->dim;
+    for (int l = 0; l < model->n_layers; ++l) {
+        float m = 0.0f;
+        for (int j = 0; j < dim; ++j) {
+            float a = fabsf(model->weight[l][j]);
+            m = a > m ? a : m;
+        }
+        qm->wscale[l] = quantScale(m);
+        qm->weight[l] = (int8_t *)malloc(dim);
+        for (int j = 0; j < dim; ++j) {
+            qm->weight[l][j] = quantClamp(model->weight[l][j] / qm->wscale[l]);
+        }
+        qm->bias[l] = model->bias[l];
+        if (mode == QUANT_PER_CHANNEL) {
+            qm->act_scale[l] = (float *)malloc(dim * sizeof(float));
+            memcpy(qm->act_scale[l], act_scale[l], dim * sizeof(float));
+        }
+    }
+    gcnQuantFinish(qm);
+}
+
+
+// Per-channel input scales of every layer (scale[l] holds dim entries),
+// taken from a float forward pass over the whole graph but measured only on
+// the calibration rows.
+void gcnCalibrate(const GCNModel *model, const CSRGraph *g, const int *labels, const float *X, const int *rows,
+                  long count, double percentile, float **scale) {
+    size_t size = (size_t)g->n_nodes * model->dim;
+    float *buf = (float *)malloc(2 * size * sizeof(float));
+    const float *in = X;
+    for (int l = 0; l < model->n_layers; ++l) {
+        quantChannelScales(in, model->dim, rows, count, percentile, scale[l]);
+        if (l + 1 < model->n_layers) {
+            gcnLayerRows(model, l, g, labels, in, buf + (l & 1) * size, NULL, g->n_nodes);
+            in = buf + (l & 1) * size;
+        }
+    }
+    free(buf);
+}
+
+
+// Quantized model file, in the checkpoint container:
+//   quant.meta         I64 [n_layers, dim, mode, norm, self_loops]
+//   layer%d.qweight    I8  [dim]
+//   layer%d.wscale     F32 [1]
+//   layer%d.bias       F32 [1]
+//   layer%d.act_scale  F32 [dim] (per channel only)
+int gcnQuantSave(const GCNQuant *qm, const char *path) {
+    char name[CKPT_NAME_LEN];
+    long meta[5] = {qm->n_layers, qm->dim, qm->mode, qm->norm, qm->self_loops};
+    Checkpoint ckpt;
+    ckptInit(&ckpt, 0, 0);
+    ckptAdd1(&ckpt, "quant.meta", CKPT_I64, 5, meta);
+    for (int l = 0; l < qm->n_layers; ++l) {
+        snprintf(name, sizeof(name), "layer%d.qweight", l);
+        ckptAdd1(&ckpt, name, CKPT_I8, qm->dim, qm->weight[l]);
+        snprintf(name, sizeof(name), "layer%d.wscale", l);
+        ckptAdd1(&ckpt, name, CKPT_F32, 1, &qm->wscale[l]);
+        snprintf(name, sizeof(name), "layer%d.bias", l);
+        ckptAdd1(&ckpt, name, CKPT_F32, 1, &qm->bias[l]);
+        if (qm->act_scale[l]) {
+            snprintf(name, sizeof(name), "layer%d.act_scale", l);
+            ckptAdd1(&ckpt, name, CKPT_F32, qm->dim, qm->act_scale[l]);
+        }
+    }
+    return ckptWrite(&ckpt, path);
+}
+
+
+// Returns 0 on success. A 3-entry quant.meta predates norm (raw sum).
+int gcnQuantLoad(GCNQuant *qm, const char *path) {
+    CkptMap map;
+    if (ckptOpen(&map, path) != 0) {
+        return 1;
+    }
+    memset(qm, 0, sizeof(*qm));
+    const CkptEntry *entry = ckptFind(&map, "quant.meta");
+    long n_meta = entry && entry->ndim == 1 && entry->shape[0] == 5 ? 5 : 3;
+    const long *meta = (const long *)ckptTensor(&map, "quant.meta", CKPT_I64, n_meta);
+    if (!meta || meta[0] < 1 || meta[0] > GCN_MAX_LAYERS || ckptVerify(&map) != 0 ||
+        (n_meta == 5 && (meta[3] < GRAPH_NORM_NONE || meta[3] > GRAPH_NORM_MEAN))) {
+        fprintf(stderr, "%s: not a quantized GCN\n", path);
+        ckptClose(&map);
+        return 1;
+    }
+    int dim = (int)meta[1];
+    qm->dim = dim;
+    qm->mode = (int)meta[2];
+    qm->norm = n_meta == 5 ? (int)meta[3] : GRAPH_NORM_NONE;
+    qm->self_loops = n_meta == 5 ? (int)meta[4] : 0;
+    char name[CKPT_NAME_LEN];
+    for (int l = 0; l < meta[0]; ++l) {
+        snprintf(name, sizeof(name), "layer%d.qweight", l);
+        const int8_t *w = (const int8_t *)ckptTensor(&map, name, CKPT_I8, dim);
+        snprintf(name, sizeof(name), "layer%d.wscale", l);
+        const float *ws = (const float *)ckptTensor(&map, name, CKPT_F32, 1);
+        snprintf(name, sizeof(name), "layer%d.bias", l);
+        const float *b = (const float *)ckptTensor(&map, name, CKPT_F32, 1);
+        snprintf(name, sizeof(name), "layer%d.act_scale", l);
+        const float *as = qm->mode == QUANT_PER_CHANNEL ? (const float *)ckptTensor(&map, name, CKPT_F32, dim) : NULL;
+        if (!w || !ws || !b || (qm->mode == QUANT_PER_CHANNEL && !as)) {
+            fprintf(stderr, "%s: layer %d is malformed\n", path, l);
+            gcnQuantFree(qm);
+            ckptClose(&map);
+            return 1;
+        }
+        qm->weight[l] = (int8_t *)malloc(dim);
+        memcpy(qm->weight[l], w, dim);
+        qm->wscale[l] = ws[0];
+        qm->bias[l] = b[0];
+        if (as) {
+            qm->act_scale[l] = (float *)malloc(dim * sizeof(float));
+            memcpy(qm->act_scale[l], as, dim * sizeof(float));
+        }
+        qm->n_layers++;
+    }
+    ckptClose(&map);
+    gcnQuantFinish(qm);
+    return 0;
+}
+
+
+// Rows ready to feed layer l (l = 0 for the node features), scales included
+void gcnQuantInput(const GCNQuant *qm, int l, QuantRows *qr, long n_rows) {
+    quantRowsInit(qr, n_rows, qm->dim, qm->mode);
+    if (qm->mode == QUANT_PER_CHANNEL) {
+        quantRowsSetScale(qr, qm->act_scale[l]);
+    }
+}
+
+
+// gcnLayerRows on int8 rows: layer l reads in and stores its listed output
+// rows into out (requantized for layer l + 1), or as floats into out_f when
+// out_f != NULL (the last layer). A normalized model weights each gathered
+// row by its edge value, so its sums are taken in float.
+void gcnQuantLayerRows(const GCNQuant *qm, int l, const CSRGraph *g, const int *labels, const QuantRows *in,
+                       QuantRows *out, float *out_f, const int *rows, int count) {
+    int dim = qm->dim;
+    const int8_t *w = qm->weight[l];
+    const float *mul = qm->mul[l];
+    float b = qm->bias[l];
+    int cap = gcnNeighborCap(qm->norm);
+    const float *a = qm->norm == GRAPH_NORM_NONE ? NULL : g->values;
+    int exact = in->mode == QUANT_PER_CHANNEL && a == NULL;
+
+    // The cap keeps per-channel sums exact in int16 (50 * 127 < 32767), which
+    // packs twice the lanes of int32 or float into each add
+    #pragma omp parallel if (count > 64)
+    {
+        int16_t *acc = (int16_t *)malloc(dim * sizeof(int16_t));
+        float *row = (float *)malloc(dim * sizeof(float));
+        #pragma omp for schedule(dynamic, 16)
+        for (int r = 0; r < count; ++r) {
+            int i = rows ? rows[r] : r;
+            if (exact) {
+                memset(acc, 0, dim * sizeof(int16_t));
+            } else {
+                memset(row, 0, dim * sizeof(float));
+            }
+            int cnt = 0;
+            for (long e = g->offsets[i]; e < g->offsets[i + 1] && cnt < cap; ++e) {
+                int u = g->indices[e];
+                if (labels && labels[u] != labels[i]) {
+                    continue;
+                }
+                cnt++;
+                const int8_t *h = in->q + (size_t)u * dim;
+                if (exact) {
+                    #pragma omp simd
+                    for (int j = 0; j < dim; ++j) {
+                        acc[j] = (int16_t)(acc[j] + h[j]);
+                    }
+                } else {
+                    // Per channel, mul applies the scales after the sum
+                    float s = (a ? a[e] : 1.0f) * (in->mode == QUANT_PER_CHANNEL ? 1.0f : in->scale[u]);
+                    #pragma omp simd
+                    for (int j = 0; j < dim; ++j) {
+                        row[j] += s * (float)h[j];
+                    }
+                }
+            }
+            float *o = out_f ? out_f + (size_t)i * dim : row;
+            if (exact) {
+                #pragma omp simd
+                for (int j = 0; j < dim; ++j) {
+                    float v = (float)((int32_t)acc[j] * w[j]) * mul[j] + b;
+                    o[j] = v > 0 ? v : 0;
+                }
+            } else {
+                #pragma omp simd
+                for (int j = 0; j < dim; ++j) {
+                    float v = row[j] * (float)w[j] * mul[j] + b;
+                    o[j] = v > 0 ? v : 0;
+                }
+            }
+            if (!out_f) {
+                quantizeRow(out, i, row);
+            }
+        }
+        free(acc);
+        free(row);
+    }
+}
+
+
+// Layers 0 .. n_layers-1 over the listed rows of each level (f == NULL: all
+// rows). act holds two row sets from gcnQuantInput sized for every node;
+// their channel scales are switched per layer. The last layer writes floats
+// to out (n_nodes x dim).
+static void gcnQuantRun(const GCNQuant *qm, const GCNFrontier *f, const CSRGraph *g, const int *labels,
+                        const QuantRows *X, QuantRows *act, float *out) {
+    const QuantRows *in = X;
+    for (int l = 0; l < qm->n_layers; ++l) {
+        int last = l + 1 == qm->n_layers;
+        QuantRows *next = &act[l & 1];
+        if (!last && qm->mode == QUANT_PER_CHANNEL) {
+            quantRowsSetScale(next, qm->act_scale[l + 1]);
+        }
+        gcnQuantLayerRows(qm, l, g, labels, in, last ? NULL : next, last ? out : NULL,
+                          f ? f->rows[l + 1] : NULL, f ? f->count[l + 1] : g->n_nodes);
+        in = next;
+    }
+}
+
+
+void gcnQuantForward(const GCNQuant *qm, const CSRGraph *g, const int *labels, const QuantRows *X,
+                     QuantRows *act, float *out) {
+    gcnQuantRun(qm, NULL, g, labels, X, act, out);
+}
+
+
+// gcnForwardFrontier on int8 rows; only the rows of the batch are valid in out
+void gcnQuantForwardFrontier(const GCNQuant *qm, const GCNFrontier *f, const CSRGraph *g, const int *labels,
+                             const QuantRows *X, QuantRows *act, float *out) {
+    gcnQuantRun(qm, f, g, labels, X, act, out);
+}
+
+#endif
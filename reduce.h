@@ -0,0 +1,161 @@
+#ifndef REDUCE_H
+#define REDUCE_H
+
+#include <stdlib.h>
+#include <omp.h>
+
+// Sums whose value does not depend on the thread count.
+// The input is cut into leaf blocks of REDUCE_BLOCK elements. Each leaf is
+// summed into REDUCE_LANES double accumulators (element k goes to lane
+// k % REDUCE_LANES, so the vectorized loop adds in a fixed order) and the
+// lanes are added pairwise. The leaf sums are then added in a pairwise tree
+// over the block index. Threads only decide who computes which leaf, never
+// the order of the additions, so results are bit-identical for any number
+// of threads, and the error grows with log(n) instead of n.
+//
+// Losses and metrics that are not a plain sum write one term per row (each
+// row summed by one thread with the lane helpers) and reduce the rows.
+
+#define REDUCE_BLOCK 2048
+#define REDUCE_LANES 8
+
+
+// Pairwise sum of `count` partials, overwriting them
+double reducePairwise(double *partial, long count) {
+    if (count == 0) {
+        return 0.0;
+    }
+    for (long stride = 1; stride < count; stride *= 2) {
+        for (long i = 0; i + stride < count; i += 2 * stride) {
+            partial[i] += partial[i + stride];
+        }
+    }
+    return partial[0];
+}
+
+
+// Pairwise sum of `count` vectors of `width` doubles (row-major), left in
+// the first one. Used for gradients accumulated per fixed row block.
+void reducePairwiseRows(double *partial, long count, long width) {
+    for (long stride = 1; stride < count; stride *= 2) {
+        #pragma omp parallel for schedule(static)
+        for (long e = 0; e < width; ++e) {
+            for (long i = 0; i + stride < count; i += 2 * stride) {
+                partial[i * width + e] += partial[(i + stride) * width + e];
+            }
+        }
+    }
+}
+
+
+static inline double reduceLanes(double *lane) {
+    return ((lane[0] + lane[1]) + (lane[2] + lane[3])) + ((lane[4] + lane[5]) + (lane[6] + lane[7]));
+}
+
+
+// Fixed-shape sum of x[0..n) on the calling thread
+static inline double reduceLeaf(const double *x, long n) {
+    double lane[REDUCE_LANES] = {0.0};
+    long k = 0;
+    for (; k + REDUCE_LANES <= n; k += REDUCE_LANES) {
+        #pragma omp simd
+        for (int l = 0; l < REDUCE_LANES; ++l) {
+            lane[l] += x[k + l];
+        }
+    }
+    for (; k < n; ++k) {
+        lane[k % REDUCE_LANES] += x[k];
+    }
+    return reduceLanes(lane);
+}
+
+
+static inline double reduceLeafFloat(const float *x, long n) {
+    double lane[REDUCE_LANES] = {0.0};
+    long k = 0;
+    for (; k + REDUCE_LANES <= n; k += REDUCE_LANES) {
+        #pragma omp simd
+        for (int l = 0; l < REDUCE_LANES; ++l) {
+            lane[l] += x[k + l];
+        }
+    }
+    for (; k < n; ++k) {
+        lane[k % REDUCE_LANES] += x[k];
+    }
+    return reduceLanes(lane);
+}
+
+
+// Fixed-shape sum of (x[k] - y)^2 on the calling thread (one row's error
+// against its target)
+static inline double reduceSquaredDiff(const double *x, double y, long n) {
+    double lane[REDUCE_LANES] = {0.0};
+    long k = 0;
+    for (; k + REDUCE_LANES <= n; k += REDUCE_LANES) {
+        #pragma omp simd
+        for (int l = 0; l < REDUCE_LANES; ++l) {
+            double d = x[k + l] - y;
+            lane[l] += d * d;
+        }
+    }
+    for (; k < n; ++k) {
+        double d = x[k] - y;
+        lane[k % REDUCE_LANES] += d * d;
+    }
+    return reduceLanes(lane);
+}
+
+
+static inline double reduceSquaredDiffFloat(const float *x, double y, long n) {
+    double lane[REDUCE_LANES] = {0.0};
+    long k = 0;
+    for (; k + REDUCE_LANES <= n; k += REDUCE_LANES) {
+        #pragma omp simd
+        for (int l = 0; l < REDUCE_LANES; ++l) {
+            double d = (double)x[k + l] - y;
+            lane[l] += d * d;
+        }
+    }
+    for (; k < n; ++k) {
+        double d = (double)x[k] - y;
+        lane[k % REDUCE_LANES] += d * d;
+    }
+    return reduceLanes(lane);
+}
+
+
+// Sum of x[0..n), leaves in parallel
+double reduceSum(const double *x, long n) {
+    long blocks = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    if (blocks <= 1) {
+        return reduceLeaf(x, n);
+    }
+    double *partial = (double *)malloc(blocks * sizeof(double));
+    #pragma omp parallel for schedule(static)
+    for (long b = 0; b < blocks; ++b) {
+        long lo = b * REDUCE_BLOCK, hi = lo + REDUCE_BLOCK < n ? lo + REDUCE_BLOCK : n;
+        partial[b] = reduceLeaf(x + lo, hi - lo);
+    }
+    double sum = reducePairwise(partial, blocks);
+    free(partial);
+    return sum;
+}
+
+
+double reduceSumFloat(const float *x, long n) {
+    long blocks = (n + REDUCE_BLOCK - 1) / REDUCE_BLOCK;
+    if (blocks <= 1) {
+        return reduceLeafFloat(x, n);
+    }
+    double *partial = (double *)malloc(blocks * sizeof(double));
+    #pragma omp parallel for schedule(static)
+    for (long b = 0; b < blocks; ++b) {
+        long lo = b * REDUCE_BLOCK, hi = lo + REDUCE_BLOCK < n ? lo + REDUCE_BLOCK : n;
+        partial[b] = reduceLeafFloat(x + lo, hi - lo);
+    }
+    double sum = reducePairwise(partial, blocks);
+    free(partial);
+    return sum;
+}
+
+#endif
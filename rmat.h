@@ -0,0 +1,116 @@
+#ifndef RMAT_H
+#define RMAT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+#include "rng.h"
+#include "graph.h"
+
+// Reproducible synthetic graphs for benchmarking. Every edge is drawn from
+// its own counter in the seed's stream, so the same (seed, parameters) give
+// the same graph for any thread count.
+
+
+// R-MAT / Kronecker generator parameters.
+// a, b, c, d -> quadrant probabilities (a + b + c + d = 1); a larger a gives a
+//               more skewed degree distribution. Graph500 uses .57/.19/.19/.05.
+// permute -> relabel vertices with a random permutation so the hubs are not
+//            all packed at the low ids.
+typedef struct RMATParams {
+    double a;
+    double b;
+    double c;
+    double d;
+    int permute;
+} RMATParams;
+
+
+// Graph500 ratios with the given a: the remaining mass is split 19:19:5
+RMATParams rmatParams(double a) {
+    RMATParams p;
+    p.a = a;
+    p.b = (1.0 - a) * 19.0 / 43.0;
+    p.c = p.b;
+    p.d = (1.0 - a) * 5.0 / 43.0;
+    p.permute = 1;
+    return p;
+}
+
+
+// Fill src/dst with n_edges R-MAT edges over n_nodes vertices. n_nodes need
+// not be a power of two: draws that fall outside are retried with the next
+// counter of the same edge.
+void rmatEdges(int n_nodes, long n_edges, RMATParams p, uint64_t seed, int *src, int *dst) {
+    int scale = 0;
+    while ((1L << scale) < n_nodes) {
+        scale++;
+    }
+    double ab = p.a + p.b, abc = p.a + p.b + p.c;
+
+    #pragma omp parallel for schedule(static)
+    for (long e = 0; e < n_edges; ++e) {
+        uint64_t counter = (uint64_t)e << 16;
+        long u, v;
+        do {
+            u = 0;
+            v = 0;
+            for (int level = 0; level < scale; ++level) {
+                double r = rngUniform(seed, counter++);
+                u <<= 1;
+                v <<= 1;
+                // Quadrants a, b, c, d are (0,0), (0,1), (1,0), (1,1)
+                if (r >= ab) {
+                    u |= 1;
+                }
+                if ((r >= p.a && r < ab) || r >= abc) {
+                    v |= 1;
+                }
+            }
+        } while (u >= n_nodes || v >= n_nodes);
+        src[e] = (int)u;
+        dst[e] = (int)v;
+    }
+
+    if (p.permute) {
+        int *perm = (int *)malloc(n_nodes * sizeof(int));
+        for (int i = 0; i < n_nodes; ++i) {
+            perm[i] = i;
+        }
+        uint64_t permSeed = rngMix(seed ^ 0x5045524dULL);
+        for (int i = n_nodes - 1; i > 0; --i) {
+            int j = (int)rngBounded(permSeed, (uint64_t)i, (uint64_t)i + 1);
+            int t = perm[i];
+            perm[i] = perm[j];
+            perm[j] = t;
+        }
+        #pragma omp parallel for schedule(static)
+        for (long e = 0; e < n_edges; ++e) {
+            src[e] = perm[src[e]];
+            dst[e] = perm[dst[e]];
+        }
+        free(perm);
+    }
+}
+
+
+// Erdos-Renyi style graph: both endpoints uniform over the vertices
+void uniformEdges(int n_nodes, long n_edges, uint64_t seed, int *src, int *dst) {
+    #pragma omp parallel for schedule(static)
+    for (long e = 0; e < n_edges; ++e) {
+        src[e] = (int)rngBounded(seed, 2 * (uint64_t)e, (uint64_t)n_nodes);
+        dst[e] = (int)rngBounded(seed, 2 * (uint64_t)e + 1, (uint64_t)n_nodes);
+    }
+}
+
+
+// Random dense matrix with entries uniform in [-scale, scale)
+void randomMatrix(float *X, long count, float scale, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < count; ++i) {
+        X[i] = (float)((2.0 * rngUniform(seed, (uint64_t)i) - 1.0) * scale);
+    }
+}
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Counter-based random numbers: the value for (seed, counter) does not depend
+// on what was drawn before, so loops can be split across any number of
+// threads and still produce the same stream.
+
+
+// splitmix64 finalizer, a bijective mix of a 64-bit counter
+static inline uint64_t rngMix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+
+// 64 random bits for draw number `counter` of stream `seed`
+static inline uint64_t rngBits(uint64_t seed, uint64_t counter) {
+    return rngMix(rngMix(seed) ^ counter);
+}
+
+
+// Uniform double in [0, 1)
+static inline double rngUniform(uint64_t seed, uint64_t counter) {
+    return (double)(rngBits(seed, counter) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+
+// Uniform integer in [0, bound) (multiply-shift, bias is negligible for
+// bounds far below 2^32)
+static inline uint64_t rngBounded(uint64_t seed, uint64_t counter, uint64_t bound) {
+    return ((rngBits(seed, counter) >> 32) * bound) >> 32;
+}
+
+#endif
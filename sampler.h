@@ -0,0 +1,281 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <omp.h>
+#include "rng.h"
+
+// Epoch sampling and mini-batch gathering for training loops.
+//
+// samplerPermute writes the sample order of one epoch. The order is a
+// bijection of [0, n): a 4-round Feistel network over the smallest power of
+// 4 >= n, keyed by (seed, epoch), and values that land outside [0, n) are
+// encrypted again until they fall inside (cycle walking, under 4 rounds
+// trips on average). Position k depends only on (seed, epoch, k), so the
+// permutation is filled in parallel, comes out the same for any number of
+// threads and any epoch can be regenerated on resume.
+//
+// A Prefetcher gathers the mini-batches of an epoch on a background thread
+// into a ring of PREFETCH_DEPTH slots. A slot holds a batch's input and
+// target rows back to back in 64-byte aligned buffers, so the compute
+// thread reads contiguous rows while the next batches are being copied
+// out of the row-pointer arrays. The compute thread takes slots in order
+// with prefetchNext and hands each back with prefetchRelease.
+//
+// Rows have `lead` unused entries in front (x row r is x + r * x_stride,
+// x_stride = lead + dims), so with lead 1 a row indexes 1-based like the
+// layer buffers of test.c.
+
+#define SAMPLER_ROUNDS 4
+#define PREFETCH_DEPTH 4
+
+
+typedef struct Sampler {
+    long n;
+    uint64_t seed;
+    int half_bits;
+    uint64_t half_mask;
+} Sampler;
+
+
+void samplerInit(Sampler *s, long n, uint64_t seed) {
+    s->n = n;
+    s->seed = seed;
+    s->half_bits = 1;
+    while (s->half_bits < 31 && (1L << (2 * s->half_bits)) < n) {
+        s->half_bits++;
+    }
+    s->half_mask = ((uint64_t)1 << s->half_bits) - 1;
+}
+
+
+static inline uint64_t samplerFeistel(const Sampler *s, uint64_t key, uint64_t x) {
+    uint64_t left = x >> s->half_bits, right = x & s->half_mask;
+    for (int round = 0; round < SAMPLER_ROUNDS; ++round) {
+        uint64_t f = rngBits(key + round, right) & s->half_mask;
+        uint64_t next = left ^ f;
+        left = right;
+        right = next;
+    }
+    return left << s->half_bits | right;
+}
+
+
+// Sample at position k of the given epoch
+static inline long samplerIndex(const Sampler *s, long epoch, long k) {
+    uint64_t key = rngBits(s->seed, (uint64_t)epoch) * SAMPLER_ROUNDS;
+    uint64_t x = samplerFeistel(s, key, (uint64_t)k);
+    while (x >= (uint64_t)s->n) {
+        x = samplerFeistel(s, key, x);
+    }
+    return (long)x;
+}
+
+
+// order[k] = samplerIndex(s, epoch, k) for all k < n
+void samplerPermute(const Sampler *s, long epoch, int *order) {
+    #pragma omp parallel for schedule(static)
+    for (long k = 0; k < s->n; ++k) {
+        order[k] = (int)samplerIndex(s, epoch, k);
+    }
+}
+
+
+// ids -> sample ids of the rows; x, y -> rows x x_stride / y_stride doubles
+typedef struct MiniBatch {
+    long index;
+    int rows;
+    int *ids;
+    double *x;
+    double *y;
+} MiniBatch;
+
+
+// X, Y -> source rows (dims and classes wide), Y may be NULL.
+// order, count, n_batches -> the current epoch: batch b gathers samples
+// order[b * batch_size ...] up to count.
+// produced / consumed -> batches gathered / released this epoch.
+// gather_time -> seconds the worker spent copying; stall_time -> seconds the
+// compute thread waited in prefetchNext.
+typedef struct Prefetcher {
+    double **X;
+    double **Y;
+    int dims;
+    int classes;
+    int lead;
+    int batch_size;
+    long x_stride;
+    long y_stride;
+    MiniBatch slot[PREFETCH_DEPTH];
+
+    const int *order;
+    long count;
+    long n_batches;
+    long produced;
+    long consumed;
+    int stop;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+
+    double gather_time;
+    double stall_time;
+    long batches;
+} Prefetcher;
+
+
+static void prefetchGather(Prefetcher *p, MiniBatch *b, long index) {
+    long first = index * p->batch_size;
+    long rows = p->count - first < p->batch_size ? p->count - first : p->batch_size;
+    b->index = index;
+    b->rows = (int)rows;
+    for (long r = 0; r < rows; ++r) {
+        int id = p->order[first + r];
+        b->ids[r] = id;
+        memcpy(b->x + r * p->x_stride + p->lead, p->X[id], p->dims * sizeof(double));
+        if (p->Y) {
+            memcpy(b->y + r * p->y_stride + p->lead, p->Y[id], p->classes * sizeof(double));
+        }
+    }
+}
+
+
+static void *prefetchMain(void *arg) {
+    Prefetcher *p = (Prefetcher *)arg;
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->stop && (p->produced == p->n_batches || p->produced - p->consumed == PREFETCH_DEPTH)) {
+            pthread_cond_wait(&p->cond, &p->lock);
+        }
+        if (p->stop) {
+            break;
+        }
+        long index = p->produced;
+        MiniBatch *b = &p->slot[index % PREFETCH_DEPTH];
+        pthread_mutex_unlock(&p->lock);
+
+        double start = omp_get_wtime();
+        prefetchGather(p, b, index);
+        double took = omp_get_wtime() - start;
+
+        pthread_mutex_lock(&p->lock);
+        p->gather_time += took;
+        p->produced++;
+        pthread_cond_broadcast(&p->cond);
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+
+static double *prefetchAlloc(long count) {
+    size_t bytes = ((count * sizeof(double) + 63) / 64) * 64;
+    double *buf = (double *)aligned_alloc(64, bytes ? bytes : 64);
+    if (buf) {
+        memset(buf, 0, bytes);
+    }
+    return buf;
+}
+
+
+// Allocate the slots and start the worker; no epoch is queued yet.
+// Returns 0 on success.
+int prefetchStart(Prefetcher *p, double **X, double **Y, int dims, int classes, int lead, int batch_size) {
+    memset(p, 0, sizeof(*p));
+    p->X = X;
+    p->Y = Y;
+    p->dims = dims;
+    p->classes = classes;
+    p->lead = lead;
+    p->batch_size = batch_size > 0 ? batch_size : 1;
+    p->x_stride = lead + dims;
+    p->y_stride = lead + classes;
+    for (int s = 0; s < PREFETCH_DEPTH; ++s) {
+        MiniBatch *b = &p->slot[s];
+        b->ids = (int *)malloc(p->batch_size * sizeof(int));
+        b->x = prefetchAlloc(p->batch_size * p->x_stride);
+        b->y = prefetchAlloc(Y ? p->batch_size * p->y_stride : 0);
+        if (!b->ids || !b->x || !b->y) {
+            fprintf(stderr, "prefetch: cannot allocate %d slots of %d rows\n", PREFETCH_DEPTH, p->batch_size);
+            return 1;
+        }
+    }
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    if (pthread_create(&p->thread, NULL, prefetchMain, p) != 0) {
+        fprintf(stderr, "prefetch: cannot start worker thread\n");
+        return 1;
+    }
+    return 0;
+}
+
+
+// Queue the first `count` samples of order as the next epoch. The previous
+// epoch must have been consumed; order must stay valid until this one is.
+void prefetchEpoch(Prefetcher *p, const int *order, long count) {
+    pthread_mutex_lock(&p->lock);
+    p->order = order;
+    p->count = count;
+    p->n_batches = (count + p->batch_size - 1) / p->batch_size;
+    p->produced = 0;
+    p->consumed = 0;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+
+// Next batch of the epoch in order, waiting for the worker if it is behind.
+// NULL once the epoch is done.
+const MiniBatch *prefetchNext(Prefetcher *p) {
+    double start = omp_get_wtime();
+    pthread_mutex_lock(&p->lock);
+    if (p->consumed == p->n_batches) {
+        pthread_mutex_unlock(&p->lock);
+        return NULL;
+    }
+    while (p->produced == p->consumed) {
+        pthread_cond_wait(&p->cond, &p->lock);
+    }
+    MiniBatch *b = &p->slot[p->consumed % PREFETCH_DEPTH];
+    p->stall_time += omp_get_wtime() - start;
+    p->batches++;
+    pthread_mutex_unlock(&p->lock);
+    return b;
+}
+
+
+// Give the batch returned by prefetchNext back to the worker
+void prefetchRelease(Prefetcher *p) {
+    pthread_mutex_lock(&p->lock);
+    p->consumed++;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+
+void prefetchStop(Prefetcher *p) {
+    pthread_mutex_lock(&p->lock);
+    p->stop = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    pthread_join(p->thread, NULL);
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->cond);
+    for (int s = 0; s < PREFETCH_DEPTH; ++s) {
+        free(p->slot[s].ids);
+        free(p->slot[s].x);
+        free(p->slot[s].y);
+    }
+}
+
+
+void prefetchReport(const Prefetcher *p, FILE *out) {
+    fprintf(out, "prefetch: %ld batches of %d, gather %.3fs on the worker, compute thread stalled %.3fs\n",
+            p->batches, p->batch_size, p->gather_time, p->stall_time);
+}
+
+#endif
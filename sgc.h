@@ -0,0 +1,348 @@
+#ifndef SGC_H
+#define SGC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <omp.h>
+#include "graph.h"
+#include "kernels.h"
+#include "rng.h"
+
+// Precomputed propagation (SGC / SIGN).
+// The graph and the input features do not change during training, so the
+// hops A X, A^2 X, ..., A^k X are computed once with the aggregation kernel
+// (aggregateSum when the graph carries normalized edge values,
+// aggregateMean otherwise) and stored row-major per node:
+//   SGC  -> only A^k X                       (dim columns)
+//   SIGN -> [X, A X, ..., A^k X] side by side ((k + 1) * dim columns)
+// Rows can be kept as float16 to halve the cache. A linear or one-hidden-
+// layer classifier is then trained on the rows in blocks of `batch` nodes,
+// so an epoch is only dense GEMMs (and a float16 decode of each block).
+
+#define SGC_MAX_HOPS 16
+
+
+// width -> columns per node.
+// data -> n_nodes x width floats, or float16 bits when half is set.
+typedef struct SGCCache {
+    int n_nodes;
+    int dim;
+    int hops;
+    int sign;
+    int half;
+    int width;
+    void *data;
+    double build_time;
+} SGCCache;
+
+
+// hidden == 0 is a linear classifier (W1 is in_dim x classes, no W2)
+typedef struct SGCModel {
+    int in_dim;
+    int hidden;
+    int classes;
+    float *W1, *b1, *W2, *b2;
+    float *dW1, *db1, *dW2, *db2;
+    Adam opt[4];
+} SGCModel;
+
+
+// Round to nearest even; overflow goes to infinity, tiny values to subnormals
+static inline uint16_t halfFromFloat(float f) {
+    uint32_t x;
+    memcpy(&x, &f, 4);
+    uint32_t sign = (x >> 16) & 0x8000, mag = x & 0x7fffffff;
+    if (mag >= 0x7f800000) {
+        return (uint16_t)(sign | 0x7c00 | (mag > 0x7f800000 ? 0x200 : 0));
+    }
+    if (mag >= 0x477ff000) {
+        return (uint16_t)(sign | 0x7c00);
+    }
+    if (mag < 0x38800000) {
+        // Subnormal: a multiple of 2^-24, rounded by the FPU
+        return (uint16_t)(sign | (uint32_t)nearbyintf(fabsf(f) * 16777216.0f));
+    }
+    uint32_t h = ((mag - 0x38000000) >> 13);
+    uint32_t rest = mag & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (h & 1))) {
+        h++;
+    }
+    return (uint16_t)(sign | h);
+}
+
+
+static inline float floatFromHalf(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16, exp = (h >> 10) & 0x1f, m = h & 0x3ff, x;
+    if (exp == 0x1f) {
+        x = sign | 0x7f800000 | (m << 13);
+    } else if (exp != 0) {
+        x = sign | ((exp + 112) << 23) | (m << 13);
+    } else if (m == 0) {
+        x = sign;
+    } else {
+        // Subnormal: normalize the mantissa
+        exp = 113;
+        while (!(m & 0x400)) {
+            m <<= 1;
+            exp--;
+        }
+        x = sign | (exp << 23) | ((m & 0x3ff) << 13);
+    }
+    float f;
+    memcpy(&f, &x, 4);
+    return f;
+}
+
+
+// Store every row of src (n_nodes x cols) at column `col` of the cache
+static void sgcStore(SGCCache *c, const float *src, int cols, int col) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < c->n_nodes; ++i) {
+        const float *s = src + (size_t)i * cols;
+        if (c->half) {
+            uint16_t *d = (uint16_t *)c->data + (size_t)i * c->width + col;
+            for (int f = 0; f < cols; ++f) {
+                d[f] = halfFromFloat(s[f]);
+            }
+        } else {
+            memcpy((float *)c->data + (size_t)i * c->width + col, s, cols * sizeof(float));
+        }
+    }
+}
+
+
+// Propagate X (n x dim) `hops` times over g into the cache
+int sgcBuild(SGCCache *c, const CSRGraph *g, const float *X, int dim, int hops, int sign, int half) {
+    if (hops < 0 || hops > SGC_MAX_HOPS) {
+        fprintf(stderr, "hops must be in [0, %d]\n", SGC_MAX_HOPS);
+        return 1;
+    }
+    double start = omp_get_wtime();
+    int n = g->n_nodes;
+    c->n_nodes = n;
+    c->dim = dim;
+    c->hops = hops;
+    c->sign = sign;
+    c->half = half;
+    c->width = sign ? (hops + 1) * dim : dim;
+    c->data = malloc((size_t)n * c->width * (half ? sizeof(uint16_t) : sizeof(float)));
+    float *buf[2];
+    buf[0] = (float *)malloc((size_t)n * dim * sizeof(float));
+    buf[1] = (float *)malloc((size_t)n * dim * sizeof(float));
+    if (!c->data || !buf[0] || !buf[1]) {
+        fprintf(stderr, "Out of memory for the hop cache\n");
+        free(c->data);
+        free(buf[0]);
+        free(buf[1]);
+        c->data = NULL;
+        return 1;
+    }
+    if (sign || hops == 0) {
+        sgcStore(c, X, dim, 0);
+    }
+    const float *in = X;
+    for (int hop = 1; hop <= hops; ++hop) {
+        float *out = buf[hop & 1];
+        if (g->values) {
+            aggregateSum(g, in, out, dim);
+        } else {
+            aggregateMean(g, in, out, dim);
+        }
+        if (sign || hop == hops) {
+            sgcStore(c, out, dim, sign ? hop * dim : 0);
+        }
+        in = out;
+    }
+    free(buf[0]);
+    free(buf[1]);
+    c->build_time = omp_get_wtime() - start;
+    return 0;
+}
+
+
+void sgcFree(SGCCache *c) {
+    free(c->data);
+    c->data = NULL;
+}
+
+
+size_t sgcBytes(const SGCCache *c) {
+    return (size_t)c->n_nodes * c->width * (c->half ? sizeof(uint16_t) : sizeof(float));
+}
+
+
+// Rows [row, row + count) as floats: a pointer into the cache, or decoded
+// into buf (count x width) for a float16 cache
+const float *sgcRows(const SGCCache *c, long row, long count, float *buf) {
+    if (!c->half) {
+        return (const float *)c->data + (size_t)row * c->width;
+    }
+    const uint16_t *src = (const uint16_t *)c->data + (size_t)row * c->width;
+    #pragma omp parallel for simd schedule(static)
+    for (long e = 0; e < count * c->width; ++e) {
+        buf[e] = floatFromHalf(src[e]);
+    }
+    return buf;
+}
+
+
+static void sgcUniform(float *W, long count, double scale, uint64_t seed) {
+    for (long k = 0; k < count; ++k) {
+        W[k] = (float)((2.0 * rngUniform(seed, (uint64_t)k) - 1.0) * scale);
+    }
+}
+
+
+void sgcModelInit(SGCModel *m, int in_dim, int hidden, int classes, float lr, unsigned long long seed) {
+    memset(m, 0, sizeof(*m));
+    m->in_dim = in_dim;
+    m->hidden = hidden;
+    m->classes = classes;
+    int out1 = hidden ? hidden : classes;
+    m->W1 = (float *)malloc((size_t)in_dim * out1 * sizeof(float));
+    m->b1 = (float *)calloc(out1, sizeof(float));
+    m->dW1 = (float *)malloc((size_t)in_dim * out1 * sizeof(float));
+    m->db1 = (float *)malloc(out1 * sizeof(float));
+    sgcUniform(m->W1, (long)in_dim * out1, sqrt(6.0 / (in_dim + out1)), seed);
+    adamInit(&m->opt[0], (long)in_dim * out1, lr);
+    adamInit(&m->opt[1], out1, lr);
+    if (hidden) {
+        m->W2 = (float *)malloc((size_t)hidden * classes * sizeof(float));
+        m->b2 = (float *)calloc(classes, sizeof(float));
+        m->dW2 = (float *)malloc((size_t)hidden * classes * sizeof(float));
+        m->db2 = (float *)malloc(classes * sizeof(float));
+        sgcUniform(m->W2, (long)hidden * classes, sqrt(6.0 / (hidden + classes)), seed + 1);
+        adamInit(&m->opt[2], (long)hidden * classes, lr);
+        adamInit(&m->opt[3], classes, lr);
+    }
+}
+
+
+void sgcModelFree(SGCModel *m) {
+    free(m->W1);
+    free(m->b1);
+    free(m->dW1);
+    free(m->db1);
+    adamFree(&m->opt[0]);
+    adamFree(&m->opt[1]);
+    if (m->hidden) {
+        free(m->W2);
+        free(m->b2);
+        free(m->dW2);
+        free(m->db2);
+        adamFree(&m->opt[2]);
+        adamFree(&m->opt[3]);
+    }
+}
+
+
+// Logits for `count` rows of X; hid (count x hidden) receives the hidden
+// activations of an MLP
+static void sgcLogits(const SGCModel *m, const float *X, long count, float *hid, float *logits) {
+    if (!m->hidden) {
+        denseForward(X, m->W1, m->b1, logits, count, m->in_dim, m->classes);
+        return;
+    }
+    denseForward(X, m->W1, m->b1, hid, count, m->in_dim, m->hidden);
+    reluInPlace(hid, count * m->hidden);
+    denseForward(hid, m->W2, m->b2, logits, count, m->hidden, m->classes);
+}
+
+
+// Scratch for `batch` rows of the cache
+typedef struct SGCScratch {
+    long batch;
+    float *rows;
+    float *hid;
+    float *dhid;
+    float *logits;
+    float *grad;
+} SGCScratch;
+
+
+void sgcScratchInit(SGCScratch *s, const SGCCache *c, const SGCModel *m, long batch) {
+    s->batch = batch;
+    s->rows = c->half ? (float *)malloc((size_t)batch * c->width * sizeof(float)) : NULL;
+    s->hid = m->hidden ? (float *)malloc((size_t)batch * m->hidden * sizeof(float)) : NULL;
+    s->dhid = m->hidden ? (float *)malloc((size_t)batch * m->hidden * sizeof(float)) : NULL;
+    s->logits = (float *)malloc((size_t)batch * m->classes * sizeof(float));
+    s->grad = (float *)malloc((size_t)batch * m->classes * sizeof(float));
+}
+
+
+void sgcScratchFree(SGCScratch *s) {
+    free(s->rows);
+    free(s->hid);
+    free(s->dhid);
+    free(s->logits);
+    free(s->grad);
+}
+
+
+// One pass over the cache in blocks of s->batch rows with an Adam step per
+// block that holds training rows (mask[i] != 0, all rows when mask is
+// NULL). Returns the mean training loss.
+double sgcEpoch(SGCModel *m, const SGCCache *c, const int *labels, const unsigned char *mask, SGCScratch *s) {
+    double loss = 0.0;
+    long used = 0;
+    for (long row = 0; row < c->n_nodes; row += s->batch) {
+        long count = row + s->batch < c->n_nodes ? s->batch : c->n_nodes - row;
+        long train = count;
+        if (mask) {
+            train = 0;
+            for (long i = row; i < row + count; ++i) {
+                train += mask[i] != 0;
+            }
+            if (train == 0) {
+                continue;
+            }
+        }
+        const float *X = sgcRows(c, row, count, s->rows);
+        sgcLogits(m, X, count, s->hid, s->logits);
+        loss += train * softmaxCrossEntropy(s->logits, labels + row, mask ? mask + row : NULL, count,
+                                            m->classes, s->grad, NULL);
+        used += train;
+        if (!m->hidden) {
+            denseGradWeight(X, s->grad, m->dW1, count, m->in_dim, m->classes);
+            denseGradBias(s->grad, count, m->classes, m->db1);
+        } else {
+            denseGradWeight(s->hid, s->grad, m->dW2, count, m->hidden, m->classes);
+            denseGradBias(s->grad, count, m->classes, m->db2);
+            // Back through W2 and the relu
+            float *dhid = s->dhid;
+            denseGradInput(s->grad, m->W2, dhid, count, m->hidden, m->classes);
+            #pragma omp parallel for simd schedule(static)
+            for (long e = 0; e < count * m->hidden; ++e) {
+                dhid[e] = s->hid[e] > 0.0f ? dhid[e] : 0.0f;
+            }
+            denseGradWeight(X, dhid, m->dW1, count, m->in_dim, m->hidden);
+            denseGradBias(dhid, count, m->hidden, m->db1);
+            adamStep(&m->opt[2], m->W2, m->dW2);
+            adamStep(&m->opt[3], m->b2, m->db2);
+        }
+        adamStep(&m->opt[0], m->W1, m->dW1);
+        adamStep(&m->opt[1], m->b1, m->db1);
+    }
+    return used ? loss / used : 0.0;
+}
+
+
+// Argmax hits over the rows with mask[i] != 0 (all rows when mask is NULL)
+long sgcCorrect(const SGCModel *m, const SGCCache *c, const int *labels, const unsigned char *mask,
+                SGCScratch *s) {
+    long hits = 0;
+    for (long row = 0; row < c->n_nodes; row += s->batch) {
+        long count = row + s->batch < c->n_nodes ? s->batch : c->n_nodes - row, part = 0;
+        const float *X = sgcRows(c, row, count, s->rows);
+        sgcLogits(m, X, count, s->hid, s->logits);
+        softmaxCrossEntropy(s->logits, labels + row, mask ? mask + row : NULL, count, m->classes, NULL,
+                            &part);
+        hits += part;
+    }
+    return hits;
+}
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef TEAM_H
+#define TEAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sched.h>
+#include <omp.h>
+
+// Persistent worker team for loops that are too short to pay for an OpenMP
+// fork/join each (one per node, per feature row, per sample and layer).
+// The caller opens one parallel region for the whole run and every thread
+// executes the same code; the kernels inside are partitions of a range:
+//
+//   teamInit(&team, 0);
+//   #pragma omp parallel num_threads(team.n_threads)
+//   {
+//       int tid = teamJoin(&team);
+//       for (...) {
+//           teamFor(&team, tid, n, 0, body, &ctx);   // body(ctx, begin, end)
+//           if (tid == 0) { ...serial part... }
+//           teamBarrier(&team, tid);
+//       }
+//   }
+//
+// teamFor cuts [0, n) into chunks of `grain` indices and deals one
+// contiguous run of chunks to each thread's queue. A queue is a single
+// 64-bit word (next chunk in the low half, end in the high half), so the
+// owner and the threads that steal from it when their own queue is empty
+// both claim with one fetch_add. A thread that reads a queue before its
+// owner has filled it sees the previous, exhausted range and moves on; the
+// owner then runs those chunks itself. teamFor ends with a barrier, so its
+// results are visible to every thread when it returns.
+//
+// teamBarrier is a sense-reversing counter barrier. It spins for
+// TEAM_SPIN polls and then yields the CPU on every poll; when the threads
+// outnumber the cores it yields right away, since spinning would only take
+// the core from the thread being waited for. The time each thread waits there
+// (load imbalance included) is the sync overhead teamReport prints.
+//
+// Code between barriers runs on every thread: work for one thread goes
+// under `if (tid == 0)`, followed by teamBarrier when others read its
+// result. OpenMP constructs inside the region run nested, on one thread.
+
+#define TEAM_MAX_THREADS 256
+#define TEAM_SPIN 2000
+// Chunks per thread when teamFor picks the grain
+#define TEAM_CHUNKS_PER_THREAD 4
+
+
+// The per-thread structs below are one 64-byte line each and aligned to it,
+// so array entries of neighboring threads never share a line
+typedef struct TeamQueue {
+    uint64_t range;
+    char pad[64 - sizeof(uint64_t)];
+} __attribute__((aligned(64))) TeamQueue;
+
+
+// Per-thread barrier sense and counters
+typedef struct TeamSelf {
+    long jobs;
+    long barriers;
+    long chunks;
+    long stolen;
+    double wait;
+    int sense;
+    char pad[64 - 4 * sizeof(long) - sizeof(double) - sizeof(int)];
+} __attribute__((aligned(64))) TeamSelf;
+
+
+typedef struct TeamCounter {
+    int value;
+    char pad[64 - sizeof(int)];
+} __attribute__((aligned(64))) TeamCounter;
+
+
+typedef struct Team {
+    int n_threads;
+    int spin;
+    TeamCounter arrived;
+    TeamCounter sense;
+    TeamQueue queue[TEAM_MAX_THREADS];
+    TeamSelf self[TEAM_MAX_THREADS];
+} Team;
+
+
+// n_threads <= 0 -> omp_get_max_threads()
+void teamInit(Team *team, int n_threads) {
+    if (n_threads <= 0) {
+        n_threads = omp_get_max_threads();
+    }
+    team->n_threads = n_threads < TEAM_MAX_THREADS ? n_threads : TEAM_MAX_THREADS;
+    team->spin = team->n_threads > omp_get_num_procs() ? 0 : TEAM_SPIN;
+    team->arrived.value = 0;
+    team->sense.value = 0;
+    for (int t = 0; t < TEAM_MAX_THREADS; ++t) {
+        team->queue[t].range = 0;
+        team->self[t].sense = 0;
+        team->self[t].jobs = 0;
+        team->self[t].barriers = 0;
+        team->self[t].chunks = 0;
+        team->self[t].stolen = 0;
+        team->self[t].wait = 0.0;
+    }
+}
+
+
+// First call of every thread in the region; returns its id. Takes the size
+// the region really got, which may be less than asked for.
+int teamJoin(Team *team) {
+    #pragma omp single
+    team->n_threads = omp_get_num_threads();
+    return omp_get_thread_num();
+}
+
+
+void teamBarrier(Team *team, int tid) {
+    TeamSelf *self = &team->self[tid];
+    int sense = !self->sense;
+    self->sense = sense;
+    self->barriers++;
+    if (team->n_threads == 1) {
+        return;
+    }
+    double start = omp_get_wtime();
+    if (__atomic_add_fetch(&team->arrived.value, 1, __ATOMIC_ACQ_REL) == team->n_threads) {
+        __atomic_store_n(&team->arrived.value, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&team->sense.value, sense, __ATOMIC_RELEASE);
+    } else {
+        int spins = 0;
+        while (__atomic_load_n(&team->sense.value, __ATOMIC_ACQUIRE) != sense) {
+            if (spins < team->spin) {
+                spins++;
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            } else {
+                sched_yield();
+            }
+        }
+    }
+    self->wait += omp_get_wtime() - start;
+}
+
+
+// Next chunk of queue q, or -1 once it is exhausted
+static inline long teamClaim(TeamQueue *q) {
+    uint64_t r = __atomic_fetch_add(&q->range, 1, __ATOMIC_ACQ_REL);
+    uint32_t next = (uint32_t)r, end = (uint32_t)(r >> 32);
+    return next < end ? (long)next : -1;
+}
+
+
+// Run body(ctx, begin, end) over [0, n) in chunks of grain (<= 0 picks
+// one), then wait for the whole team. Every thread must call it with the
+// same n and grain.
+void teamFor(Team *team, int tid, long n, long grain, void (*body)(void *, long, long), void *ctx) {
+    int T = team->n_threads;
+    TeamSelf *self = &team->self[tid];
+    if (grain <= 0) {
+        grain = (n + (long)T * TEAM_CHUNKS_PER_THREAD - 1) / ((long)T * TEAM_CHUNKS_PER_THREAD);
+        grain = grain > 0 ? grain : 1;
+    }
+    long chunks = (n + grain - 1) / grain;
+    uint64_t lo = (uint64_t)(chunks * tid / T), hi = (uint64_t)(chunks * (tid + 1) / T);
+    __atomic_store_n(&team->queue[tid].range, hi << 32 | lo, __ATOMIC_RELEASE);
+    self->jobs++;
+    for (int k = 0; k < T; ++k) {
+        int victim = (tid + k) % T;
+        long c;
+        while ((c = teamClaim(&team->queue[victim])) >= 0) {
+            long begin = c * grain, end = begin + grain < n ? begin + grain : n;
+            body(ctx, begin, end);
+            self->chunks++;
+            self->stolen += victim != tid;
+        }
+    }
+    teamBarrier(team, tid);
+}
+
+
+// Totals over the threads. elapsed -> wall time of the region, for the share
+// spent waiting at barriers.
+void teamReport(const Team *team, FILE *out, double elapsed) {
+    long jobs = team->self[0].jobs, barriers = team->self[0].barriers, chunks = 0, stolen = 0;
+    double wait = 0.0, max_wait = 0.0;
+    for (int t = 0; t < team->n_threads; ++t) {
+        const TeamSelf *s = &team->self[t];
+        chunks += s->chunks;
+        stolen += s->stolen;
+        wait += s->wait;
+        max_wait = s->wait > max_wait ? s->wait : max_wait;
+    }
+    wait /= team->n_threads;
+    fprintf(out, "team: %d threads, %ld loops, %ld barriers, %ld chunks (%ld stolen); barrier wait %.3fs mean, %.3fs max",
+            team->n_threads, jobs, barriers, chunks, stolen, wait, max_wait);
+    if (elapsed > 0.0) {
+        fprintf(out, " (%.2f%% of %.3fs)", 100.0 * wait / elapsed, elapsed);
+    }
+    fprintf(out, "\n");
+}
+
+#endif
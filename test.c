@@ -4,8 +4,15 @@
 #include <time.h>
 #include <omp.h>
 #include <string.h>
+#include <limits.h>
 #include "read_data.h"
 #include "activation.h"
+#include "checkpoint.h"
+#include "arena.h"
+#include "reduce.h"
+#include "team.h"
+#include "eval.h"
+#include "sampler.h"
 
 
 // Initialize constants used in optimizers
@@ -15,6 +22,17 @@ const double beta_1 = 0.9;
 const double beta_2 = 0.999;
 
 
+// Worker team that runs training and testing
+Team team;
+
+
+// Seed of the training sample order (saved in checkpoints)
+uint64_t sample_seed;
+
+// Samples per prefetched training batch
+#define TRAIN_BATCH 64
+
+
 // Pseudo-random number generator 
 int seed;
 double randn(){
@@ -65,6 +83,17 @@ struct NeuralNet* newNet(int n_layers, int n_neurons_per_layer[]){
     for(int i=0;i<n_layers;i++){
         nn->n_neurons_per_layer[i] = n_neurons_per_layer[i];
     }
+
+    // Per-layer pointer arrays
+    nn->w = malloc((nn->n_layers-1)*sizeof(double**));
+    nn->momentum_w = malloc((nn->n_layers-1)*sizeof(double**));
+    nn->momentum2_w = malloc((nn->n_layers-1)*sizeof(double**));
+    nn->b = malloc((nn->n_layers-1)*sizeof(double*));
+    nn->momentum_b = malloc((nn->n_layers-1)*sizeof(double*));
+    nn->momentum2_b = malloc((nn->n_layers-1)*sizeof(double*));
+    nn->in = malloc(nn->n_layers*sizeof(double*));
+    nn->out = malloc(nn->n_layers*sizeof(double*));
+    nn->delta = malloc(nn->n_layers*sizeof(double*));
     
     // Allocate memory for weights and biases in parallel
     #pragma omp parallel for
@@ -149,171 +178,166 @@ void init_nn(struct NeuralNet* nn){
 }
 
 
-// Function to shuffle elements of an array
-void shuffle(int* arr, size_t n){
-    if(n > 1){
-        for(size_t i=0;i<n-1;i++){
-        size_t j = i+rand()/(RAND_MAX/(n-i)+1);
-          int t = arr[j];
-          arr[j] = arr[i];
-          arr[i] = t;
+// One layer's share of work for the worker team. Forward and delta passes
+// partition the neurons j (or i) of layer k, so each neuron's sum is built
+// by one thread in the serial order; the update partitions the rows of
+// every weight matrix at once, row 0 of layer k standing for its biases.
+struct LayerWork{
+    struct NeuralNet* nn;
+    int k;
+    char* activation_fun;
+    char* opt;
+    double learning_rate;
+};
+
+
+// Weighted sums of neurons [begin, end) of layer k, and their activations
+// for a hidden layer (the output layer is done by output_layer)
+void forward_neurons(void* ctx, long begin, long end){
+    struct LayerWork* work = ctx;
+    struct NeuralNet* nn = work->nn;
+    int k = work->k;
+    for(int j=begin+1;j<end+1;j++){
+        double in = 1.0 * nn->b[k-1][j];
+        for(int i=1;i<nn->n_neurons_per_layer[k-1]+1;i++){
+            in += nn->out[k-1][i] * nn->w[k-1][i][j];
+        }
+        nn->in[k][j] = in;
+        if(k == nn->n_layers-1){
+            continue;
+        }
+        if(strcmp(work->activation_fun, "sigmoid") == 0){
+            nn->out[k][j] = sigmoid(nn->in[k][j]);
+        }
+        else if(strcmp(work->activation_fun, "tanh") == 0){
+            nn->out[k][j] = tanh(nn->in[k][j]);
+        }
+        else if(strcmp(work->activation_fun, "relu") == 0){
+            nn->out[k][j] = relu(nn->in[k][j]);
+        }
+        else{
+            nn->out[k][j] = sigmoid(nn->in[k][j]);
         }
     }
 }
 
 
-
-
-void forward_propagation(struct NeuralNet* nn, char* activation_fun, char* loss){
-    #pragma omp parallel for
-    for(int i=0;i<nn->n_layers;i++){
-        for(int j=0;j<nn->n_neurons_per_layer[i]+1;j++){
-            nn->in[i][j] = 0.0;
+// Non-linear activation of the n output neurons in[0..n) into out[0..n)
+void output_activation(double* in, double* out, int n, char* loss){
+    if(strcmp(loss, "mse") == 0){
+        for(int j=0;j<n;j++){
+            out[j] = sigmoid(in[j]);
         }
     }
-    for(int k=1;k<nn->n_layers;k++){
-        // Compute the weighted sum
-        #pragma omp parallel for
-        for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-            nn->in[k][j] += 1.0 * nn->b[k-1][j];
-        }
-        #pragma omp parallel for collapse(2)
-        for(int i=1;i<nn->n_neurons_per_layer[k-1]+1;i++){
-            for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-                nn->in[k][j] += nn->out[k-1][i] * nn->w[k-1][i][j];
+    else if(strcmp(loss, "ce") == 0){
+        double max_input_to_softmax = (double)INT_MIN;
+        for(int j=0;j<n;j++){
+            if(fabs(in[j]) > max_input_to_softmax){
+                max_input_to_softmax = fabs(in[j]);
             }
         }
-        // Apply non-linear activation function to the weighted sums
-        if(k == nn->n_layers-1){
-            if(strcmp(loss, "mse") == 0){
-                #pragma omp parallel for
-                for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-                    nn->out[k][j] = sigmoid(nn->in[k][j]);
-                }
-            }
-            else if(strcmp(loss, "ce") == 0){
-                double max_input_to_softmax = (double)INT_MIN;
-                #pragma omp parallel for reduction(max:max_input_to_softmax)
-                for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-                    if(fabs(nn->in[k][j]) > max_input_to_softmax){
-                        max_input_to_softmax = fabs(nn->in[k][j]);
-                    }
-                }
-                double deno = 0.0;
-                #pragma omp parallel for reduction(+:deno)
-                for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-                    nn->in[k][j] /= max_input_to_softmax;
-                    deno += exp(nn->in[k][j]);
-                }
-                #pragma omp parallel for
-                for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-                    nn->out[k][j] = (double)exp(nn->in[k][j])/(double)deno;
-                }
-            }
+        for(int j=0;j<n;j++){
+            in[j] /= max_input_to_softmax;
+            out[j] = exp(in[j]);
         }
-        else{
-            #pragma omp parallel for
-            for(int j=1;j<nn->n_neurons_per_layer[k]+1;j++){
-                if(strcmp(activation_fun, "sigmoid") == 0){
-                    nn->out[k][j] = sigmoid(nn->in[k][j]);
-                }
-                else if(strcmp(activation_fun, "tanh") == 0){
-                    nn->out[k][j] = tanh(nn->in[k][j]);
-                }
-                else if(strcmp(activation_fun, "relu") == 0){
-                    nn->out[k][j] = relu(nn->in[k][j]);
-                }
-                else{
-                    nn->out[k][j] = sigmoid(nn->in[k][j]);
-                }
-            }
+        // Fixed-shape sum, so the softmax does not depend on the thread count
+        double deno = reduceSum(out, n);
+        for(int j=0;j<n;j++){
+            out[j] /= deno;
         }
     }
 }
 
 
-// Function to calculate loss
-double calc_loss(struct NeuralNet* nn, char* loss){
+// Output layer activation (a handful of neurons, one thread)
+void output_layer(struct NeuralNet* nn, char* loss){
+    int k = nn->n_layers-1;
+    output_activation(&nn->in[k][1], &nn->out[k][1], nn->n_neurons_per_layer[k], loss);
+}
+
+
+// Called by every thread of the team, with the input already in out[0]
+void forward_propagation(struct NeuralNet* nn, char* activation_fun, char* loss, int tid){
+    for(int k=1;k<nn->n_layers;k++){
+        struct LayerWork work = {nn, k, activation_fun, NULL, 0.0};
+        teamFor(&team, tid, nn->n_neurons_per_layer[k], 0, forward_neurons, &work);
+    }
+    if(tid == 0){
+        output_layer(nn, loss);
+    }
+    teamBarrier(&team, tid);
+}
+
+
+// Loss of n outputs out[0..n) against targets[0..n)
+double row_loss(const double* out, const double* targets, int n, char* loss){
     double loss_val = 0.0;
-    int last_layer = nn->n_layers-1;
-    for(int i=1;i<nn->n_neurons_per_layer[last_layer]+1;i++){
+    for(int i=0;i<n;i++){
         if(strcmp(loss, "mse") == 0){
-            loss_val += (0.5)*(nn->out[last_layer][i] - nn->targets[i]) * (nn->out[last_layer][i] - nn->targets[i]);
+            loss_val += (0.5)*(out[i] - targets[i]) * (out[i] - targets[i]);
         }
         else if(strcmp(loss, "ce") == 0){
-            loss_val -= nn->targets[i]*(log(nn->out[last_layer][i]));
+            loss_val -= targets[i]*(log(out[i]));
         }
-	}
+    }
     return loss_val;
 }
 
 
-#include <omp.h>
+// Function to calculate loss
+double calc_loss(struct NeuralNet* nn, char* loss){
+    int last_layer = nn->n_layers-1;
+    return row_loss(&nn->out[last_layer][1], &nn->targets[1], nn->n_neurons_per_layer[last_layer], loss);
+}
 
-// Function for back propagation step
-void back_propagation(struct NeuralNet* nn, char* activation_fun, double learning_rate, char* loss, char* opt, int itr) {
-    int last_layer = nn->n_layers - 1;
 
-    // Calculate the error in the output layer
-    #pragma omp parallel for
-    for (int i = 1; i < nn->n_neurons_per_layer[last_layer] + 1; i++) {
+// Errors of neurons [begin, end) of hidden layer k from those of layer k+1
+void delta_neurons(void* ctx, long begin, long end){
+    struct LayerWork* work = ctx;
+    struct NeuralNet* nn = work->nn;
+    int k = work->k;
+    for (int i = begin + 1; i < end + 1; i++) {
+        double sum = 0.0;
+        for (int j = 1; j < nn->n_neurons_per_layer[k + 1] + 1; j++) {
+            sum += nn->b[k][j] * nn->delta[k + 1][j];
+            sum += nn->w[k][i][j] * nn->delta[k + 1][j];
+        }
         double grad;
-        if (strcmp(loss, "mse") == 0) {
-            grad = sigmoid_d(nn->out[last_layer][i]);
-        } else if (strcmp(loss, "ce") == 0) {
-            grad = 1.0; // No need to compute the gradient explicitly
+        if (strcmp(work->activation_fun, "sigmoid") == 0) {
+            grad = sigmoid_d(nn->out[k][i]);
+        } else if (strcmp(work->activation_fun, "tanh") == 0) {
+            grad = tanh_d(nn->out[k][i]);
+        } else if (strcmp(work->activation_fun, "relu") == 0) {
+            grad = relu_d(nn->out[k][i]);
+        } else {
+            grad = sigmoid_d(nn->out[k][i]);
         }
-        nn->delta[last_layer][i] = grad * (nn->out[last_layer][i] - nn->targets[i]);
+        nn->delta[k][i] = grad * sum;
     }
+}
 
-    // Backpropagate the error from the last layer to the first layer
-    for (int k = nn->n_layers - 2; k > 0; k--) {
-        #pragma omp parallel for
-        for (int i = 1; i < nn->n_neurons_per_layer[k] + 1; i++) {
-            double sum = 0.0;
-            for (int j = 1; j < nn->n_neurons_per_layer[k + 1] + 1; j++) {
-                sum += nn->b[k][j] * nn->delta[k + 1][j];
-                sum += nn->w[k][i][j] * nn->delta[k + 1][j];
-            }
-            double grad;
-            if (strcmp(activation_fun, "sigmoid") == 0) {
-                grad = sigmoid_d(nn->out[k][i]);
-            } else if (strcmp(activation_fun, "tanh") == 0) {
-                grad = tanh_d(nn->out[k][i]);
-            } else if (strcmp(activation_fun, "relu") == 0) {
-                grad = relu_d(nn->out[k][i]);
-            } else {
-                grad = sigmoid_d(nn->out[k][i]);
-            }
-            nn->delta[k][i] = grad * sum;
-        }
-    }
 
-    // Update the weights according to the given optimization technique
-    #pragma omp parallel for collapse(3)
-    for (int k = 0; k < nn->n_layers - 1; k++) {
-        for (int i = 1; i < nn->n_neurons_per_layer[k] + 1; i++) {
-            for (int j = 1; j < nn->n_neurons_per_layer[k + 1] + 1; j++) {
-                double dw = nn->delta[k + 1][j] * nn->out[k][i];
-                // Update weights based on optimization technique
-                if (strcmp(opt, "sgd") == 0) {
-                    nn->w[k][i][j] -= learning_rate * dw;
-                } else if (strcmp(opt, "momentum") == 0) {
-                    // Add your implementation for momentum optimization
-                } else if (strcmp(opt, "rmsprop") == 0) {
-                    // Add your implementation for RMSprop optimization
-                } else if (strcmp(opt, "adam") == 0) {
-                    // Add your implementation for Adam optimization
-                }
-            }
+// Rows [begin, end) of all weight matrices laid end to end; row 0 of
+// layer k updates its bias weights
+void update_rows(void* ctx, long begin, long end){
+    struct LayerWork* work = ctx;
+    struct NeuralNet* nn = work->nn;
+    char* opt = work->opt;
+    double learning_rate = work->learning_rate;
+    int k = 0;
+    long first = 0;
+    for (long r = begin; r < end; r++) {
+        while (r >= first + nn->n_neurons_per_layer[k] + 1) {
+            first += nn->n_neurons_per_layer[k] + 1;
+            k++;
         }
-        // Update the bias weights
-        #pragma omp parallel for
+        int i = r - first;
         for (int j = 1; j < nn->n_neurons_per_layer[k + 1] + 1; j++) {
-            double db = nn->delta[k + 1][j] * 1.0;
-            // Update bias weights based on optimization technique
+            // Update bias weights, or weights, based on optimization technique
+            double d = nn->delta[k + 1][j] * (i == 0 ? 1.0 : nn->out[k][i]);
+            double* target = i == 0 ? &nn->b[k][j] : &nn->w[k][i][j];
             if (strcmp(opt, "sgd") == 0) {
-                nn->b[k][j] -= learning_rate * db;
+                *target -= learning_rate * d;
             } else if (strcmp(opt, "momentum") == 0) {
                 // Add your implementation for momentum optimization
             } else if (strcmp(opt, "rmsprop") == 0) {
@@ -326,46 +350,95 @@ void back_propagation(struct NeuralNet* nn, char* activation_fun, double learnin
 }
 
 
+// Function for back propagation step, called by every thread of the team
+void back_propagation(struct NeuralNet* nn, char* activation_fun, double learning_rate, char* loss, char* opt, int itr, int tid) {
+    int last_layer = nn->n_layers - 1;
 
-// Function to train the model for 1 epoch
-double* model_train(struct NeuralNet* nn, double** X_train, double** y_train, double* y_train_temp, 
-                    char* activation_fun, char* loss, char* opt, double learning_rate,
-                    int num_samples_to_train, int itr){     
-    int arr[N_SAMPLES];
-    for(int i=0;i<N_SAMPLES;i++){
-        arr[i] = i;
+    // Calculate the error in the output layer
+    if (tid == 0) {
+        for (int i = 1; i < nn->n_neurons_per_layer[last_layer] + 1; i++) {
+            double grad;
+            if (strcmp(loss, "mse") == 0) {
+                grad = sigmoid_d(nn->out[last_layer][i]);
+            } else if (strcmp(loss, "ce") == 0) {
+                grad = 1.0; // No need to compute the gradient explicitly
+            }
+            nn->delta[last_layer][i] = grad * (nn->out[last_layer][i] - nn->targets[i]);
+        }
+    }
+    teamBarrier(&team, tid);
+
+    // Backpropagate the error from the last layer to the first layer
+    for (int k = nn->n_layers - 2; k > 0; k--) {
+        struct LayerWork work = {nn, k, activation_fun, opt, learning_rate};
+        teamFor(&team, tid, nn->n_neurons_per_layer[k], 0, delta_neurons, &work);
     }
-    shuffle(arr, N_SAMPLES);
-    int shuffler[num_samples_to_train];
-    for(int i=0;i<num_samples_to_train;i++){
-        shuffler[i] = arr[i];
+
+    // Update the weights according to the given optimization technique
+    long rows = 0;
+    for (int k = 0; k < nn->n_layers - 1; k++) {
+        rows += nn->n_neurons_per_layer[k] + 1;
     }
+    struct LayerWork work = {nn, 0, activation_fun, opt, learning_rate};
+    teamFor(&team, tid, rows, 0, update_rows, &work);
+}
+
+
+
+// Function to train the model for 1 epoch. The first num_samples_to_train
+// samples of the epoch's permutation arrive in batches gathered by the
+// prefetcher. One parallel region covers all the samples; the master points
+// the input and target layers at each gathered row and scores the output.
+double* model_train(struct NeuralNet* nn, double* y_train_temp, Sampler* sampler, Prefetcher* prefetch,
+                    char* activation_fun, char* loss, char* opt, double learning_rate,
+                    int num_samples_to_train, int itr){     
+    int* order = malloc(N_SAMPLES*sizeof(int));
+    samplerPermute(sampler, itr, order);
+    prefetchEpoch(prefetch, order, num_samples_to_train);
+    double* input = nn->out[0];
+    double* targets = nn->targets;
     int correct = 0;
     double loss_val = 0.0;
-    for(int i=0;i<num_samples_to_train;i++){
-        shuffle(shuffler, num_samples_to_train);
-        int idx = -1;
-        double max_val = (double)INT_MIN;
-        for(int j=1;j<nn->n_neurons_per_layer[0]+1;j++){
-            nn->out[0][j] = X_train[arr[i]][j-1];
-        }
-        for(int j=1;j<nn->n_neurons_per_layer[nn->n_layers-1]+1;j++){
-            nn->targets[j] = y_train[arr[i]][j-1];
-        }
-        forward_propagation(nn, activation_fun, loss);
-        back_propagation(nn, activation_fun, learning_rate, loss, opt, itr);
-        loss_val += calc_loss(nn, loss);
-            
-        for(int j=1;j<nn->n_neurons_per_layer[nn->n_layers-1]+1;j++){
-            if(nn->out[nn->n_layers-1][j] > max_val){
-                max_val =nn->out[nn->n_layers-1][j];
-                idx = j-1;
+    #pragma omp parallel num_threads(team.n_threads)
+    {
+        int tid = teamJoin(&team);
+        const MiniBatch* batch = NULL;
+        int r = 0;
+        for(int i=0;i<num_samples_to_train;i++){
+            if(tid == 0){
+                if(batch == NULL){
+                    batch = prefetchNext(prefetch);
+                    r = 0;
+                }
+                nn->out[0] = batch->x + r*prefetch->x_stride;
+                nn->targets = batch->y + r*prefetch->y_stride;
+            }
+            teamBarrier(&team, tid);
+            forward_propagation(nn, activation_fun, loss, tid);
+            back_propagation(nn, activation_fun, learning_rate, loss, opt, itr, tid);
+            if(tid == 0){
+                int idx = -1;
+                double max_val = (double)INT_MIN;
+                loss_val += calc_loss(nn, loss);
+                for(int j=1;j<nn->n_neurons_per_layer[nn->n_layers-1]+1;j++){
+                    if(nn->out[nn->n_layers-1][j] > max_val){
+                        max_val =nn->out[nn->n_layers-1][j];
+                        idx = j-1;
+                    }
+                }
+                if(idx == (int)y_train_temp[batch->ids[r]]){
+                    correct++;
+                }
+                if(++r == batch->rows){
+                    prefetchRelease(prefetch);
+                    batch = NULL;
+                }
             }
-        }
-        if(idx == (int)y_train_temp[arr[i]]){
-            correct++;
         }
     }
+    nn->out[0] = input;
+    nn->targets = targets;
+    free(order);
     loss_val /=(double)num_samples_to_train;
     double accuracy = (double)correct/(double)num_samples_to_train;
     static double metrics[2];
@@ -375,54 +448,267 @@ double* model_train(struct NeuralNet* nn, double** X_train, double** y_train, do
 }
 
 
-// Function to test the model
-double* model_test(struct NeuralNet* nn, double** X_test, double** y_test, double* y_test_temp, char* activation_fun, char* loss){
-    int correct = 0;
-    double loss_val = 0.0;
-    for(int i=0;i<N_TEST_SAMPLES;i++){
-        int idx = -1;
-        double max_val = (double)INT_MIN;
+// Samples per evaluation batch; a batch's activations stay in the
+// thread's scratch while each weight row is read once for all of them
+#define TEST_BATCH 32
+
+
+// Read-only view of the network and the test set for the batches
+struct TestSet{
+    const struct NeuralNet* nn;
+    double** X;
+    double** y;
+    double (*activation)(double);
+    char* loss;
+    int width;
+};
+
+
+// Forward pass of samples [begin, end) through two TEST_BATCH x width
+// blocks of scratch, rows 1-based like the network's buffers. Each sum adds
+// the bias and then the inputs in order, as forward_propagation does.
+void test_batch(const void* ctx, void* scratch, long begin, long end, int* pred, double* loss_out){
+    const struct TestSet* set = ctx;
+    const struct NeuralNet* nn = set->nn;
+    int width = set->width;
+    int rows = end - begin;
+    double* cur = scratch;
+    double* next = cur + (size_t)TEST_BATCH*width;
+    for(int r=0;r<rows;r++){
         for(int j=1;j<nn->n_neurons_per_layer[0]+1;j++){
-            nn->out[0][j] = X_test[i][j-1];
+            cur[r*width+j] = set->X[begin+r][j-1];
+        }
+    }
+    for(int k=1;k<nn->n_layers;k++){
+        int n = nn->n_neurons_per_layer[k];
+        for(int r=0;r<rows;r++){
+            for(int j=1;j<n+1;j++){
+                next[r*width+j] = 1.0 * nn->b[k-1][j];
+            }
+        }
+        for(int i=1;i<nn->n_neurons_per_layer[k-1]+1;i++){
+            const double* w = nn->w[k-1][i];
+            for(int r=0;r<rows;r++){
+                double x = cur[r*width+i];
+                double* in = next + r*width;
+                for(int j=1;j<n+1;j++){
+                    in[j] += x * w[j];
+                }
+            }
         }
-        for(int j=1;j<nn->n_neurons_per_layer[nn->n_layers-1]+1;j++){
-            nn->targets[j] = y_test[i][j-1];
+        if(k < nn->n_layers-1){
+            for(int r=0;r<rows;r++){
+                for(int j=1;j<n+1;j++){
+                    next[r*width+j] = set->activation(next[r*width+j]);
+                }
+            }
         }
-        forward_propagation(nn, activation_fun, loss);
-        loss_val += calc_loss(nn, loss);
-            
-        for(int j=1;j<nn->n_neurons_per_layer[nn->n_layers-1]+1;j++){
-            if(nn->out[nn->n_layers-1][j] > max_val){
-                max_val =nn->out[nn->n_layers-1][j];
+        double* swap = cur;
+        cur = next;
+        next = swap;
+    }
+    // cur holds the output layer's weighted sums; next takes its activations
+    int n_out = nn->n_neurons_per_layer[nn->n_layers-1];
+    for(int r=0;r<rows;r++){
+        double* out = next + r*width;
+        output_activation(cur + r*width + 1, out + 1, n_out, set->loss);
+        loss_out[r] = row_loss(out + 1, set->y[begin+r], n_out, set->loss);
+        int idx = -1;
+        double max_val = (double)INT_MIN;
+        for(int j=1;j<n_out+1;j++){
+            if(out[j] > max_val){
+                max_val = out[j];
                 idx = j-1;
             }
         }
-        if(idx == (int)y_test_temp[i]){
-            correct++;
+        pred[r] = idx;
+    }
+}
+
+
+// Function to test the model: batched forward passes over the test set in
+// parallel, with per-class accuracy in the report (free with evalFree)
+void model_test(struct NeuralNet* nn, double** X_test, double** y_test, double* y_test_temp, char* activation_fun, char* loss, EvalReport* report){
+    struct TestSet set = {nn, X_test, y_test, sigmoid, loss, 0};
+    if(strcmp(activation_fun, "tanh") == 0){
+        set.activation = tanh;
+    }
+    else if(strcmp(activation_fun, "relu") == 0){
+        set.activation = relu;
+    }
+    for(int k=0;k<nn->n_layers;k++){
+        if(nn->n_neurons_per_layer[k]+1 > set.width){
+            set.width = nn->n_neurons_per_layer[k]+1;
         }
     }
-    loss_val /= (double)N_TEST_SAMPLES;
-    double accuracy = (double)correct/(double)N_TEST_SAMPLES;
-    static double metrics[2];
-    metrics[0] = loss_val;
-    metrics[1] = accuracy;
-    return metrics;
+    int* labels = malloc(N_TEST_SAMPLES*sizeof(int));
+    for(int i=0;i<N_TEST_SAMPLES;i++){
+        labels[i] = (int)y_test_temp[i];
+    }
+    size_t scratch = 2*(size_t)TEST_BATCH*set.width*sizeof(double);
+    if(evalRun(report, test_batch, &set, N_TEST_SAMPLES, TEST_BATCH, scratch, labels, N_CLASSES) != 0){
+        exit(1);
+    }
+    free(labels);
 }
 
 
-int main(){
+// n_rows row pointers into one contiguous n_rows x n_cols block of the arena
+double** arena_rows(Arena* arena, int n_rows, int n_cols){
+    double** rows = arenaAlloc(arena, n_rows*sizeof(double*), 0);
+    double* block = arenaAlloc(arena, (size_t)n_rows*n_cols*sizeof(double), 0);
+    for(int i=0;i<n_rows;i++){
+        rows[i] = block + (size_t)i*n_cols;
+    }
+    return rows;
+}
+
+
+// Copy a jagged rows x cols block into one contiguous buffer
+double* pack_rows(double** rows, int n_rows, int n_cols){
+    double* packed = malloc((size_t)n_rows*n_cols*sizeof(double));
+    for(int i=0;i<n_rows;i++){
+        memcpy(packed + (size_t)i*n_cols, rows[i], n_cols*sizeof(double));
+    }
+    return packed;
+}
+
+
+void unpack_rows(double** rows, const double* packed, int n_rows, int n_cols){
+    for(int i=0;i<n_rows;i++){
+        memcpy(rows[i], packed + (size_t)i*n_cols, n_cols*sizeof(double));
+    }
+}
+
+
+// Save weights, biases, both optimizer moments, the epoch/step counters, the
+// randn() state and the sample order seed. The writer copies the tensors, so the packed buffers can
+// be freed as soon as the snapshot is submitted.
+void save_checkpoint(struct NeuralNet* nn, CkptWriter* writer, const char* path, int epoch, long step){
+    Checkpoint ckpt;
+    char name[CKPT_NAME_LEN];
+    double* packed[3*(nn->n_layers-1)];
+    int n_packed = 0;
+    ckptInit(&ckpt, epoch, step);
+    ckpt.header.rng[0] = (uint64_t)(unsigned int)seed;
+    ckpt.header.rng[1] = sample_seed;
+    ckptAdd1(&ckpt, "n_neurons_per_layer", CKPT_I32, nn->n_layers, nn->n_neurons_per_layer);
+    for(int k=0;k<nn->n_layers-1;k++){
+        int rows = nn->n_neurons_per_layer[k]+1;
+        int cols = nn->n_neurons_per_layer[k+1]+1;
+        double*** tensors[3] = {nn->w, nn->momentum_w, nn->momentum2_w};
+        const char* names[3] = {"w", "momentum_w", "momentum2_w"};
+        for(int t=0;t<3;t++){
+            packed[n_packed] = pack_rows(tensors[t][k], rows, cols);
+            snprintf(name, sizeof(name), "%s%d", names[t], k);
+            ckptAdd2(&ckpt, name, CKPT_F64, rows, cols, packed[n_packed]);
+            n_packed++;
+        }
+        snprintf(name, sizeof(name), "b%d", k);
+        ckptAdd1(&ckpt, name, CKPT_F64, rows, nn->b[k]);
+        snprintf(name, sizeof(name), "momentum_b%d", k);
+        ckptAdd1(&ckpt, name, CKPT_F64, rows, nn->momentum_b[k]);
+        snprintf(name, sizeof(name), "momentum2_b%d", k);
+        ckptAdd1(&ckpt, name, CKPT_F64, rows, nn->momentum2_b[k]);
+    }
+    if(writer){
+        ckptWriterSubmit(writer, &ckpt, path);
+    }
+    else{
+        ckptWrite(&ckpt, path);
+    }
+    for(int i=0;i<n_packed;i++){
+        free(packed[i]);
+    }
+}
+
+
+// Rebuild a network from a checkpoint. Returns NULL if the file is missing or
+// inconsistent; epoch and step receive the saved counters.
+struct NeuralNet* load_checkpoint(const char* path, int* epoch, long* step){
+    CkptMap map;
+    if(ckptOpen(&map, path) != 0){
+        return NULL;
+    }
+    const CkptEntry* entry = ckptFind(&map, "n_neurons_per_layer");
+    int n_layers = entry ? (int)entry->shape[0] : 0;
+    const int* layers = entry ? ckptTensor(&map, "n_neurons_per_layer", CKPT_I32, n_layers) : NULL;
+    if(layers == NULL){
+        ckptClose(&map);
+        return NULL;
+    }
+    int n_neurons_per_layer[n_layers];
+    memcpy(n_neurons_per_layer, layers, n_layers*sizeof(int));
+    struct NeuralNet* nn = newNet(n_layers, n_neurons_per_layer);
+
+    char name[CKPT_NAME_LEN];
+    int ok = 1;
+    for(int k=0;k<n_layers-1 && ok;k++){
+        int rows = n_neurons_per_layer[k]+1;
+        int cols = n_neurons_per_layer[k+1]+1;
+        double*** tensors[3] = {nn->w, nn->momentum_w, nn->momentum2_w};
+        const char* names[3] = {"w", "momentum_w", "momentum2_w"};
+        for(int t=0;t<3 && ok;t++){
+            snprintf(name, sizeof(name), "%s%d", names[t], k);
+            const double* packed = ckptTensor(&map, name, CKPT_F64, (long)rows*cols);
+            if(packed){
+                unpack_rows(tensors[t][k], packed, rows, cols);
+            }
+            ok = ok && packed != NULL;
+        }
+        double** vectors[3] = {nn->b, nn->momentum_b, nn->momentum2_b};
+        const char* vnames[3] = {"b", "momentum_b", "momentum2_b"};
+        for(int t=0;t<3 && ok;t++){
+            snprintf(name, sizeof(name), "%s%d", vnames[t], k);
+            const double* data = ckptTensor(&map, name, CKPT_F64, rows);
+            if(data){
+                memcpy(vectors[t][k], data, rows*sizeof(double));
+            }
+            ok = ok && data != NULL;
+        }
+    }
+    if(!ok){
+        free_NN(nn);
+        ckptClose(&map);
+        return NULL;
+    }
+    seed = (int)map.header->rng[0];
+    sample_seed = map.header->rng[1];
+    *epoch = (int)map.header->epoch;
+    *step = (long)map.header->step;
+    ckptClose(&map);
+    return nn;
+}
+
+
+int main(int argc, char** argv){
 
     // Used for setting a random seed
     srand(time(NULL));
     int seed = rand();
+    sample_seed = (uint64_t)(unsigned int)seed;
 
     // Initialize neural network architecture parameters
     int n_layers = 4;
     int n_neurons_per_layer[] = {784, 64, 32, 10};
 
-    // Create and initialize the neural network
-    struct NeuralNet* nn = newNet(n_layers, n_neurons_per_layer);
-    init_nn(nn);
+    // Create and initialize the neural network, or resume it from the
+    // checkpoint given on the command line
+    struct NeuralNet* nn;
+    int start_epoch = 0;
+    long step = 0;
+    if(argc > 1){
+        nn = load_checkpoint(argv[1], &start_epoch, &step);
+        if(nn == NULL){
+            printf("Error restoring checkpoint %s\n", argv[1]);
+            exit(1);
+        }
+        start_epoch++;
+    }
+    else{
+        nn = newNet(n_layers, n_neurons_per_layer);
+        init_nn(nn);
+    }
 
     // Initialize the learning rate, optimizer, loss, and other hyper-parameters
     double learning_rate = 1e-4;
@@ -433,44 +719,51 @@ int main(){
     int num_samples_to_train = 10000;
     int epochs = 5;
 
-    // Fetch the training and test data and pre-process them
-    double** X_train = malloc(N_SAMPLES*sizeof(double*));
-    for(int i=0;i<N_SAMPLES;i++){
-        X_train[i] = malloc(N_DIMS*sizeof(double));
-    }
-    double** y_train = malloc(N_SAMPLES * sizeof(double*));
-    for(int i=0;i<N_SAMPLES;i++){
-        y_train[i] = malloc(N_CLASSES * sizeof(double));
-    }
-    double* y_train_temp = malloc(N_SAMPLES*sizeof(double));
+    // Fetch the training and test data and pre-process them. Every sample
+    // row is carved out of one arena that lives for the whole run.
+    Arena data_arena;
+    arenaInit(&data_arena, "data", 0, ARENA_HUGE_THP);
+    double** X_train = arena_rows(&data_arena, N_SAMPLES, N_DIMS);
+    double** y_train = arena_rows(&data_arena, N_SAMPLES, N_CLASSES);
+    double* y_train_temp = arenaAlloc(&data_arena, N_SAMPLES*sizeof(double), 0);
     read_csv_file(X_train, y_train_temp, y_train, "train");
     scale_data(X_train, "train");
 
-    double** X_test = malloc(N_TEST_SAMPLES*sizeof(double*));
-    for(int i=0;i<N_TEST_SAMPLES;i++){
-        X_test[i] = malloc(N_DIMS*sizeof(double));
-    }
-    double** y_test = malloc(N_TEST_SAMPLES * sizeof(double*));
-    for(int i=0;i<N_TEST_SAMPLES;i++){
-        y_test[i] = malloc(N_CLASSES * sizeof(double));
-    }
-    double* y_test_temp = malloc(N_TEST_SAMPLES*sizeof(double));
+    double** X_test = arena_rows(&data_arena, N_TEST_SAMPLES, N_DIMS);
+    double** y_test = arena_rows(&data_arena, N_TEST_SAMPLES, N_CLASSES);
+    double* y_test_temp = arenaAlloc(&data_arena, N_TEST_SAMPLES*sizeof(double), 0);
     read_csv_file(X_test, y_test_temp, y_test, "test");
     scale_data(X_test, "test");
     normalize_data(X_train, X_test);
 
     // Initialize file to store metrics info for each epoch
-    FILE* file = fopen("metrics_64_32.txt", "w");
-    fprintf(file, "train_loss,train_acc,test_loss,test_acc\n");
+    FILE* file = fopen("metrics_64_32.txt", start_epoch > 0 ? "a" : "w");
+    if(start_epoch == 0){
+        fprintf(file, "train_loss,train_acc,test_loss,test_acc\n");
+    }
+    CkptWriter writer;
+    ckptWriterStart(&writer);
+    for(int itr=0;itr<start_epoch;itr++){
+        learning_rate = init_lr * exp(-0.1 * (itr+1));
+    }
     
     // Train the model for given number of epoch and test it after every epoch
-    for(int itr=0;itr<epochs;itr++){
-        double* train_metrics = model_train(nn, X_train, y_train, y_train_temp, activation_fun, loss, opt, learning_rate, num_samples_to_train, itr+1);
+    teamInit(&team, 0);
+    Sampler sampler;
+    samplerInit(&sampler, N_SAMPLES, sample_seed);
+    Prefetcher prefetch;
+    if(prefetchStart(&prefetch, X_train, y_train, N_DIMS, N_CLASSES, 1, TRAIN_BATCH) != 0){
+        exit(1);
+    }
+    double train_start = omp_get_wtime();
+    for(int itr=start_epoch;itr<epochs;itr++){
+        double* train_metrics = model_train(nn, y_train_temp, &sampler, &prefetch, activation_fun, loss, opt, learning_rate, num_samples_to_train, itr+1);
         double train_loss = train_metrics[0];
         double train_acc = train_metrics[1];
-        double* test_metrics = model_test(nn, X_test, y_test, y_test_temp, activation_fun, loss);
-        double test_loss = test_metrics[0];
-        double test_acc = test_metrics[1];
+        EvalReport test_report;
+        model_test(nn, X_test, y_test, y_test_temp, activation_fun, loss, &test_report);
+        double test_loss = test_report.loss;
+        double test_acc = test_report.accuracy;
 
         fprintf(file, "%lf,", train_loss);
         fprintf(file, "%lf,", train_acc);
@@ -482,16 +775,29 @@ int main(){
         printf("Train Accuracy: %lf, ", train_acc);
         printf("Test loss: %lf, ", test_loss);
         printf("Test Accuracy: %lf\n", test_acc);
+        if(itr == epochs-1){
+            evalPrint(&test_report, "Test", stdout);
+        }
+        evalFree(&test_report);
 
         learning_rate = init_lr * exp(-0.1 * (itr+1));
 
+        // Checkpoint after every epoch, written in the background
+        step += num_samples_to_train;
+        save_checkpoint(nn, &writer, "nn_ckpt.bin", itr, step);
     }
+    ckptWriterStop(&writer);
+    teamReport(&team, stdout, omp_get_wtime() - train_start);
+    prefetchReport(&prefetch, stdout);
+    prefetchStop(&prefetch);
 
     // Close the file
     fclose(file);
 
     // Free the dynamically allocated memory
     free_NN(nn);
+    arenaReport(&data_arena, stdout);
+    arenaRelease(&data_arena);
 
     return 0;
 }
@@ -1,94 +1,355 @@
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 #include<omp.h>
+#include "dataset.h"
+#include "reduce.h"
+
+// Linear baseline on the raw node features (no graph).
+// Usage: test [dataset_dir] [epochs] [regression|logistic] [gd|normal]
+//   regression -> y = x . w + b against the label value, mean squared error
+//   logistic   -> one weight vector per class, softmax cross-entropy
+// gd trains with Adam on full-batch gradients; normal solves the ridge
+// normal equations (X^T X + lambda I) W = X^T Y with a Cholesky factorization
+// instead (for logistic, against one-hot targets). X is row-major, so every
+// output column is a GEMV over contiguous rows.
 
 // Hyperparameters
 #define learning_rate 0.001
 #define beta1 0.9
 #define beta2 0.999
 #define epsilon 1e-8
+#define ridge 1e-3
+
+#define row_block 64
+#define grad_rows 256
+
+
+typedef struct Linear {
+    int cols;       // features per row
+    int outputs;    // 1 for regression, classes for logistic
+    int logistic;
+    double *w;      // outputs x cols, one contiguous weight vector per output
+    double *b;      // outputs
+    double *grad_w;
+    double *grad_b;
+    double *m;      // Adam moments over w then b
+    double *v;
+    long t;
+} Linear;
+
+
+void init_linear(Linear *model, int cols, int outputs, int logistic) {
+    model->cols = cols;
+    model->outputs = outputs;
+    model->logistic = logistic;
+    long params = (long)outputs * (cols + 1);
+    model->w = (double *)calloc(params, sizeof(double));
+    model->b = model->w + (size_t)outputs * cols;
+    model->grad_w = (double *)calloc(params, sizeof(double));
+    model->grad_b = model->grad_w + (size_t)outputs * cols;
+    model->m = (double *)calloc(params, sizeof(double));
+    model->v = (double *)calloc(params, sizeof(double));
+    model->t = 0;
+}
+
 
+void free_linear(Linear *model) {
+    free(model->w);
+    free(model->grad_w);
+    free(model->m);
+    free(model->v);
+}
 
 
-double loss_cal(double* y_true, double* y_pred) {   //Calculating Loss 
-    double sum = 0.0;
-    for (int i = 0; i < 19717; i++) {
-        double diff = y_true[i] - y_pred[i];
-        sum += diff * diff;
+// y_pred (rows x outputs) = x * w^T + b, a GEMV per output over row blocks
+void linear_regression(const double *x, double *y_pred, const Linear *model, long rows) {
+    int cols = model->cols, outputs = model->outputs;
+    #pragma omp parallel for schedule(static)
+    for (long i0 = 0; i0 < rows; i0 += row_block) {
+        long i1 = i0 + row_block < rows ? i0 + row_block : rows;
+        for (int k = 0; k < outputs; ++k) {
+            const double *wk = model->w + (size_t)k * cols;
+            for (long i = i0; i < i1; ++i) {
+                const double *xi = x + (size_t)i * cols;
+                double sum = model->b[k];
+                #pragma omp simd reduction(+:sum)
+                for (int j = 0; j < cols; ++j) {
+                    sum += xi[j] * wk[j];
+                }
+                y_pred[(size_t)i * outputs + k] = sum;
+            }
+        }
     }
-    return sum / 19717;
 }
 
-void linear_regression(double** x, double* y_pred, double w, double b) {      // Calculating linear regression
-    //#pragma omp parallel for
-    for (int i = 0; i < 19717; i++) {
-        for(int j = 0; j < 500; j++)
-            y_pred[i] = w * x[i][j] + b;
+
+// Turns y_pred into the residual d(loss)/d(prediction) per row and returns
+// the loss: mean squared error, or the mean cross-entropy of the softmax.
+// Row losses are summed with reduceSum, so the loss curve is the same for
+// any thread count.
+double loss_cal(const int *labels, double *y_pred, const Linear *model, long rows) {
+    int outputs = model->outputs;
+    double *row_loss = (double *)malloc(rows * sizeof(double));
+    #pragma omp parallel for schedule(static)
+    for (long i = 0; i < rows; i++) {
+        double *zi = y_pred + (size_t)i * outputs;
+        if (!model->logistic) {
+            double diff = zi[0] - labels[i];
+            row_loss[i] = diff * diff;
+            zi[0] = 2 * diff;
+            continue;
+        }
+        double zmax = zi[0], deno = 0.0;
+        for (int k = 1; k < outputs; ++k) {
+            zmax = zi[k] > zmax ? zi[k] : zmax;
+        }
+        for (int k = 0; k < outputs; ++k) {
+            zi[k] = exp(zi[k] - zmax);
+            deno += zi[k];
+        }
+        for (int k = 0; k < outputs; ++k) {
+            zi[k] /= deno;
+        }
+        row_loss[i] = -log(zi[labels[i]] > 1e-300 ? zi[labels[i]] : 1e-300);
+        zi[labels[i]] -= 1.0;
     }
+    double sum = reduceSum(row_loss, rows);
+    free(row_loss);
+    return sum / rows;
 }
 
 
-void compute_gradients(double** x, double* y_true, double* y_pred, double* gradient_w, double* gradient_b) {
-   //#pragma omp parallel for                                     // Calculating gradient descent to miminize loss
-    for (int i = 0; i < 19717; i++) {
-        for(int j = 0; j < 500; j++){
-        double diff = y_true[i] - y_pred[i];
-        gradient_w[0] += -2* x[i][j] * diff;
-        gradient_b[0] +=  -2 * diff;
+// grad_w[k] = x^T residual[:, k] / rows. Every block of grad_rows rows
+// sums into its own partial and the partials are added pairwise, so the
+// gradient (and the whole loss curve) is the same for any thread count.
+void compute_gradients(const double *x, const double *residual, Linear *model, long rows) {
+    int cols = model->cols, outputs = model->outputs;
+    long params = (long)outputs * (cols + 1);
+    long blocks = (rows + grad_rows - 1) / grad_rows;
+    double *partial = (double *)calloc((size_t)blocks * params, sizeof(double));
+    #pragma omp parallel for schedule(static)
+    for (long blk = 0; blk < blocks; blk++) {
+        double *p = partial + (size_t)blk * params;
+        long end = (blk + 1) * grad_rows < rows ? (blk + 1) * grad_rows : rows;
+        for (long i = blk * grad_rows; i < end; i++) {
+            const double *xi = x + (size_t)i * cols;
+            for (int k = 0; k < outputs; ++k) {
+                double r = residual[(size_t)i * outputs + k];
+                double *pk = p + (size_t)k * cols;
+                #pragma omp simd
+                for (int j = 0; j < cols; ++j) {
+                    pk[j] += r * xi[j];
+                }
+                p[(size_t)outputs * cols + k] += r;
+            }
         }
-}   
-    gradient_w[0] /= 19717;
-    gradient_b[0] /= 19717;
+    }
+    reducePairwiseRows(partial, blocks, params);
+    for (long e = 0; e < params; ++e) {
+        model->grad_w[e] = partial[e] / rows;
+    }
+    free(partial);
 }
 
-int main() {
 
-    FILE *file;
-    file = fopen("/home/anubhav/GraphNN/GNN/pubmed/features.txt", "r");         // reading the dataset  
-    int rows = 19717;
-    int cols = 500;
+void adam_update(Linear *model) {
+    long params = (long)model->outputs * (model->cols + 1);
+    model->t++;
+    double c1 = 1.0 - pow(beta1, (double)model->t), c2 = 1.0 - pow(beta2, (double)model->t);
+    #pragma omp parallel for simd schedule(static)
+    for (long e = 0; e < params; ++e) {
+        double g = model->grad_w[e];
+        model->m[e] = beta1 * model->m[e] + (1 - beta1) * g;
+        model->v[e] = beta2 * model->v[e] + (1 - beta2) * g * g;
+        model->w[e] -= learning_rate * (model->m[e] / c1) / (sqrt(model->v[e] / c2) + epsilon);
+    }
+}
+
 
-    double **x = (double **)malloc(rows * sizeof(double *));
-    for (int i = 0; i < rows; i++) {
-        x[i] = (double *)malloc(cols * sizeof(double));
+// In-place Cholesky of the n x n SPD matrix A (lower triangle); 1 if A is
+// not positive definite
+int cholesky(double *A, int n) {
+    for (int j = 0; j < n; ++j) {
+        double *aj = A + (size_t)j * n;
+        double d = aj[j];
+        for (int k = 0; k < j; ++k) {
+            d -= aj[k] * aj[k];
+        }
+        if (d <= 0.0) {
+            return 1;
+        }
+        aj[j] = sqrt(d);
+        #pragma omp parallel for schedule(static)
+        for (int i = j + 1; i < n; ++i) {
+            double *ai = A + (size_t)i * n;
+            double s = ai[j];
+            for (int k = 0; k < j; ++k) {
+                s -= ai[k] * aj[k];
+            }
+            ai[j] = s / aj[j];
+        }
     }
-   for (int i = 0; i < rows; i++) {
-        for (int j = 0; j < cols; j++) {
-            if (fscanf(file, "%lf", &x[i][j]) != 1) {
-                fprintf(stderr, "Error reading data from the file\n");
-                return 1;
+    return 0;
+}
+
+
+// Solve L L^T z = rhs in place for one right-hand side
+void cholesky_solve(const double *L, int n, double *z) {
+    for (int i = 0; i < n; ++i) {
+        double s = z[i];
+        for (int k = 0; k < i; ++k) {
+            s -= L[(size_t)i * n + k] * z[k];
+        }
+        z[i] = s / L[(size_t)i * n + i];
+    }
+    for (int i = n - 1; i >= 0; --i) {
+        double s = z[i];
+        for (int k = i + 1; k < n; ++k) {
+            s -= L[(size_t)k * n + i] * z[k];
+        }
+        z[i] = s / L[(size_t)i * n + i];
+    }
+}
+
+
+// Ridge normal equations with the bias as an extra all-ones column. The
+// Gram matrix and X^T Y are built from per-thread partials (lower triangle).
+int normal_equations(const double *x, const int *labels, Linear *model, long rows) {
+    int cols = model->cols, outputs = model->outputs, n = cols + 1;
+    int nthreads = omp_get_max_threads();
+    size_t block = (size_t)n * n + (size_t)n * outputs;
+    double *partial = (double *)calloc(nthreads * block, sizeof(double));
+    double *A = (double *)calloc(block, sizeof(double));
+    double *B = A + (size_t)n * n;
+    #pragma omp parallel num_threads(nthreads)
+    {
+        double *pa = partial + omp_get_thread_num() * block, *pb = pa + (size_t)n * n;
+        #pragma omp for schedule(static)
+        for (long i = 0; i < rows; i++) {
+            const double *xi = x + (size_t)i * cols;
+            for (int r = 0; r < n; ++r) {
+                double xr = r < cols ? xi[r] : 1.0;
+                if (xr == 0.0) {
+                    continue;
+                }
+                double *row = pa + (size_t)r * n;
+                int below = r < cols ? r : cols;
+                #pragma omp simd
+                for (int c = 0; c < below; ++c) {
+                    row[c] += xr * xi[c];
+                }
+                if (r == cols) {
+                    row[cols] += 1.0;
+                } else {
+                    row[r] += xr * xr;
+                }
+                for (int k = 0; k < outputs; ++k) {
+                    double y = model->logistic ? (labels[i] == k) : labels[i];
+                    pb[(size_t)r * outputs + k] += xr * y;
+                }
             }
         }
-   }
-    file = fopen("/home/anubhav/GraphNN/GNN/pubmed/labels.txt", "r");  
-    double *y_true = (double *)malloc(rows * sizeof(double *));
-   for (int i = 0; i < rows; i++) {
-            if (fscanf(file, "%lf", &y_true[i]) != 1) {
-                fprintf(stderr, "Error reading data from the file\n");
-                return 1;
+        #pragma omp for schedule(static)
+        for (size_t e = 0; e < block; ++e) {
+            double sum = 0.0;
+            for (int t = 0; t < nthreads; ++t) {
+                sum += partial[t * block + e];
             }
+            A[e] = sum;
+        }
     }
-    double lo = 0.0;
-    double w = 1.0;
-    double b = 0.0;
-    double y_pred[19717];
-    double gradient_w[1] = {0.0};
-    double gradient_b[1] = {0.0};
-    double start_time = omp_get_wtime();
-    for (int epoch = 0; epoch < 500; epoch++) {
-        linear_regression(x, y_pred, w, b);
-        compute_gradients(x, y_true, y_pred, gradient_w, gradient_b);
+    free(partial);
+    for (int r = 0; r < cols; ++r) {
+        A[(size_t)r * n + r] += ridge * rows;
+    }
+    if (cholesky(A, n) != 0) {
+        fprintf(stderr, "X^T X is not positive definite\n");
+        free(A);
+        return 1;
+    }
+    double *z = (double *)malloc(n * sizeof(double));
+    for (int k = 0; k < outputs; ++k) {
+        for (int r = 0; r < n; ++r) {
+            z[r] = B[(size_t)r * outputs + k];
+        }
+        cholesky_solve(A, n, z);
+        memcpy(model->w + (size_t)k * cols, z, cols * sizeof(double));
+        model->b[k] = z[cols];
+    }
+    free(z);
+    free(A);
+    return 0;
+}
 
-        w -= learning_rate * gradient_w[0]; // Update parameters using gradient descent
-        b -= learning_rate * gradient_b[0];
 
-        double loss_ = loss_cal(y_true, y_pred);
-        //printf("Epoch %d: Loss=%.4f, b=%.4f\n", epoch + 1, loss_, b);
-        lo = loss_;
+// Fraction of rows whose prediction (rounded value or argmax) is the label
+double accuracy(const double *y_pred, const int *labels, const Linear *model, long rows) {
+    long hits = 0;
+    #pragma omp parallel for reduction(+:hits) schedule(static)
+    for (long i = 0; i < rows; i++) {
+        const double *zi = y_pred + (size_t)i * model->outputs;
+        int best = 0;
+        if (model->logistic) {
+            for (int k = 1; k < model->outputs; ++k) {
+                best = zi[k] > zi[best] ? k : best;
+            }
+        } else {
+            best = (int)lround(zi[0]);
+        }
+        hits += best == labels[i];
+    }
+    return (double)hits / rows;
+}
+
+
+int main(int argc, char **argv) {
+    Dataset data;
+    if (datasetLoad(&data, argc > 1 ? argv[1] : DATASET_DIR, 0) != 0) {         // reading the dataset
+        return 1;
+    }
+    int epochs = argc > 2 ? atoi(argv[2]) : 500;
+    int logistic = argc > 3 && strcmp(argv[3], "logistic") == 0;
+    int normal = argc > 4 && strcmp(argv[4], "normal") == 0;
+    long rows = data.n_nodes;
+    int cols = data.n_features;
+
+    double *x = (double *)malloc((size_t)rows * cols * sizeof(double));
+    for (long e = 0; e < (long)rows * cols; e++) {
+        x[e] = data.features[e];
+    }
+    Linear model;
+    init_linear(&model, cols, logistic ? data.n_classes : 1, logistic);
+    double *y_pred = (double *)malloc((size_t)rows * model.outputs * sizeof(double));
+
+    double lo = 0.0;
+    double start_time = omp_get_wtime();
+    if (normal) {
+        if (normal_equations(x, data.labels, &model, rows) != 0) {
+            return 1;
+        }
+        linear_regression(x, y_pred, &model, rows);
+        double acc = accuracy(y_pred, data.labels, &model, rows);
+        lo = loss_cal(data.labels, y_pred, &model, rows);
+        printf("Normal equations: Loss=%.4f, accuracy=%.4f\n", lo, acc);
+    } else {
+        for (int epoch = 0; epoch < epochs; epoch++) {
+            linear_regression(x, y_pred, &model, rows);
+            lo = loss_cal(data.labels, y_pred, &model, rows);
+            compute_gradients(x, y_pred, &model, rows);
+            adam_update(&model);
+            //printf("Epoch %d: Loss=%.4f\n", epoch + 1, lo);
+        }
+        linear_regression(x, y_pred, &model, rows);
+        printf("Loss=%.4f, b=%.4f, accuracy=%.4f\n", lo, model.b[0], accuracy(y_pred, data.labels, &model, rows));
     }
-    printf("Loss=%.4f, b=%.4f\n", lo, b);
     double end = omp_get_wtime();
-    printf("%f",end-start_time);
+    printf("%f\n", end - start_time);
+
+    free(x);
+    free(y_pred);
+    free_linear(&model);
+    datasetFree(&data);
     return 0;
 }
@@ -1,14 +1,19 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<math.h>
+#include "dataset.h"
+#include "arena.h"
+#include "reduce.h"
 
 #define learning_rate 0.001
-#define num_features 500
-#define num_edges 88648
 #define num_layers 5
-#define num_nodes 19717
 #define epsilon 1e-8
 
+// Sizes of the loaded dataset, set once in main
+int num_nodes;
+long num_edges;
+int num_features;
+
 typedef struct Node{
     double  node;
     double *feature;
@@ -20,15 +25,18 @@ typedef struct Egdes{
     double dest_node;
 } Edges;
 
+// weights is num_features x num_features, row-major
 typedef struct GNLayers{
-    double weights[num_features][num_features];
+    double *weights;
     double *bias;
 }GNLayers;
 
-void initializeGNLayer(GNLayers * layer) {
+void initializeGNLayer(GNLayers * layer, Arena *arena) {
+    layer->weights = (double*)arenaAlloc(arena, (size_t)num_features * num_features * sizeof(double), 0);
+    layer->bias = (double*)arenaAlloc(arena, num_features * sizeof(double), 0);
     for (int i = 0; i < num_features; i++) {
         for (int j = 0; j < num_features; j++) {
-            layer->weights[i][j] = ((float)rand() / RAND_MAX) - 0.5;
+            layer->weights[(size_t)i * num_features + j] = ((float)rand() / RAND_MAX) - 0.5;
         }
         layer->bias[i] = 0.0;
     }
@@ -48,21 +56,21 @@ void messagePassing(Node nodes[], Edges edges[], GNLayers* layer) {
                     new_feature += nodes[k].feature[j] * 1;
                 }
             }
-            nodes[i].feature[j] = relu(new_feature * layer->weights[j][j] + layer->bias[j]);
+            nodes[i].feature[j] = relu(new_feature * layer->weights[(size_t)j * num_features + j] + layer->bias[j]);
         }
     }
 }
 
 
+// Per-row squared errors summed with reduceSum (same value for any thread count)
 double computeMSE(Node nodes[], double labels[]) {
-    double mse = 0.0;
+    double *row_error = (double*)malloc(num_nodes * sizeof(double));
+    #pragma omp parallel for schedule(static)
     for (int i = 0; i < num_nodes; i++) {
-        for (int j = 0;j<num_features;j++){
-            double prediction = nodes[i].feature[j]; 
-            double error = prediction - labels[i];
-            mse += (error * error);
-        }
+        row_error[i] = reduceSquaredDiff(nodes[i].feature, labels[i], num_features);
     }
+    double mse = reduceSum(row_error, num_nodes);
+    free(row_error);
     return mse / num_nodes;
 }
 
@@ -70,13 +78,14 @@ double computeMSE(Node nodes[], double labels[]) {
 
 double computeGradient(Node nodes[], Edges edges[], GNLayers* layer, double labels[], int node_index, int feature_index) {
     double loss = computeMSE(nodes, labels);
-    double original_weight = layer->weights[feature_index][feature_index];
+    double *weight = &layer->weights[(size_t)feature_index * num_features + feature_index];
+    double original_weight = *weight;
 
 
-    layer->weights[feature_index][feature_index] += epsilon;        // Perturb the weight slightly and compute the loss
+    *weight += epsilon;        // Perturb the weight slightly and compute the loss
     double perturbed_loss = computeMSE(nodes, labels);
 
-    layer->weights[feature_index][feature_index] = original_weight;         // Reset the weight
+    *weight = original_weight;         // Reset the weight
 
     double gradient = (perturbed_loss - loss) / epsilon;                // Compute the gradient
 
@@ -90,85 +99,48 @@ void backwardPass(Node nodes[], Edges edges[], GNLayers* layer,double labels[])
     for (int i = 0; i < num_nodes; i++) {
         for (int j = 0; j < num_features; j++) {
             double gradient = computeGradient(nodes, edges, layer, labels, i, j);
-            layer->weights[j][j] -= learning_rate * gradient;
+            layer->weights[(size_t)j * num_features + j] -= learning_rate * gradient;
         }
     }
 }
 
 
-int main(){
-    GNLayers layers[num_layers];
-    Edges edges[88648];
-    Node nodes[19718];
-
-
-    double labels[88648];
-
-    FILE *src = fopen("/home/anubhav/GraphNN/GNN/pubmed/src.txt", "r");
-    FILE *dest = fopen("/home/anubhav/GraphNN/GNN/pubmed/destination.txt", "r");
+// test_2 [dataset_dir]
+int main(int argc, char **argv){
+    Dataset data;
+    if (datasetLoad(&data, argc > 1 ? argv[1] : DATASET_DIR, 0) != 0) {
+        return 1;
+    }
+    num_nodes = data.n_nodes;
+    num_edges = data.n_edges;
+    num_features = data.n_features;
 
-    double source, destination;
-    int i = 0;
-    while (fscanf(dest, "%lf", &source) == 1) { // Check the return value of fscanf
-        edges[i].dest_node = source;
-        //printf("%lf  %lf   ", edges[i].src_node,source); // Print the value you just stored
-        i++;
-        if (i == 88648) {
-            break;
-        }
-}
-    // printf("3\n");
-    while (fscanf(src, "%lf", &source) == 1) { // Check the return value of fscanf
-        edges[i].src_node = source;
-        // printf("%lf    ", edges[i].src_node); // Print the value you just stored
-        i++;
-        if (i == 88648) {
-            break;
-        }
+    // Everything below lives for the whole run
+    Arena arena;
+    arenaInit(&arena, "run", 0, ARENA_HUGE_THP);
+    GNLayers layers[num_layers];
+    for (int layer = 0; layer < num_layers; layer++) {
+        initializeGNLayer(&layers[layer], &arena);
     }
-    i = 0;
-    double prev = -11111;
-    FILE *noddes = fopen("/home/anubhav/GraphNN/GNN/pubmed/src.txt", "r");
-    i = 0;
-    while (fscanf(noddes, "%lf", &destination) ) { 
-        if(prev != destination){
-            prev = destination;
-            nodes[i].node = destination;
-            i++;
-            // printf("%d\n",i);
-        }
-        if(i==19717)
-        break;
+    Edges *edges = (Edges*)arenaAlloc(&arena, num_edges * sizeof(Edges), 0);
+    Node *nodes = (Node*)arenaAlloc(&arena, num_nodes * sizeof(Node), 0);
+    double *labels = (double*)arenaAlloc(&arena, num_nodes * sizeof(double), 0);
+    double *features = (double*)arenaAlloc(&arena, (size_t)num_nodes * num_features * sizeof(double), 0);
+
+    for (long e = 0; e < num_edges; e++) {
+        edges[e].src_node = data.src[e];
+        edges[e].dest_node = data.dst[e];
     }
-    int j = 1;
-    i = 0;
-   
-    FILE *feat = fopen("/home/anubhav/GraphNN/GNN/pubmed/features.txt", "r");
-    
-
-    while (fscanf(feat, "%lf", &destination) ==1 ) {
-            nodes[i].feature = (double*)malloc(500 * sizeof(double)); 
-            //printf("%d  %d\n",j,i);
-            nodes[i].feature[j] = destination;
-           // printf("%lf\n",nodes[i].feature[j]);
-            j++;
-        if(j%500==0){
-            i++;
-            j = 0;
-        }
-
-        if(i==19717){
-            break;
+    for (int i = 0; i < num_nodes; i++) {
+        nodes[i].node = i;
+        nodes[i].feature = features + (size_t)i * num_features;
+        for (int j = 0; j < num_features; j++) {
+            nodes[i].feature[j] = data.features[(size_t)i * num_features + j];
         }
+        labels[i] = data.labels[i];
     }
-    printf("  %lf\n",nodes[19717].feature[7]);
-
-    FILE *label = fopen("/home/anubhav/GraphNN/GNN/pubmed/labels.txt", "r");
-    i = 0;
-    while (fscanf(label, "%lf", &destination) ) { 
-            labels[i] = destination;
-            i++;
-    }
+    datasetFree(&data);
+    printf("  %lf\n",nodes[num_nodes - 1].feature[7]);
 
 
 
@@ -185,5 +157,7 @@ int main(){
         }
     }
 
+    arenaReport(&arena, stdout);
+    arenaRelease(&arena);
     return 0;
 }
@@ -2,13 +2,32 @@
 #include<stdlib.h>
 #include<math.h>
 #include<omp.h>
+#include<string.h>
+#include "checkpoint.h"
+#include "dataset.h"
+#include "arena.h"
+#include "reduce.h"
+#include "team.h"
 
 #define learning_rate 0.001
-#define num_features 500
-#define num_edges 88648
 #define num_layers 5
-#define num_nodes 19717
 #define epsilon 1e-8
+#define rng_seed 1
+#define checkpoint_every 10
+#define checkpoint_path "node_weight_ckpt.bin"
+
+// run_arena -> parameters and features, for the whole run.
+// epoch_arena -> per-epoch scratch (checkpoint packing, loss rows), cleared every epoch.
+Arena run_arena;
+Arena epoch_arena;
+
+// Worker team that runs the training loop
+Team team;
+
+// Sizes of the loaded dataset, set once in main
+int num_nodes;
+long num_edges;
+int num_features;
 
 typedef struct Node{
     int  node;
@@ -23,8 +42,9 @@ typedef struct NodeWeight{
 
 void initializeGNLayer(NodeWeight *layer) {  
 
+        double *weights = (double *) arenaAlloc(&run_arena, (size_t)num_nodes * num_features * sizeof(double), 0);
         for (int i = 0; i < num_nodes; i++) {
-            layer[i].weights = (double *) malloc(num_features * sizeof(double));
+            layer[i].weights = weights + (size_t)i * num_features;
             layer[i].bias = 0.01;
           //initializing random values to the weight matrix 
             for (int j = 0; j < num_features; j++) {
@@ -42,40 +62,83 @@ float sigmoid(double x){
     return 1/(1+exp(-x));
 }
 
-void messagePassing(Node nodes[], NodeWeight *layer,int csr[],int dest[],int label[]) {
-    long x=  0,prev = 0;
-    for (int i = 0; i < num_nodes; i++) { 
-              #pragma omp parallel for                          // updates the features of a node
-        for (int j = 0; j < num_features; j++) {
-            double new_feature = 0.0;
-            for (int k = prev; k <= csr[i]; k++) {
+// s_i, the sum of feature 1 over the neighbors of node i, is the same for
+// every feature j of i, except that once feature 1 of i is written a node
+// that is its own neighbor sees the new value. Nodes are updated in order
+// and later nodes read the feature 1 that earlier nodes just wrote, so the
+// master does features 0 and 1 node by node and keeps the sum the rest of
+// the row sees; features 2 onwards of all nodes are then one partition over
+// the team.
+typedef struct MessageRows {
+    Node *nodes;
+    NodeWeight *layer;
+    double *sum;
+} MessageRows;
+
+
+void messageRows(void *ctx, long begin, long end) {
+    MessageRows *m = (MessageRows *) ctx;
+    for (long i = begin; i < end; i++) {
+        for (int j = 2; j < num_features; j++) {
+            double y = relu(m->sum[i]*m->layer[i].weights[j]+m->layer[i].bias);
+            m->nodes[i].feature[j] = y;
+        }
+    }
+}
 
-                     int g = dest[k];
-                     //if(label[i] == label[g])
-                        new_feature += nodes[g].feature[1] ;
-                        //printf("%lf\n",new_feature);
 
-            }
-           double y = relu(new_feature*layer[i].weights[j]+layer[i].bias);
-            nodes[i].feature[j] = y;
+double neighborSum(Node nodes[], int dest[], long prev, long last) {
+    double new_feature = 0.0;
+    for (long k = prev; k <= last; k++) {
+        int g = dest[k];
+        //if(label[i] == label[g])
+        new_feature += nodes[g].feature[1] ;
+    }
+    return new_feature;
+}
 
+
+void messagePassing(Node nodes[], NodeWeight *layer,int csr[],int dest[],int label[],double *sum,int tid) {
+    if (tid == 0) {
+        long x=  0,prev = 0;
+        for (int i = 0; i < num_nodes; i++) {                     // updates the features of a node
+            double new_feature = neighborSum(nodes, dest, prev, csr[i]);
+            for (int j = 0; j < num_features && j < 2; j++) {
+                double y = relu(new_feature*layer[i].weights[j]+layer[i].bias);
+                nodes[i].feature[j] = y;
+            }
+            sum[i] = neighborSum(nodes, dest, prev, csr[i]);
+            x++;
+            prev = csr[x];
         }
-        x++;
-        prev = csr[x];
     }
+    teamBarrier(&team, tid);
+    MessageRows rows = {nodes, layer, sum};
+    teamFor(&team, tid, num_nodes, 0, messageRows, &rows);
 }
 
 
-double computeMSE(Node nodes[], int labels[]) {          //Calculating mean square error to reduce loss
-    double mse = 0.0;
-    for (int i = 0; i < num_nodes; i++) {
-        for (int j = 0;j<num_features;j++){
-            double prediction = nodes[i].feature[j]; 
-            double error = prediction - labels[i];
-            mse += (error * error);
-        }
+typedef struct ErrorRows {
+    Node *nodes;
+    int *labels;
+    double *row_error;
+} ErrorRows;
+
+
+void errorRows(void *ctx, long begin, long end) {
+    ErrorRows *r = (ErrorRows *) ctx;
+    for (long i = begin; i < end; i++) {
+        r->row_error[i] = reduceSquaredDiff(r->nodes[i].feature, r->labels[i], num_features);
     }
-    return mse / num_nodes;
+}
+
+
+// Every thread reduces the rows itself (same fixed-shape sum, same value),
+// which is cheaper than handing the result over with another barrier
+double computeMSE(Node nodes[], int labels[], double *row_error, int tid) {          //Calculating mean square error to reduce loss
+    ErrorRows rows = {nodes, labels, row_error};
+    teamFor(&team, tid, num_nodes, 0, errorRows, &rows);
+    return reduceSum(row_error, num_nodes) / num_nodes;      // fixed-shape sum, same for any thread count
 }
 
 
@@ -96,100 +159,171 @@ double computeGradient(Node nodes[],  NodeWeight* layer, int labels[], int node_
 
 
 
-void backwardPass(Node nodes[],  NodeWeight* layer,int labels[],double mse) {           //Backward propagation function
-//#pragma omp parallel for
-    for (int i = 0; i < num_features; i++) {
-        #pragma omp parallel for
+// Rows i are independent; j stays in order within a row, since
+// computeGradient reads weight 0 of the row it updates
+typedef struct GradientRows {
+    Node *nodes;
+    NodeWeight *layer;
+    int *labels;
+    double mse;
+} GradientRows;
+
+
+void gradientRows(void *ctx, long begin, long end) {
+    GradientRows *r = (GradientRows *) ctx;
+    for (long i = begin; i < end; i++) {
         for (int j= 0;j<num_features;j++){
-            double gradient = computeGradient(nodes,  layer, labels, i,j,mse);
-            layer[i].weights[j] -= learning_rate * gradient;
+            double gradient = computeGradient(r->nodes, r->layer, r->labels, i,j,r->mse);
+            r->layer[i].weights[j] -= learning_rate * gradient;
         }
     }
 }
 
 
-void run(Node *nodes, NodeWeight *layers,int labels[],int csr[], int dest[]){
+void backwardPass(Node nodes[],  NodeWeight* layer,int labels[],double mse,int tid) {           //Backward propagation function
+    GradientRows rows = {nodes, layer, labels, mse};
+    teamFor(&team, tid, num_features, 0, gradientRows, &rows);
+}
+
+
+// Snapshot every node's weight vector and bias, and the node features the
+// next epoch starts from (messagePassing rewrites them in place). The
+// weights are packed into one num_nodes x num_features buffer for the writer
+// to copy; the features already are one.
+void saveCheckpoint(Node *nodes, NodeWeight *layers, CkptWriter *writer, int epoch){
+    double *weights = (double *) arenaAlloc(&epoch_arena, (size_t)num_nodes * num_features * sizeof(double), 0);
+    double *bias = (double *) arenaAlloc(&epoch_arena, num_nodes * sizeof(double), 0);
+    for (int i = 0; i < num_nodes; i++) {
+        memcpy(weights + (size_t)i * num_features, layers[i].weights, num_features * sizeof(double));
+        bias[i] = layers[i].bias;
+    }
+    Checkpoint ckpt;
+    ckptInit(&ckpt, epoch, epoch);
+    ckpt.header.rng[0] = rng_seed;
+    ckptAdd2(&ckpt, "weights", CKPT_F64, num_nodes, num_features, weights);
+    ckptAdd1(&ckpt, "bias", CKPT_F64, num_nodes, bias);
+    ckptAdd2(&ckpt, "features", CKPT_F64, num_nodes, num_features, nodes[0].feature);
+    ckptWriterSubmit(writer, &ckpt, checkpoint_path);
+}
+
+
+// Restores the weights and the node features; returns the epoch to resume
+// from, or -1 if the checkpoint can't be used
+int loadCheckpoint(Node *nodes, NodeWeight *layers, const char *path){
+    CkptMap map;
+    if (ckptOpen(&map, path) != 0) {
+        return -1;
+    }
+    const double *weights = (const double *) ckptTensor(&map, "weights", CKPT_F64, (long)num_nodes * num_features);
+    const double *bias = (const double *) ckptTensor(&map, "bias", CKPT_F64, num_nodes);
+    const double *features = (const double *) ckptTensor(&map, "features", CKPT_F64, (long)num_nodes * num_features);
+    if (!weights || !bias || !features) {
+        ckptClose(&map);
+        return -1;
+    }
+    for (int i = 0; i < num_nodes; i++) {
+        memcpy(layers[i].weights, weights + (size_t)i * num_features, num_features * sizeof(double));
+        layers[i].bias = bias[i];
+    }
+    memcpy(nodes[0].feature, features, (size_t)num_nodes * num_features * sizeof(double));
+    int epoch = (int)map.header->epoch + 1;
+    ckptClose(&map);
+    return epoch;
+}
+
+
+// The whole training loop is one parallel region: the kernels are
+// partitions over the team and the master does the printing and checkpoints
+void run(Node *nodes, NodeWeight *layers,int labels[],int csr[], int dest[], int start_epoch){
     float start = omp_get_wtime();
-    for (int epoch = 0; epoch < 100; epoch++) {
+    CkptWriter writer;
+    ckptWriterStart(&writer);
+    double *sum = (double *) arenaAlloc(&run_arena, num_nodes * sizeof(double), 0);
+    double *row_error = (double *) arenaAlloc(&run_arena, num_nodes * sizeof(double), 0);
+    teamInit(&team, 0);
+    #pragma omp parallel num_threads(team.n_threads)
+    {
+      int tid = teamJoin(&team);
+      for (int epoch = start_epoch; epoch < 100; epoch++) {
         for (int layer = 0; layer < num_layers; layer++) {
-            messagePassing(nodes, layers,csr,dest,labels);
+            messagePassing(nodes, layers,csr,dest,labels,sum,tid);
         }
 
-        double current_mse = computeMSE(nodes, labels);
-        printf("Epoch %d, MSE: %lf\n", epoch, current_mse);
+        double current_mse = computeMSE(nodes, labels, row_error, tid);
+        if (tid == 0) {
+            printf("Epoch %d, MSE: %lf\n", epoch, current_mse);
+        }
 
         for (int layer = num_layers - 1; layer >= 0; layer--) {
-            backwardPass(nodes,layers, labels,current_mse);
+            backwardPass(nodes,layers, labels,current_mse,tid);
             // printf("Hello world\n");
         }
+        // Nothing in the next epoch touches the weights before the
+        // master's own message pass, so no barrier is needed here
+        if (tid == 0) {
+            if ((epoch + 1) % checkpoint_every == 0) {
+                saveCheckpoint(nodes, layers, &writer, epoch);
+            }
+            arenaClear(&epoch_arena);
+        }
       }
+    }
+      ckptWriterStop(&writer);
       float end = omp_get_wtime();
       printf("%f",end-start);
-      printf("Done");
+      printf("Done\n");
+      teamReport(&team, stdout, end - start);
  }
 
 
-int main(){
-    Node *nodes = (Node *) malloc(num_nodes * sizeof(Node));
-    NodeWeight *layers = (NodeWeight *) malloc(num_nodes * sizeof(NodeWeight));
+// test_4 [checkpoint|-] [dataset_dir]
+int main(int argc, char **argv){
+    Dataset data;
+    if (datasetLoad(&data, argc > 2 ? argv[2] : DATASET_DIR, 0) != 0) {
+        return 1;
+    }
+    num_nodes = data.n_nodes;
+    num_edges = data.n_edges;
+    num_features = data.n_features;
+
+    arenaInit(&run_arena, "run", 0, ARENA_HUGE_THP);
+    arenaInit(&epoch_arena, "epoch", 0, ARENA_HUGE_THP);
+    Node *nodes = (Node *) arenaAlloc(&run_arena, num_nodes * sizeof(Node), 0);
+    NodeWeight *layers = (NodeWeight *) arenaAlloc(&run_arena, num_nodes * sizeof(NodeWeight), 0);
+    srand(rng_seed);
     initializeGNLayer(layers);    
-    int dest,csr[num_nodes];
-    int i = 0,x = -1;
-    int prev = -11111;
-    FILE *noddes = fopen("/home/anubhav/GraphNN/GNN/pubmed/src.txt", "r");
-    i = 0;
-    while (fscanf(noddes, "%d", &dest) ==1) { 
-        if(prev != dest){
-            prev = dest;
-            nodes[i].node = dest;
-            csr[i] = x;
-            if(i==0){
-            csr[i] = 0;}
-            i++;
+    // csr[i] is the last edge of node i-1 (csr[0] is 0), as messagePassing
+    // expects; the extra entry closes the last node
+    int *csr = (int *) arenaAlloc(&run_arena, (num_nodes + 1) * sizeof(int), 0);
+    double *features = (double *) arenaAlloc(&run_arena, (size_t)num_nodes * num_features * sizeof(double), 0);
+    for (int i = 0; i < num_nodes; i++) {
+        nodes[i].node = i;
+        csr[i] = (i == 0) ? 0 : (int)data.graph->offsets[i] - 1;
+        nodes[i].feature = features + (size_t)i * num_features;
+        for (int j = 0; j < num_features; j++) {
+            nodes[i].feature[j] = data.features[(size_t)i * num_features + j];
         }
-        x++;
     }
-
-    int j = 0;
-    i = 0;
-    double destn;
-   
-    FILE *feat = fopen("/home/anubhav/GraphNN/GNN/pubmed/features.txt", "r");
-    while (fscanf(feat, "%lf", &destn) ==1 ) {
-
-        if(j%num_features==0){
-            j = 0;
-            nodes[i].feature = (double *) malloc(num_features * sizeof(double)); 
-            i++;
+    csr[num_nodes] = (int)num_edges - 1;
+
+    int start_epoch = 0;
+    if (argc > 1 && strcmp(argv[1], "-") != 0) {        // resume from a checkpoint
+        start_epoch = loadCheckpoint(nodes, layers, argv[1]);
+        if (start_epoch < 0) {
+            fprintf(stderr, "Error restoring checkpoint %s\n", argv[1]);
+            return 1;
         }
-            nodes[i-1].feature[j] = destn;
-            j++;
     }
-                    printf("%lf \n",nodes[0].feature[0]);
+    printf("%lf \n",nodes[0].feature[0]);
 
+    run(nodes,layers,data.labels,csr,data.graph->indices,start_epoch);
 
-
-    FILE *desst = fopen("/home/anubhav/GraphNN/GNN/pubmed/destination.txt", "r");
-    int destination[num_edges];
-    i = 0;
-    while (fscanf(desst, "%d", &dest) == 1 ) {
-        destination[i] = dest;
-        i++;
-    }
-
-
-    int *labels,labl;
-    labels = (int*) malloc(num_nodes * sizeof(int));
-    FILE *label = fopen("/home/anubhav/GraphNN/GNN/pubmed/labels.txt", "r");
-    i = 0;
-    while (fscanf(label, "%d", &labl)==1 ) { 
-            labels[i] = destn;
-            i++;
-    }
-    run(nodes,layers,labels,csr,destination);
-
+    arenaReport(&run_arena, stdout);
+    arenaReport(&epoch_arena, stdout);
+    arenaRelease(&run_arena);
+    arenaRelease(&epoch_arena);
+    datasetFree(&data);
     return 0;
 
 
 }
- 
\ No newline at end of file